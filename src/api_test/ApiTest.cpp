@@ -0,0 +1,303 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "TurtleApi.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  svg_path_turtle_api_test - tests of the embedding API (see TurtleApi.h)
+//
+//    The command line is tested by tools/run_tests, but the API's results
+//    are values, so they're checked here: that errors come back as
+//    Messages, that a program runs into a string, that an import is parsed
+//    again once its file has changed, and that SegmentStream gives the same
+//    path data, stops its program when it's destroyed part way through, and
+//    survives a program that recurses without end.
+//
+//    Each failed check is reported, and the exit status is the number of
+//    them.  Run it from any directory - the only imports are of files that
+//    it writes to the temp directory.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static int s_failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if(!ok)
+    {
+	std::cerr << "Failed: " << what << '\n';
+	++s_failures;
+    }
+}
+
+#define CHECK(expr) check(expr, #expr)
+
+static bool has_error(const std::vector<Message> &messages,
+		      const std::string &text)
+{
+    for(const auto &m : messages)
+	if(m.is_error() && m.to_string().find(text) != std::string::npos)
+	    return true;
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  TurtleCompiler and CompiledProgram
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static void test_compile_error(TurtleCompiler &compiler)
+{
+    std::vector<Message> messages;
+
+    auto program = compiler.compile("bad", "f (", messages);
+
+    CHECK(!program);
+    CHECK(has_error(messages, "bad:1:4: Error: Expected an expression"));
+
+    std::string output;
+
+    messages.clear();
+
+    CHECK(!program.execute(Options{}, output, messages));
+    CHECK(output.empty());
+    CHECK(has_error(messages, "The program did not compile"));
+}
+
+static void test_execute(TurtleCompiler &compiler)
+{
+    std::vector<Message> messages;
+
+    auto program = compiler.compile("square", "M 0 0 f 10 r 90 f 10",
+				    messages);
+
+    CHECK(static_cast<bool>(program));
+    CHECK(messages.empty());
+
+    std::string output;
+
+    CHECK(program.execute(Options{}, output, messages));
+    CHECK(output == "M 0 0 L 10 0 L 10 10 \n");
+    CHECK(messages.empty());
+
+    // A program runs as many times as it's asked to, with other options.
+    Options compact;
+
+    compact.compact = true;
+
+    CHECK(program.execute(compact, output, messages));
+    CHECK(output == "M0 0H10V10\n");
+}
+
+static void test_execute_error(TurtleCompiler &compiler)
+{
+    std::vector<Message> messages;
+
+    auto program = compiler.compile("popper", "f 1 pop", messages);
+
+    CHECK(static_cast<bool>(program));
+
+    std::string output;
+
+    CHECK(!program.execute(Options{}, output, messages));
+    CHECK(output.empty());
+    CHECK(has_error(messages, "popper: Error: Empty stack in 'pop' command."));
+}
+
+// A module is parsed again once its file has changed, and so is a module
+// that imports it, although its own file hasn't changed.
+static void test_changed_import(TurtleCompiler &compiler)
+{
+    namespace fs = std::filesystem;
+
+    auto dir = fs::temp_directory_path();
+    auto inner = (dir / "svg_path_turtle_api_test_inner.svgt").string();
+    auto outer = (dir / "svg_path_turtle_api_test_outer.svgt").string();
+
+    std::ofstream(inner) << "def side() { f 10 }\n";
+    std::ofstream(outer) << "import '" << inner << "'\n"
+			 << "def shape() { side }\n";
+
+    std::string text = "import '" + outer + "' M 0 0 shape";
+
+    std::vector<Message> messages;
+    std::string output;
+
+    auto before = compiler.compile("before", text, messages);
+
+    CHECK(before.execute(Options{}, output, messages));
+    CHECK(output == "M 0 0 L 10 0 \n");
+
+    std::ofstream(inner) << "def side() { f 200 }\n";
+
+    // The same text again would run the same code, if nothing had changed.
+    auto after = compiler.compile("after", text, messages);
+
+    CHECK(after.execute(Options{}, output, messages));
+    CHECK(output == "M 0 0 L 200 0 \n");
+    CHECK(messages.empty());
+
+    // The program compiled before the change still runs as it did.
+    CHECK(before.execute(Options{}, output, messages));
+    CHECK(output == "M 0 0 L 10 0 \n");
+
+    fs::remove(inner);
+    fs::remove(outer);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  SegmentStream
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static void test_stream(TurtleCompiler &compiler)
+{
+    std::vector<Message> messages;
+
+    auto program = compiler.compile("stream", "M 0 0 for 10 { f 1 r 90 }",
+				    messages);
+
+    CHECK(static_cast<bool>(program));
+
+    SegmentStream segments(program, Options{}, 4);
+
+    std::vector<PathSegment> batch;
+    std::vector<PathSegment> all;
+
+    while(segments.next(batch))
+    {
+	CHECK(!batch.empty() && batch.size() <= 4);
+
+	all.insert(all.end(), batch.begin(), batch.end());
+    }
+
+    CHECK(batch.empty());
+    CHECK(segments.ok());
+
+    CHECK(all.size() == 11);
+
+    if(all.size() == 11)
+    {
+	CHECK(all[0].command == 'M' && all[0].num_args == 2);
+	CHECK(all[1].command == 'L' && all[1].num_args == 2);
+	CHECK(all[1].args[0] == 1 && all[1].args[1] == 0);
+	CHECK(all[10].command == 'L');
+    }
+}
+
+static void test_stream_not_compiled()
+{
+    SegmentStream segments(CompiledProgram{}, Options{});
+
+    std::vector<PathSegment> batch;
+
+    CHECK(!segments.next(batch));
+    CHECK(!segments.ok());
+    CHECK(has_error(segments.get_messages(), "The program did not compile"));
+}
+
+// A program that would draw far more than the pipe holds is stopped when
+// its stream is destroyed (rather than this waiting for it to finish, or
+// it waiting forever for room in the pipe).
+static void test_stream_destroyed_early(TurtleCompiler &compiler)
+{
+    std::vector<Message> messages;
+
+    auto program = compiler.compile("endless", "for 100000000 { f 1 }",
+				    messages);
+
+    CHECK(static_cast<bool>(program));
+
+    {
+	SegmentStream segments(program, Options{}, 16);
+
+	std::vector<PathSegment> batch;
+
+	CHECK(segments.next(batch));
+	CHECK(batch.size() == 16);
+    }
+
+    {
+	// Not even started on
+	SegmentStream segments(program, Options{}, 16);
+    }
+}
+
+// Recursion without end is a stack overflow error on the stream's thread,
+// with either backend, rather than a crash, however small the platform's
+// threads' stacks are.
+static void test_stream_deep_recursion(bool bytecode)
+{
+    TurtleCompiler compiler(bytecode);
+
+    std::vector<Message> messages;
+
+    auto program = compiler.compile("deep", "def t(n) { t (n + 1) f 1 } t 0",
+				    messages);
+
+    CHECK(static_cast<bool>(program));
+
+    SegmentStream segments(program, Options{});
+
+    std::vector<PathSegment> batch;
+
+    while(segments.next(batch))
+	;
+
+    CHECK(!segments.ok());
+    CHECK(has_error(segments.get_messages(), "Stack overflow"));
+}
+
+int main()
+{
+    TurtleCompiler compiler;
+
+    test_compile_error(compiler);
+    test_execute(compiler);
+    test_execute_error(compiler);
+    test_changed_import(compiler);
+
+    test_stream(compiler);
+    test_stream_not_compiled();
+    test_stream_destroyed_early(compiler);
+    test_stream_deep_recursion(false);
+    test_stream_deep_recursion(true);
+
+    if(s_failures)
+	std::cerr << s_failures << " failure(s)\n";
+    else
+	std::cout << "Ok.\n";
+
+    return s_failures;
+}
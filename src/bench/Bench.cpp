@@ -0,0 +1,562 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Engine.h"
+#include "Tokenizer.h"
+#include "Parser.h"
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <functional>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  svg_path_turtle_bench - benchmarks for the parser, engine and turtle
+//
+//    Each workload is a generated turtle program, scaled by a size parameter.
+//    For each one, this reports:
+//
+//      parse   - lexing, parsing and compiling (a fresh engine each time)
+//      exec    - execution, with the output counted and discarded
+//      total   - both, plus engine construction
+//
+//    along with ns per executed statement, output segments per second, and
+//    the peak RSS of the workload's runs.  Each workload runs in a child
+//    process of its own, so that the peak is its own, rather than the most
+//    of any workload so far (where there's no fork(), the column is 0).
+//
+//    The executed statement count is the engine's own, as --max-statements
+//    counts them, taken from the timed runs (so with loop unrolling and tail
+//    calls, which a debug sink would turn off).  Statements of builtins (f,
+//    r, push, ...) are not counted separately - they are part of the user
+//    statement that calls them.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+using clock_type = std::chrono::steady_clock;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Output sink
+//
+//    Discards the output, but counts SVG path commands, which are the only
+//    letters in path data.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+class CountingBuf : public std::streambuf
+{
+    char m_buf[4096];
+
+    size_t m_segments = 0;
+
+    void count(const char *begin, const char *end)
+    {
+	for(auto p = begin; p != end; ++p)
+	    if(std::isalpha(static_cast<unsigned char>(*p)))
+		++m_segments;
+    }
+
+protected:
+    int overflow(int ch) override
+    {
+	count(pbase(), pptr());
+
+	setp(m_buf, m_buf + sizeof(m_buf));
+
+	if(ch != traits_type::eof())
+	    sputc(static_cast<char>(ch));
+
+	return 0;
+    }
+
+    int sync() override
+    {
+	overflow(traits_type::eof());
+
+	return 0;
+    }
+
+public:
+    CountingBuf()
+    {
+	setp(m_buf, m_buf + sizeof(m_buf));
+    }
+
+    size_t get_segments()
+    {
+	sync();
+
+	return m_segments;
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Workloads
+//
+//////////////////////////////////////////////////////////////////////////////
+
+struct Workload
+{
+    const char *name;
+    const char *size_label;
+
+    int size;
+    int quick_size;
+
+    bool needs_library;
+
+    std::function<std::string(int)> make_program;
+};
+
+static const std::vector<Workload> s_workloads = {
+    {
+	"polygon", "sides", 1000000, 100000, false,
+	[](int n)
+	{
+	    return "def polygon(n) { for n { f 1 r (360/n) } z }\n"
+		   "M 0 0\n"
+		   "polygon " + std::to_string(n) + "\n";
+	}
+    },
+    {
+	"hilbert", "depth", 8, 6, false,
+	[](int n)
+	{
+	    return "def hilbert(level angle)\n"
+		   "{\n"
+		   "  if level > 0\n"
+		   "  {\n"
+		   "    l angle\n"
+		   "    hilbert (level - 1) -angle\n"
+		   "    f 4\n"
+		   "    r angle\n"
+		   "    hilbert (level - 1) angle\n"
+		   "    f 4\n"
+		   "    hilbert (level - 1) angle\n"
+		   "    r angle\n"
+		   "    f 4\n"
+		   "    hilbert (level - 1) -angle\n"
+		   "    l angle\n"
+		   "  }\n"
+		   "}\n"
+		   "M 0 0\n"
+		   "hilbert " + std::to_string(n) + " 90\n";
+	}
+    },
+    {
+	"plant", "depth", 11, 8, false,
+	[](int n)
+	{
+	    return "def plant(n len)\n"
+		   "{\n"
+		   "  if n > 0\n"
+		   "  {\n"
+		   "    f len\n"
+		   "    push r 25 plant (n-1) (len*0.7) pop\n"
+		   "    push l 25 plant (n-1) (len*0.7) pop\n"
+		   "    r 5 plant (n-1) (len*0.8)\n"
+		   "  }\n"
+		   "}\n"
+		   "M 0 0\n"
+		   "plant " + std::to_string(n) + " 10\n";
+	}
+    },
+    {
+	"lambdas", "repeats", 20000, 2000, true,
+	[](int n)
+	{
+	    return "import 'library.svgt'\n"
+		   "def each(n fn(i)) { for i = 1..n { fn i } }\n"
+		   "def sq(s) { for 4 { f s r 90 } }\n"
+		   "M 0 0\n"
+		   "for " + std::to_string(n) + "\n"
+		   "{\n"
+		   "  each 5 { =>(i) sq i }\n"
+		   "  rotate 3 { stamp { sq 3 } }\n"
+		   "}\n";
+	}
+    },
+    {
+	"stamps", "stamps", 200000, 20000, true,
+	[](int n)
+	{
+	    // Every point, length and angle goes through two matrices.
+	    return "import 'library.svgt'\n"
+		   "M 0 0\n"
+		   "for " + std::to_string(n) + "\n"
+		   "{\n"
+		   "  r 7 f 1\n"
+		   "  stamp { mirror { ellipse 3 2 c 2 30 2 -30 4 1 } }\n"
+		   "}\n";
+	}
+    },
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Running
+//
+//////////////////////////////////////////////////////////////////////////////
+
+struct RunResult
+{
+    double parse_seconds = 0.0;
+    double exec_seconds = 0.0;
+    double total_seconds = 0.0;
+
+    size_t segments = 0;
+    std::uint64_t statements = 0;
+};
+
+static double seconds_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+static RunResult run_program(const std::string &program,
+			     ExecutionEngine::Backend backend)
+{
+    RunResult result;
+
+    CountingBuf buf;
+    std::ostream out(&buf);
+
+    auto start = clock_type::now();
+
+    ExecutionEngine engine(out, nullptr, backend);
+
+    engine.set_decimal_places(2);
+
+    auto parse_start = clock_type::now();
+
+    size_t main_chunk_index = ExecutionEngine::no_chunk;
+
+    {
+	std::istringstream in(program);
+
+	Lexer lex(in);
+
+	Parser p(lex, engine);
+
+	p.set_filename("<bench>");
+
+	p.parse();
+
+	main_chunk_index = p.get_main();
+    }
+
+    result.parse_seconds = seconds_since(parse_start);
+
+    auto exec_start = clock_type::now();
+
+    engine.execute_main(main_chunk_index);
+
+    out.flush();
+
+    result.exec_seconds = seconds_since(exec_start);
+    result.total_seconds = seconds_since(start);
+
+    result.segments = buf.get_segments();
+    result.statements = engine.get_statements_run();
+
+    return result;
+}
+
+// The best of 'repeats' runs
+static RunResult run_best(const std::string &program,
+			  ExecutionEngine::Backend backend,
+			  int repeats)
+{
+    RunResult best;
+
+    for(int i = 0; i < repeats; ++i)
+    {
+	auto r = run_program(program, backend);
+
+	if(i == 0 || r.total_seconds < best.total_seconds)
+	    best = r;
+    }
+
+    return best;
+}
+
+// As run_best(), but in a child process, whose peak RSS (from wait4()) is
+// returned in peak_rss_kb.  The result comes back through a pipe.
+static RunResult run_in_child(const std::string &program,
+			      ExecutionEngine::Backend backend,
+			      int repeats,
+			      long &peak_rss_kb)
+{
+    peak_rss_kb = 0;
+
+#if defined(__unix__) || defined(__APPLE__)
+    int fds[2];
+
+    if(pipe(fds) != 0)
+    {
+	std::cerr << "ERROR: pipe: " << strerror(errno) << '\n';
+	exit(1);
+    }
+
+    // Otherwise the child would write out the parent's buffered output too.
+    std::cout.flush();
+
+    pid_t pid = fork();
+
+    if(pid < 0)
+    {
+	std::cerr << "ERROR: fork: " << strerror(errno) << '\n';
+	exit(1);
+    }
+
+    if(pid == 0)
+    {
+	close(fds[0]);
+
+	auto best = run_best(program, backend, repeats);
+
+	bool written = write(fds[1], &best, sizeof(best)) == sizeof(best);
+
+	_exit(written ? 0 : 1);
+    }
+
+    close(fds[1]);
+
+    RunResult best;
+
+    bool was_read = read(fds[0], &best, sizeof(best)) == sizeof(best);
+
+    close(fds[0]);
+
+    int status = 0;
+    rusage usage{};
+
+    if(wait4(pid, &status, 0, &usage) != pid || !was_read
+       || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+	std::cerr << "ERROR: the benchmark's child process failed\n";
+	exit(1);
+    }
+
+#if defined(__APPLE__)
+    peak_rss_kb = usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    peak_rss_kb = usage.ru_maxrss;
+#endif
+
+    return best;
+#else
+    return run_best(program, backend, repeats);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Options
+//
+//////////////////////////////////////////////////////////////////////////////
+
+struct BenchOptions
+{
+    int repeats = 3;
+    bool quick = false;
+
+    bool closures = true;
+    bool bytecode = true;
+
+    std::vector<std::string> only;
+
+    bool wants(const Workload &w) const
+    {
+	if(only.empty())
+	    return true;
+
+	for(const auto &name : only)
+	    if(name == w.name)
+		return true;
+
+	return false;
+    }
+};
+
+static const char *s_command_name = "svg_path_turtle_bench";
+
+static void exit_w_usage(const std::string &msg = {})
+{
+    if(!msg.empty())
+	std::cerr << "ERROR: " << msg << '\n';
+
+    std::cerr << "Usage: " << s_command_name
+	      << " [OPTION]... [WORKLOAD]..." << '\n';
+
+    std::cerr << R"(
+ --quick              - use small sizes (a smoke test, not a measurement)
+ --repeats <N>        - timed runs per workload (the best one is reported)
+ --closures           - only benchmark the closure backend
+ --bytecode           - only benchmark the bytecode backend
+ -h,--help            - show this help
+
+Workloads: polygon hilbert plant lambdas stamps (default: all)
+
+The lambdas and stamps workloads import library.svgt from the current
+directory.
+)";
+
+    exit(msg.empty() ? 0 : 1);
+}
+
+static BenchOptions parse_command_line(int argc, char **argv)
+{
+    BenchOptions opt;
+
+    for(int i = 1; i < argc; ++i)
+    {
+	const char *arg = argv[i];
+
+	auto opt_is = [&](const char *s) { return strcmp(arg, s) == 0; };
+
+	if(opt_is("--help") || opt_is("-h")) exit_w_usage();
+	else if(opt_is("--quick"))          opt.quick = true;
+	else if(opt_is("--closures"))       opt.bytecode = false;
+	else if(opt_is("--bytecode"))       opt.closures = false;
+	else if(opt_is("--repeats"))
+	{
+	    if(++i == argc)
+		exit_w_usage("--repeats requires a number");
+
+	    opt.repeats = atoi(argv[i]);
+
+	    if(opt.repeats < 1)
+		exit_w_usage("--repeats: invalid number");
+	}
+	else if(arg[0] == '-')
+	    exit_w_usage("Unrecognized option: " + std::string(arg));
+	else
+	    opt.only.emplace_back(arg);
+    }
+
+    if(!opt.closures && !opt.bytecode)
+	exit_w_usage("Only one of --closures or --bytecode is allowed");
+
+    return opt;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Main
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static void bench(const Workload &w,
+		  int size,
+		  ExecutionEngine::Backend backend,
+		  int repeats)
+{
+    auto program = w.make_program(size);
+
+    long peak_rss_kb = 0;
+
+    auto best = run_in_child(program, backend, repeats, peak_rss_kb);
+
+    auto statements = best.statements;
+
+    double ns_per_statement = statements
+			    ? best.exec_seconds * 1e9 / statements
+			    : 0.0;
+
+    double segments_per_second = best.exec_seconds > 0
+			       ? best.segments / best.exec_seconds
+			       : 0.0;
+
+    std::string label = std::string(w.name) + " " + w.size_label
+		      + "=" + std::to_string(size);
+
+    std::cout << std::left << std::setw(24) << label
+	      << std::setw(10)
+	      << (backend == ExecutionEngine::Backend::bytecode ? "bytecode"
+								: "closures")
+	      << std::right << std::fixed
+	      << std::setprecision(2)
+	      << std::setw(10) << best.parse_seconds * 1e3
+	      << std::setw(10) << best.exec_seconds * 1e3
+	      << std::setw(10) << best.total_seconds * 1e3
+	      << std::setprecision(1)
+	      << std::setw(10) << ns_per_statement
+	      << std::setprecision(0)
+	      << std::setw(14) << segments_per_second
+	      << std::setw(12) << peak_rss_kb
+	      << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    auto opt = parse_command_line(argc, argv);
+
+    std::cout << std::left << std::setw(24) << "workload"
+	      << std::setw(10) << "backend"
+	      << std::right
+	      << std::setw(10) << "parse ms"
+	      << std::setw(10) << "exec ms"
+	      << std::setw(10) << "total ms"
+	      << std::setw(10) << "ns/stmt"
+	      << std::setw(14) << "segments/s"
+	      << std::setw(12) << "peak KB"
+	      << '\n';
+
+    for(const auto &w : s_workloads)
+    {
+	if(!opt.wants(w))
+	    continue;
+
+	if(w.needs_library && !std::ifstream("library.svgt"))
+	{
+	    std::cout << w.name << ": skipped (library.svgt not found)\n";
+	    continue;
+	}
+
+	int size = opt.quick ? w.quick_size : w.size;
+
+	if(opt.closures)
+	    bench(w, size, ExecutionEngine::Backend::closures, opt.repeats);
+
+	if(opt.bytecode)
+	    bench(w, size, ExecutionEngine::Backend::bytecode, opt.repeats);
+    }
+}
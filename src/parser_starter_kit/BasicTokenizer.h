@@ -203,8 +203,7 @@ private: // base tokens - id, num, 1-char punctuation, .., ...
 	{
 	    push();
 
-	    while(is_id_tailchar())
-		push();
+	    push_while(is_id_tail_char);
 
 	    m_token = tk_identifier;
 
@@ -235,8 +234,7 @@ private: // base tokens - id, num, 1-char punctuation, .., ...
 
 	m_token = tk_integer;
 
-	while(is_digit())
-	    push();
+	push_while(is_digit_char);
 
 	// note: 1..3 is 1 .. 3
 	if(is('.') && !next_is('.'))
@@ -245,8 +243,7 @@ private: // base tokens - id, num, 1-char punctuation, .., ...
 
 	    m_token = tk_number;
 
-	    while(is_digit())
-		push();
+	    push_while(is_digit_char);
 	}
 
 	if(is('e') || is('E'))
@@ -257,8 +254,7 @@ private: // base tokens - id, num, 1-char punctuation, .., ...
 
 	    push_if('-');
 
-	    while(is_digit())
-		push();
+	    push_while(is_digit_char);
 	}
 
 	return true;
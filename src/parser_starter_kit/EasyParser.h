@@ -28,6 +28,7 @@
 #include "ParserBase.h"
 
 #include <memory>
+#include <memory_resource>
 
 namespace ParserStarterKit {
 
@@ -63,6 +64,9 @@ protected:
 
     LexicalContextStackType m_names;
 
+    // If set, name definitions are allocated from here instead of the heap.
+    std::pmr::memory_resource *m_name_resource = nullptr;
+
 public:
     EasyParser(TokenInterface &tokens,
 		  LexerInterface &lexer)
@@ -85,7 +89,13 @@ public:
 	    auto &p = *ptr_to_shared_ptr;
 
 	    if(!p.get())
-		p = std::make_shared<NameType>();
+	    {
+		if(m_name_resource)
+		    p = std::allocate_shared<NameType>(
+			    std::pmr::polymorphic_allocator<NameType>(m_name_resource));
+		else
+		    p = std::make_shared<NameType>();
+	    }
 
 	    return dynamic_cast<NameType*>(p.get());
 	}
@@ -93,6 +103,12 @@ public:
 	return nullptr;
     }
 
+    // The resource must outlive every name defined through this parser.
+    void set_name_resource(std::pmr::memory_resource *resource)
+    {
+	m_name_resource = resource;
+    }
+
     NameBaseType *lookup_name(const std::string &name, bool required = false)
     {
 	auto ptr_to_shared_ptr = Base::lookup_name(name, required);
@@ -48,6 +48,11 @@ namespace ParserStarterKit {
 //    InputInterface, to bind this to an istream, or FILE*,
 //    in-memory buffer, etc...
 //
+//    Or, for input that is all in memory, call set_input_buffer()
+//    instead.  Characters are then read with pointer arithmetic
+//    (no virtual call per character), and TokenizerBase gets each
+//    token's text as one slice of the buffer.
+//
 /////////////////////////////////////////////////////////////////
 
 class InputBase : public InputInterface
@@ -57,6 +62,28 @@ class InputBase : public InputInterface
 
     Location m_input_loc;
 
+    // Where the input starts - see set_input_start()
+    Location m_start_loc{ 1, 1 };
+
+    // Buffered input - see set_input_buffer()
+    const char *m_buffer_begin = nullptr;
+    const char *m_buffer_pos = nullptr;
+    const char *m_buffer_end = nullptr;
+
+    // Where m_current_char is, in the buffer
+    const char *m_current_ptr = nullptr;
+
+    int read_char()
+    {
+	if(!m_buffer_begin)
+	    return get_next_char();
+
+	if(m_buffer_pos == m_buffer_end)
+	    return EOF;
+
+	return static_cast<unsigned char>(*m_buffer_pos++);
+    }
+
     void next_line()
     {
 	++m_input_loc.linenum;
@@ -73,12 +100,74 @@ protected:
     {
 	assert(!is_input_initialized());
 
-	next_line();
+	m_input_loc = m_start_loc;
+
+	m_current_ptr = m_buffer_pos;
 
-	m_current_char = get_next_char();
+	m_current_char = read_char();
 
 	if(m_current_char != EOF)
-	    m_next_char = get_next_char();
+	    m_next_char = read_char();
+    }
+
+    // The input is [begin, end), which must outlive this object.  Call this
+    // before initialize().
+    void set_input_buffer(const char *begin, const char *end)
+    {
+	assert(!is_input_initialized());
+	assert(begin && begin <= end);
+
+	m_buffer_begin = m_buffer_pos = begin;
+	m_buffer_end = end;
+    }
+
+    // For input that is part of a larger source: the location of its first
+    // character there.  Call this before initialize().
+    void set_input_start(Location start)
+    {
+	assert(!is_input_initialized());
+	assert(start);
+
+	m_start_loc = start;
+    }
+
+    bool is_input_buffered() const
+    {
+	return m_buffer_begin != nullptr;
+    }
+
+    // With buffered input only: the position of peek() in the buffer
+    const char *get_input_ptr() const
+    {
+	assert(is_input_buffered());
+
+	return m_current_ptr;
+    }
+
+    const char *get_input_end() const
+    {
+	assert(is_input_buffered());
+
+	return m_buffer_end;
+    }
+
+    // With buffered input only: skips n characters at once, after they have
+    // been scanned through get_input_ptr().  They must not include a '\n'.
+    void advance_within_line(int n)
+    {
+	assert(is_input_buffered());
+	assert(n >= 0 && n <= m_buffer_end - m_current_ptr);
+
+	if(n == 0)
+	    return;
+
+	m_current_ptr += n;
+	m_input_loc.charnum += n;
+
+	m_buffer_pos = m_current_ptr;
+
+	m_current_char = read_char();
+	m_next_char = read_char();
     }
 
     const Location &get_input_loc() const
@@ -108,32 +197,57 @@ protected:
 
     bool next_is_digit() const
     {
-	return static_cast<bool>(isdigit(peek_next()));
+	return is_digit_char(peek_next());
     }
 
     bool is_punct() const
     {
-	return static_cast<bool>(ispunct(peek()));
+	return is_punct_char(peek());
     }
 
     bool is_alpha() const
     {
-	return static_cast<bool>(isalpha(peek()));
+	return is_alpha_char(peek());
     }
 
     bool is_digit() const
     {
-	return static_cast<bool>(isdigit(peek()));
+	return is_digit_char(peek());
     }
 
     bool is_id_tailchar() const
     {
-	return is('_') || is_alpha() || is_digit();
+	return is_id_tail_char(peek());
     }
 
     bool is_basic_whitespace() const
     {
-	return is('\n') || static_cast<bool>(isblank(peek()));
+	return is('\n') || is(' ') || is('\t');
+    }
+
+    // Character classes, also for TokenizerBase::push_while()
+    //
+    // These are the classes of the "C" locale (i.e. ASCII), written out so
+    // they inline, rather than being a library call per character.
+
+    static bool is_digit_char(int ch)
+    {
+	return ch >= '0' && ch <= '9';
+    }
+
+    static bool is_alpha_char(int ch)
+    {
+	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+    }
+
+    static bool is_punct_char(int ch)
+    {
+	return ch > ' ' && ch < 0x7f && !is_digit_char(ch) && !is_alpha_char(ch);
+    }
+
+    static bool is_id_tail_char(int ch)
+    {
+	return ch == '_' || is_alpha_char(ch) || is_digit_char(ch);
     }
 
     void advance()
@@ -145,8 +259,10 @@ protected:
 	else
 	    ++m_input_loc.charnum;
 
+	++m_current_ptr;
+
 	m_current_char = m_next_char;
-	m_next_char = get_next_char();
+	m_next_char = read_char();
     }
 
     // Returns false if no EOL at EOF
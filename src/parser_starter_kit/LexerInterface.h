@@ -26,6 +26,7 @@
 
 #include "SourceLocation.h"
 #include "BasicTokens.h"
+#include "SymbolTable.h"
 
 #include <string>
 
@@ -42,6 +43,9 @@ struct TokenDetails
     int tok = tk_NONE;
     std::string str;
     TokenSpan span;
+
+    // For identifiers, if the tokenizer has a SymbolTable
+    Symbol sym = no_symbol;
 };
 
 class LexerInterface
@@ -26,9 +26,10 @@
 
 #include "NameInterface.h"
 #include "SourceLocation.h"
+#include "SymbolTable.h"
 
 #include <cassert>
-#include <map>
+#include <unordered_map>
 #include <list>
 #include <string>
 
@@ -41,8 +42,8 @@ namespace ParserStarterKit {
 //    For DEF, supply your struct or class type that holds the definition
 //    of a name.
 //
-//  Note: this is a very simple implementation, designed for education and
-//  not efficiency.  It is a stack of std::map objects.
+//  Note: this is a simple implementation: a stack of hash maps, keyed by
+//  the Symbol of each name.
 //
 ///////////////////////////////////////////////////////////////////////////
 
@@ -53,7 +54,9 @@ protected:
     using NamedefType = DEF_TYPE;
 
 public:
-    using ContextType = std::map<std::string, NamedefType>;
+    // Names are interned, so that a lookup hashes an integer rather than
+    // comparing strings.  See set_symbol_table().
+    using ContextType = std::unordered_map<Symbol, NamedefType>;
 
 protected:
     struct ContextEntry
@@ -65,7 +68,23 @@ protected:
 
     std::list<ContextEntry> m_stack;
 
+    SymbolTable m_own_symbols;
+
+    SymbolTable *m_symbols = &m_own_symbols;
+
 public:
+    // To share the symbols of the tokenizer (and of other contexts whose
+    // names get imported here).  Call this before defining any names.
+    void set_symbol_table(SymbolTable &symbols)
+    {
+	m_symbols = &symbols;
+    }
+
+    SymbolTable &get_symbol_table()
+    {
+	return *m_symbols;
+    }
+
     void push_context() override
     {
 	m_stack.emplace_front();
@@ -83,21 +102,33 @@ public:
     // nullptr, unless accept_dup is true, in which case it will return a
     // pointer to the existing Namedef_Type object (for overriding a name).
     NamedefType *define_name(const std::string &name, bool accept_dup = false) override
+    {
+	return define_symbol(m_symbols->intern(name), accept_dup);
+    }
+
+    NamedefType *define_symbol(Symbol sym, bool accept_dup = false)
     {
 	assert(!m_stack.empty());
 
 	auto &context = m_stack.front().context;
 
-	auto res = context.try_emplace(name);
+	auto res = context.try_emplace(sym);
 
 	return res.second ? &res.first->second : nullptr;
     }
 
     NamedefType *lookup_name(const std::string &name) override
+    {
+	auto sym = m_symbols->find(name);
+
+	return sym == no_symbol ? nullptr : lookup_symbol(sym);
+    }
+
+    NamedefType *lookup_symbol(Symbol sym)
     {
 	for(auto &entry : m_stack)
 	{
-	    auto f = entry.context.find(name);
+	    auto f = entry.context.find(sym);
 
 	    if(f != entry.context.end())
 		return &f->second;
@@ -108,11 +139,13 @@ public:
 
     NamedefType *lookup_global_name(const std::string &name) override
     {
-	if(!m_stack.empty())
+	auto sym = m_symbols->find(name);
+
+	if(sym != no_symbol && !m_stack.empty())
 	{
 	    auto &entry = m_stack.back();
 
-	    auto f = entry.context.find(name);
+	    auto f = entry.context.find(sym);
 
 	    if(f != entry.context.end())
 		return &f->second;
@@ -121,6 +154,13 @@ public:
 	return nullptr;
     }
 
+    const ContextType &get_innermost_context() const
+    {
+	assert(!m_stack.empty());
+
+	return m_stack.front().context;
+    }
+
     // extract_innermost_context()
     //
     //   For importing names.  See import_names() below.
@@ -135,9 +175,11 @@ public:
     }
 
     // import_names() merges contexts by copying names from 'other'
-    // into the current innermost context.
+    // into the current innermost context.  'other' must have come from a
+    // LexicalContextStack with the same symbol table.
     //
-    // Duplicate names are not copied, and are returned in a list of strings.
+    // Duplicate names are not copied, and are returned in a (sorted) list
+    // of strings.
 
     std::list<std::string> import_names(const ContextType &other)
     {
@@ -152,9 +194,11 @@ public:
 	    auto res = context.try_emplace(v.first, v.second);
 
 	    if(!res.second)
-		duplicates.emplace_back(v.first);
+		duplicates.emplace_back(m_symbols->get_name(v.first));
 	}
 
+	duplicates.sort();
+
 	return duplicates;
     }
 };
@@ -163,6 +163,7 @@ protected:
     //
     //      token()      - the current token
     //      token_str()  - its text
+    //      token_symbol() - its Symbol (for identifiers)
     //      token_loc()  - its start location
     //
     //      peek(n)      - n-th lookahead token
@@ -220,6 +221,12 @@ protected:
 	return m_token.str;
     }
 
+    // The identifier's Symbol, if the lexer interns them (or no_symbol)
+    Symbol token_symbol() const
+    {
+	return m_token.sym;
+    }
+
     const Location &token_loc() const
     {
 	return m_token.span.start;
@@ -0,0 +1,103 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ParserStarterKit {
+
+/////////////////////////////////////////////////////////////////
+//
+//  SymbolTable - interned names
+//
+//    Each distinct name gets a small integer, its Symbol, the
+//    first time it is interned.  The tokenizer interns identifiers
+//    as it reads them (see TokenizerBase::set_symbol_table()), so
+//    that keywords, names and scopes can be looked up by integer,
+//    rather than by comparing strings.
+//
+//    Every tokenizer and LexicalContextStack whose names meet
+//    (e.g. a program and the modules it imports) must share one
+//    SymbolTable.
+//
+/////////////////////////////////////////////////////////////////
+
+using Symbol = int;
+
+constexpr Symbol no_symbol = -1;
+
+class SymbolTable
+{
+    // A deque, so that the string_view keys stay valid.
+    std::deque<std::string> m_names;
+
+    std::unordered_map<std::string_view, Symbol> m_symbols;
+
+public:
+    SymbolTable() = default;
+
+    SymbolTable(const SymbolTable &) = delete;
+    SymbolTable &operator=(const SymbolTable &) = delete;
+
+    Symbol intern(std::string_view name)
+    {
+	auto f = m_symbols.find(name);
+
+	if(f != m_symbols.end())
+	    return f->second;
+
+	auto sym = static_cast<Symbol>(m_names.size());
+
+	m_symbols.emplace(m_names.emplace_back(name), sym);
+
+	return sym;
+    }
+
+    // Returns no_symbol if the name was never interned
+    Symbol find(std::string_view name) const
+    {
+	auto f = m_symbols.find(name);
+
+	return f == m_symbols.end() ? no_symbol : f->second;
+    }
+
+    const std::string &get_name(Symbol sym) const
+    {
+	assert(sym >= 0 && static_cast<size_t>(sym) < m_names.size());
+
+	return m_names[static_cast<size_t>(sym)];
+    }
+
+    size_t size() const
+    {
+	return m_names.size();
+    }
+};
+
+} // namespace ParserStarterKit
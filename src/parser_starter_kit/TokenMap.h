@@ -25,9 +25,11 @@
 #pragma once
 
 #include "TokenInterface.h"
+#include "SymbolTable.h"
 
 #include <string>
 #include <map>
+#include <vector>
 
 namespace ParserStarterKit {
 
@@ -76,6 +78,20 @@ class TokenMap : public TokenInterface
     std::map<int, TokenInfo> m_builtin_tokens;
     std::map<std::string, const TokenInfo*> m_keywords;
 
+    // Keyword tokens, indexed by Symbol - see set_keyword_symbols()
+    SymbolTable *m_keyword_symbols = nullptr;
+    std::vector<int> m_keywords_by_symbol;
+
+    void index_keyword(const std::string &text, int token)
+    {
+	auto sym = static_cast<size_t>(m_keyword_symbols->intern(text));
+
+	if(sym >= m_keywords_by_symbol.size())
+	    m_keywords_by_symbol.resize(sym + 1, tk_NONE);
+
+	m_keywords_by_symbol[sym] = token;
+    }
+
     const TokenInfo *get_token_info(int token) const
     {
 	auto f = m_builtin_tokens.find(token);
@@ -105,6 +121,9 @@ public:
 	{
 	    auto res2 = m_keywords.emplace(text, &res.first->second);
 
+	    if(res2.second && m_keyword_symbols)
+		index_keyword(text, token);
+
 	    return res2.second;
 	}
 
@@ -145,6 +164,27 @@ public:
 	return tk_NONE;
     }
 
+    // Interns the keywords (and any added later) in 'symbols', for
+    // translate_keyword_symbol().
+    void set_keyword_symbols(SymbolTable &symbols)
+    {
+	m_keyword_symbols = &symbols;
+	m_keywords_by_symbol.clear();
+
+	for(const auto &[text, info] : m_keywords)
+	    index_keyword(text, info->token);
+    }
+
+    // Like translate_keyword(), for a Symbol from the keyword symbols
+    int translate_keyword_symbol(Symbol sym) const
+    {
+	auto i = static_cast<size_t>(sym);
+
+	return sym >= 0 && i < m_keywords_by_symbol.size()
+	    ? m_keywords_by_symbol[i]
+	    : tk_NONE;
+    }
+
     OpInfo get_postfix_op_info(int op_token) const override
     {
 	if(const auto *info = get_token_info(op_token))
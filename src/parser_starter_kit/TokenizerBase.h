@@ -28,7 +28,6 @@
 #include "TokenMap.h"
 #include "InputBase.h"
 
-#include <string>
 #include <string>
 #include <utility>
 
@@ -55,6 +54,26 @@ protected:
     int m_token = tk_NONE;
     std::string m_text;
 
+    // If set, identifiers are interned here - see set_symbol_table()
+    SymbolTable *m_symbols = nullptr;
+
+    // With buffered input, the text pushed so far (if it is all in one
+    // piece) is just noted here, and it is copied to m_text once, at the
+    // end of the token.  See flush_text().
+    const char *m_text_begin = nullptr;
+    const char *m_text_end = nullptr;
+
+    // Completes m_text.  Only needed to look at m_text while a token is
+    // still being pushed.
+    void flush_text()
+    {
+	if(m_text_begin)
+	{
+	    m_text.append(m_text_begin, m_text_end);
+	    m_text_begin = m_text_end = nullptr;
+	}
+    }
+
 protected:
     virtual bool push_next_token()
     {
@@ -96,11 +115,60 @@ protected:
     {
 	while(count--)
 	{
-	    m_text += static_cast<char>(peek());
-	    consume();
+	    if(is_input_buffered())
+	    {
+		if(m_text_end != get_input_ptr())
+		{
+		    flush_text();
+		    m_text_begin = get_input_ptr();
+		}
+
+		consume();
+
+		m_text_end = get_input_ptr();
+	    }
+	    else
+	    {
+		m_text += static_cast<char>(peek());
+		consume();
+	    }
 	}
     }
 
+    // Pushes the run of characters that pred(ch) accepts.  pred must reject
+    // '\n' and EOF.  With buffered input, the run is found with pointer
+    // arithmetic, and skipped all at once.
+    template<class PRED>
+    void push_while(PRED pred)
+    {
+	if(!is_input_buffered())
+	{
+	    while(pred(peek()))
+		push();
+
+	    return;
+	}
+
+	auto begin = get_input_ptr();
+	auto end = begin;
+
+	while(end != get_input_end() && pred(static_cast<unsigned char>(*end)))
+	    ++end;
+
+	if(end == begin)
+	    return;
+
+	if(m_text_end != begin)
+	{
+	    flush_text();
+	    m_text_begin = begin;
+	}
+
+	advance_within_line(static_cast<int>(end - begin));
+
+	m_text_end = end;
+    }
+
     bool push_if(int ch)
     {
 	if(!is(ch))
@@ -127,13 +195,28 @@ public:
 
 	auto start = get_input_loc();
 
+	Symbol sym = no_symbol;
+
 	if(is(tk_EOF))
 	    m_token = tk_EOF;
-	else if(push_next_token())
+	else
 	{
-	    if(m_token == tk_identifier)
-		if(auto keyword = translate_keyword(m_text))
+	    bool pushed = push_next_token();
+
+	    flush_text();
+
+	    if(pushed && m_token == tk_identifier)
+	    {
+		if(m_symbols)
+		{
+		    sym = m_symbols->intern(m_text);
+
+		    if(auto keyword = translate_keyword_symbol(sym))
+			m_token = keyword;
+		}
+		else if(auto keyword = translate_keyword(m_text))
 		    m_token = keyword;
+	    }
 	}
 
 	auto end = get_input_loc();
@@ -141,9 +224,19 @@ public:
 	return {
 		std::exchange(m_token, tk_NONE),
 		std::move(m_text),
-		{ start, end }
+		{ start, end },
+		sym
 	       };
     }
+
+    // Each identifier token gets its Symbol from 'symbols' (which must
+    // outlive this), and keywords are looked up by Symbol too.
+    void set_symbol_table(SymbolTable &symbols)
+    {
+	m_symbols = &symbols;
+
+	set_keyword_symbols(symbols);
+    }
 };
 
 } // namespace ParserStarterKit
@@ -27,36 +27,37 @@
 #include "Tokens.h"
 
 #include <assert.h>
-#include <functional>
-#include <cmath>
-#include <map>
 
 using namespace ParserStarterKit;
 
+// The operator semantics, and the Expr code that evaluates them at runtime,
+// are in Expression.h.  Here they are matched with their tokens, and with
+// constant folding.
+
+static Expr to_expr(const ASTNode &n)
+{
+    return n.is_constexpr() ? Expr::constant(n.get_constant())
+			    : n.get_expression();
+}
+
 ///////////////////////////////////////////////////////////////////////
 // Prefix ops
 ///////////////////////////////////////////////////////////////////////
 
-template<int op>
-double prefix_op(double rhs);
-
-template<> double prefix_op<tk_minus>(double rhs) { return -rhs; }
-template<> double prefix_op<tk_bang>(double rhs) { return rhs ? 0 : 1; }
-
 struct MakePrefixOpBase
 {
   virtual ~MakePrefixOpBase() = default;
 
-  virtual ASTNode create(Expr rhs) const = 0;
+  virtual ASTNode create(const Expr &rhs) const = 0;
   virtual ASTNode create(double rhs) const = 0;
 };
 
-template<int op>
+template<ExprOp op>
 struct MakePrefixOp : public MakePrefixOpBase
 {
-  ASTNode create(Expr rhs) const override
+  ASTNode create(const Expr &rhs) const override
   {
-    return ASTNode{ [rhs]()->double { return prefix_op<op>(rhs()); } };
+    return ASTNode{ Expr::prefix(op, rhs) };
   }
 
   ASTNode create(double rhs) const override
@@ -65,18 +66,26 @@ struct MakePrefixOp : public MakePrefixOpBase
   }
 };
 
-static const MakePrefixOpBase *get_prefix_operator_factory(int op)
+// The factories are stateless, so each one is a single static instance, and
+// the lookup is a switch rather than a map.
+template<class Factory>
+static const Factory *get_factory()
 {
-    using PrefixOpMap = std::map<int, MakePrefixOpBase *>;
+    static const Factory factory;
 
-    static PrefixOpMap ops = {
-      { tk_minus, new MakePrefixOp<tk_minus>() },
-      { tk_bang,  new MakePrefixOp<tk_bang>()  },
-    };
+    return &factory;
+}
 
-    assert(ops.contains(op));
+static const MakePrefixOpBase *get_prefix_operator_factory(int op)
+{
+    switch(op)
+    {
+      case tk_minus: return get_factory<MakePrefixOp<ExprOp::negate>>();
+      case tk_bang:  return get_factory<MakePrefixOp<ExprOp::logical_not>>();
+    }
 
-    return ops[op];
+    assert(false);
+    return nullptr;
 }
 
 ASTNode create_prefix_op_expr(int op, ASTNode rhs)
@@ -91,173 +100,66 @@ ASTNode create_prefix_op_expr(int op, ASTNode rhs)
 // Binary ops
 ///////////////////////////////////////////////////////////////////////
 
-template<int op>
-double binary_op(double lhs, double rhs);
-
-template<> double binary_op<tk_plus      >(double lhs, double rhs) { return lhs + rhs; };
-template<> double binary_op<tk_minus     >(double lhs, double rhs) { return lhs - rhs; };
-template<> double binary_op<tk_star      >(double lhs, double rhs) { return lhs * rhs; };
-template<> double binary_op<tk_slash     >(double lhs, double rhs) { return lhs / rhs; };
-template<> double binary_op<tk_pow       >(double lhs, double rhs) { return std::pow(lhs, rhs); };
-template<> double binary_op<tk_equality  >(double lhs, double rhs) { return lhs == rhs ? 1.0 : 0.0; };
-template<> double binary_op<tk_inequality>(double lhs, double rhs) { return lhs != rhs ? 1.0 : 0.0; };
-template<> double binary_op<tk_lt        >(double lhs, double rhs) { return lhs < rhs ? 1.0 : 0.0; };
-template<> double binary_op<tk_gt        >(double lhs, double rhs) { return lhs > rhs ? 1.0 : 0.0; };
-template<> double binary_op<tk_le        >(double lhs, double rhs) { return lhs <= rhs ? 1.0 : 0.0; };
-template<> double binary_op<tk_ge        >(double lhs, double rhs) { return lhs >= rhs ? 1.0 : 0.0; };
-
-// Note: &&/|| could short-circuit, but this seems low priority since this
-// language does not currently have user-defined functions that return values.
-template<> double binary_op<tk_or        >(double lhs, double rhs) { return lhs ? lhs : (rhs ? rhs : 0.0); };
-template<> double binary_op<tk_and       >(double lhs, double rhs) { return (lhs && rhs) ? rhs : 0.0; };
-
 struct MakeBinaryOpBase
 {
   virtual ~MakeBinaryOpBase() = default;
 
-  virtual ASTNode create(Expr lhs, Expr rhs) const = 0;
-  virtual ASTNode create(Expr lhs, double rhs) const = 0;
-  virtual ASTNode create(double lhs, Expr rhs) const = 0;
-  virtual ASTNode create(double lhs, double rhs) const = 0;
+  virtual ASTNode create(const ASTNode &lhs, const ASTNode &rhs) const = 0;
 };
 
-template<int op>
+template<ExprOp op>
 struct MakeBinaryOp : public MakeBinaryOpBase
 {
-  ASTNode create(Expr lhs, Expr rhs) const override
+  ASTNode create(const ASTNode &lhs, const ASTNode &rhs) const override
   {
-    return ASTNode{ [lhs, rhs]()->double { return binary_op<op>(lhs(), rhs()); } };
-  }
-
-  ASTNode create(double lhs, Expr rhs) const override
-  {
-    return ASTNode{ [lhs, rhs]()->double { return binary_op<op>(lhs, rhs()); } };
-  }
-
-  ASTNode create(Expr lhs, double rhs) const override
-  {
-    return ASTNode{ [lhs, rhs]()->double { return binary_op<op>(lhs(), rhs); } };
-  }
-
-  ASTNode create(double lhs, double rhs) const override
-  {
-    return ASTNode{ binary_op<op>(lhs, rhs) };
+    if(lhs.is_constexpr() && rhs.is_constexpr())
+      return ASTNode{ binary_op<op>(lhs.get_constant(), rhs.get_constant()) };
+    else
+      return ASTNode{ Expr::binary(op, to_expr(lhs), to_expr(rhs)) };
   }
 };
 
 static const MakeBinaryOpBase *get_binary_operator_factory(int op)
 {
-    using BinaryOpMap = std::map<int, MakeBinaryOpBase *>;
-
-    static BinaryOpMap ops = {
-      { tk_plus,       new MakeBinaryOp<tk_plus>()       },
-      { tk_minus,      new MakeBinaryOp<tk_minus>()      },
-      { tk_star,       new MakeBinaryOp<tk_star>()       },
-      { tk_slash,      new MakeBinaryOp<tk_slash>()      },
-      { tk_pow,        new MakeBinaryOp<tk_pow>()        },
-      { tk_equality,   new MakeBinaryOp<tk_equality>()   },
-      { tk_inequality, new MakeBinaryOp<tk_inequality>() },
-      { tk_or,         new MakeBinaryOp<tk_or>()         },
-      { tk_and,        new MakeBinaryOp<tk_and>()        },
-      { tk_lt,         new MakeBinaryOp<tk_lt>()         },
-      { tk_gt,         new MakeBinaryOp<tk_gt>()         },
-      { tk_le,         new MakeBinaryOp<tk_le>()         },
-      { tk_ge,         new MakeBinaryOp<tk_ge>()         },
-    };
-
-    assert(ops.contains(op));
+    switch(op)
+    {
+      case tk_plus:       return get_factory<MakeBinaryOp<ExprOp::add>>();
+      case tk_minus:      return get_factory<MakeBinaryOp<ExprOp::subtract>>();
+      case tk_star:       return get_factory<MakeBinaryOp<ExprOp::multiply>>();
+      case tk_slash:      return get_factory<MakeBinaryOp<ExprOp::divide>>();
+      case tk_pow:        return get_factory<MakeBinaryOp<ExprOp::power>>();
+      case tk_equality:   return get_factory<MakeBinaryOp<ExprOp::equal>>();
+      case tk_inequality: return get_factory<MakeBinaryOp<ExprOp::not_equal>>();
+      case tk_or:         return get_factory<MakeBinaryOp<ExprOp::logical_or>>();
+      case tk_and:        return get_factory<MakeBinaryOp<ExprOp::logical_and>>();
+      case tk_lt:         return get_factory<MakeBinaryOp<ExprOp::less>>();
+      case tk_gt:         return get_factory<MakeBinaryOp<ExprOp::greater>>();
+      case tk_le:         return get_factory<MakeBinaryOp<ExprOp::less_equal>>();
+      case tk_ge:         return get_factory<MakeBinaryOp<ExprOp::greater_equal>>();
+    }
 
-    return ops[op];
+    assert(false);
+    return nullptr;
 }
 
 ASTNode create_binary_op_expr(int op, ASTNode lhs, ASTNode rhs)
 {
   auto *factory = get_binary_operator_factory(op);
 
-  if(lhs.is_constexpr())
-    return rhs.is_constexpr()
-         ? factory->create(lhs.get_constant(), rhs.get_constant())
-         : factory->create(lhs.get_constant(), rhs.get_expression());
-  else
-    return rhs.is_constexpr()
-         ? factory->create(lhs.get_expression(), rhs.get_constant())
-         : factory->create(lhs.get_expression(), rhs.get_expression());
+  return factory->create(lhs, rhs);
 }
 
 ///////////////////////////////////////////////////////////////////////
 // Ternary op (?:)
 ///////////////////////////////////////////////////////////////////////
 
-namespace condexp
-{
-    using Cnst = double;
-
-    inline double f(Expr le, Expr re, Expr te) { return le() ? re() : te(); };
-    inline double f(Expr le, Expr re, Cnst tc) { return le() ? re() : tc  ; };
-    inline double f(Expr le, Cnst rc, Expr te) { return le() ? rc   : te(); };
-    inline double f(Expr le, Cnst rc, Cnst tc) { return le() ? rc   : tc  ; };
-    inline double f(Cnst lc, Expr re, Expr te) { return lc   ? re() : te(); };
-    inline double f(Cnst lc, Expr re, Cnst tc) { return lc   ? re() : tc  ; };
-    inline double f(Cnst lc, Cnst rc, Expr te) { return lc   ? rc   : te(); };
-    inline double f(Cnst lc, Cnst rc, Cnst tc) { return lc   ? rc   : tc  ; };
-};
-
-template<class L, class R, class T>
-static ASTNode create_conditional(L l, R r, T t)
-{
-    return ASTNode{ [l, r, t]()->double { return condexp::f(l, r, t); } };
-}
-
 ASTNode create_conditional_expr(ASTNode lhs, ASTNode rhs, ASTNode third)
 {
+  // A constant condition selects its branch now, which may itself be a
+  // constant.  The other branch is simply dropped, as it would never have
+  // been evaluated.
   if(lhs.is_constexpr())
-  {
-    if(rhs.is_constexpr())
-    {
-      if(third.is_constexpr())
-	  return create_conditional(lhs.get_constant(),
-				    rhs.get_constant(),
-				    third.get_constant());
-      else
-	  return create_conditional(lhs.get_constant(),
-				    rhs.get_constant(),
-				    third.get_expression());
-    }
-    else
-    {
-      if(third.is_constexpr())
-	  return create_conditional(lhs.get_constant(),
-				    rhs.get_expression(),
-				    third.get_constant());
-      else
-	  return create_conditional(lhs.get_constant(),
-				    rhs.get_expression(),
-				    third.get_expression());
-    }
-  }
-  else
-  {
-    if(rhs.is_constexpr())
-    {
-      if(third.is_constexpr())
-	  return create_conditional(lhs.get_expression(),
-				    rhs.get_constant(),
-				    third.get_constant());
-      else
-	  return create_conditional(lhs.get_expression(),
-				    rhs.get_constant(),
-				    third.get_expression());
-    }
-    else
-    {
-      if(third.is_constexpr())
-	  return create_conditional(lhs.get_expression(),
-				    rhs.get_expression(),
-				    third.get_constant());
-      else
-	  return create_conditional(lhs.get_expression(),
-				    rhs.get_expression(),
-				    third.get_expression());
-    }
-  }
+    return lhs.get_constant() ? rhs : third;
+
+  return ASTNode{ Expr::conditional(to_expr(lhs), to_expr(rhs), to_expr(third)) };
 }
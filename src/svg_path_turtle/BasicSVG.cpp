@@ -23,11 +23,14 @@
  */
 
 #include "BasicSVG.h"
+#include "DoubleToString.h"
 
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <format>
+#include <cassert>
+#include <utility>
 
 using std::string;
 
@@ -54,7 +57,7 @@ bool SVGConfig::configure(const string &config)
     return true;
 }
 
-void SVGConfig::output_header(std::ostream &out) const
+void SVGConfig::output_header(std::ostream &out, bool start_path) const
 {
     constexpr const char *svg =
 	R"(<svg viewbox="{}" width="{}" height="{}" xmlns="{}">)";
@@ -66,11 +69,12 @@ void SVGConfig::output_header(std::ostream &out) const
     constexpr const char *rect =
 	R"(<rect x="0" y="0" width="100%" height="100%" fill="{}"/>)";
 
-    constexpr const char *path =
-	R"(<path fill="{}" stroke="{}" stroke-width="{}" )"
-	    R"(stroke-linejoin="{}" stroke-linecap="{}" d=")";
+    auto vb = get_viewbox();
 
-    auto viewbox = std::format(viewbox_format, m_width, m_height);
+    auto viewbox = std::format(viewbox_format, vb[2], vb[3]);
+
+    if(m_has_viewbox)
+	viewbox = std::format("{} {} {} {}", vb[0], vb[1], vb[2], vb[3]);
 
     out << std::format(svg, viewbox, m_width, m_height, xmlns);
     out << std::endl;
@@ -81,16 +85,201 @@ void SVGConfig::output_header(std::ostream &out) const
 	out << std::endl;
     }
 
-    out << std::format(path, m_fill_color, m_stroke_color,
-			     m_stroke_width, m_stroke_linejoin,
-			     m_stroke_linecap);
+    if(start_path)
+	out << "<path " << get_path_attributes() << R"( d=")";
+}
+
+string SVGConfig::get_path_attributes() const
+{
+    constexpr const char *attributes =
+	R"(fill="{}" stroke="{}" stroke-width="{}" )"
+	    R"(stroke-linejoin="{}" stroke-linecap="{}")";
+
+    // The stroke width is left alone if it isn't just a number.
+    string stroke_width = m_stroke_width;
+
+    double width = 0.0;
+
+    if(m_scale != 1.0 && get_stroke_width(width))
+	stroke_width = std::format("{}", width * m_scale);
+
+    return std::format(attributes, m_fill_color, m_stroke_color,
+				   stroke_width, m_stroke_linejoin,
+				   m_stroke_linecap);
+}
+
+// Returns false if the stroke width isn't just a number.
+bool SVGConfig::get_stroke_width(double &width) const
+{
+    try
+    {
+	size_t pos = 0;
+	width = std::stod(m_stroke_width, &pos);
+
+	return pos == m_stroke_width.size();
+    }
+    catch(...)
+    {
+	return false;
+    }
+}
+
+std::array<double, 4> SVGConfig::get_viewbox() const
+{
+    if(m_has_viewbox)
+	return { m_viewbox[0] * m_scale, m_viewbox[1] * m_scale,
+		 m_viewbox[2] * m_scale, m_viewbox[3] * m_scale };
+
+    return { 0.0, 0.0, m_width * m_scale, m_height * m_scale };
 }
 
-void SVGConfig::output_footer(std::ostream &out) const
+double SVGConfig::get_scaled_stroke_width(double otherwise) const
+{
+    double width = 0.0;
+
+    return get_stroke_width(width) ? width * m_scale : otherwise;
+}
+
+void SVGConfig::fit_viewbox(double min_x, double min_y,
+			    double max_x, double max_y)
+{
+    double margin = 0.0;
+
+    if(get_stroke_width(margin))
+	margin /= 2;
+
+    m_has_viewbox = true;
+
+    m_viewbox[0] = min_x - margin;
+    m_viewbox[1] = min_y - margin;
+    m_viewbox[2] = max_x - min_x + 2 * margin;
+    m_viewbox[3] = max_y - min_y + 2 * margin;
+}
+
+void SVGConfig::output_new_path(std::ostream &out,
+				const string &name,
+				const string &attributes) const
+{
+    out << R"("/>)" << std::endl << "<path ";
+
+    if(!name.empty())
+	out << std::format(R"(id="{}" )", name);
+
+    out << (attributes.empty() ? get_path_attributes() : attributes)
+	<< R"( d=")";
+}
+
+void SVGConfig::output_footer(std::ostream &out, bool end_path) const
 {
     constexpr const char *path_end = R"("/>)";
 
     constexpr const char *end = "</svg>";
 
-    out << path_end << std::endl << end << std::endl;
+    if(end_path)
+	out << path_end << std::endl;
+
+    out << end << std::endl;
+}
+
+// The attributes of the path's next element, with its id if it's the
+// first.
+string SVGSymbols::get_attributes()
+{
+    string attributes;
+
+    if(!m_path_name.empty())
+	attributes = std::format(R"(id="{}" )", std::exchange(m_path_name, {}));
+
+    attributes += m_attributes.empty() ? m_config.get_path_attributes()
+				       : m_attributes;
+
+    return attributes;
+}
+
+void SVGSymbols::end_path_element()
+{
+    if(std::exchange(m_in_path_element, false))
+	m_out << R"("/>)" << std::endl;
+}
+
+void SVGSymbols::new_path(const string &name, const string &attributes)
+{
+    end_path_element();
+
+    m_path_name = name;
+    m_attributes = attributes;
+}
+
+void SVGSymbols::finish()
+{
+    end_path_element();
+}
+
+void SVGSymbols::begin_path_data()
+{
+    assert(!m_in_path_element);
+
+    m_out << "<path " << get_attributes() << R"( d=")";
+
+    m_in_path_element = true;
+}
+
+// The current <path> ends, and a group with its attributes starts.
+void SVGSymbols::begin_fragments()
+{
+    end_path_element();
+
+    m_out << "<g " << get_attributes() << ">" << std::endl;
+}
+
+void SVGSymbols::fragment(std::string_view data, const Matrix2d &placement)
+{
+    constexpr const char *symbol =
+	R"(<symbol id="{}" overflow="visible"><path d="{}"/></symbol>)";
+
+    constexpr const char *use = R"(<use href="#{}" transform="{}"/>)";
+
+    auto first = data.find_first_not_of(" \n");
+    auto last = data.find_last_not_of(" \n");
+
+    assert(first != data.npos);
+
+    data = data.substr(first, last + 1 - first);
+
+    auto [it, is_new] = m_ids.try_emplace(string(data), m_ids.size() + 1);
+
+    auto id = std::format("s{}", it->second);
+
+    if(is_new)
+	m_out << std::format(symbol, id, it->first) << std::endl;
+
+    // The path data is in grid units with --integer-grid, and so must the
+    // translation be.
+    auto coefficients = placement.get_svg_matrix();
+
+    coefficients[4] *= m_config.get_scale();
+    coefficients[5] *= m_config.get_scale();
+
+    string matrix = "matrix(";
+
+    for(size_t i = 0; i < coefficients.size(); ++i)
+    {
+	int precision = i < 4 ? m_decimal_places + 4 : m_decimal_places;
+
+	if(i > 0)
+	    matrix += ' ';
+
+	matrix += double_to_string(coefficients[i], precision);
+    }
+
+    matrix += ')';
+
+    m_out << std::format(use, id, matrix) << std::endl;
+}
+
+// The group ends.  Whatever is drawn next starts another <path>, like the
+// one before it (see begin_path_data()).
+void SVGSymbols::end_fragments()
+{
+    m_out << "</g>" << std::endl;
 }
@@ -24,8 +24,13 @@
 
 #pragma once
 
+#include "Turtle.h"
+
 #include <string>
+#include <array>
+#include <string_view>
 #include <iostream>
+#include <unordered_map>
 
 class SVGConfig
 {
@@ -40,6 +45,15 @@ class SVGConfig
     std::string m_stroke_linejoin = "round";
     std::string m_stroke_linecap  = "round";
 
+    // For path data in scaled units (see --integer-grid)
+    double m_scale = 1.0;
+
+    // From fit_viewbox(), in place of "0 0 width height"
+    bool m_has_viewbox = false;
+    double m_viewbox[4] = { 0, 0, 0, 0 };
+
+    bool get_stroke_width(double &width) const;
+
 public:
     explicit operator bool() const
     {
@@ -54,6 +68,117 @@ public:
     // configure() also enables
     bool configure(const std::string &config);
 
-    void output_header(std::ostream &out) const;
-    void output_footer(std::ostream &out) const;
+    // The viewbox and the stroke width are multiplied by scale, so that the
+    // picture looks the same.
+    void set_scale(double scale)
+    {
+	m_scale = scale;
+    }
+
+    // Sets the viewbox to the given box (in the same units as the path
+    // data, before any scaling), with room for half the stroke width
+    // around it.  The width and height are left as they were.
+    void fit_viewbox(double min_x, double min_y, double max_x, double max_y);
+
+    // The attributes that -s or --svg-out give each <path>
+    std::string get_path_attributes() const;
+
+    double get_scale() const
+    {
+	return m_scale;
+    }
+
+    //// For drawing the picture some other way (see PathRasterizer)
+
+    long get_width() const  { return m_width; }
+    long get_height() const { return m_height; }
+
+    // As output_header() writes it: x, y, width and height, in the units
+    // of the path data
+    std::array<double, 4> get_viewbox() const;
+
+    const std::string &get_background_color() const
+    {
+	return m_background_color;
+    }
+
+    const std::string &get_fill_color() const      { return m_fill_color; }
+    const std::string &get_stroke_color() const    { return m_stroke_color; }
+    const std::string &get_stroke_linejoin() const { return m_stroke_linejoin; }
+    const std::string &get_stroke_linecap() const  { return m_stroke_linecap; }
+
+    // In the units of the path data, or 'otherwise' if the configured
+    // width isn't just a number
+    double get_scaled_stroke_width(double otherwise) const;
+
+    // The header starts the first <path> element, and the footer ends the
+    // last, unless SVGSymbols writes the path elements (without start_path
+    // and end_path).
+    void output_header(std::ostream &out, bool start_path = true) const;
+    void output_footer(std::ostream &out, bool end_path = true) const;
+
+    // Ends the current <path> element and starts another, for new_path.
+    // With no attributes, the new one gets the configured colors and such.
+    void output_new_path(std::ostream &out,
+			 const std::string &name,
+			 const std::string &attributes) const;
+};
+
+// For --symbols: writes the fragments of the path data (see
+// OstreamTurtle::set_fragment_sink()) in an SVG file.  The first time a
+// fragment's data comes up, it is written as a <symbol>, and each time, as a
+// <use> of the symbol, placed by the fragment's transform.  The uses are in
+// a group with the path's attributes, between the <path> elements that
+// have the rest of the path data.  So the copies look like the rest of the
+// path, except that each one is filled on its own, and a placement that
+// scales also scales the stroke.
+//
+// It writes the path elements as well, in place of SVGConfig, and only
+// those that something is drawn in.  A path's id goes on the first of
+// them, whether that's a <path> or a <g>.
+class SVGSymbols final : public TurtleFragmentSink
+{
+    const SVGConfig &m_config;
+
+    std::ostream &m_out;
+
+    // The ids of the symbols written so far, by their path data
+    std::unordered_map<std::string, size_t> m_ids;
+
+    // From the current path's new_path, if it has any.  The name is
+    // cleared once an element has its id.
+    std::string m_path_name;
+    std::string m_attributes;
+
+    // Whether a <path> element's data is being written
+    bool m_in_path_element = false;
+
+    int m_decimal_places;
+
+    std::string get_attributes();
+
+    void end_path_element();
+
+public:
+    // The placements' translations are written with the path data's
+    // decimal places, and the rest of them with a few more.
+    SVGSymbols(const SVGConfig &config, std::ostream &out, int decimal_places)
+	: m_config(config)
+	, m_out(out)
+	, m_decimal_places(decimal_places)
+    {
+    }
+
+    // For new_path, in place of SVGConfig::output_new_path()
+    void new_path(const std::string &name, const std::string &attributes);
+
+    // Before SVGConfig::output_footer()
+    void finish();
+
+    //// TurtleFragmentSink
+
+    void begin_path_data() override;
+    void begin_fragments() override;
+    void fragment(std::string_view data, const Matrix2d &placement) override;
+    void end_fragments() override;
 };
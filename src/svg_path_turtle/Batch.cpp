@@ -0,0 +1,210 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Batch.h"
+
+#include "FileUtil.h"
+#include "Messages.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+using std::string;
+
+BatchRenderer::BatchRenderer(const Options &opt)
+    : m_opt(opt)
+{
+}
+
+void BatchRenderer::add_program(const string &input_filename,
+				string output_filename)
+{
+    if(output_filename.empty())
+    {
+	auto slash = input_filename.find_last_of("/\\");
+	auto dot = input_filename.rfind('.');
+
+	output_filename = input_filename;
+
+	if(dot != string::npos && (slash == string::npos || dot > slash))
+	    output_filename.resize(dot);
+
+	output_filename += m_opt.svg_out ? ".svg" : ".path";
+    }
+
+    if(output_filename == input_filename)
+	throw BatchError("'" + input_filename + "' would be overwritten by "
+			 "its own output");
+
+    m_jobs.push_back({ input_filename, output_filename });
+}
+
+void BatchRenderer::add_manifest(const string &filename)
+{
+    Infile manifest(filename);
+
+    std::istream &in = manifest;
+
+    for(string line; std::getline(in, line); )
+    {
+	std::istringstream fields(line);
+
+	string input_filename, output_filename;
+
+	if(!(fields >> input_filename) || input_filename[0] == '#')
+	    continue;
+
+	fields >> output_filename;
+
+	add_program(input_filename, output_filename);
+    }
+}
+
+void BatchRenderer::compile_jobs()
+{
+    ProgramRunner compiler(m_opt.bytecode);
+
+    for(auto &job : m_jobs)
+    {
+	std::ifstream in(job.input_filename, std::ios::in | std::ios::binary);
+
+	if(!in)
+	{
+	    std::cerr << job.input_filename << ": " << strerror(errno) << '\n';
+	    continue;
+	}
+
+	string program(std::istreambuf_iterator<char>(in),
+		       std::istreambuf_iterator<char>{});
+
+	job.main_chunk_index = compiler.compile(job.input_filename, program,
+						std::cerr);
+
+	if(job.main_chunk_index != ExecutionEngine::no_chunk)
+	    job.program = compiler.get_program();
+    }
+}
+
+bool BatchRenderer::run_job(ExecutionEngine &engine,
+			    std::stringbuf &buffer,
+			    std::ostream &out,
+			    Job &job)
+{
+    std::ostringstream messages;
+
+    bool ok = execute_program(engine, job.main_chunk_index,
+			      job.input_filename, m_opt, out, messages);
+
+    string output = buffer.str();
+
+    buffer.str({});
+
+    if(ok && job.output_filename == "-")
+	job.output = std::move(output);
+    else if(ok)
+    {
+	std::ofstream file(job.output_filename);
+
+	if(!(file << output) || !file.flush())
+	{
+	    messages << job.output_filename << ": " << strerror(errno) << '\n';
+	    ok = false;
+	}
+    }
+
+    if(!messages.view().empty())
+    {
+	std::lock_guard lock(m_stderr_mutex);
+
+	std::cerr << messages.view();
+    }
+
+    return ok;
+}
+
+void BatchRenderer::work()
+{
+    std::stringbuf buffer;
+    std::ostream out(&buffer);
+
+    std::unique_ptr<ExecutionEngine> engine;
+
+    for(size_t i; (i = m_next_job++) < m_jobs.size(); )
+    {
+	Job &job = m_jobs[i];
+
+	if(!job.program)
+	    continue; // it didn't compile
+
+	// The programs are nearly always all in one Program, so one engine
+	// runs them all.
+	if(!engine || engine->get_program() != job.program)
+	    engine = std::make_unique<ExecutionEngine>(job.program, out);
+
+	job.ok = run_job(*engine, buffer, out, job);
+
+	if(!job.ok)
+	    engine.reset();
+    }
+}
+
+size_t BatchRenderer::run(unsigned threads)
+{
+    compile_jobs();
+
+    if(threads == 0)
+	threads = std::max(1u, std::thread::hardware_concurrency());
+
+    threads = static_cast<unsigned>(std::min<size_t>(threads, m_jobs.size()));
+
+    {
+	std::vector<std::jthread> pool;
+
+	for(unsigned i = 1; i < threads; ++i)
+	    pool.emplace_back([this] { work(); });
+
+	// This thread is one of the workers too.
+	work();
+    }
+
+    size_t failures = 0;
+
+    for(auto &job : m_jobs)
+    {
+	if(!job.ok)
+	    ++failures;
+	else if(job.output_filename == "-")
+	    std::cout << job.output;
+    }
+
+    std::cout.flush();
+
+    return failures;
+}
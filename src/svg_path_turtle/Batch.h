@@ -0,0 +1,120 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "ProgramRunner.h"
+#include "Options.h"
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// BatchRenderer - runs many programs, on a pool of threads (--batch)
+//
+//   - First, all of the programs are compiled, one after another, by one
+//     ProgramRunner.  They share their imports, so library.svgt is parsed
+//     once, however many programs import it.
+//
+//   - Then each thread runs the compiled programs, taking the next one from
+//     the list when it finishes one.  The threads have their own
+//     ExecutionEngines (and so their own stacks and turtles), which share the
+//     compiled Program.
+//
+//   - Each program's output is written to its own file, and only if it ran
+//     without errors.  An output of "-" goes to stdout, after all of the
+//     programs have run, in the order they were listed.
+//
+//   - The messages of each program are written to stderr together, as soon
+//     as it finishes.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class BatchRenderer
+{
+    struct Job
+    {
+	std::string input_filename;
+	std::string output_filename;
+
+	ExecutionEngine::SharedProgram program;
+	size_t main_chunk_index = ExecutionEngine::no_chunk;
+
+	bool ok = false;
+
+	// Only kept for stdout
+	std::string output;
+    };
+
+    const Options &m_opt;
+
+    std::vector<Job> m_jobs;
+
+    std::atomic<size_t> m_next_job = 0;
+
+    std::mutex m_stderr_mutex;
+
+    void compile_jobs();
+
+    void work();
+
+    // The engine writes to 'out', which writes to 'buffer'.
+    bool run_job(ExecutionEngine &engine,
+		 std::stringbuf &buffer,
+		 std::ostream &out,
+		 Job &job);
+
+public:
+    struct BatchError : public std::runtime_error
+    {
+	explicit BatchError(const std::string &msg)
+	    : std::runtime_error(msg)
+	{
+	}
+    };
+
+    BatchRenderer(const BatchRenderer &) = delete;
+    BatchRenderer &operator=(const BatchRenderer &) = delete;
+
+    explicit BatchRenderer(const Options &opt);
+
+    // With no output filename, it is the input filename with its extension
+    // replaced by .svg (with -s) or .path.  Throws BatchError if that would
+    // overwrite the input.
+    void add_program(const std::string &input_filename,
+		     std::string output_filename = {});
+
+    // Each line is "INFILE [OUTFILE]".  Blank lines and lines starting with
+    // '#' are skipped.  A filename of "-" is stdin.
+    void add_manifest(const std::string &filename);
+
+    // Returns the number of programs that had errors.  With threads == 0,
+    // there is one thread per core.
+    size_t run(unsigned threads);
+};
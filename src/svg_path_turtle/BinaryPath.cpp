@@ -0,0 +1,171 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "BinaryPath.h"
+#include "LittleEndian.h"
+#include "PathCommand.h"
+
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+
+static constexpr char s_magic[4] = { 'S', 'P', 'T', 'B' };
+static constexpr char s_version = 1;
+
+// The arguments of each command, including the destination point, or -1
+// if it isn't one.  The formatting characters are kept too, with none.
+static int get_args_size(char cmd)
+{
+    if(cmd == ' ' || cmd == '\n')
+	return 0;
+
+    return get_command_args_size(cmd);
+}
+
+static bool is_arc_flag(char cmd, int arg_index)
+{
+    return cmd == 'A' && (arg_index == 3 || arg_index == 4);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// BinaryPathWriter
+//////////////////////////////////////////////////////////////////////////////
+
+BinaryPathWriter::BinaryPathWriter(std::streambuf &out, int value_size)
+    : out(out)
+    , m_value_size(value_size)
+{
+    assert(value_size == 4 || value_size == 8);
+
+    const char header[8] = { s_magic[0], s_magic[1], s_magic[2], s_magic[3],
+			     s_version, static_cast<char>(value_size), 0, 0 };
+
+    out.sputn(header, sizeof(header));
+}
+
+void BinaryPathWriter::write_value(double val)
+{
+    char bytes[8];
+
+    if(m_value_size == 4)
+	to_little_endian(static_cast<float>(val), bytes);
+    else
+	to_little_endian(val, bytes);
+
+    out.sputn(bytes, m_value_size);
+}
+
+void BinaryPathWriter::write_flag(bool flag)
+{
+    out.sputc(flag ? 1 : 0);
+}
+
+void BinaryPathWriter::emit_char(char ch)
+{
+    assert(get_args_size(ch) >= 0);
+
+    m_command = ch;
+    m_arg_index = 0;
+
+    out.sputc(ch);
+}
+
+void BinaryPathWriter::emit_flag(bool flag)
+{
+    assert(is_arc_flag(m_command, m_arg_index));
+
+    write_flag(flag);
+
+    ++m_arg_index;
+}
+
+void BinaryPathWriter::emit_number(double val)
+{
+    // ellipse() passes its arc flags as numbers
+    if(is_arc_flag(m_command, m_arg_index))
+	write_flag(val != 0.0);
+    else
+	write_value(val);
+
+    ++m_arg_index;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Reading
+//////////////////////////////////////////////////////////////////////////////
+
+static void read_bytes(std::istream &in, char *bytes, size_t size)
+{
+    if(!in.read(bytes, size))
+	throw BinaryPathError("Truncated binary path data");
+}
+
+void read_binary_path(std::istream &in, TurtleEmitInterface &sink)
+{
+    char header[8];
+
+    if(!in.read(header, sizeof(header))
+       || std::memcmp(header, s_magic, sizeof(s_magic)) != 0)
+	throw BinaryPathError("Not binary path data (bad header)");
+
+    if(header[4] != s_version)
+	throw BinaryPathError("Unsupported binary path version "
+			      + std::to_string(int(header[4])));
+
+    const int value_size = header[5];
+
+    if(value_size != 4 && value_size != 8)
+	throw BinaryPathError("Invalid value size in binary path header");
+
+    char bytes[8];
+
+    for(int ch; (ch = in.get()) != std::istream::traits_type::eof(); )
+    {
+	const char cmd = static_cast<char>(ch);
+
+	const int nargs = get_args_size(cmd);
+
+	if(nargs < 0)
+	    throw BinaryPathError("Invalid command in binary path data");
+
+	sink.emit_char(cmd);
+
+	for(int i = 0; i < nargs; ++i)
+	{
+	    if(is_arc_flag(cmd, i))
+	    {
+		read_bytes(in, bytes, 1);
+
+		sink.emit_flag(bytes[0] != 0);
+	    }
+	    else
+	    {
+		read_bytes(in, bytes, value_size);
+
+		sink.emit_number(value_size == 4 ? from_little_endian<float>(bytes)
+						 : from_little_endian<double>(bytes));
+	    }
+	}
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Turtle.h"
+
+#include <istream>
+#include <streambuf>
+#include <stdexcept>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Binary path IR - SVG path data without the text
+//
+//   For consumers that would only parse the 'd' attribute again (e.g. to
+//   rasterize it), this writes the path commands as a binary stream instead,
+//   so no numbers are ever formatted or parsed.
+//
+//   Header (8 bytes):
+//
+//     "SPTB"           magic
+//     version          1 byte (1)
+//     value size       1 byte (4 = float32, 8 = float64)
+//     reserved         2 bytes (0)
+//
+//   Then one record per command:
+//
+//     opcode           1 byte - the (absolute) SVG command letter, one of
+//                      M L A Q T C S Z
+//     arguments        as in SVG, each a little-endian float of the header's
+//                      value size, except that the two flags of A are one
+//                      byte each (0 or 1)
+//
+//   The nl and sp commands are recorded as '\n' and ' ' opcodes, with no
+//   arguments, so that text converted back matches the original exactly.
+//   Renderers can just skip them.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class BinaryPathWriter final : public TurtleEmitInterface
+{
+    std::streambuf &out;
+
+    int m_value_size;
+
+    char m_command = 0;
+    int m_arg_index = 0;
+
+    void write_value(double val);
+    void write_flag(bool flag);
+
+public:
+    // value_size is 4 or 8
+    BinaryPathWriter(std::streambuf &out, int value_size);
+
+    void emit_char(char ch) override;
+    void emit_flag(bool flag) override;
+    void emit_number(double val) override;
+};
+
+struct BinaryPathError : public std::runtime_error
+{
+    explicit BinaryPathError(const std::string &msg)
+	: std::runtime_error(msg)
+    {
+    }
+};
+
+// Replays a binary path stream into 'sink' (e.g. an OstreamTurtle, to turn it
+// back into SVG text).  Throws BinaryPathError if the stream is invalid.
+void read_binary_path(std::istream &in, TurtleEmitInterface &sink);
@@ -0,0 +1,132 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Bytecode - the instruction set of the ExecutionEngine's bytecode backend
+//
+//   - Each instruction corresponds to exactly one statement of the closure
+//     backend, so the statement indices seen by the debugger are the same
+//     for both backends.
+//
+//   - Operands are small integers.  Anything larger (constants, expressions,
+//     builtin function bodies, loop descriptions) lives in a pool owned by the
+//     ExecutionEngine, and the operand is the index into that pool.
+//
+//   - The opcode list is an X-macro, so that the enum, the opcode names and
+//     the computed-goto dispatch table can't get out of sync.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define SVG_PATH_TURTLE_OPCODES(X)                                      \
+									\
+    /* a = constant index */                                            \
+    X(push_constant_local)                                             \
+    X(push_constant_capture)                                           \
+									\
+    /* a = expression index */                                          \
+    X(push_expr_local)                                                 \
+    X(push_expr_capture)                                               \
+									\
+    /* a = source offset, b = size */                                   \
+    X(copy_local_to_local)                                             \
+    X(copy_global_to_local)                                            \
+    X(copy_capture_to_local)                                           \
+    X(copy_local_to_capture)                                           \
+    X(copy_global_to_capture)                                          \
+    X(copy_capture_to_capture)                                         \
+    X(copy_enclosing_to_local)                                         \
+    X(copy_enclosing_to_capture)                                       \
+									\
+    /* the start of this frame, as the first value of a closure */      \
+    X(push_frame_link)                                                 \
+									\
+    /* a = fn index */                                                  \
+    X(push_lambda_local)                                               \
+    X(push_lambda_capture)                                             \
+    X(push_self_lambda_local)                                          \
+    X(push_self_lambda_capture)                                        \
+    X(start_fn_call)                                                   \
+    X(start_self_fn_call)                                              \
+									\
+    /* a = fn index, b = args size (locals), c = args size (captures) */ \
+    X(call_fn)                                                         \
+    X(call_memo)            /* call_fn, with --memoize */              \
+									\
+    /* a = offset of the lambda */                                      \
+    X(start_lambda_call_local)                                         \
+    X(start_lambda_call_capture)                                       \
+    X(start_lambda_call_enclosing)                                     \
+									\
+    /* a = offset of the lambda, b/c = args size (locals/captures) */   \
+    X(call_lambda_local)                                               \
+    X(call_lambda_capture)                                             \
+    X(call_lambda_enclosing)                                           \
+									\
+    /* a = condition expression, b = if block, c = else block */        \
+    X(if_else)                                                         \
+									\
+    /* a = block index (an if statement whose condition folded) */      \
+    X(local_block)                                                     \
+									\
+    /* a = loop index */                                                \
+    X(for_count)                                                       \
+    X(for_range)                                                       \
+    X(for_range_step)                                                  \
+									\
+    X(breakpoint)                                                      \
+									\
+    /* a = native index (the body of a builtin function) */            \
+    X(native)
+
+enum class Opcode : std::uint8_t
+{
+#define SVG_PATH_TURTLE_OPCODE_ENUM(name) name,
+    SVG_PATH_TURTLE_OPCODES(SVG_PATH_TURTLE_OPCODE_ENUM)
+#undef SVG_PATH_TURTLE_OPCODE_ENUM
+};
+
+struct Instruction
+{
+    Opcode op;
+
+    std::int32_t a = 0;
+    std::int32_t b = 0;
+    std::int32_t c = 0;
+
+    bool is_loop() const
+    {
+	return op == Opcode::for_count
+	    || op == Opcode::for_range
+	    || op == Opcode::for_range_step;
+    }
+};
+
+static_assert(sizeof(Instruction) == 16, "Instructions should stay compact");
+
+const char *get_opcode_name(Opcode op);
@@ -0,0 +1,499 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Compositor.h"
+
+#include "FileUtil.h"
+#include "Tokenizer.h"
+
+#include <charconv>
+#include <iostream>
+#include <iterator>
+#include <system_error>
+#include <vector>
+
+using std::string;
+using std::string_view;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Utilities
+//
+//////////////////////////////////////////////////////////////////////////////
+
+using CompositorError = Compositor::CompositorError;
+
+static string read_file(const string &filename)
+{
+    Infile in(filename);
+
+    std::istream &is = in;
+
+    return string(std::istreambuf_iterator<char>(is),
+		  std::istreambuf_iterator<char>());
+}
+
+static string_view trim(string_view s)
+{
+    const char *ws = " \t\r\n";
+
+    auto first = s.find_first_not_of(ws);
+
+    if(first == string_view::npos)
+	return {};
+
+    return s.substr(first, s.find_last_not_of(ws) + 1 - first);
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool is_name_char(char c)
+{
+    return !is_space(c) && c != '=' && c != '>' && c != '/'
+	&& c != '"' && c != '\'';
+}
+
+// A character reference (without its & and ;), which has to be to an ASCII
+// character other than NUL, as path data and programs are ASCII, and a NUL
+// would end the file name.
+static char decode_character_reference(string_view entity,
+				       const string &filename)
+{
+    auto error = [&](const string &what)
+    {
+	return CompositorError("File '" + filename + "' has " + what + ": &"
+			       + string(entity) + ";");
+    };
+
+    bool hex = entity.size() > 1 && entity[1] == 'x';
+
+    auto digits = entity.substr(hex ? 2 : 1);
+    auto digits_end = digits.data() + digits.size();
+
+    unsigned long c = 0;
+
+    auto [end, ec] = std::from_chars(digits.data(), digits_end, c,
+				     hex ? 16 : 10);
+
+    if(ec == std::errc::result_out_of_range
+       || (ec == std::errc{} && c > 0x10ffff))
+	throw error("a character reference out of range");
+
+    if(ec != std::errc{} || end != digits_end)
+	throw error("an invalid character reference");
+
+    if(c == 0)
+	throw error("a NUL character reference");
+
+    if(c > 0x7f)
+	throw error("a non-ASCII character reference");
+
+    return static_cast<char>(c);
+}
+
+// Only the predefined XML entities, and character references
+static string decode_entities(string_view s, const string &filename)
+{
+    string result;
+
+    while(!s.empty())
+    {
+	auto amp = s.find('&');
+	auto semi = s.find(';', amp);
+
+	if(amp == string_view::npos || semi == string_view::npos)
+	    break;
+
+	result += s.substr(0, amp);
+
+	auto entity = s.substr(amp + 1, semi - amp - 1);
+
+	if     (entity == "amp")  result += '&';
+	else if(entity == "lt")   result += '<';
+	else if(entity == "gt")   result += '>';
+	else if(entity == "quot") result += '"';
+	else if(entity == "apos") result += '\'';
+	else if(entity.size() > 1 && entity[0] == '#')
+	    result += decode_character_reference(entity, filename);
+	else
+	    result += s.substr(amp, semi + 1 - amp);
+
+	s.remove_prefix(semi + 1);
+    }
+
+    result += s;
+
+    return result;
+}
+
+static void check_path_data(const string &src, string_view data)
+{
+    string_view valid = "-0123456789.,MmLlHhVvCcSsQqTtAaZz \t\r\n";
+
+    for(char c : data)
+	if(valid.find(c) == string_view::npos)
+	    throw CompositorError("File '" + src
+				  + "' contains invalid SVG path data");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Tag scanning
+//
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    struct Attribute
+    {
+	string_view name;
+	string value;
+
+	// The whole attribute, including any space in front of it
+	size_t begin = 0;
+	size_t end = 0;
+    };
+
+    struct Tag
+    {
+	string_view name;
+
+	std::vector<Attribute> attributes;
+
+	// Offset of the "/>" or ">"
+	size_t close = 0;
+
+	const Attribute *find(string_view name) const
+	{
+	    for(auto &a : attributes)
+		if(a.name == name)
+		    return &a;
+
+	    return nullptr;
+	}
+    };
+}
+
+// Scans the start tag that begins at s[pos] (a '<'), returning its end.
+// The filename is for errors.
+static size_t scan_tag(string_view s, size_t pos, Tag &tag,
+		       const string &filename)
+{
+    auto next = pos + 1;
+
+    auto name_end = next;
+
+    while(name_end < s.size() && is_name_char(s[name_end]))
+	++name_end;
+
+    tag.name = s.substr(next, name_end - next);
+
+    next = name_end;
+
+    for(;;)
+    {
+	auto attr_begin = next;
+
+	while(next < s.size() && is_space(s[next]))
+	    ++next;
+
+	if(next >= s.size())
+	    throw CompositorError("Unterminated <" + string(tag.name) + "> tag");
+
+	if(s[next] == '>' || s.substr(next, 2) == "/>")
+	{
+	    tag.close = next;
+
+	    return s.find('>', next) + 1;
+	}
+
+	Attribute a;
+
+	a.begin = attr_begin;
+
+	auto name_begin = next;
+
+	while(next < s.size() && is_name_char(s[next]))
+	    ++next;
+
+	a.name = s.substr(name_begin, next - name_begin);
+
+	while(next < s.size() && is_space(s[next]))
+	    ++next;
+
+	if(a.name.empty() || next >= s.size() || s[next] != '=')
+	    throw CompositorError("Malformed attribute in <"
+				  + string(tag.name) + "> tag");
+
+	++next;
+
+	while(next < s.size() && is_space(s[next]))
+	    ++next;
+
+	char quote = next < s.size() ? s[next] : 0;
+
+	auto value_end = s.find(quote, next + 1);
+
+	if((quote != '"' && quote != '\'') || value_end == string_view::npos)
+	    throw CompositorError("Malformed value of attribute '"
+				  + string(a.name) + "'");
+
+	a.value = decode_entities(s.substr(next + 1, value_end - next - 1),
+				  filename);
+
+	next = a.end = value_end + 1;
+
+	tag.attributes.push_back(std::move(a));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Compositor
+//
+//////////////////////////////////////////////////////////////////////////////
+
+Compositor::Compositor(const Options &opt,
+		       OstreamTurtle::OutputFormatType format)
+    : m_opt(opt)
+    , m_program_out(&m_program_buffer)
+    , m_engine(m_program_out,
+	       nullptr,
+	       opt.bytecode ? ExecutionEngine::Backend::bytecode
+			    : ExecutionEngine::Backend::closures)
+{
+    m_engine.set_decimal_places(opt.decimal_places);
+    m_engine.set_output_format(format);
+    m_engine.set_simplify(opt.simplify);
+    m_engine.set_integer_grid(opt.integer_grid);
+    m_engine.set_limits(opt.get_limits());
+}
+
+string Compositor::read_named_path(const string &filename, const string &name)
+{
+    auto it = m_svg_files.find(filename);
+
+    if(it == m_svg_files.end())
+    {
+	auto &paths = m_svg_files[filename];
+
+	string svg = read_file(filename);
+
+	for(auto pos = svg.find("<path"); pos != string::npos;
+		 pos = svg.find("<path", pos))
+	{
+	    Tag tag;
+
+	    pos = scan_tag(svg, pos, tag, filename);
+
+	    auto id = tag.find("id");
+	    auto d = tag.find("d");
+
+	    if(tag.name == "path" && id && d)
+		paths.emplace(id->value, d->value);
+	}
+
+	it = m_svg_files.find(filename);
+    }
+
+    auto path = it->second.find(name);
+
+    if(path == it->second.end())
+	throw CompositorError("File '" + filename + "' has no path named '"
+			      + name + "'");
+
+    return path->second;
+}
+
+string Compositor::run_program(const string &filename)
+{
+    {
+	Infile input_file(filename);
+
+	Lexer lex(input_file);
+
+	Parser p(lex, m_engine);
+
+	// The first program's files are shared with all of the others.
+	if(!m_files)
+	{
+	    p.set_filename(filename);
+
+	    m_files = p.get_files();
+	}
+	else if(!p.set_filename(filename, m_files))
+	    throw CompositorError("'" + filename + "' was already imported "
+				  "as a module, and cannot also be a program");
+
+	p.parse();
+
+	// Each program only takes the params that it declares.
+	for(const auto &[param, value] : m_opt.params)
+	    m_engine.set_param(p.get_main(), param, value);
+
+	m_engine.execute_main(p.get_main());
+
+	m_engine.reset_params();
+    }
+
+    if(m_engine.had_pen_height_error() && !m_opt.disable_pen_warning)
+	std::cerr << filename << ": Warning: Pen height became negative. "
+		     "Results may be incorrect.\n";
+
+    m_engine.reset_turtle();
+
+    string result = m_program_buffer.str();
+
+    m_program_buffer.str({});
+
+    return result;
+}
+
+const string &Compositor::get_path_data(string_view attribute,
+					const string &value)
+{
+    string key = string(attribute) + '\0' + value;
+
+    auto it = m_paths.find(key);
+
+    if(it != m_paths.end())
+	return it->second;
+
+    if(value.empty())
+	throw CompositorError("Empty '" + string(attribute) + "' attribute");
+
+    string data;
+
+    if(attribute == "turtle")
+	data = run_program(value);
+    else
+    {
+	auto hash = value.find('#');
+
+	if(hash == string::npos)
+	    data = read_file(value);
+	else
+	    data = read_named_path(value.substr(0, hash),
+				   value.substr(hash + 1));
+
+	check_path_data(value, data);
+    }
+
+    return m_paths[key] = string(trim(data));
+}
+
+void Compositor::composite(string_view svg, std::ostream &out)
+{
+    const string template_name = m_opt.input_filename.empty()
+			       || m_opt.input_filename == "-"
+			       ? "<stdin>" : m_opt.input_filename;
+
+    size_t copied = 0;
+
+    auto copy_through = [&](size_t end)
+    {
+	out.write(svg.data() + copied, end - copied);
+
+	copied = end;
+    };
+
+    for(size_t pos = svg.find('<'); pos != string_view::npos;
+	       pos = svg.find('<', pos))
+    {
+	// Skip comments, CDATA, declarations and end tags
+	if(svg.substr(pos, 4) == "<!--")
+	{
+	    pos = svg.find("-->", pos);
+
+	    if(pos == string_view::npos)
+		throw CompositorError("Unterminated comment");
+
+	    continue;
+	}
+
+	if(svg.substr(pos, 9) == "<![CDATA[")
+	{
+	    pos = svg.find("]]>", pos);
+
+	    if(pos == string_view::npos)
+		throw CompositorError("Unterminated CDATA section");
+
+	    continue;
+	}
+
+	if(svg.substr(pos, 5) != "<path"
+	   || pos + 5 >= svg.size()
+	   || is_name_char(svg[pos + 5]))
+	{
+	    ++pos;
+	    continue;
+	}
+
+	Tag tag;
+
+	auto tag_end = scan_tag(svg, pos, tag, template_name);
+
+	auto src = tag.find("src");
+	auto turtle = tag.find("turtle");
+
+	if(src && turtle)
+	    throw CompositorError("A path has both 'src' and 'turtle' "
+				  "attributes");
+
+	if(auto source = src ? src : turtle)
+	{
+	    const string &data = get_path_data(source->name, source->value);
+
+	    // The new d attribute takes the place of the source attribute,
+	    // and any old d attribute is dropped.
+	    for(auto &a : tag.attributes)
+	    {
+		if(&a == source)
+		{
+		    copy_through(a.begin);
+
+		    auto attr = svg.substr(a.begin, a.end - a.begin);
+
+		    out << attr.substr(0, attr.find_first_not_of(" \t\r\n"))
+			<< "d=\"" << data << '"';
+
+		    copied = a.end;
+		}
+		else if(a.name == "d")
+		{
+		    copy_through(a.begin);
+
+		    copied = a.end;
+		}
+	    }
+	}
+
+	pos = tag_end;
+    }
+
+    copy_through(svg.size());
+}
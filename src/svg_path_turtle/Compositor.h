@@ -0,0 +1,117 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Engine.h"
+#include "Parser.h"
+#include "Options.h"
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <ostream>
+#include <map>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Compositor - fills in the path data of an SVG template (--composite)
+//
+//   This does the job of tools/svg_path_turtle_compositor, without Python and
+//   without running svg_path_turtle once per path:
+//
+//   - The template is copied through as it is, except for the <path> tags
+//     with a src or turtle attribute.  That attribute is replaced by d, the
+//     path data.
+//
+//   - src="file" is a file of path data, as written by svg_path_turtle, and
+//     src="file.svg#name" is the path with id="name" in an SVG file (see
+//     new_path).
+//
+//   - turtle="program" is a turtle program, which is run here to produce the
+//     path data.  All of the programs are compiled into one ExecutionEngine,
+//     sharing their imports, so a module like library.svgt is only parsed
+//     once however many programs use it.
+//
+//   Each file or program is only read (or run) once, however many paths
+//   refer to it.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class Compositor
+{
+    const Options &m_opt;
+
+    // Programs write here, and their output is taken after each one.
+    std::stringbuf m_program_buffer;
+    std::ostream m_program_out;
+
+    ExecutionEngine m_engine;
+
+    Parser::SharedFiles m_files;
+
+    // Path data, by src or turtle attribute value
+    std::map<std::string, std::string> m_paths;
+
+    // The named paths of SVG files, by filename
+    std::map<std::string, std::map<std::string, std::string>> m_svg_files;
+
+    const std::string &get_path_data(std::string_view attribute,
+				     const std::string &value);
+
+    std::string read_named_path(const std::string &filename,
+				const std::string &name);
+    std::string run_program(const std::string &filename);
+
+public:
+    struct CompositorError : public std::runtime_error
+    {
+	explicit CompositorError(const std::string &msg)
+	    : std::runtime_error(msg)
+	{
+	}
+    };
+
+    Compositor(const Compositor &) = delete;
+    Compositor &operator=(const Compositor &) = delete;
+
+    Compositor(const Options &opt, OstreamTurtle::OutputFormatType format);
+
+    // Throws CompositorError for bad templates, files and paths.  (Errors in
+    // the turtle programs themselves are reported, and exit, as usual.)
+    void composite(std::string_view svg_template, std::ostream &out);
+
+    // For reporting errors in the programs
+    ExecutionEngine &get_engine()
+    {
+	return m_engine;
+    }
+
+    // For all of the programs run so far
+    std::uint64_t get_segment_count() const
+    {
+	return m_engine.get_segment_count();
+    }
+};
@@ -55,6 +55,14 @@ void EngineDebugger::set_show_stacks(bool b)
     m_show_stacks = b;
 }
 
+void EngineDebugger::set_profile(bool b, unsigned sample_interval)
+{
+    if(b)
+	m_profiler = std::make_unique<Profiler>(sample_interval);
+    else
+	m_profiler.reset();
+}
+
 bool EngineDebugger::needs_trace_file() const
 {
     return m_call_trace_level || m_report_breakpoints;
@@ -139,6 +147,64 @@ void EngineDebugger::list_chunks(std::ostream &out)
     out << " --------- End of chunks -------------------------\n";
 }
 
+std::string EngineDebugger::get_chunk_name(size_t chunk_index) const
+{
+    if(chunk_index < m_chunk_names.size())
+	return m_chunk_names[chunk_index];
+
+    return {};
+}
+
+// The function's name (or what sort of chunk it is), and where it starts
+std::string EngineDebugger::get_chunk_display_name(size_t chunk_index) const
+{
+    std::string name;
+
+    if(chunk_index < m_chunk_names.size())
+	name = m_chunk_names[chunk_index];
+
+    if(chunk_index >= m_chunks.size())
+	return name.empty() ? "(builtin)" : name;
+
+    const ChunkInfo &c = m_chunks[chunk_index];
+
+    if(name.empty())
+	name = c.is_call_frame ? "(lambda)" : "(block)";
+
+    if(!c.statements.empty())
+    {
+	const auto &loc = c.statements[0].loc;
+	const auto &filename = m_filenames.at(c.file_id);
+
+	if(filename.empty())
+	    name += std::format(" (line {})", loc.linenum);
+	else
+	    name += std::format(" ({}:{})", filename, loc.linenum);
+    }
+
+    return name;
+}
+
+void EngineDebugger::write_profile(std::ostream &out) const
+{
+    assert(m_profiler);
+
+    m_profiler->write_report(out, [this](size_t chunk_index)
+    {
+	return get_chunk_display_name(chunk_index);
+    });
+}
+
+void EngineDebugger::write_folded_stacks(std::ostream &out) const
+{
+    assert(m_profiler);
+
+    m_profiler->write_folded_stacks(out, [this](size_t chunk_index)
+    {
+	return get_chunk_display_name(chunk_index);
+    });
+}
+
 void EngineDebugger::show_location(std::ostream &out,
 				    const EngineLocation &loc) const
 {
@@ -247,6 +313,15 @@ void EngineDebugger::set_source_location(const SourceLocation &loc,
     m_source_info.label = label;
 }
 
+void EngineDebugger::set_chunk_name(size_t chunk_index,
+				    const std::string &name)
+{
+    if(chunk_index >= m_chunk_names.size())
+	m_chunk_names.resize(chunk_index + 1);
+
+    m_chunk_names[chunk_index] = name;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 //
 //  EngineDebugSink implementation
@@ -289,6 +364,9 @@ bool EngineDebugger::want_stack_description() const
 
 void EngineDebugger::handle_trace_point(const EngineDebugSink::Info &info)
 {
+    if(m_profiler)
+	m_profiler->count_statement(info.loc.chunk_index);
+
     if(m_call_trace_level)
     {
 	assert(m_p_trace_stream);
@@ -329,3 +407,23 @@ void EngineDebugger::handle_breakpoint(const EngineLocation &loc)
 	m_p_trace_stream->flush();
     }
 }
+
+void EngineDebugger::handle_enter_chunk(size_t chunk_index,
+					std::uint64_t segment_count)
+{
+    if(m_profiler)
+	m_profiler->enter(chunk_index, segment_count);
+}
+
+void EngineDebugger::handle_exit_chunk(size_t chunk_index,
+				       std::uint64_t segment_count)
+{
+    if(m_profiler)
+	m_profiler->exit(chunk_index, segment_count);
+}
+
+void EngineDebugger::handle_sample(const std::vector<EngineLocation> &stack)
+{
+    if(m_profiler)
+	m_profiler->sample(stack);
+}
@@ -28,10 +28,12 @@
 
 #include "DebugSink.h"
 #include "Messages.h"
+#include "Profiler.h"
 
 #include <vector>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 
 class EngineDebugger : public EngineDebugSink
@@ -123,6 +125,12 @@ private:
 
     bool m_is_executing = false;
 
+    // From set_chunk_name(), for the chunks that have names
+    std::vector<std::string> m_chunk_names;
+
+    // With set_profile()
+    std::unique_ptr<Profiler> m_profiler;
+
     EngineLocation m_pen_height_error_loc;
 
     //////////////////////////////////////////////////////
@@ -137,6 +145,8 @@ private:
 
     void show_location(std::ostream &out, const EngineLocation &loc) const;
 				       
+    std::string get_chunk_display_name(size_t chunk_index) const;
+
     void show_trace_point(std::ostream &out,
 			  const char *phase,
 			  const EngineLocation &loc,
@@ -153,6 +163,8 @@ private:
     void set_source_location(const SourceLocation &loc,
 			     const char *label = nullptr) override;
 
+    void set_chunk_name(size_t chunk_index, const std::string &name) override;
+
     //////////////////////////////////////////////////////
     //
     // EngineDebugSink implementation
@@ -175,6 +187,14 @@ private:
 
     void handle_breakpoint(const EngineLocation &loc) override;
 
+    void handle_enter_chunk(size_t chunk_index,
+			    std::uint64_t segment_count) override;
+
+    void handle_exit_chunk(size_t chunk_index,
+			   std::uint64_t segment_count) override;
+
+    void handle_sample(const std::vector<EngineLocation> &stack) override;
+
 public:
 
     //////////////////////////////////////////////////////
@@ -190,6 +210,10 @@ public:
     void set_report_breakpoints(bool b = true);
     void set_show_stacks(bool b = true);
 
+    // Keeps the costs of each chunk (see Profiler.h), for write_profile().
+    // The sample interval must be the engine's.
+    void set_profile(bool b = true, unsigned sample_interval = 0);
+
     //// Debugging
 
     // If needs_trace_file() returns true, set_trace_output() must be called
@@ -206,4 +230,16 @@ public:
 			const std::string &stack_description);
 
     void list_chunks(std::ostream &out);
+
+    // The name that the parser gave the chunk, or an empty string.  This
+    // works without an engine too, if this is only the parser's sink.
+    std::string get_chunk_name(size_t chunk_index) const;
+
+    //// Profiling
+
+    // A table of the chunks that were run, the costliest first
+    void write_profile(std::ostream &out) const;
+
+    // The call stacks' self times, for flame graph tools
+    void write_folded_stacks(std::ostream &out) const;
 };
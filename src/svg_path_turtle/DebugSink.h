@@ -27,7 +27,9 @@
 #include "EngineTypes.h"
 #include "Turtle.h"
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 class EngineDebugSink
 {
@@ -37,7 +39,7 @@ public:
     {
       const EngineLocation &loc;
 
-      const SvgPathTurtle &turtle; // execution only
+      const SvgPathTurtleBase &turtle; // execution only
 
       // stack_description may be empty (see want_stack_description())
 
@@ -62,6 +64,20 @@ public:
     virtual void handle_pen_height_error(const EngineLocation &loc) = 0;
 
     virtual void handle_breakpoint(const EngineLocation &loc) = 0;
+
+    // Each chunk's frame (builtins' too) is entered and left through these,
+    // with the number of path segments drawn so far.
+    virtual void handle_enter_chunk(size_t chunk_index,
+				    std::uint64_t segment_count) = 0;
+
+    virtual void handle_exit_chunk(size_t chunk_index,
+				   std::uint64_t segment_count) = 0;
+
+    // With a sample interval (see ExecutionEngine::set_sample_interval()),
+    // this is called every n statements, instead of handle_trace_point(),
+    // handle_enter_chunk() and handle_exit_chunk().  The innermost frame is
+    // last, and may be a builtin's.
+    virtual void handle_sample(const std::vector<EngineLocation> &stack) = 0;
 };
 
 class ParserDebugSink
@@ -73,4 +89,8 @@ public:
 
     virtual void set_source_location(const SourceLocation &loc,
 				     const char *label = nullptr) = 0;
+
+    // The name of a function's chunk (builtins included), for reports.
+    virtual void set_chunk_name(size_t chunk_index,
+				const std::string &name) = 0;
 };
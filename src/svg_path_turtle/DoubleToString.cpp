@@ -25,34 +25,54 @@
 #include "DoubleToString.h"
 
 #include <string>
-#include <sstream>
-#include <iomanip>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <algorithm>
 
-std::string double_to_string(double d, int precision)
+// std::to_chars with a precision formats exactly as printf("%.*f") does, which
+// is also what std::fixed with std::setprecision() gives.
+
+char *double_to_chars(char *first, char *last, double d, int precision)
 {
-    std::ostringstream o;
+    auto [end, ec] = std::to_chars(first, last, d,
+				   std::chars_format::fixed, precision);
+
+    if(ec != std::errc{})
+	return nullptr;
 
-    o << std::fixed << std::setprecision(precision) << d;
+    // Drop trailing zeros, and then a dangling '.'
 
-    std::string s = o.str();
+    if(std::memchr(first, '.', end - first))
+    {
+	while(end[-1] == '0')
+	    --end;
 
-    auto p = s.find_last_of('.');
+	if(end[-1] == '.')
+	    --end;
+    }
 
-    if(p != std::string::npos)
+    if(end - first == 2 && first[0] == '-' && first[1] == '0')
     {
-	auto end = s.find_last_not_of('0');
-
-	if(end != std::string::npos)
-	{
-	    if(end == p)
-		s.erase(end);
-	    else if(end > p)
-		s.erase(end+1);
-	}
+	first[0] = '0';
+	end = first + 1;
     }
 
-    if(s == "-0")
-	return "0";
+    return end;
+}
+
+std::string double_to_string(double d, int precision)
+{
+    char buf[double_to_chars_size];
+
+    if(auto end = double_to_chars(buf, buf + sizeof(buf), d, precision))
+	return { buf, end };
+
+    // Only very large values (or precisions) get here.  DBL_MAX has 309
+    // digits before the '.'.
+    std::vector<char> big(320 + std::max(precision, 0));
+
+    auto end = double_to_chars(big.data(), big.data() + big.size(), d, precision);
 
-    return s;
+    return { big.data(), end };
 }
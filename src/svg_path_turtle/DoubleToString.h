@@ -25,9 +25,18 @@
 #pragma once
 
 #include <string>
+#include <cstddef>
 
 // Returns a string representing 'd' with std::fixed,
 // std::setprecision(precision), and with no trailing zeros (or exponent), no
 // dangling '.', and no "-0".
 
 std::string double_to_string(double d, int precision = 2);
+
+// The same, but written into [first, last) without allocating.  Returns the
+// end of what was written, or nullptr if it doesn't fit.  A buffer of
+// double_to_chars_size fits any coordinate of reasonable size.
+
+constexpr size_t double_to_chars_size = 64;
+
+char *double_to_chars(char *first, char *last, double d, int precision = 2);
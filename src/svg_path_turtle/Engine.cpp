@@ -23,6 +23,7 @@
  */
 
 #include "Engine.h"
+#include "EngineMemo.h"
 
 #include <iostream>
 #include <sstream>
@@ -30,20 +31,42 @@
 #include <cassert>
 #include <format>
 
-constexpr int infinite_recursion_limit = 1000000;
+ExecutionEngine::Program::Program(Backend backend)
+    : m_chunks(m_arena.get_resource())
+    , m_backend(backend)
+    , m_constants(m_arena.get_resource())
+    , m_exprs(m_arena.get_resource())
+    , m_natives(m_arena.get_resource())
+    , m_loops(m_arena.get_resource())
+{
+}
 
 ExecutionEngine::ExecutionEngine(std::ostream &out,
-				 EngineDebugSink *debugger)
+				 EngineDebugSink *debugger,
+				 Backend backend)
     : m_turtle(out)
     , m_debugger(debugger)
 {
+    auto program = std::make_shared<Program>(backend);
+
+    m_build = program.get();
+    m_program = std::move(program);
 }
 
+ExecutionEngine::ExecutionEngine(SharedProgram program, std::ostream &out)
+    : m_program(std::move(program))
+    , m_turtle(out)
+{
+    assert(m_program);
+}
+
+ExecutionEngine::~ExecutionEngine() = default;
+
 ExecutionEngine::Chunk &ExecutionEngine::get_chunk()
 {
     assert(!m_is_executing);
 
-    return get_chunk(m_current_chunk);
+    return get_build_chunk(m_current_chunk);
 }
 
 const ExecutionEngine::Chunk &ExecutionEngine::get_chunk() const
@@ -53,29 +76,58 @@ const ExecutionEngine::Chunk &ExecutionEngine::get_chunk() const
     return get_chunk(m_current_chunk);
 }
 
-ExecutionEngine::Chunk &ExecutionEngine::get_chunk(size_t index)
+void ExecutionEngine::add_statement(Statement stmt)
 {
-    assert(index < m_chunks.size());
+    assert(!is_bytecode());
+
+    get_chunk().statements.push_back(stmt);
 
-    return m_chunks[index];
+    note_new_statement();
 }
 
-const ExecutionEngine::Chunk &ExecutionEngine::get_chunk(size_t index) const
+void ExecutionEngine::add_instruction(Opcode op, int a, int b, int c)
 {
-    assert(index < m_chunks.size());
+    assert(is_bytecode());
 
-    return m_chunks[index];
+    get_chunk().code.push_back({ .op = op, .a = a, .b = b, .c = c });
+
+    note_new_statement();
 }
 
-void ExecutionEngine::add_statement(Statement stmt)
+void ExecutionEngine::add_native_statement(Statement stmt)
 {
-    auto &s = get_chunk().statements;
+    if(!is_bytecode())
+	add_statement(stmt);
+    else
+    {
+	auto index = static_cast<int>(build().m_natives.size());
+
+	build().m_natives.push_back(stmt);
+
+	add_instruction(Opcode::native, index);
+    }
+}
+
+int ExecutionEngine::add_constant(double val)
+{
+    build().m_constants.push_back(val);
+
+    return static_cast<int>(build().m_constants.size() - 1);
+}
 
-    s.push_back(stmt);
+int ExecutionEngine::add_expr(Expr e)
+{
+    build().m_exprs.push_back(e);
+
+    return static_cast<int>(build().m_exprs.size() - 1);
+}
 
+void ExecutionEngine::note_new_statement()
+{
     if(m_debugger && !get_chunk().is_builtin())
     {
-	const EngineLocation parse_loc{ m_current_chunk, s.size() - 1 };
+	const EngineLocation parse_loc{ m_current_chunk,
+					get_chunk().get_num_statements() - 1 };
 
 	EngineDebugSink::Info info{ parse_loc, m_turtle, get_stack_description_arg() };
 
@@ -106,8 +158,22 @@ EngineLocation ExecutionEngine::get_engine_location() const
 
 void ExecutionEngine::exec_statement(const Statement &stmt)
 {
-    stmt();
+    stmt(*this);
+}
+
+void ExecutionEngine::pen_down()
+{
+    m_turtle.pen_down();
+
+    check_pen_height();
+}
 
+// Only pen_down() can make the pen height negative, so it's only checked
+// there, and not after every statement.  The location reported to the
+// debugger is the same, since get_engine_location() skips over the frame of
+// the builtin 'down' itself.
+void ExecutionEngine::check_pen_height()
+{
     if(!m_pen_height_became_negative)
 	if(m_turtle.get_pen_height() < 0)
 	{
@@ -122,6 +188,18 @@ void ExecutionEngine::trace_statement()
 {
     assert(m_debugger);
 
+    if(m_sample_interval)
+    {
+	if(--m_sample_countdown == 0)
+	{
+	    m_sample_countdown = m_sample_interval;
+
+	    m_debugger->handle_sample(m_debug_program_counter);
+	}
+
+	return;
+    }
+
     auto chunk_index = m_debug_program_counter.back().chunk_index;
 
     if(!get_chunk(chunk_index).is_builtin())
@@ -134,14 +212,47 @@ void ExecutionEngine::trace_statement()
     }
 }
 
-void ExecutionEngine::exec_statements(std::vector<Statement> &statements)
+void ExecutionEngine::exec_statements(const StatementList &statements,
+				      bool tail)
+{
+    if(!m_debugger)
+	run_statements<false>(statements, tail);
+    else
+	run_statements<true>(statements, tail);
+}
+
+// Only the last statement can be in tail position (see m_tail_position), and
+// only if the statements are.
+template<bool debugging>
+void ExecutionEngine::run_statements(const StatementList &statements,
+				     bool tail)
 {
-    if(!m_stack.check_stack_size(infinite_recursion_limit))
+    if(!m_stack.check_stack_size(m_stack_limit))
+	throw_stack_overflow();
+
+    if(native_stack_exhausted())
 	throw InfiniteRecursionException{};
 
-    if(!m_debugger)
-	for(const auto &stmt : statements)
-	    exec_statement(stmt);
+    count_statements(statements.size());
+
+    if constexpr(!debugging)
+    {
+	if(statements.empty())
+	    return;
+
+	m_tail_position = false;
+
+	auto last = std::prev(statements.end());
+
+	for(auto stmt = statements.begin(); stmt != last; ++stmt)
+	    exec_statement(*stmt);
+
+	m_tail_position = tail;
+
+	exec_statement(*last);
+
+	m_tail_position = false;
+    }
     else
 	for(const auto &stmt : statements)
 	{
@@ -153,20 +264,28 @@ void ExecutionEngine::exec_statements(std::vector<Statement> &statements)
 	}
 }
 
+template<bool debugging>
 void ExecutionEngine::exec_fn_body(const StackSize &args_size,
 				    int params_size,
 				    bool has_closure_position,
-				    std::vector<Statement> &statements)
+				    const StatementList &statements)
 {
     // Closure objects are not passed into functions - only the
     // closure_position.  That's why the 'captures' size is zero here.
 
     m_stack.push_frame({ args_size.locals, 0 }, { params_size, 0 } );
 
-    exec_statements(statements);
+    run_statements<debugging>(statements, true);
 
     m_stack.pop_frame();
 
+    // A call the body left to be made here replaces it, closure position
+    // and all.  Its arguments have no captures, so those of this call are
+    // still the ones to unwind.
+    if constexpr(!debugging)
+	while(m_tail_call.chunk)
+	    has_closure_position = exec_tail_call(has_closure_position);
+
     // When we unwind the fn call, we have to also pop the closure position if
     // it was pushed, and also the closures created for any anonymous lambda
     // functions in the arguments.
@@ -179,53 +298,164 @@ void ExecutionEngine::exec_fn_body(const StackSize &args_size,
     m_stack.pop(pop_size);
 }
 
+// Without a debugger, a call in tail position (see m_tail_position) is left
+// to the exec_fn_body() of the function making it, which makes it once its
+// own frame is gone, so that tail recursion runs in constant native stack.
+// The conditions are those of the bytecode backend's is_tail_call(), and
+// calls from the main chunk aren't tail calls either, since its frame (the
+// first after the bottom one) holds the globals.
+void ExecutionEngine::exec_call_or_tail_call(const Chunk &c,
+					      size_t fn_index,
+					      const StackSize &args_size,
+					      bool has_closure_position)
+{
+    if(!m_tail_position
+       || m_stack.get_num_frames() <= 2
+       || c.is_builtin()
+       || args_size.captures != 0
+       || m_stack.get_frame_size().captures != 0)
+    {
+	exec_call<false>(c, fn_index, args_size, has_closure_position);
+	return;
+    }
+
+    m_tail_position = false;
+
+    // The closure position (if any), then the arguments
+    int size = args_size.locals + (has_closure_position ? 1 : 0);
+    int top = m_stack.get_frame_size().locals;
+
+    m_tail_call.values.clear();
+
+    for(int i = top - size; i < top; ++i)
+	m_tail_call.values.push_back(m_stack[i]);
+
+    m_stack.pop({ size, 0 });
+
+    m_tail_call.chunk = &c;
+    m_tail_call.args_size = args_size.locals;
+    m_tail_call.has_closure_position = has_closure_position;
+}
+
+// Makes the call in m_tail_call, once the function that made it has popped
+// its frame.  Whether that function had a closure position, just below
+// where its frame was, is given, and whether the new call has is returned.
+bool ExecutionEngine::exec_tail_call(bool has_closure_position)
+{
+    const Chunk &c = *std::exchange(m_tail_call.chunk, nullptr);
+
+    m_stack.pop({ has_closure_position ? 1 : 0, 0 });
+
+    for(double val : m_tail_call.values)
+	m_stack.push(val);
+
+    m_stack.push_frame({ m_tail_call.args_size, 0 },
+		       { c.info.f.params_size, 0 });
+
+    has_closure_position = m_tail_call.has_closure_position;
+
+    run_statements<false>(c.statements, true);
+
+    m_stack.pop_frame();
+
+    return has_closure_position;
+}
+
 void ExecutionEngine::exec_call_fn(size_t fn_index, const StackSize &args_size)
 {
-    Chunk &c = get_chunk(fn_index);
+    const Chunk &c = get_chunk(fn_index);
+
+    if(!m_debugger)
+	exec_call<false>(c, fn_index, args_size, c.info.f.is_closure());
+    else
+	exec_call<true>(c, fn_index, args_size, c.info.f.is_closure());
+}
 
+// The callee's Chunk is bound when the call is compiled, and whether the
+// engine is debugging is known then too, so this has no lookups or debugger
+// checks of its own.
+template<bool debugging>
+void ExecutionEngine::exec_call(const Chunk &c,
+				size_t fn_index,
+				const StackSize &args_size,
+				bool has_closure_position)
+{
     assert(c.is_call_frame());
 
-    if(m_debugger)
+    if constexpr(debugging)
 	push_debug_frame(fn_index);
 
-    exec_fn_body(args_size,
-		 c.info.f.params_size,
-		 c.info.f.is_closure(),
-		 c.statements);
+    exec_fn_body<debugging>(args_size,
+			    c.info.f.params_size,
+			    has_closure_position,
+			    c.statements);
 
-    if(m_debugger)
+    if constexpr(debugging)
 	pop_debug_frame();
 }
 
-void ExecutionEngine::exec_call_lambda(size_t fn_index,
-					const StackSize &args_size)
+// Memoized calls are made from EngineMemo.cpp.
+template void ExecutionEngine::exec_call<false>(const Chunk &c,
+						size_t fn_index,
+						const StackSize &args_size,
+						bool has_closure_position);
+
+template<bool debugging>
+void ExecutionEngine::exec_call_lambda(double fn_index,
+					const StackSize &args_size,
+					LambdaCallCache &cache)
 {
-    Chunk &c = get_chunk(fn_index);
+    const Chunk *c = cache.chunk.load(std::memory_order_relaxed);
 
-    assert(c.is_call_frame());
+    if(!c || static_cast<double>(c->index) != fn_index)
+    {
+	assert(fn_index >= 0.0);
+	assert(std::fmod(fn_index, 1.0) == 0.0);
 
-    if(m_debugger)
-	push_debug_frame(fn_index);
+	c = &get_chunk(static_cast<size_t>(fn_index));
+
+	cache.chunk.store(c, std::memory_order_relaxed);
+    }
 
-    exec_fn_body(args_size,
-		 c.info.f.params_size,
-		 true,
-		 c.statements);
+    if constexpr(!debugging)
+	exec_call_or_tail_call(*c, static_cast<size_t>(fn_index), args_size, true);
+    else
+	exec_call<true>(*c, static_cast<size_t>(fn_index), args_size, true);
+}
 
+// The per-iteration part of a loop.  Without a debugger, this is
+// exec_call_local_block() without the chunk lookup or the stack check (the
+// stack can't grow from one iteration to the next).
+void ExecutionEngine::exec_loop_body(size_t block_index, const Chunk &c)
+{
     if(m_debugger)
-	pop_debug_frame();
+    {
+	exec_call_local_block(block_index);
+	return;
+    }
+
+    // The loop goes round again, so nothing in it is in tail position.
+    m_tail_position = false;
+
+    count_statements(c.statements.size());
+
+    for(const auto &stmt : c.statements)
+	exec_statement(stmt);
+
+    m_stack.pop(c.info.b.get_unwind_size());
 }
 
 void ExecutionEngine::exec_call_local_block(size_t block_index)
 {
-    Chunk &c = get_chunk(block_index);
+    const Chunk &c = get_chunk(block_index);
 
     assert(c.is_local_block());
 
     if(m_debugger)
 	push_debug_frame(block_index);
 
-    exec_statements(c.statements);
+    // In tail position if the statement running it is
+    exec_statements(c.statements, m_tail_position);
 
     m_stack.pop(c.info.b.get_unwind_size());
 
@@ -233,7 +463,7 @@ void ExecutionEngine::exec_call_local_block(size_t block_index)
 	pop_debug_frame();
 }
 
-static void describe_stack(std::ostream &out, FrameStack<double>::Scanner scanner)
+static void describe_stack(std::ostream &out, EngineStack::Scanner scanner)
 {
     for(; scanner.more(); scanner.next())
 	if(scanner.is_outer_frame())
@@ -275,6 +505,10 @@ void ExecutionEngine::push_debug_frame(size_t chunk_index)
     assert(m_debugger);
 
     m_debug_program_counter.emplace_back(chunk_index, static_cast<size_t>(0));
+
+    if(!m_sample_interval)
+	m_debugger->handle_enter_chunk(chunk_index,
+				       m_turtle.get_segment_count());
 }
 
 void ExecutionEngine::pop_debug_frame()
@@ -282,7 +516,12 @@ void ExecutionEngine::pop_debug_frame()
     assert(m_debugger);
     assert(!m_debug_program_counter.empty());
 
+    auto chunk_index = m_debug_program_counter.back().chunk_index;
+
     m_debug_program_counter.pop_back();
+
+    if(!m_sample_interval)
+	m_debugger->handle_exit_chunk(chunk_index, m_turtle.get_segment_count());
 }
 
 void ExecutionEngine::increment_debug_statement_counter()
@@ -293,19 +532,55 @@ void ExecutionEngine::increment_debug_statement_counter()
     ++m_debug_program_counter.back().statement_index;
 }
 
+void ExecutionEngine::set_sample_interval(unsigned n)
+{
+    m_sample_interval = n;
+    m_sample_countdown = n;
+}
+
 void ExecutionEngine::set_output_format(OstreamTurtle::OutputFormatType format)
 {
     m_turtle.set_output_format(format);
 }
 
+void ExecutionEngine::set_segment_sink(TurtleEmitInterface &sink)
+{
+    m_turtle.set_segment_sink(sink);
+}
+
 void ExecutionEngine::set_decimal_places(int n)
 {
     m_turtle.set_decimal_places(n);
 }
 
+void ExecutionEngine::set_simplify(bool simplify)
+{
+    m_turtle.set_simplify(simplify);
+}
+
+void ExecutionEngine::set_clip(const PathCuller::Rect &clip)
+{
+    m_turtle.set_clip(clip);
+}
+
+void ExecutionEngine::set_new_path_handler(NewPathHandler handler)
+{
+    m_new_path_handler = std::move(handler);
+}
+
+void ExecutionEngine::set_fragment_sink(TurtleFragmentSink *sink)
+{
+    m_turtle.set_fragment_sink(sink);
+}
+
+void ExecutionEngine::set_integer_grid(bool integer_grid)
+{
+    m_turtle.set_integer_grid(integer_grid);
+}
+
 Expr ExecutionEngine::compile_access_constant(double val)
 {
-    return [val]()->double { return val; };
+    return Expr::constant(val);
 }
 
 Expr ExecutionEngine::compile_access_value(ValueDomain source, int offset)
@@ -313,25 +588,16 @@ Expr ExecutionEngine::compile_access_value(ValueDomain source, int offset)
     switch(source)
     {
 	case ValueDomain::Local:
-	    return
-		[this, offset]()->double
-		{
-		    return m_stack[offset];
-		};
+	    return Expr::leaf(ExprOp::read_local, offset);
 
 	case ValueDomain::Global:
-	    return
-		[this, offset]()->double
-		{
-		    return m_stack.read_global(offset);
-		};
+	    return Expr::leaf(ExprOp::read_global, offset);
 
 	case ValueDomain::Capture:
-	    return
-		[this, offset]()->double
-		{
-		    return m_stack.read_capture(offset);
-		};
+	    return Expr::leaf(ExprOp::read_capture, offset);
+
+	case ValueDomain::Enclosing:
+	    return Expr::leaf(ExprOp::read_enclosing, offset);
     }
 
     assert(false);
@@ -340,22 +606,127 @@ Expr ExecutionEngine::compile_access_value(ValueDomain source, int offset)
 
 Expr ExecutionEngine::compile_turtle_x_expr()
 {
-    return [this]()->double { return m_turtle.get_x(); };
+    mark_impure();
+
+    return Expr::leaf(ExprOp::turtle_x);
 }
 
 Expr ExecutionEngine::compile_turtle_y_expr()
 {
-    return [this]()->double { return m_turtle.get_y(); };
+    mark_impure();
+
+    return Expr::leaf(ExprOp::turtle_y);
 }
 
 Expr ExecutionEngine::compile_turtle_dir_expr()
 {
-    return [this]()->double { return m_turtle.get_dir(); };
+    mark_impure();
+
+    return Expr::leaf(ExprOp::turtle_dir);
 }
 
 Expr ExecutionEngine::compile_unique_val_expr()
 {
-    return [this]()->double { return m_next_unique_num++; };
+    mark_impure();
+
+    return Expr::leaf(ExprOp::unique);
+}
+
+ExecutionEngine::UniqueNum ExecutionEngine::next_unique_num()
+{
+    if(m_next_unique_num == m_unique_limit)
+	throw UniqueRangeException{};
+
+    return m_next_unique_num++;
+}
+
+Expr ExecutionEngine::compile_param_expr(size_t main_chunk_index,
+					 const std::string &name,
+					 double default_value)
+{
+    auto &params = build().m_params;
+
+    params.push_back({ name, default_value, main_chunk_index });
+
+    return Expr::leaf(ExprOp::read_param, static_cast<int>(params.size() - 1));
+}
+
+double ExecutionEngine::eval_code(const Expr &e)
+{
+    constexpr int small_stack_size = 16;
+
+    if(e.get_max_depth() <= small_stack_size)
+    {
+	double stack[small_stack_size];
+
+	return eval_code(e, stack);
+    }
+    else
+    {
+	std::vector<double> stack(e.get_max_depth());
+
+	return eval_code(e, stack.data());
+    }
+}
+
+double ExecutionEngine::eval_code(const Expr &e, double *stack)
+{
+    double *sp = stack;
+
+    for(const ExprInstruction *ip = e.begin(); ip != e.end(); ++ip)
+    {
+	switch(ip->op)
+	{
+	    // Leaves
+
+	    case ExprOp::constant:     *sp++ = ip->value;                          break;
+	    case ExprOp::read_local:   *sp++ = m_stack[ip->offset];                break;
+	    case ExprOp::read_global:  *sp++ = m_stack.read_global(ip->offset);    break;
+	    case ExprOp::read_capture: *sp++ = m_stack.read_capture(ip->offset);   break;
+	    case ExprOp::read_enclosing: *sp++ = m_stack.read_enclosing(ip->offset); break;
+	    case ExprOp::read_param:   *sp++ = m_param_values[ip->offset];         break;
+	    case ExprOp::turtle_x:     *sp++ = m_turtle.get_x();                   break;
+	    case ExprOp::turtle_y:     *sp++ = m_turtle.get_y();                   break;
+	    case ExprOp::turtle_dir:   *sp++ = m_turtle.get_dir();                 break;
+	    case ExprOp::unique:       *sp++ = next_unique_num();                 break;
+
+	    // Prefix ops
+
+	    case ExprOp::negate:      sp[-1] = prefix_op<ExprOp::negate>(sp[-1]);      break;
+	    case ExprOp::logical_not: sp[-1] = prefix_op<ExprOp::logical_not>(sp[-1]); break;
+
+	    // Binary ops
+
+	    case ExprOp::add:           --sp; sp[-1] = binary_op<ExprOp::add>(sp[-1], *sp);           break;
+	    case ExprOp::subtract:      --sp; sp[-1] = binary_op<ExprOp::subtract>(sp[-1], *sp);      break;
+	    case ExprOp::multiply:      --sp; sp[-1] = binary_op<ExprOp::multiply>(sp[-1], *sp);      break;
+	    case ExprOp::divide:        --sp; sp[-1] = binary_op<ExprOp::divide>(sp[-1], *sp);        break;
+	    case ExprOp::power:         --sp; sp[-1] = binary_op<ExprOp::power>(sp[-1], *sp);         break;
+	    case ExprOp::equal:         --sp; sp[-1] = binary_op<ExprOp::equal>(sp[-1], *sp);         break;
+	    case ExprOp::not_equal:     --sp; sp[-1] = binary_op<ExprOp::not_equal>(sp[-1], *sp);     break;
+	    case ExprOp::less:          --sp; sp[-1] = binary_op<ExprOp::less>(sp[-1], *sp);          break;
+	    case ExprOp::greater:       --sp; sp[-1] = binary_op<ExprOp::greater>(sp[-1], *sp);       break;
+	    case ExprOp::less_equal:    --sp; sp[-1] = binary_op<ExprOp::less_equal>(sp[-1], *sp);    break;
+	    case ExprOp::greater_equal: --sp; sp[-1] = binary_op<ExprOp::greater_equal>(sp[-1], *sp); break;
+	    case ExprOp::logical_or:    --sp; sp[-1] = binary_op<ExprOp::logical_or>(sp[-1], *sp);    break;
+	    case ExprOp::logical_and:   --sp; sp[-1] = binary_op<ExprOp::logical_and>(sp[-1], *sp);   break;
+
+	    // Control flow - the '- 1' is for the loop's ++ip
+
+	    case ExprOp::jump_if_false:
+		if(!*--sp)
+		    ip += ip->offset - 1;
+		break;
+
+	    case ExprOp::jump:
+		ip += ip->offset - 1;
+		break;
+	}
+    }
+
+    assert(sp == stack + 1);
+
+    return stack[0];
 }
 
 size_t ExecutionEngine::push_chunk(ChunkType type)
@@ -364,13 +735,14 @@ size_t ExecutionEngine::push_chunk(ChunkType type)
 
     m_chunk_index_stack.emplace_back(m_current_chunk);
 
-    m_current_chunk = m_chunks.size();
+    m_current_chunk = build().m_chunks.size();
 
-    m_chunks.emplace_back();
+    build().m_chunks.emplace_back(build().m_arena.get_resource());
 
     Chunk &c = get_chunk();
 
     c.type = type;
+    c.index = m_current_chunk;
 
     switch(type)
     {
@@ -469,7 +841,16 @@ void ExecutionEngine::pop_call_frame_chunk()
 
 size_t ExecutionEngine::push_local_block_chunk()
 {
-    return push_chunk(ChunkType::local_block);
+    auto enclosing_chunk = m_current_chunk;
+
+    auto index = push_chunk(ChunkType::local_block);
+
+    if(m_callers.size() <= index)
+	m_callers.resize(index + 1);
+
+    m_callers[index].push_back(enclosing_chunk);
+
+    return index;
 }
 
 void ExecutionEngine::pop_local_block_chunk()
@@ -519,13 +900,28 @@ void ExecutionEngine::create_closure(size_t fn_index)
 {
     assert(get_chunk(fn_index).is_call_frame());
 
-    Chunk &c = get_chunk(fn_index);
+    Chunk &c = get_build_chunk(fn_index);
 
     auto closure_offset = m_stack.get_frame_size().captures;
 
     m_current_closure_start_offset = closure_offset;
 
     c.info.f.closure_offset = closure_offset;
+
+    // The closure starts with a link to this frame, where it reads the
+    // values it captured from here (see ValueDomain::Enclosing).
+    push_for_parser(ValueDomain::Capture, 1);
+
+    if(is_bytecode())
+	add_instruction(Opcode::push_frame_link);
+    else
+	add_statement(
+		[](ExecutionEngine &engine)
+		{
+		    auto link = engine.m_stack.get_local_frame_start();
+
+		    engine.m_stack.push_capture(link);
+		});
 }
 
 int ExecutionEngine::get_closure_capture_offset()
@@ -537,25 +933,36 @@ int ExecutionEngine::compile_push_value(ValueDomain dest, Expr e)
 {
     auto offset = push_for_parser(dest, 1);
 
+    if(is_bytecode())
+    {
+	assert(dest != ValueDomain::Global);
+
+	add_instruction(dest == ValueDomain::Local ? Opcode::push_expr_local
+						   : Opcode::push_expr_capture,
+			add_expr(e));
+
+	return offset;
+    }
+
     switch(dest)
     {
 	case ValueDomain::Local:
 	    add_statement(
-		    [this, e]()
+		    [e](ExecutionEngine &engine)
 		    {
-			auto val = e();
+			auto val = engine.eval(e);
 
-			m_stack.push(val);
+			engine.m_stack.push(val);
 		    });
 	    break;
 
 	case ValueDomain::Capture:
 	    add_statement(
-		    [this, e]()
+		    [e](ExecutionEngine &engine)
 		    {
-			auto val = e();
+			auto val = engine.eval(e);
 
-			m_stack.push_capture(val);
+			engine.m_stack.push_capture(val);
 		    });
 	    break;
 
@@ -570,21 +977,32 @@ int ExecutionEngine::compile_push_constant(ValueDomain dest, double val)
 {
     auto offset = push_for_parser(dest, 1);
 
+    if(is_bytecode())
+    {
+	assert(dest != ValueDomain::Global);
+
+	add_instruction(dest == ValueDomain::Local ? Opcode::push_constant_local
+						   : Opcode::push_constant_capture,
+			add_constant(val));
+
+	return offset;
+    }
+
     switch(dest)
     {
 	case ValueDomain::Local:
 	    add_statement(
-		    [this, val]()
+		    [val](ExecutionEngine &engine)
 		    {
-			m_stack.push(val);
+			engine.m_stack.push(val);
 		    });
 	    break;
 
 	case ValueDomain::Capture:
 	    add_statement(
-		    [this, val]()
+		    [val](ExecutionEngine &engine)
 		    {
-			m_stack.push_capture(val);
+			engine.m_stack.push_capture(val);
 		    });
 	    break;
 
@@ -607,6 +1025,41 @@ int ExecutionEngine::compile_push_copy(ValueDomain dest_domain,
     using ValueDomain::Local;
     using ValueDomain::Capture;
     using ValueDomain::Global;
+    using ValueDomain::Enclosing;
+
+    if(is_bytecode())
+    {
+	assert(dest_domain == Local || dest_domain == Capture);
+
+	auto op = Opcode::copy_local_to_local;
+
+	switch(source_domain)
+	{
+	    case Local:
+		op = dest_domain == Local ? Opcode::copy_local_to_local
+					  : Opcode::copy_local_to_capture;
+		break;
+
+	    case Global:
+		op = dest_domain == Local ? Opcode::copy_global_to_local
+					  : Opcode::copy_global_to_capture;
+		break;
+
+	    case Capture:
+		op = dest_domain == Local ? Opcode::copy_capture_to_local
+					  : Opcode::copy_capture_to_capture;
+		break;
+
+	    case Enclosing:
+		op = dest_domain == Local ? Opcode::copy_enclosing_to_local
+					  : Opcode::copy_enclosing_to_capture;
+		break;
+	}
+
+	add_instruction(op, offset, size);
+
+	return offset_of_copy;
+    }
 
     switch(dest_domain)
     {
@@ -615,25 +1068,33 @@ int ExecutionEngine::compile_push_copy(ValueDomain dest_domain,
 	    {
 		case ValueDomain::Local:
 		    add_statement(
-			[this, offset, size]()
+			[offset, size](ExecutionEngine &engine)
 			{
-			    copy_stack<Local, Local>(offset, size);
+			    engine.copy_stack<Local, Local>(offset, size);
 			});
 		    break;
 
 		case ValueDomain::Global:
 		    add_statement(
-			[this, offset, size]()
+			[offset, size](ExecutionEngine &engine)
 			{
-			    copy_stack<Global, Local>(offset, size);
+			    engine.copy_stack<Global, Local>(offset, size);
 			});
 		    break;
 
 		case ValueDomain::Capture:
 		    add_statement(
-			[this, offset, size]()
+			[offset, size](ExecutionEngine &engine)
 			{
-			    copy_stack<Capture, Local>(offset, size);
+			    engine.copy_stack<Capture, Local>(offset, size);
+			});
+		    break;
+
+		case ValueDomain::Enclosing:
+		    add_statement(
+			[offset, size](ExecutionEngine &engine)
+			{
+			    engine.copy_stack<Enclosing, Local>(offset, size);
 			});
 		    break;
 
@@ -647,25 +1108,33 @@ int ExecutionEngine::compile_push_copy(ValueDomain dest_domain,
 	    {
 		case ValueDomain::Local:
 		    add_statement(
-			[this, offset, size]()
+			[offset, size](ExecutionEngine &engine)
 			{
-			    copy_stack<Local, Capture>(offset, size);
+			    engine.copy_stack<Local, Capture>(offset, size);
 			});
 		    break;
 
 		case ValueDomain::Global:
 		    add_statement(
-			[this, offset, size]()
+			[offset, size](ExecutionEngine &engine)
 			{
-			    copy_stack<Global, Capture>(offset, size);
+			    engine.copy_stack<Global, Capture>(offset, size);
 			});
 		    break;
 
 		case ValueDomain::Capture:
 		    add_statement(
-			[this, offset, size]()
+			[offset, size](ExecutionEngine &engine)
 			{
-			    copy_stack<Capture, Capture>(offset, size);
+			    engine.copy_stack<Capture, Capture>(offset, size);
+			});
+		    break;
+
+		case ValueDomain::Enclosing:
+		    add_statement(
+			[offset, size](ExecutionEngine &engine)
+			{
+			    engine.copy_stack<Enclosing, Capture>(offset, size);
 			});
 		    break;
 
@@ -691,39 +1160,58 @@ int ExecutionEngine::compile_push_lambda(ValueDomain dest,
     using ValueDomain::Capture;
     using ValueDomain::Global;
 
+    if(is_bytecode())
+    {
+	assert(dest != Global);
+
+	Opcode op;
+
+	if(dest == Local)
+	    op = is_self_recursion ? Opcode::push_self_lambda_local
+				   : Opcode::push_lambda_local;
+	else
+	    op = is_self_recursion ? Opcode::push_self_lambda_capture
+				   : Opcode::push_lambda_capture;
+
+	add_instruction(op, static_cast<int>(fn_index));
+
+	return offset;
+    }
+
     switch(dest)
     {
 	case Local:
 	    if(is_self_recursion)
 		add_statement(
-			[this, fn_index]()
+			[fn_index](ExecutionEngine &engine)
 			{
-			    exec_start_fn_call<Local, true, true>(fn_index);
+			    engine.exec_start_fn_call<Local, true, true>(fn_index);
 			});
 	    else
 		add_statement(
-			[this, fn_index]()
+			[fn_index](ExecutionEngine &engine)
 			{
-			    exec_start_fn_call<Local, false, true>(fn_index);
+			    engine.exec_start_fn_call<Local, false, true>(fn_index);
 			});
 	    break;
 
 	case Capture:
 	    if(is_self_recursion)
 		add_statement(
-			[this, fn_index]()
+			[fn_index](ExecutionEngine &engine)
 			{
-			    exec_start_fn_call<Capture, true, true>(fn_index);
+			    engine.exec_start_fn_call<Capture, true, true>(fn_index);
 			});
 	    else
 		add_statement(
-			[this, fn_index]()
+			[fn_index](ExecutionEngine &engine)
 			{
-			    exec_start_fn_call<Capture, false, true>(fn_index);
+			    engine.exec_start_fn_call<Capture, false, true>(fn_index);
 			});
 	    break;
 
 	case Global:
+	case ValueDomain::Enclosing:
 	    assert(false);
     }
 
@@ -745,17 +1233,21 @@ void ExecutionEngine::compile_start_fn_call(size_t fn_index, bool is_self_recurs
 {
     using ValueDomain::Local;
 
-    if(is_self_recursion)
+    if(is_bytecode())
+	add_instruction(is_self_recursion ? Opcode::start_self_fn_call
+					  : Opcode::start_fn_call,
+			static_cast<int>(fn_index));
+    else if(is_self_recursion)
 	add_statement(
-		[this, fn_index]()
+		[fn_index](ExecutionEngine &engine)
 		{
-		    exec_start_fn_call<Local, true, false>(fn_index);
+		    engine.exec_start_fn_call<Local, true, false>(fn_index);
 		});
     else
 	add_statement(
-		[this, fn_index]()
+		[fn_index](ExecutionEngine &engine)
 		{
-		    exec_start_fn_call<Local, false, false>(fn_index);
+		    engine.exec_start_fn_call<Local, false, false>(fn_index);
 		});
 }
 
@@ -764,34 +1256,97 @@ void ExecutionEngine::compile_call_fn(size_t fn_index,
 {
     unwind_stack_for_parser(args_size);
 
-    add_statement(
-	[this, fn_index, args_size]()
-	{
-	    exec_call_fn(fn_index, args_size);
-	});
+    note_caller(fn_index);
+
+    if(is_bytecode())
+    {
+	add_instruction(is_memoizing() ? Opcode::call_memo : Opcode::call_fn,
+			static_cast<int>(fn_index),
+			args_size.locals,
+			args_size.captures);
+	return;
+    }
+
+    // Whether the callee is a closure isn't final until its definition has
+    // been compiled (it may be this function), so that's checked at runtime.
+
+    const Chunk *c = &get_chunk(fn_index);
+
+    if(is_memoizing())
+    {
+	if(c->is_builtin())
+	    add_statement(
+		[c, fn_index, args_size](ExecutionEngine &engine)
+		{
+		    engine.exec_recorded_builtin(*c, fn_index, args_size);
+		});
+	else
+	    add_statement(
+		[c, fn_index, args_size](ExecutionEngine &engine)
+		{
+		    engine.exec_memo_call(*c, fn_index, args_size);
+		});
+    }
+    else if(!m_debugger)
+	add_statement(
+	    [c, fn_index, args_size](ExecutionEngine &engine)
+	    {
+		engine.exec_call_or_tail_call(*c, fn_index, args_size, c->info.f.is_closure());
+	    });
+    else
+	add_statement(
+	    [c, fn_index, args_size](ExecutionEngine &engine)
+	    {
+		engine.exec_call<true>(*c, fn_index, args_size, c->info.f.is_closure());
+	    });
 }
 
 void ExecutionEngine::compile_start_lambda_call(ValueDomain source, int offset)
 {
+    if(is_bytecode())
+    {
+	assert(source != ValueDomain::Global);
+
+	auto op = Opcode::start_lambda_call_local;
+
+	if(source == ValueDomain::Capture)
+	    op = Opcode::start_lambda_call_capture;
+	else if(source == ValueDomain::Enclosing)
+	    op = Opcode::start_lambda_call_enclosing;
+
+	add_instruction(op, offset);
+	return;
+    }
+
     switch(source)
     {
 	case ValueDomain::Local:
 	    add_statement(
-		[this, offset]()
+		[offset](ExecutionEngine &engine)
 		{
-		    auto closure_position = m_stack[offset + 1];
+		    auto closure_position = engine.m_stack[offset + 1];
 
-		    m_stack.push(closure_position);
+		    engine.m_stack.push(closure_position);
 		});
 	    break;
 
 	case ValueDomain::Capture:
 	    add_statement(
-		[this, offset]()
+		[offset](ExecutionEngine &engine)
+		{
+		    auto closure_position = engine.m_stack.read_capture(offset + 1);
+
+		    engine.m_stack.push(closure_position);
+		});
+	    break;
+
+	case ValueDomain::Enclosing:
+	    add_statement(
+		[offset](ExecutionEngine &engine)
 		{
-		    auto closure_position = m_stack.read_capture(offset + 1);
+		    auto closure_position = engine.m_stack.read_enclosing(offset + 1);
 
-		    m_stack.push(closure_position);
+		    engine.m_stack.push(closure_position);
 		});
 	    break;
 
@@ -806,31 +1361,68 @@ void ExecutionEngine::compile_call_lambda_fn(ValueDomain source,
 {
     unwind_stack_for_parser(args_size);
 
+    mark_impure();
+
+    if(is_bytecode())
+    {
+	assert(source != ValueDomain::Global);
+
+	auto op = Opcode::call_lambda_local;
+
+	if(source == ValueDomain::Capture)
+	    op = Opcode::call_lambda_capture;
+	else if(source == ValueDomain::Enclosing)
+	    op = Opcode::call_lambda_enclosing;
+
+	add_instruction(op,
+			offset,
+			args_size.locals,
+			args_size.captures);
+	return;
+    }
+
+    if(!m_debugger)
+	compile_call_lambda_fn<false>(source, offset, args_size);
+    else
+	compile_call_lambda_fn<true>(source, offset, args_size);
+}
+
+template<bool debugging>
+void ExecutionEngine::compile_call_lambda_fn(ValueDomain source,
+					      int offset,
+					      const StackSize &args_size)
+{
+    // Each call site has its own cache, which lives in the statement.
+
     switch(source)
     {
 	case ValueDomain::Local:
 	    add_statement(
-		[this, offset, args_size]()
+		[offset, args_size, cache = LambdaCallCache{}](ExecutionEngine &engine) mutable
 		{
-		    auto fn_index = m_stack[offset];
-
-		    assert(fn_index >= 0.0);
-		    assert(std::fmod(fn_index, 1.0) == 0.0);
-
-		    exec_call_lambda(static_cast<size_t>(fn_index), args_size);
+		    engine.exec_call_lambda<debugging>(engine.m_stack[offset], args_size, cache);
 		});
 	    break;
 
 	case ValueDomain::Capture:
 	    add_statement(
-		[this, offset, args_size]()
+		[offset, args_size, cache = LambdaCallCache{}](ExecutionEngine &engine) mutable
 		{
-		    auto fn_index = m_stack.read_capture(offset);
-
-		    assert(fn_index >= 0.0);
-		    assert(std::fmod(fn_index, 1.0) == 0.0);
+		    engine.exec_call_lambda<debugging>(
+				engine.m_stack.read_capture(offset),
+				args_size,
+				cache);
+		});
+	    break;
 
-		    exec_call_lambda(static_cast<size_t>(fn_index), args_size);
+	case ValueDomain::Enclosing:
+	    add_statement(
+		[offset, args_size, cache = LambdaCallCache{}](ExecutionEngine &engine) mutable
+		{
+		    engine.exec_call_lambda<debugging>(
+				engine.m_stack.read_enclosing(offset),
+				args_size,
+				cache);
 		});
 	    break;
 
@@ -843,16 +1435,79 @@ void ExecutionEngine::compile_if_statement(Expr condition, size_t if_body, size_
 {
     assert(condition);
 
+    // If the condition folded to a constant, only the taken branch is
+    // compiled in (if there is one), and nothing is evaluated at runtime.
+    if(condition.is_single(ExprOp::constant))
+    {
+	auto taken = eval(condition) ? if_body : else_body;
+
+	if(taken)
+	    compile_local_block(taken);
+
+	return;
+    }
+
+    if(is_bytecode())
+    {
+	add_instruction(Opcode::if_else,
+			add_expr(condition),
+			static_cast<int>(if_body),
+			static_cast<int>(else_body));
+	return;
+    }
+
     add_statement(
-	[this, condition, if_body, else_body]()
+	[condition, if_body, else_body](ExecutionEngine &engine)
 	{
-	    if(condition())
-		exec_call_local_block(if_body);
+	    if(engine.eval(condition))
+		engine.exec_call_local_block(if_body);
 	    else if(else_body)
-		exec_call_local_block(else_body);
+		engine.exec_call_local_block(else_body);
 	});
 }
 
+void ExecutionEngine::compile_local_block(size_t block_index)
+{
+    if(is_bytecode())
+    {
+	add_instruction(Opcode::local_block, static_cast<int>(block_index));
+	return;
+    }
+
+    add_statement(
+	[block_index](ExecutionEngine &engine)
+	{
+	    engine.exec_call_local_block(block_index);
+	});
+}
+
+// Loops with a constant count and a simple body are compiled inline, as
+// 'count' copies of the body, if that's small enough.  This is skipped when
+// debugging, since the debugger identifies statements by their position in
+// their own block.
+bool ExecutionEngine::compile_unrolled_loop(int count, size_t block_index)
+{
+    const Chunk &body = get_chunk(block_index);
+
+    if(m_debugger || !body.is_simple_block())
+	return false;
+
+    if(count > 0 && count * body.get_num_statements() > max_unrolled_size)
+	return false;
+
+    Chunk &c = get_chunk();
+
+    for(int i = 0; i < count; ++i)
+	if(is_bytecode())
+	    c.code.insert(c.code.end(), body.code.begin(), body.code.end());
+	else
+	    c.statements.insert(c.statements.end(),
+				body.statements.begin(),
+				body.statements.end());
+
+    return true;
+}
+
 void ExecutionEngine::compile_for_loop(Expr start, Expr step, Expr end,
 					size_t block_index,
 					bool has_named_loop_var)
@@ -860,64 +1515,93 @@ void ExecutionEngine::compile_for_loop(Expr start, Expr step, Expr end,
     assert(start);
     assert(end || !step);
 
+    if(!end && start.is_single(ExprOp::constant))
+	if(compile_unrolled_loop(static_cast<int>(eval(start)), block_index))
+	    return;
+
+    if(is_bytecode())
+    {
+	LoopInfo loop{ .start = add_expr(start),
+		       .step = step ? add_expr(step) : -1,
+		       .end = end ? add_expr(end) : -1,
+		       .block_index = static_cast<int>(block_index),
+		       .has_named_loop_var = has_named_loop_var };
+
+	build().m_loops.push_back(loop);
+
+	auto op = !end ? Opcode::for_count
+	       : !step ? Opcode::for_range
+	               : Opcode::for_range_step;
+
+	add_instruction(op, static_cast<int>(build().m_loops.size() - 1));
+
+	return;
+    }
+
     if(!end)
     {
 	// no 'end', so only 'start' matters, and it's an integer count.
 	add_statement(
-		[this, start, block_index, has_named_loop_var]()
+		[start, block_index, has_named_loop_var](ExecutionEngine &engine)
 		{
-		    int count = static_cast<int>(start());
+		    int count = static_cast<int>(engine.eval(start));
+
+		    const Chunk &c = engine.get_chunk(block_index);
 
 		    for(int i = 0; i < count; ++i)
 		    {
 			if(has_named_loop_var)
-			    m_stack.push(i);
+			    engine.m_stack.push(i);
 
-			exec_call_local_block(block_index);
+			engine.exec_loop_body(block_index, c);
 		    }
 		});
     }
     else if(!step)
 	// no step, so it defaults to 1.0
 	add_statement(
-		[this, start, end, block_index, has_named_loop_var]()
+		[start, end, block_index, has_named_loop_var](ExecutionEngine &engine)
 		{
-		    double s = start();
-		    double e = end();
+		    const Chunk &c = engine.get_chunk(block_index);
+
+		    double s = engine.eval(start);
+		    double e = engine.eval(end);
 
 		    if(s <= e)
 			for(; s <= e; s += 1.0)
 			{
 			    if(has_named_loop_var)
-				m_stack.push(s);
+				engine.m_stack.push(s);
 
-			    exec_call_local_block(block_index);
+			    engine.exec_loop_body(block_index, c);
 			}
 		    else
 			for(; s >= e; s -= 1.0)
 			{
 			    if(has_named_loop_var)
-				m_stack.push(s);
+				engine.m_stack.push(s);
 
-			    exec_call_local_block(block_index);
+			    engine.exec_loop_body(block_index, c);
 			}
 		});
     else
 	// full loop, start..stop..end
 	add_statement(
-		[this, start, step, end, block_index, has_named_loop_var]()
+		[start, step, end, block_index, has_named_loop_var](ExecutionEngine &engine)
 		{
-		    double s = start();
-		    double inc = step();
-		    double e = end();
+		    const Chunk &c = engine.get_chunk(block_index);
+
+		    double s = engine.eval(start);
+		    double inc = engine.eval(step);
+		    double e = engine.eval(end);
 
 		    if(s <= e)
 			for(; s <= e; s += inc)
 			{
 			    if(has_named_loop_var)
-				m_stack.push(s);
+				engine.m_stack.push(s);
 
-			    exec_call_local_block(block_index);
+			    engine.exec_loop_body(block_index, c);
 			}
 		    else
 		    {
@@ -927,9 +1611,9 @@ void ExecutionEngine::compile_for_loop(Expr start, Expr step, Expr end,
 			for(; s >= e; s -= inc)
 			{
 			    if(has_named_loop_var)
-				m_stack.push(s);
+				engine.m_stack.push(s);
 
-			    exec_call_local_block(block_index);
+			    engine.exec_loop_body(block_index, c);
 			}
 		    }
 		});
@@ -937,7 +1621,10 @@ void ExecutionEngine::compile_for_loop(Expr start, Expr step, Expr end,
 
 void ExecutionEngine::compile_breakpoint()
 {
-    add_statement( [this]() { exec_breakpoint(); } );
+    if(is_bytecode())
+	add_instruction(Opcode::breakpoint);
+    else
+	add_statement( [](ExecutionEngine &engine) { engine.exec_breakpoint(); } );
 }
 
 void ExecutionEngine::exec_breakpoint()
@@ -946,17 +1633,150 @@ void ExecutionEngine::exec_breakpoint()
 	m_debugger->handle_breakpoint(get_engine_location());
 }
 
+void ExecutionEngine::compile_new_path(const std::string &name,
+				       const std::string &attributes)
+{
+    mark_impure();
+
+    add_native_statement( [name, attributes](ExecutionEngine &engine)
+			  {
+			      engine.exec_new_path(name, attributes);
+			  });
+}
+
+void ExecutionEngine::exec_new_path(const std::string &name,
+				    const std::string &attributes)
+{
+    m_turtle.end_path();
+
+    if(m_new_path_handler)
+	m_new_path_handler(name, attributes);
+}
+
 void ExecutionEngine::execute_main(size_t chunk_index)
 {
     assert(chunk_index != no_chunk);
 
     m_stack.reset();
 
+    // Left over if the last run stopped with an error
+    m_tail_position = false;
+
+    fill_param_values();
+
+    clear_memo();
+
+    start_limits();
+
     m_is_executing = true;
 
-    exec_call_fn(chunk_index, { 0, 0 });
+    if(!is_bytecode())
+	exec_call_fn(chunk_index, { 0, 0 });
+    else
+	exec_bytecode_main(chunk_index);
 
     m_turtle.finish();
+
+    m_is_executing = false;
+}
+
+void ExecutionEngine::set_limits(const Limits &limits)
+{
+    m_limits = limits;
+
+    m_stack_limit = infinite_recursion_limit;
+
+    if(limits.max_stack_depth > 0)
+	m_stack_limit = std::min(limits.max_stack_depth, m_stack_limit);
+}
+
+void ExecutionEngine::start_limits()
+{
+    m_statements_run = 0;
+    m_deadline = std::chrono::steady_clock::now() + m_limits.max_time;
+    m_output_start = m_turtle.get_bytes_written();
+
+    m_turtle.set_output_limit(m_limits.max_output_bytes
+			      ? m_output_start + m_limits.max_output_bytes
+			      : 0);
+
+    char here;
+    auto base = reinterpret_cast<std::uintptr_t>(&here);
+
+    m_native_stack_floor = base > max_native_stack ? base - max_native_stack
+						   : 0;
+
+    restart_limit_countdown();
+}
+
+void ExecutionEngine::restart_limit_countdown()
+{
+    std::int64_t countdown = no_limit_countdown;
+
+    if(m_limits.max_time.count() || m_limits.cancel)
+	countdown = limit_check_interval;
+
+    // Running one statement past the limit gets to check_limits().
+    if(m_limits.max_statements)
+    {
+	auto remaining = m_limits.max_statements
+		       - std::min(m_statements_run, m_limits.max_statements)
+		       + 1;
+
+	if(remaining < static_cast<std::uint64_t>(countdown))
+	    countdown = static_cast<std::int64_t>(remaining);
+    }
+
+    m_limit_countdown = countdown;
+    m_countdown_start = countdown;
+}
+
+void ExecutionEngine::check_limits()
+{
+    m_statements_run = get_statements_run();
+
+    if(m_limits.cancel && m_limits.cancel->load(std::memory_order_relaxed))
+	throw CancelledException{};
+
+    if(m_limits.max_statements && m_statements_run > m_limits.max_statements)
+	throw StatementLimitException{};
+
+    if(m_limits.max_time.count()
+       && std::chrono::steady_clock::now() >= m_deadline)
+	throw TimeLimitException{};
+
+    restart_limit_countdown();
+}
+
+// Including those of the current countdown
+std::uint64_t ExecutionEngine::get_statements_run() const
+{
+    return m_statements_run
+	 + static_cast<std::uint64_t>(m_countdown_start - m_limit_countdown);
+}
+
+std::uint64_t ExecutionEngine::get_output_bytes() const
+{
+    auto bytes = m_turtle.get_bytes_written();
+
+    return bytes > m_output_start ? bytes - m_output_start : 0;
+}
+
+void ExecutionEngine::throw_stack_overflow() const
+{
+    if(m_stack_limit < infinite_recursion_limit)
+	throw StackLimitException{};
+
+    throw InfiniteRecursionException{};
+}
+
+void ExecutionEngine::reset_turtle()
+{
+    m_turtle.reset();
+
+    m_pen_height_became_negative = false;
+    m_next_unique_num = 1;
+    m_unique_limit = no_unique_limit;
 }
 
 bool ExecutionEngine::had_pen_height_error() const
@@ -964,6 +1784,40 @@ bool ExecutionEngine::had_pen_height_error() const
     return m_pen_height_became_negative;
 }
 
+void ExecutionEngine::fill_param_values()
+{
+    const auto &params = m_program->get_params();
+
+    for(size_t i = m_param_values.size(); i < params.size(); ++i)
+	m_param_values.push_back(params[i].default_value);
+}
+
+bool ExecutionEngine::set_param(size_t main_chunk_index,
+				const std::string &name,
+				double value)
+{
+    const auto &params = m_program->get_params();
+
+    fill_param_values();
+
+    bool found = false;
+
+    for(size_t i = 0; i < params.size(); ++i)
+	if(params[i].main_chunk_index == main_chunk_index &&
+	   params[i].name == name)
+	{
+	    m_param_values[i] = value;
+	    found = true;
+	}
+
+    return found;
+}
+
+void ExecutionEngine::reset_params()
+{
+    m_param_values.clear();
+}
+
 std::pair<std::vector<EngineLocation>, std::string>
   ExecutionEngine::get_backtrace() const
 {
@@ -25,29 +25,67 @@
 #pragma once
 
 #include "Expression.h"
+#include "Bytecode.h"
 #include "EngineStack.h"
+#include "ProgramArena.h"
 #include "EngineTypes.h"
 #include "DebugSink.h"
 #include "OstreamTurtle.h"
 
-#include <functional>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <memory_resource>
+#include <type_traits>
 #include <string>
 #include <tuple>
 #include <ostream>
 #include <stdexcept>
+#include <cstdint>
+#include <limits>
 
 ///////////////////////////////////////////////////////////////////////////////
 //
 // ExecutionEngine - SvgPathTurtle execution engine
 //
-//   - This is not a bytecode interpreter because I wanted to experiment with
-//     std::function.  The result is only a little over twice as slow as raw C++
-//     (tested using direct calls to SvgPathTurtle for a one-million-sided
-//     polygon).
+//   - The original (closure) backend is not a bytecode interpreter because I
+//     wanted to experiment with std::function.  The result is only a little
+//     over twice as slow as raw C++ (tested using direct calls to
+//     SvgPathTurtle for a one-million-sided polygon).  That polygon, and
+//     other workloads, can be measured with svg_path_turtle_bench (see
+//     src/bench/Bench.cpp, or 'make bench').
+//
+//   - Raw C++ can drive the same turtle without the engine.  The drawing
+//     commands are in BasicSvgPathTurtle<Emitter> (see Turtle.h), which
+//     calls its emitter directly.  SvgPathTurtle is the virtual version,
+//     while the engine's OstreamTurtle has its output inlined.
+//
+//   - There is now also a bytecode backend (see Bytecode.h), selected at
+//     construction.  Both backends are built from the same compile_*() calls,
+//     and must produce identical output.  The bytecode interpreter is not
+//     recursive - calls, local blocks and loops are tracked on an explicit
+//     control stack.
+//
+//   - The compiled program (chunks, statement closures and operand pools) is
+//     allocated from a ProgramArena, and released all at once with the
+//     engine.  Statements are ArenaFunctions now, rather than std::functions.
+//
+//   - The compiled program is a Program, which the engine that compiles it
+//     shares with any other engines that run it (see get_program()).  Those
+//     engines only have their own stack, turtle and output, so they can run
+//     the same program on different threads at once.
+//
+//   - The statements of a parallel block can be run by such engines, on
+//     other threads, and their output merged in program order (see
+//     EngineParallel.cpp).
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace memo_detail { struct MemoKey; }
+
 class ExecutionEngine
 {
     //////////////////////////////////////////////////////
@@ -62,15 +100,63 @@ public:
 	Global,
 	Capture,
 	Local,
+
+	// A value in the frame of the function that the current closure was
+	// created in (only as a source)
+	Enclosing,
     };
 
     static constexpr size_t no_chunk = EngineLocation::no_chunk;
 
+    enum class Backend
+    {
+	closures,
+	bytecode,
+    };
+
+    // The stack that a thread of its own running programs should have: as
+    // much as a main thread usually has, which is max_native_stack (see
+    // below), and room for what's under the run.
+    static constexpr size_t thread_stack_size = 8 << 20;
+
+    using NewPathHandler = std::function<void(const std::string &name,
+					      const std::string &attributes)>;
+
+    // Limits on a run, for programs that can't be trusted to finish (a
+    // render server's, say - see set_limits()).  Zero is no limit.
+    struct Limits
+    {
+	// Statements are counted as each block, function body and loop
+	// iteration is entered, which counts as one more.
+	std::uint64_t max_statements = 0;
+
+	std::chrono::milliseconds max_time{0};
+
+	// What is written to the engine's output stream (see
+	// OstreamTurtle::get_bytes_written()), which the turtle checks as it
+	// writes each command
+	std::uint64_t max_output_bytes = 0;
+
+	// In place of infinite_recursion_limit, if it's lower
+	int max_stack_depth = 0;
+
+	// Once this is set (from any thread, or a signal handler), the run
+	// stops.
+	const std::atomic<bool> *cancel = nullptr;
+    };
+
 private:
-    using Statement = std::function<void()>;
+    using Statement = ArenaFunction<ExecutionEngine>;
+    using StatementList = std::pmr::vector<Statement>;
 
     using StackSize = EngineStack::Size;
 
+    static constexpr int infinite_recursion_limit = 1000000;
+
+    // Constant count loops with simple bodies are unrolled if the result has
+    // no more than this many statements.
+    static constexpr int max_unrolled_size = 16;
+
     struct EngineExceptionBase : public std::runtime_error
     {
 	EngineExceptionBase()
@@ -136,6 +222,13 @@ private:
     {
 	ChunkType type;
 
+	// This chunk's own index (see LambdaCallCache)
+	size_t index = 0;
+
+	// False if calling this chunk with the same arguments might not make
+	// the same builtin calls (see EngineMemo.cpp)
+	bool is_pure = true;
+
 	union
 	{
 	    FunctionInfo f;
@@ -164,9 +257,169 @@ private:
 	    return type == ChunkType::builtin_function;
 	}
 
-	std::vector<Statement> statements;
+	// A builtin whose body is a single native statement (bytecode only)
+	bool is_native() const
+	{
+	    return is_builtin()
+		&& code.size() == 1
+		&& code.front().op == Opcode::native;
+	}
+
+	// Only one of these is used, depending on the Backend.
+	StatementList statements;
+	std::pmr::vector<Instruction> code;
+
+	explicit Chunk(std::pmr::memory_resource *resource)
+	    : type(ChunkType::local_block)
+	    , statements(resource)
+	    , code(resource)
+	{
+	}
+
+	size_t get_num_statements() const
+	{
+	    return statements.size() + code.size();
+	}
+
+	// A block with nothing to unwind declares no locals (not even a loop
+	// variable), so loop iterations can simply run it again.
+	bool is_simple_block() const
+	{
+	    auto size = info.b.get_unwind_size();
+
+	    return is_local_block() && size.locals == 0 && size.captures == 0;
+	}
+    };
+
+    ///////////////////////////////////////////////
+    // Bytecode support types
+    ///////////////////////////////////////////////
+
+    struct LoopInfo
+    {
+	int start;
+	int step;
+	int end;
+	int block_index;
+	bool has_named_loop_var;
+    };
+
+    struct LoopState
+    {
+	double s;
+	double inc;
+	double e;
+	int count;
+	int i;
+	bool ascending;
+    };
+
+    // A monomorphic inline cache for a lambda call site - lambda calls
+    // nearly always see the same function (e.g. a loop that calls its
+    // lambda argument), so the last callee's Chunk is kept.
+    //
+    // The cache is part of the compiled program, which several engines may
+    // be running at once, so it is atomic.  Relaxed accesses are enough,
+    // since every Chunk was complete before the program could be shared.
+    struct LambdaCallCache
+    {
+	std::atomic<const Chunk *> chunk = nullptr;
+
+	LambdaCallCache() = default;
+
+	LambdaCallCache(const LambdaCallCache &other)
+	    : chunk(other.chunk.load(std::memory_order_relaxed))
+	{
+	}
+    };
+
+    enum class FrameType:char
+    {
+	call,
+	memo_call, // a call whose builtin calls are recorded (see EngineMemo.cpp)
+	local_block,
+	loop_body, // a local block that is re-run, in place, for each iteration
+    };
+
+    struct ControlFrame
+    {
+	const Instruction *pc;
+	const Instruction *end;
+	const Instruction *begin;
+
+	FrameType type;
+
+	// For calls, this is popped after the frame itself is popped.  For
+	// local blocks, it is the block's unwind size.
+	StackSize unwind_size;
+    };
+
+    //////////////////////////////////////////////////////
+    //
+    // Program - the compiled code
+    //
+    //////////////////////////////////////////////////////
+
+public:
+    // A program parameter, declared with 'param name = default'
+    struct Param
+    {
+	std::string name;
+	double default_value;
+
+	// The program (main chunk) that declares it
+	size_t main_chunk_index;
+    };
+
+    class Program
+    {
+	friend class ExecutionEngine;
+
+	// This owns the compiled program, so it's declared first, and
+	// destroyed last.  Everything below allocates from it.
+	ProgramArena m_arena;
+
+	// A deque, so that Chunks never move.  Compiled calls hold a pointer
+	// to their callee's Chunk, even while it's still being compiled.
+	std::pmr::deque<Chunk> m_chunks;
+
+	Backend m_backend;
+
+	// Bytecode operand pools
+
+	std::pmr::vector<double> m_constants;
+	std::pmr::vector<Expr> m_exprs;
+	std::pmr::vector<Statement> m_natives;
+	std::pmr::vector<LoopInfo> m_loops;
+
+	// Read by ExprOp::read_param, by index
+	std::vector<Param> m_params;
+
+    public:
+	Program(const Program &) = delete;
+	Program &operator=(const Program &) = delete;
+
+	explicit Program(Backend backend);
+
+	Backend get_backend() const
+	{
+	    return m_backend;
+	}
+
+	const ProgramArena::Stats &get_arena_stats() const
+	{
+	    return m_arena.get_stats();
+	}
+
+	const std::vector<Param> &get_params() const
+	{
+	    return m_params;
+	}
     };
 
+    using SharedProgram = std::shared_ptr<const Program>;
+
+private:
     //////////////////////////////////////////////////////
     //
     // Data
@@ -174,6 +427,17 @@ private:
     //////////////////////////////////////////////////////
 
 
+    ///////////////////////////////////////////////
+    // Program
+    ///////////////////////////////////////////////
+
+    // The program that this engine runs
+    SharedProgram m_program;
+
+    // The same Program, if this engine is compiling it, or null if it only
+    // runs it.  Everything built during parsing allocates from its arena.
+    Program *m_build = nullptr;
+
     ///////////////////////////////////////////////
     // Parsing
     ///////////////////////////////////////////////
@@ -186,11 +450,10 @@ private:
     // See set_parser_push_val()
     double m_parser_value_for_push = 0.0;
 
-    ///////////////////////////////////////////////
-    // Storing code
-    ///////////////////////////////////////////////
-
-    std::vector<Chunk> m_chunks;
+    // For each chunk, the chunks that call it (or, for a local block, the
+    // chunk it's in), so that they can be marked impure too (see
+    // mark_impure()).
+    std::vector<std::vector<size_t>> m_callers;
 
     ///////////////////////////////////////////////
     // Parsing and Execution
@@ -214,14 +477,115 @@ private:
 
     bool m_pen_height_became_negative = false;
 
+    // Bytecode interpreter state
+
+    std::vector<ControlFrame> m_control_stack;
+    std::vector<LoopState> m_loop_stack;
+
+    // Closure tail calls (see exec_call_or_tail_call())
+    //
+    // m_tail_position is set while the last statement of a function body
+    // starts, or the last of a local block started from there.  A tail call
+    // moves its closure position and arguments to m_tail_call, and returns,
+    // to be made by the caller's exec_fn_body().
+
+    bool m_tail_position = false;
+
+    struct TailCall
+    {
+	const Chunk *chunk = nullptr;
+	int args_size = 0;
+	bool has_closure_position = false;
+	std::vector<double> values;
+    };
+
+    TailCall m_tail_call;
+
     // Language feature support
 
-    int m_next_unique_num = 1;
+    using UniqueNum = std::int64_t;
+
+    static constexpr UniqueNum no_unique_limit
+			= std::numeric_limits<UniqueNum>::max();
+
+    UniqueNum m_next_unique_num = 1;
+
+    // With unique ranges, each statement of a parallel block gets its own
+    // range of unique numbers, which ends here (see set_unique_range()).
+    UniqueNum m_unique_limit = no_unique_limit;
+
+    int m_unique_range = 0;
+
+    UniqueNum next_unique_num();
+
+    // One for each of the program's params, once it runs.  Params that
+    // haven't been set have their default values.
+    std::vector<double> m_param_values;
+
+    void fill_param_values();
 
     // The turtle
 
     OstreamTurtle m_turtle;
 
+    // See set_new_path_handler()
+    NewPathHandler m_new_path_handler;
+
+    // Parallel blocks (see EngineParallel.cpp)
+
+    struct ParallelTask;
+    struct ParallelWorker;
+
+    static constexpr size_t max_parallel_window = 4096;
+
+    unsigned m_parallel_threads = 1;
+
+    // Memoization (see EngineMemo.cpp)
+
+    struct MemoCache;
+
+    // The most doubles recorded for one call, and for all of them
+    static constexpr size_t max_memo_entry_size = 1 << 16;
+    static constexpr size_t max_memo_size = 1 << 23;
+
+    bool m_memoize = false;
+
+    std::unique_ptr<MemoCache> m_memo;
+
+    // Limits (see set_limits())
+    //
+    // The statements are counted down to the next check_limits(), which
+    // checks the cancel flag and the clock as well, every
+    // limit_check_interval statements.  Without any limits, the countdown
+    // never gets there, so all that a block costs is the subtraction.  The
+    // output is checked by the turtle (see OstreamTurtle::set_output_limit()).
+
+    static constexpr std::int64_t limit_check_interval = 4096;
+
+    static constexpr std::int64_t no_limit_countdown
+			= std::numeric_limits<std::int64_t>::max();
+
+    Limits m_limits;
+
+    int m_stack_limit = infinite_recursion_limit;
+
+    // The closure backend recurses natively, so deep enough recursion
+    // overflows the thread's stack long before m_stack_limit, at a depth
+    // that depends on how the functions nest their blocks.  Each run may
+    // use max_native_stack bytes below where start_limits() was called.
+    static constexpr std::uintptr_t max_native_stack = 6 << 20;
+
+    std::uintptr_t m_native_stack_floor = 0;
+
+    std::int64_t m_limit_countdown = no_limit_countdown;
+    std::int64_t m_countdown_start = no_limit_countdown;
+
+    // The statements counted before the current countdown
+    std::uint64_t m_statements_run = 0;
+
+    std::chrono::steady_clock::time_point m_deadline;
+    std::uint64_t m_output_start = 0;
+
     ///////////////////////////////////////////////
     // Debugging
     ///////////////////////////////////////////////
@@ -230,6 +594,10 @@ private:
 
     std::vector<EngineLocation> m_debug_program_counter;
 
+    // With set_sample_interval(), the statements left until the next sample
+    unsigned m_sample_interval = 0;
+    unsigned m_sample_countdown = 0;
+
     //////////////////////////////////////////////////////
     //
     // Functions
@@ -243,16 +611,71 @@ private:
 
     //// Parsing/building
 
-    Chunk &get_chunk(size_t index);
-    const Chunk &get_chunk(size_t index) const;
+    Program &build()
+    {
+	assert(m_build);
+
+	return *m_build;
+    }
+
+    // Only while compiling
+    Chunk &get_build_chunk(size_t index)
+    {
+	assert(index < build().m_chunks.size());
+
+	return build().m_chunks[index];
+    }
+
+    const Chunk &get_chunk(size_t index) const
+    {
+	assert(index < m_program->m_chunks.size());
+
+	return m_program->m_chunks[index];
+    }
 
     // These get the current chunk during construction, but assert during
     // execution.
     Chunk &get_chunk();
     const Chunk &get_chunk() const;
 
+    bool is_bytecode() const
+    {
+	return m_program->m_backend == Backend::bytecode;
+    }
+
     void add_statement(Statement stmt);
 
+    // Statements are usually lambdas, which are moved into the arena here.
+    template<class F>
+	requires (!std::is_same_v<std::decay_t<F>, Statement>)
+    void add_statement(F &&fn)
+    {
+	add_statement(Statement(build().m_arena, std::forward<F>(fn)));
+    }
+
+    // Bytecode equivalents of add_statement()
+    void add_instruction(Opcode op, int a = 0, int b = 0, int c = 0);
+    void add_native_statement(Statement stmt);
+
+    template<class F>
+	requires (!std::is_same_v<std::decay_t<F>, Statement>)
+    void add_native_statement(F &&fn)
+    {
+	add_native_statement(Statement(build().m_arena, std::forward<F>(fn)));
+    }
+
+    int add_constant(double val);
+    int add_expr(Expr e);
+
+    void note_new_statement();
+
+    bool compile_unrolled_loop(int count, size_t block_index);
+
+    template<bool debugging>
+    void compile_call_lambda_fn(ValueDomain source,
+				int offset,
+				const StackSize &args_size);
+
     size_t push_chunk(ChunkType type);
     void pop_chunk();
 
@@ -264,22 +687,197 @@ private:
     //// Execution
 
     void exec_call_fn(size_t fn_index, const StackSize &args_size);
-    void exec_call_lambda(size_t fn_index, const StackSize &args_size);
+
+    template<bool debugging>
+    void exec_call(const Chunk &c,
+		   size_t fn_index,
+		   const StackSize &args_size,
+		   bool has_closure_position);
+
+    template<bool debugging>
+    void exec_call_lambda(double fn_index,
+			  const StackSize &args_size,
+			  LambdaCallCache &cache);
+
+    void exec_call_or_tail_call(const Chunk &c,
+				size_t fn_index,
+				const StackSize &args_size,
+				bool has_closure_position);
+
+    bool exec_tail_call(bool has_closure_position);
 
     void exec_call_local_block(size_t block_index);
+    void exec_loop_body(size_t block_index, const Chunk &c);
 
+    template<bool debugging>
     void exec_fn_body(const StackSize &args_size,
 		      int params_size,
 		      bool has_closure_position,
-		      std::vector<Statement>& statements);
+		      const StatementList &statements);
 
     void exec_statement(const Statement &stmt);
-    void exec_statements(std::vector<Statement> &statements);
+    void exec_statements(const StatementList &statements, bool tail);
+
+    template<bool debugging>
+    void run_statements(const StatementList &statements, bool tail);
+
+    void check_pen_height();
+
+    //// Execution (limits)
+
+    // n statements are about to run.
+    void count_statements(size_t n)
+    {
+	m_limit_countdown -= static_cast<std::int64_t>(n) + 1;
+
+	if(m_limit_countdown <= 0)
+	    check_limits();
+    }
+
+    void check_limits();
+    void start_limits();
+    void restart_limit_countdown();
+    void inherit_limits(const ExecutionEngine &parent);
+
+    std::uint64_t get_output_bytes() const;
+
+    [[noreturn]] void throw_stack_overflow() const;
+
+    // The stack grows down on everything this is built for.
+    bool native_stack_exhausted() const
+    {
+	char here;
+
+	return reinterpret_cast<std::uintptr_t>(&here) < m_native_stack_floor;
+    }
+
+    //// Execution (bytecode)
+
+    void exec_bytecode_main(size_t chunk_index);
+
+    template<bool debugging>
+    void run_bytecode();
+
+    bool is_tail_call(const StackSize &args_size) const;
+    StackSize unwind_for_tail_call(const StackSize &args_size,
+				   bool has_closure_position);
+
+    // Returns false if the call was completed immediately.
+    template<bool debugging>
+    bool enter_call(size_t fn_index,
+		    const StackSize &args_size,
+		    bool has_closure_position);
+
+    // enter_call(), with --memoize
+    bool enter_memo_call(size_t fn_index, const StackSize &args_size);
+
+    // Runs a call to completion, from within an instruction
+    void exec_bytecode_call(size_t fn_index, const StackSize &args_size);
+
+    template<bool debugging>
+    void enter_local_block(size_t block_index,
+			   FrameType type = FrameType::local_block);
+
+    // Returns false if the loop has no (more) iterations.
+    bool start_loop(const Instruction &ins);
+    bool next_loop_iteration(const Instruction &ins);
+
+    template<bool debugging>
+    void enter_loop_body(const Instruction &ins);
+
+    void push_loop_var(const Instruction &ins);
+
+    template<bool debugging>
+    void finish_instruction();
+
+    template<bool debugging>
+    bool return_from_frame();
 
     void exec_breakpoint();
 
+    void exec_new_path(const std::string &name,
+		       const std::string &attributes);
+
     int get_closure_capture_offset();
 
+    //// Execution (parallel blocks)
+
+    // Runs a local block to completion, from within a statement
+    void exec_block_now(size_t block_index);
+    void exec_bytecode_block(size_t block_index);
+
+    void exec_parallel(const std::vector<size_t> &blocks);
+
+    // Runs blocks[next...] in windows of parallel tasks.  run_here(n) runs
+    // blocks[n] on this engine, and unique_start(n) is the first unique
+    // number of blocks[n], with unique ranges.
+    void exec_parallel_windows(const std::vector<size_t> &blocks,
+			       size_t next,
+			       const std::function<void(size_t)> &run_here,
+			       const std::function<UniqueNum(size_t)> &unique_start);
+
+    void run_parallel_tasks(const OstreamTurtle::Snapshot &start,
+			    std::vector<ParallelTask> &tasks,
+			    std::vector<std::unique_ptr<ParallelWorker>> &workers);
+
+    void run_parallel_task(const ExecutionEngine &parent,
+			   const OstreamTurtle::Snapshot &start,
+			   ParallelTask &task,
+			   std::stringbuf &output);
+
+    bool join_parallel_task(const OstreamTurtle::Snapshot &start,
+			    UniqueNum start_unique_num,
+			    ParallelTask &task);
+
+    //// Memoization
+
+    bool is_memoizing() const;
+    void clear_memo();
+
+    void mark_impure();
+    void mark_impure(size_t chunk_index);
+    void note_caller(size_t callee_index);
+
+    void record_builtin_call(size_t fn_index, const StackSize &args_size);
+
+    void exec_recorded_builtin(const Chunk &c,
+			       size_t fn_index,
+			       const StackSize &args_size);
+
+    static bool can_memoize(const Chunk &c, const StackSize &args_size);
+
+    bool replay_memo_call(size_t fn_index, const StackSize &args_size);
+    size_t start_memo_recording();
+    void finish_memo_recording(memo_detail::MemoKey &&key, size_t start);
+
+    void exec_memo_call(const Chunk &c,
+			size_t fn_index,
+			const StackSize &args_size);
+
+    void replay_memo(const std::vector<double> &calls);
+
+    //// Expression evaluation
+
+    // Most expressions (including all builtin function arguments) are a
+    // single constant or local value, so those are handled inline.
+    double eval(const Expr &e)
+    {
+	if(e.size() == 1)
+	{
+	    const ExprInstruction &ins = *e.begin();
+
+	    if(ins.op == ExprOp::read_local)
+		return m_stack[ins.offset];
+	    else if(ins.op == ExprOp::constant)
+		return ins.value;
+	}
+
+	return eval_code(e);
+    }
+
+    double eval_code(const Expr &e);
+    double eval_code(const Expr &e, double *stack);
+
     //// Templatized stack read & push
 
     template<ValueDomain source>
@@ -291,6 +889,8 @@ private:
 	    return m_stack.read_capture(offset);
 	else if constexpr(source == ValueDomain::Global)
 	    return m_stack.read_global(offset);
+	else if constexpr(source == ValueDomain::Enclosing)
+	    return m_stack.read_enclosing(offset);
 	else
 	    static_assert(false, "Unhandled ValueDomain for read()");
     }
@@ -367,8 +967,11 @@ private:
 
     std::string get_stack_description_arg(bool force = false) const;
 
+    // An expression's steps, in postfix order (see dump_ir())
+    std::string describe_expr(const Expr &e) const;
+
 public:
-    virtual ~ExecutionEngine() = default;
+    virtual ~ExecutionEngine();
 
     //////////////////////////////////////////////////////
     //
@@ -382,24 +985,166 @@ public:
     ////////////////////////////////////////////////
 
     explicit ExecutionEngine(std::ostream &out,
-			     EngineDebugSink *debugger = nullptr);
+			     EngineDebugSink *debugger = nullptr,
+			     Backend backend = Backend::closures);
+
+    // For running a program that another engine compiled (see
+    // get_program()).  This engine can't compile anything itself, and it
+    // has no debugger, since the program's debugging support (or the lack
+    // of it) was decided when it was compiled.
+    ExecutionEngine(SharedProgram program, std::ostream &out);
+
+    // The compiled program, for other engines to run.  It must not be
+    // compiled into any further while they do - that is, the engine that
+    // compiled it (and its Parser) should be finished with it.
+    SharedProgram get_program() const
+    {
+	return m_program;
+    }
 	
     void set_output_format(OstreamTurtle::OutputFormatType format);
 
+    // The path data goes to sink as commands and numbers, rather than to
+    // the output stream as text (see OstreamTurtle::set_segment_sink()).
+    void set_segment_sink(TurtleEmitInterface &sink);
+
     void set_decimal_places(int n);
 
+    void set_simplify(bool simplify);
+
+    // Drops what is drawn outside the clip (see PathCuller.h).
+    void set_clip(const PathCuller::Rect &clip);
+
+    // The new_path statement ends the current path's data, then calls this
+    // to write whatever separates it from the next one (e.g. the end of one
+    // <path> element and the start of the next).
+    void set_new_path_handler(NewPathHandler handler);
+
+    // Passes what's drawn inside push_matrix ... pop_matrix to sink, in
+    // place of writing it (see OstreamTurtle::set_fragment_sink()).
+    void set_fragment_sink(TurtleFragmentSink *sink);
+
+    void set_integer_grid(bool integer_grid);
+
+    // The threads that may run the statements of a parallel block at once.
+    // 1 (the default) runs them here, one after another, and 0 means one per
+    // core.  With a debugger, they are always run here.
+    void set_parallel_threads(unsigned threads);
+
+    // Gives the n'th statement of each parallel block the unique numbers
+    // from (base + n * size), where base is the first one that the block
+    // could use, so that they don't depend on the order the statements run
+    // in.  With this, a parallel run's unique numbers are the same as a
+    // serial run's.  A statement that uses more than 'size' of them is an
+    // error.  0 (the default) numbers them in the order they're used.
+    void set_unique_range(int size);
+
+    // Calls to pure functions with the same arguments replay the builtin
+    // calls of the first, rather than running it again.  This is decided as
+    // calls are compiled, so it must be set first, and it only applies to
+    // the closure backend, without a debugger.
+    void set_memoize(bool memoize);
+
+    // With a debugger, only keeps the program counter, and passes the call
+    // stack to handle_sample() every n statements, rather than tracing each
+    // statement and call.  Errors are still located, and the samples make
+    // an approximate profile, at a fraction of the cost.  0 (the default)
+    // traces everything.
+    void set_sample_interval(unsigned n);
+
+    // For the runs that follow (see execute_main()), each of which counts
+    // its statements, time and output from its start.  A limit that is
+    // exceeded stops the run with its own exception, as does the cancel
+    // flag (see catch_execution_errors()).  They are checked as blocks,
+    // function bodies and loop iterations are entered, and the clock, the
+    // output and the cancel flag only every so often, so a run may go a
+    // little past them.
+    void set_limits(const Limits &limits);
+
+    // The memory holding the compiled program.  The parser allocates its
+    // name definitions here as well, since they are released together.
+    std::pmr::memory_resource *get_program_memory()
+    {
+	return build().m_arena.get_resource();
+    }
+
+    const ProgramArena::Stats &get_arena_stats() const
+    {
+	return m_program->get_arena_stats();
+    }
+
+    // The number of path segments drawn so far (see OstreamTurtle)
+    std::uint64_t get_segment_count() const
+    {
+	return m_turtle.get_segment_count();
+    }
+
+    const OstreamTurtle::CommandCounts &get_command_counts() const
+    {
+	return m_turtle.get_command_counts();
+    }
+
+    // The statements run by the last execute_main(), as --max-statements
+    // counts them (each block counts one more, for entering it).  They are
+    // counted with or without limits, and without a debug sink.
+    std::uint64_t get_statements_run() const;
+
+    // The most that the value stack has held, and the deepest it has been,
+    // in this engine (not counting parallel blocks' other engines)
+    EngineStack::Size get_peak_stack_size() const
+    {
+	return m_stack.get_peak_size();
+    }
+
+    int get_peak_frames() const
+    {
+	return m_stack.get_peak_frames();
+    }
+
+    size_t get_num_chunks() const
+    {
+	return m_program->m_chunks.size();
+    }
+
+    // Writes each chunk's instructions, with their operands, estimated costs
+    // and the fast paths they take (see EngineDump.cpp).  The bytecode
+    // backend only, since the closure backend's statements can't be looked
+    // into (but they match the instructions one for one).  name() gives a
+    // chunk's name, if it has one.  Calls from main aren't tail calls.
+    using ChunkNameFn = std::function<std::string(size_t chunk_index)>;
+
+    void dump_ir(std::ostream &out,
+		 size_t main_chunk_index,
+		 const ChunkNameFn &name) const;
+
+    // The bounding box of everything drawn, in world space.  It's only kept
+    // after set_track_bounds(true) (see OstreamTurtle).
+    void set_track_bounds(bool track_bounds)
+    {
+	m_turtle.set_track_bounds(track_bounds);
+    }
+
+    const PathBounds::Box &get_bounds() const
+    {
+	return m_turtle.get_bounds();
+    }
+
     // Setting up builtins
 
     void setup_turtle_fn(auto fn, auto...args)
     {
-	add_statement( [this, fn, args...] { (m_turtle.*fn)(args()...); });
+	add_native_statement( [fn, args...](ExecutionEngine &e) { (e.m_turtle.*fn)(e.eval(args)...); });
     }
 
     void setup_engine_fn(auto fn, auto...args)
     {
-	add_statement( [this, fn, args...] { (this->*fn)(args()...); });
+	add_native_statement( [fn, args...](ExecutionEngine &e) { (e.*fn)(e.eval(args)...); });
     }
 
+    // Builtins implemented by the engine
+
+    void pen_down();
+
     ////////////////////////////////////////////////
     // Parsing
     ////////////////////////////////////////////////
@@ -439,6 +1184,9 @@ public:
     Expr compile_turtle_y_expr();
     Expr compile_turtle_dir_expr();
     Expr compile_unique_val_expr();
+    Expr compile_param_expr(size_t main_chunk_index,
+			    const std::string &name,
+			    double default_value);
 
     // Code: Instructions
     
@@ -460,21 +1208,50 @@ public:
 
     void compile_if_statement(Expr condition, size_t if_body, size_t else_body);
 
+    void compile_local_block(size_t block_index);
+
     void compile_for_loop(Expr start, Expr step, Expr end,
 		       size_t block_index, bool has_named_loop_var);
 
     void compile_breakpoint();
 
+    void compile_new_path(const std::string &name,
+			  const std::string &attributes);
+
+    // A parallel block - each of the blocks is one of its statements.
+    void compile_parallel(std::vector<size_t> blocks);
+
     ////////////////////////////////////////////////
     // Execution
     ////////////////////////////////////////////////
 
     class InfiniteRecursionException : public EngineExceptionBase {};
+    class UniqueRangeException : public EngineExceptionBase {};
+
+    // See set_limits()
+    class StatementLimitException : public EngineExceptionBase {};
+    class TimeLimitException : public EngineExceptionBase {};
+    using OutputLimitException = OstreamTurtle::OutputLimitException;
+    class StackLimitException : public EngineExceptionBase {};
+    class CancelledException : public EngineExceptionBase {};
 
     void execute_main(size_t chunk_index);
 
+    // For executing another program (e.g. another main chunk) from a clean
+    // slate: resets the turtle, pen height errors, and unique numbers.
+    void reset_turtle();
+
     bool had_pen_height_error() const;
 
+    // Params keep their values from one run to the next, so a compiled
+    // program can be re-run with new values, without parsing it again.
+    // set_param() returns false if the program (given by its main chunk)
+    // has no such param.  Params of the engine's other programs are never
+    // set, even if they have the same name.
+    bool set_param(size_t main_chunk_index, const std::string &name,
+		   double value);
+    void reset_params();
+
     ////////////////////////////////////////////////
     // Debugging (during execution)
     ////////////////////////////////////////////////
@@ -486,3 +1263,77 @@ public:
     std::pair<std::vector<EngineLocation>, std::string> get_backtrace() const;
 
 };
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Runs fn (which executes turtle code), passing the message for any error it
+//  throws to on_error
+//
+//////////////////////////////////////////////////////////////////////////////
+
+template<class FN, class ON_ERROR>
+void catch_execution_errors(FN fn, ON_ERROR on_error)
+{
+    try
+    {
+	fn();
+    }
+    catch(const SvgPathTurtle::ParallelLinesException&)
+    {
+	on_error("Parallel lines in q or Q command.");
+    }
+    catch(const SvgPathTurtle::InvalidReflectionException&)
+    {
+	on_error("Invalid reflection arguments x==0 and y==0.");
+    }
+    catch(const SvgPathTurtle::EmptyTurtleStackException&)
+    {
+	on_error("Empty stack in 'pop' command.");
+    }
+    catch(const SvgPathTurtle::EmptyMatrixStackException&)
+    {
+	on_error("Empty stack in 'pop_matrix' command.");
+    }
+    catch(const ExecutionEngine::UniqueRangeException&)
+    {
+	on_error("A statement of a parallel block used up its range of "
+		 "unique numbers (see --unique-range)");
+    }
+    catch(const ExecutionEngine::InfiniteRecursionException&)
+    {
+	on_error("Stack overflow - probably due to infinitely "
+		 "recursive user-defined command function");
+    }
+    catch(const ExecutionEngine::StatementLimitException&)
+    {
+	on_error("The program ran more statements than it is allowed "
+		 "(see --max-statements)");
+    }
+    catch(const ExecutionEngine::TimeLimitException&)
+    {
+	on_error("The program ran for longer than it is allowed "
+		 "(see --max-time)");
+    }
+    catch(const ExecutionEngine::OutputLimitException&)
+    {
+	on_error("The program wrote more output than it is allowed "
+		 "(see --max-output)");
+    }
+    catch(const ExecutionEngine::StackLimitException&)
+    {
+	on_error("Stack overflow - the program went deeper than it is "
+		 "allowed (see --max-stack)");
+    }
+    catch(const ExecutionEngine::CancelledException&)
+    {
+	on_error("The run was cancelled");
+    }
+    catch(const std::runtime_error &err)
+    {
+	on_error(err.what());
+    }
+    catch(...)
+    {
+	on_error("Unknown error");
+    }
+}
@@ -0,0 +1,792 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Engine.h"
+#include "EngineMemo.h"
+
+#include <cmath>
+#include <cassert>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// The bytecode interpreter
+//
+//   This mirrors the closure backend in Engine.cpp statement for statement.
+//   The order of the stack operations, the stack size checks, the pen height
+//   checks and the debugger callbacks must all stay identical, or the two
+//   backends will produce different output (or different error locations).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Labels-as-values is a GNU extension that's supported by both gcc and clang.
+// Other compilers get a plain switch.
+#if defined(__GNUC__)
+#define SVG_PATH_TURTLE_COMPUTED_GOTO 1
+#else
+#define SVG_PATH_TURTLE_COMPUTED_GOTO 0
+#endif
+
+const char *get_opcode_name(Opcode op)
+{
+    static const char *names[] =
+    {
+#define SVG_PATH_TURTLE_OPCODE_NAME(name) #name,
+	SVG_PATH_TURTLE_OPCODES(SVG_PATH_TURTLE_OPCODE_NAME)
+#undef SVG_PATH_TURTLE_OPCODE_NAME
+    };
+
+    return names[static_cast<int>(op)];
+}
+
+void ExecutionEngine::exec_bytecode_main(size_t chunk_index)
+{
+    m_control_stack.clear();
+    m_loop_stack.clear();
+
+    if(m_debugger)
+    {
+	enter_call<true>(chunk_index, { 0, 0 }, false);
+	run_bytecode<true>();
+    }
+    else
+    {
+	enter_call<false>(chunk_index, { 0, 0 }, false);
+	run_bytecode<false>();
+    }
+}
+
+template<bool debugging>
+bool ExecutionEngine::enter_call(size_t fn_index,
+				 const StackSize &args_size,
+				 bool has_closure_position)
+{
+    const Chunk &c = get_chunk(fn_index);
+
+    assert(c.is_call_frame());
+
+    // Without a debugger, a call in tail position replaces the frame of the
+    // function making it.  With one, every frame is kept, so that traces
+    // match the closure backend.
+    StackSize outer_unwind_size{};
+
+    if constexpr(!debugging)
+	if(!c.is_native() && is_tail_call(args_size))
+	    outer_unwind_size = unwind_for_tail_call(args_size, has_closure_position);
+
+    if constexpr(debugging)
+	push_debug_frame(fn_index);
+
+    // See exec_fn_body() for why the captures are zero here.
+    m_stack.push_frame({ args_size.locals, 0 }, { c.info.f.params_size, 0 } );
+
+    if(!m_stack.check_stack_size(m_stack_limit))
+	throw_stack_overflow();
+
+    count_statements(c.code.size());
+
+    StackSize unwind_size{
+			    .locals = has_closure_position ? 1 : 0,
+			    .captures = args_size.captures
+			 };
+
+    unwind_size = unwind_size + outer_unwind_size;
+
+    // Without a debugger, a builtin is just its native body, so it is run
+    // right here rather than in a frame of its own.
+    if constexpr(!debugging)
+	if(c.is_native())
+	{
+	    m_program->m_natives[c.code.front().a](*this);
+
+	    m_stack.pop_frame();
+	    m_stack.pop(unwind_size);
+
+	    return false;
+	}
+
+    m_control_stack.push_back({ c.code.data(),
+				c.code.data() + c.code.size(),
+				c.code.data(),
+				FrameType::call,
+				unwind_size });
+
+    return true;
+}
+
+// A call is in tail position if nothing follows it in its function, either
+// directly or in any local blocks it's nested in (loop bodies don't count,
+// since they go round again).
+//
+// The call must also not leave anything on the capture stack that the new
+// call might refer to - that is, there are no closures for anonymous lambdas
+// among its arguments, and none were created by the calling function.
+bool ExecutionEngine::is_tail_call(const StackSize &args_size) const
+{
+    if(args_size.captures != 0 || m_stack.get_frame_size().captures != 0)
+	return false;
+
+    for(auto i = m_control_stack.size(); i-- > 1; )
+    {
+	const ControlFrame &frame = m_control_stack[i];
+
+	if(frame.pc + 1 != frame.end || frame.type == FrameType::loop_body)
+	    return false;
+
+	if(frame.type == FrameType::call)
+	    return true;
+
+	// A recording has to see its call return.
+	if(frame.type == FrameType::memo_call)
+	    return false;
+    }
+
+    // Calls from the main chunk aren't worth it.
+    return false;
+}
+
+// Pops the calling function's frame (and those of any local blocks it's in),
+// leaving only the new call's arguments and closure position.  The calling
+// function's own captured arguments are left in place, since the arguments
+// of the new call may refer to them, so they are returned, to be unwound
+// with the new call instead.
+ExecutionEngine::StackSize
+ExecutionEngine::unwind_for_tail_call(const StackSize &args_size,
+				       bool has_closure_position)
+{
+    while(m_control_stack.back().type != FrameType::call)
+	m_control_stack.pop_back();
+
+    StackSize unwind_size = m_control_stack.back().unwind_size;
+
+    m_control_stack.pop_back();
+
+    m_stack.replace_frame(args_size.locals + (has_closure_position ? 1 : 0),
+			  unwind_size.locals);
+
+    return { 0, unwind_size.captures };
+}
+
+template<bool debugging>
+void ExecutionEngine::enter_local_block(size_t block_index, FrameType type)
+{
+    const Chunk &c = get_chunk(block_index);
+
+    assert(c.is_local_block());
+
+    if constexpr(debugging)
+	push_debug_frame(block_index);
+
+    if(!m_stack.check_stack_size(m_stack_limit))
+	throw_stack_overflow();
+
+    count_statements(c.code.size());
+
+    m_control_stack.push_back({ c.code.data(),
+				c.code.data() + c.code.size(),
+				c.code.data(),
+				type,
+				c.info.b.get_unwind_size() });
+}
+
+bool ExecutionEngine::start_loop(const Instruction &ins)
+{
+    const LoopInfo &loop = m_program->m_loops[ins.a];
+
+    LoopState state{};
+
+    switch(ins.op)
+    {
+	case Opcode::for_count:
+	    // no 'end', so only 'start' matters, and it's an integer count.
+	    state.count = static_cast<int>(eval(m_program->m_exprs[loop.start]));
+	    state.i = 0;
+
+	    if(state.i >= state.count)
+		return false;
+
+	    break;
+
+	case Opcode::for_range:
+	    // no step, so it defaults to 1.0
+	    state.s = eval(m_program->m_exprs[loop.start]);
+	    state.e = eval(m_program->m_exprs[loop.end]);
+	    state.inc = 1.0;
+	    state.ascending = state.s <= state.e;
+
+	    if(!state.ascending && !(state.s >= state.e))
+		return false;
+
+	    break;
+
+	case Opcode::for_range_step:
+	    // full loop, start..stop..end
+	    state.s = eval(m_program->m_exprs[loop.start]);
+	    state.inc = eval(m_program->m_exprs[loop.step]);
+	    state.e = eval(m_program->m_exprs[loop.end]);
+	    state.ascending = state.s <= state.e;
+
+	    if(!state.ascending)
+	    {
+		if(state.inc < 0)
+		    state.inc = -state.inc;
+
+		if(!(state.s >= state.e))
+		    return false;
+	    }
+
+	    break;
+
+	default:
+	    assert(false);
+	    return false;
+    }
+
+    m_loop_stack.push_back(state);
+
+    return true;
+}
+
+bool ExecutionEngine::next_loop_iteration(const Instruction &ins)
+{
+    assert(!m_loop_stack.empty());
+
+    LoopState &state = m_loop_stack.back();
+
+    if(ins.op == Opcode::for_count)
+	return ++state.i < state.count;
+
+    if(state.ascending)
+    {
+	state.s += state.inc;
+
+	return state.s <= state.e;
+    }
+    else
+    {
+	state.s -= state.inc;
+
+	return state.s >= state.e;
+    }
+}
+
+void ExecutionEngine::push_loop_var(const Instruction &ins)
+{
+    if(m_program->m_loops[ins.a].has_named_loop_var)
+    {
+	const LoopState &state = m_loop_stack.back();
+
+	if(ins.op == Opcode::for_count)
+	    m_stack.push(state.i);
+	else
+	    m_stack.push(state.s);
+    }
+}
+
+template<bool debugging>
+void ExecutionEngine::enter_loop_body(const Instruction &ins)
+{
+    push_loop_var(ins);
+
+    enter_local_block<debugging>(m_program->m_loops[ins.a].block_index, FrameType::loop_body);
+}
+
+template<bool debugging>
+void ExecutionEngine::finish_instruction()
+{
+    if constexpr(debugging)
+	increment_debug_statement_counter();
+
+    ++m_control_stack.back().pc;
+}
+
+template<bool debugging>
+bool ExecutionEngine::return_from_frame()
+{
+    ControlFrame &frame = m_control_stack.back();
+
+    if(frame.type == FrameType::loop_body)
+    {
+	// The loop instruction is the current instruction of the enclosing
+	// frame.  If the loop goes round again, the body's frame is simply
+	// rewound, rather than popped and pushed again.
+
+	const Instruction &ins = *m_control_stack[m_control_stack.size() - 2].pc;
+
+	m_stack.pop(frame.unwind_size);
+
+	if constexpr(debugging)
+	    pop_debug_frame();
+
+	if(next_loop_iteration(ins))
+	{
+	    count_statements(static_cast<size_t>(frame.end - frame.begin));
+
+	    push_loop_var(ins);
+
+	    if constexpr(debugging)
+		push_debug_frame(m_program->m_loops[ins.a].block_index);
+
+	    frame.pc = frame.begin;
+
+	    return false;
+	}
+
+	m_loop_stack.pop_back();
+	m_control_stack.pop_back();
+
+	finish_instruction<debugging>();
+
+	return false;
+    }
+
+    if(frame.type == FrameType::call || frame.type == FrameType::memo_call)
+	m_stack.pop_frame();
+
+    m_stack.pop(frame.unwind_size);
+
+    if constexpr(debugging)
+	pop_debug_frame();
+
+    if(frame.type == FrameType::memo_call)
+    {
+	auto &[key, start] = m_memo->pending.back();
+
+	finish_memo_recording(std::move(key), start);
+
+	m_memo->pending.pop_back();
+    }
+
+    m_control_stack.pop_back();
+
+    if(m_control_stack.empty())
+	return true;
+
+    // Back in the calling frame, the current instruction is the one that
+    // entered the frame we just left, and it is now finished.
+
+    finish_instruction<debugging>();
+
+    return false;
+}
+
+template<bool debugging>
+void ExecutionEngine::run_bytecode()
+{
+    using ValueDomain::Local;
+    using ValueDomain::Capture;
+    using ValueDomain::Global;
+    using ValueDomain::Enclosing;
+
+    // The operand pools, which don't change while the program runs
+    const Program &program = *m_program;
+
+    ControlFrame *frame = nullptr;
+    const Instruction *ins = nullptr;
+
+#if SVG_PATH_TURTLE_COMPUTED_GOTO
+
+    static const void *dispatch_table[] =
+    {
+#define SVG_PATH_TURTLE_OPCODE_LABEL(name) &&op_##name,
+	SVG_PATH_TURTLE_OPCODES(SVG_PATH_TURTLE_OPCODE_LABEL)
+#undef SVG_PATH_TURTLE_OPCODE_LABEL
+    };
+
+#define DISPATCH(op)	goto *dispatch_table[static_cast<int>(op)];
+#define CASE(name)	op_##name
+
+    // Each instruction dispatches the next one itself, unless the frame ends.
+#define NEXT_INSTRUCTION					\
+	finish_instruction<debugging>();			\
+	if(frame->pc == frame->end)				\
+	    goto fetch;						\
+	if constexpr(debugging)					\
+	    trace_statement();					\
+	ins = frame->pc;					\
+	goto *dispatch_table[static_cast<int>(ins->op)]
+
+#else
+
+#define DISPATCH(op)	switch(op)
+#define CASE(name)	case Opcode::name
+#define NEXT_INSTRUCTION goto next_instruction
+
+#endif
+
+  fetch:
+    frame = &m_control_stack.back();
+
+    if(frame->pc == frame->end)
+    {
+	if(return_from_frame<debugging>())
+	    return;
+
+	goto fetch;
+    }
+
+    if constexpr(debugging)
+	trace_statement();
+
+    ins = frame->pc;
+
+    DISPATCH(ins->op)
+    {
+	CASE(push_constant_local):
+	{
+	    m_stack.push(program.m_constants[ins->a]);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(push_constant_capture):
+	{
+	    m_stack.push_capture(program.m_constants[ins->a]);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(push_expr_local):
+	{
+	    auto val = eval(program.m_exprs[ins->a]);
+
+	    m_stack.push(val);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(push_expr_capture):
+	{
+	    auto val = eval(program.m_exprs[ins->a]);
+
+	    m_stack.push_capture(val);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(copy_local_to_local):
+	{
+	    copy_stack<Local, Local>(ins->a, ins->b);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(copy_global_to_local):
+	{
+	    copy_stack<Global, Local>(ins->a, ins->b);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(copy_capture_to_local):
+	{
+	    copy_stack<Capture, Local>(ins->a, ins->b);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(copy_local_to_capture):
+	{
+	    copy_stack<Local, Capture>(ins->a, ins->b);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(copy_global_to_capture):
+	{
+	    copy_stack<Global, Capture>(ins->a, ins->b);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(copy_capture_to_capture):
+	{
+	    copy_stack<Capture, Capture>(ins->a, ins->b);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(copy_enclosing_to_local):
+	{
+	    copy_stack<Enclosing, Local>(ins->a, ins->b);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(copy_enclosing_to_capture):
+	{
+	    copy_stack<Enclosing, Capture>(ins->a, ins->b);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(push_frame_link):
+	{
+	    m_stack.push_capture(m_stack.get_local_frame_start());
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(push_lambda_local):
+	{
+	    exec_start_fn_call<Local, false, true>(ins->a);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(push_lambda_capture):
+	{
+	    exec_start_fn_call<Capture, false, true>(ins->a);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(push_self_lambda_local):
+	{
+	    exec_start_fn_call<Local, true, true>(ins->a);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(push_self_lambda_capture):
+	{
+	    exec_start_fn_call<Capture, true, true>(ins->a);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(start_fn_call):
+	{
+	    exec_start_fn_call<Local, false, false>(ins->a);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(start_self_fn_call):
+	{
+	    exec_start_fn_call<Local, true, false>(ins->a);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(call_fn):
+	{
+	    const Chunk &c = get_chunk(ins->a);
+
+	    if(enter_call<debugging>(ins->a, { ins->b, ins->c }, c.info.f.is_closure()))
+		goto fetch;
+
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(call_memo):
+	{
+	    if(enter_memo_call(ins->a, { ins->b, ins->c }))
+		goto fetch;
+
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(start_lambda_call_local):
+	{
+	    auto closure_position = m_stack[ins->a + 1];
+
+	    m_stack.push(closure_position);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(start_lambda_call_capture):
+	{
+	    auto closure_position = m_stack.read_capture(ins->a + 1);
+
+	    m_stack.push(closure_position);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(start_lambda_call_enclosing):
+	{
+	    auto closure_position = m_stack.read_enclosing(ins->a + 1);
+
+	    m_stack.push(closure_position);
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(call_lambda_local):
+	{
+	    auto fn_index = m_stack[ins->a];
+
+	    assert(fn_index >= 0.0);
+	    assert(std::fmod(fn_index, 1.0) == 0.0);
+
+	    if(enter_call<debugging>(static_cast<size_t>(fn_index), { ins->b, ins->c }, true))
+		goto fetch;
+
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(call_lambda_capture):
+	{
+	    auto fn_index = m_stack.read_capture(ins->a);
+
+	    assert(fn_index >= 0.0);
+	    assert(std::fmod(fn_index, 1.0) == 0.0);
+
+	    if(enter_call<debugging>(static_cast<size_t>(fn_index), { ins->b, ins->c }, true))
+		goto fetch;
+
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(call_lambda_enclosing):
+	{
+	    auto fn_index = m_stack.read_enclosing(ins->a);
+
+	    assert(fn_index >= 0.0);
+	    assert(std::fmod(fn_index, 1.0) == 0.0);
+
+	    if(enter_call<debugging>(static_cast<size_t>(fn_index), { ins->b, ins->c }, true))
+		goto fetch;
+
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(if_else):
+	{
+	    if(eval(program.m_exprs[ins->a]))
+	    {
+		enter_local_block<debugging>(ins->b);
+		goto fetch;
+	    }
+	    else if(ins->c)
+	    {
+		enter_local_block<debugging>(ins->c);
+		goto fetch;
+	    }
+
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(local_block):
+	{
+	    enter_local_block<debugging>(ins->a);
+	    goto fetch;
+	}
+
+	CASE(for_count):
+	CASE(for_range):
+	CASE(for_range_step):
+	{
+	    if(start_loop(*ins))
+	    {
+		enter_loop_body<debugging>(*ins);
+		goto fetch;
+	    }
+
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(breakpoint):
+	{
+	    exec_breakpoint();
+	    NEXT_INSTRUCTION;
+	}
+
+	CASE(native):
+	{
+	    program.m_natives[ins->a](*this);
+	    NEXT_INSTRUCTION;
+	}
+    }
+
+#if !SVG_PATH_TURTLE_COMPUTED_GOTO
+  next_instruction:
+    finish_instruction<debugging>();
+    goto fetch;
+#endif
+
+#undef DISPATCH
+#undef CASE
+#undef NEXT_INSTRUCTION
+}
+
+// The bytecode side of exec_memo_call() and exec_recorded_builtin() (see
+// EngineMemo.cpp).  A recorded call's frame is a memo_call, and the
+// recording finishes in return_from_frame().
+bool ExecutionEngine::enter_memo_call(size_t fn_index,
+				      const StackSize &args_size)
+{
+    const Chunk &c = get_chunk(fn_index);
+
+    if(c.is_builtin())
+    {
+	record_builtin_call(fn_index, args_size);
+
+	return enter_call<false>(fn_index, args_size, false);
+    }
+
+    if(!can_memoize(c, args_size))
+	return enter_call<false>(fn_index, args_size, c.info.f.is_closure());
+
+    if(replay_memo_call(fn_index, args_size))
+	return false;
+
+    m_memo->pending.emplace_back(m_memo->key, start_memo_recording());
+
+    enter_call<false>(fn_index, args_size, false);
+
+    m_control_stack.back().type = FrameType::memo_call;
+
+    return true;
+}
+
+// Runs a call to completion, in the middle of another instruction (see
+// replay_memo()), as exec_bytecode_block() runs a block.
+void ExecutionEngine::exec_bytecode_call(size_t fn_index,
+					 const StackSize &args_size)
+{
+    // A native builtin is run right away, with no frame to run.
+    if(get_chunk(fn_index).is_native())
+    {
+	enter_call<false>(fn_index, args_size, false);
+	return;
+    }
+
+    auto control_stack = std::move(m_control_stack);
+    auto loop_stack = std::move(m_loop_stack);
+
+    m_control_stack.clear();
+    m_loop_stack.clear();
+
+    enter_call<false>(fn_index, args_size, false);
+    run_bytecode<false>();
+
+    m_control_stack = std::move(control_stack);
+    m_loop_stack = std::move(loop_stack);
+}
+
+// Runs a local block to completion, in the middle of another instruction
+// (see exec_parallel()).  The interpreter's stacks are set aside meanwhile,
+// and then moved back, so that the frames that are running don't move.
+void ExecutionEngine::exec_bytecode_block(size_t block_index)
+{
+    auto control_stack = std::move(m_control_stack);
+    auto loop_stack = std::move(m_loop_stack);
+
+    m_control_stack.clear();
+    m_loop_stack.clear();
+
+    if(m_debugger)
+    {
+	enter_local_block<true>(block_index);
+	run_bytecode<true>();
+    }
+    else
+    {
+	enter_local_block<false>(block_index);
+	run_bytecode<false>();
+    }
+
+    m_control_stack = std::move(control_stack);
+    m_loop_stack = std::move(loop_stack);
+}
@@ -0,0 +1,415 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Engine.h"
+
+#include <cassert>
+#include <format>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// dump_ir() - the compiled program, chunk by chunk (for --dump-ir)
+//
+//   Each instruction is shown with its operands decoded: constants, the
+//   stack offsets and sizes that it copies or passes, the expressions that
+//   it evaluates (in postfix order, as eval() runs them), and the chunks
+//   that it calls or enters.
+//
+//   The cost is a rough static estimate: one for each instruction, plus one
+//   for each step of its expressions.  It doesn't include what's called, or
+//   how many times a loop goes round.
+//
+//   The notes say which fast paths apply:
+//
+//   - native: the callee is a builtin with a native body, which is run
+//     without a frame of its own
+//
+//   - tail position: the call is the last thing its function does (perhaps
+//     in an if statement, but not in a loop).  Whether it replaces the
+//     caller's frame is only known when it runs: is_tail_call() also wants
+//     the caller to have nothing on the capture stack, and not to be main
+//     or a call that --memoize is recording.  The default backend's
+//     exec_call_or_tail_call() wants the same, and a callee that isn't a
+//     builtin.
+//
+//   - self: a recursive call or reference, which skips the callee lookup
+//
+//   Constant folding shows up as constants in place of expressions, ifs
+//   whose condition folded as plain local_blocks (or nothing at all), and
+//   unrolled loops as copies of their body's instructions.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    const char *get_expr_op_name(ExprOp op)
+    {
+	switch(op)
+	{
+	    case ExprOp::constant:      return "constant";
+	    case ExprOp::read_local:    return "local";
+	    case ExprOp::read_global:   return "global";
+	    case ExprOp::read_capture:  return "capture";
+	    case ExprOp::read_enclosing: return "enclosing";
+	    case ExprOp::read_param:    return "param";
+	    case ExprOp::turtle_x:      return "turtle_x";
+	    case ExprOp::turtle_y:      return "turtle_y";
+	    case ExprOp::turtle_dir:    return "turtle_dir";
+	    case ExprOp::unique:        return "unique";
+	    case ExprOp::negate:        return "neg";
+	    case ExprOp::logical_not:   return "!";
+	    case ExprOp::add:           return "+";
+	    case ExprOp::subtract:      return "-";
+	    case ExprOp::multiply:      return "*";
+	    case ExprOp::divide:        return "/";
+	    case ExprOp::power:         return "^";
+	    case ExprOp::equal:         return "==";
+	    case ExprOp::not_equal:     return "!=";
+	    case ExprOp::less:          return "<";
+	    case ExprOp::greater:       return ">";
+	    case ExprOp::less_equal:    return "<=";
+	    case ExprOp::greater_equal: return ">=";
+	    case ExprOp::logical_or:    return "||";
+	    case ExprOp::logical_and:   return "&&";
+	    case ExprOp::jump_if_false: return "jump_if_false";
+	    case ExprOp::jump:          return "jump";
+	}
+
+	return "?";
+    }
+}
+
+std::string ExecutionEngine::describe_expr(const Expr &e) const
+{
+    std::string s;
+
+    for(const auto &ins : e)
+    {
+	if(!s.empty())
+	    s += ' ';
+
+	switch(ins.op)
+	{
+	    case ExprOp::constant:
+		s += std::format("{}", ins.value);
+		break;
+
+	    case ExprOp::read_local:
+	    case ExprOp::read_global:
+	    case ExprOp::read_capture:
+	    case ExprOp::read_enclosing:
+		s += std::format("{}[{}]", get_expr_op_name(ins.op), ins.offset);
+		break;
+
+	    case ExprOp::read_param:
+		s += "param " + m_program->m_params[ins.offset].name;
+		break;
+
+	    case ExprOp::jump_if_false:
+	    case ExprOp::jump:
+		s += std::format("{} +{}", get_expr_op_name(ins.op), ins.offset);
+		break;
+
+	    default:
+		s += get_expr_op_name(ins.op);
+	}
+    }
+
+    return s;
+}
+
+void ExecutionEngine::dump_ir(std::ostream &out,
+			      size_t main_chunk_index,
+			      const ChunkNameFn &name) const
+{
+    assert(is_bytecode());
+
+    const Program &program = *m_program;
+
+    auto plain_name = [&](size_t index)
+    {
+	auto n = name(index);
+
+	if(n.empty())
+	    n = get_chunk(index).is_call_frame() ? "(lambda)" : "(block)";
+
+	return n;
+    };
+
+    // For references to other chunks
+    auto chunk_name = [&](int index)
+    {
+	return std::format("{} #{}", plain_name(static_cast<size_t>(index)),
+			   index);
+    };
+
+    auto expr_cost = [&](int index)
+    {
+	return index < 0 ? 0 : static_cast<int>(program.m_exprs[index].size());
+    };
+
+    auto expr = [&](int index)
+    {
+	return describe_expr(program.m_exprs[index]);
+    };
+
+    // The chunks whose last instruction is the last of a function, other
+    // than main.  A block is always after the chunk it's in.
+    std::vector<bool> ends_function(program.m_chunks.size());
+
+    for(size_t i = 0; i < program.m_chunks.size(); ++i)
+    {
+	const Chunk &c = program.m_chunks[i];
+
+	if(c.type == ChunkType::function && i != main_chunk_index)
+	    ends_function[i] = true;
+
+	if(!ends_function[i] || c.code.empty())
+	    continue;
+
+	const Instruction &last = c.code.back();
+
+	if(last.op == Opcode::local_block)
+	    ends_function[static_cast<size_t>(last.a)] = true;
+	else if(last.op == Opcode::if_else)
+	{
+	    ends_function[static_cast<size_t>(last.b)] = true;
+
+	    if(last.c)
+		ends_function[static_cast<size_t>(last.c)] = true;
+	}
+    }
+
+    out << " --------- IR --------------------------------------\n";
+
+    for(size_t i = 0; i < program.m_chunks.size(); ++i)
+    {
+	const Chunk &c = program.m_chunks[i];
+
+	// Calls to these are noted as native, so there's no more to say.
+	if(c.is_native())
+	    continue;
+
+	std::vector<std::pair<std::string, int>> lines;
+
+	for(size_t pc = 0; pc < c.code.size(); ++pc)
+	{
+	    const Instruction &ins = c.code[pc];
+
+	    std::string operands;
+	    std::string notes;
+	    int cost = 1;
+
+	    switch(ins.op)
+	    {
+		case Opcode::push_constant_local:
+		case Opcode::push_constant_capture:
+		    operands = std::format("{}", program.m_constants[ins.a]);
+		    break;
+
+		case Opcode::push_expr_local:
+		case Opcode::push_expr_capture:
+		    operands = expr(ins.a);
+		    cost += expr_cost(ins.a);
+		    break;
+
+		case Opcode::copy_local_to_local:
+		case Opcode::copy_local_to_capture:
+		    operands = std::format("local[{}] size {}", ins.a, ins.b);
+		    break;
+
+		case Opcode::copy_global_to_local:
+		case Opcode::copy_global_to_capture:
+		    operands = std::format("global[{}] size {}", ins.a, ins.b);
+		    break;
+
+		case Opcode::copy_capture_to_local:
+		case Opcode::copy_capture_to_capture:
+		    operands = std::format("capture[{}] size {}", ins.a, ins.b);
+		    break;
+
+		case Opcode::copy_enclosing_to_local:
+		case Opcode::copy_enclosing_to_capture:
+		    operands = std::format("enclosing[{}] size {}", ins.a, ins.b);
+		    break;
+
+		case Opcode::push_frame_link:
+		    break;
+
+		case Opcode::push_self_lambda_local:
+		case Opcode::push_self_lambda_capture:
+		case Opcode::start_self_fn_call:
+		    notes = "self";
+		    [[fallthrough]];
+
+		case Opcode::push_lambda_local:
+		case Opcode::push_lambda_capture:
+		case Opcode::start_fn_call:
+		    operands = chunk_name(ins.a);
+		    break;
+
+		case Opcode::call_fn:
+		case Opcode::call_memo:
+		{
+		    const Chunk &callee = get_chunk(static_cast<size_t>(ins.a));
+
+		    operands = std::format("{} args {}/{}",
+					   chunk_name(ins.a), ins.b, ins.c);
+
+		    // With a debugger, every call has a frame of its own.
+		    if(m_debugger)
+			;
+		    else if(callee.is_native())
+			notes = "native";
+		    else if(ends_function[i]
+			    && pc + 1 == c.code.size()
+			    && ins.c == 0)
+			notes = "tail position";
+		    break;
+		}
+
+		case Opcode::start_lambda_call_local:
+		    operands = std::format("local[{}]", ins.a);
+		    break;
+
+		case Opcode::start_lambda_call_capture:
+		    operands = std::format("capture[{}]", ins.a);
+		    break;
+
+		case Opcode::start_lambda_call_enclosing:
+		    operands = std::format("enclosing[{}]", ins.a);
+		    break;
+
+		case Opcode::call_lambda_local:
+		    operands = std::format("local[{}] args {}/{}",
+					   ins.a, ins.b, ins.c);
+		    break;
+
+		case Opcode::call_lambda_capture:
+		    operands = std::format("capture[{}] args {}/{}",
+					   ins.a, ins.b, ins.c);
+		    break;
+
+		case Opcode::call_lambda_enclosing:
+		    operands = std::format("enclosing[{}] args {}/{}",
+					   ins.a, ins.b, ins.c);
+		    break;
+
+		case Opcode::if_else:
+		    operands = std::format("{} ? {}", expr(ins.a),
+					   chunk_name(ins.b));
+		    if(ins.c)
+			operands += " : " + chunk_name(ins.c);
+		    cost += expr_cost(ins.a);
+		    break;
+
+		case Opcode::local_block:
+		    operands = chunk_name(ins.a);
+		    break;
+
+		case Opcode::for_count:
+		case Opcode::for_range:
+		case Opcode::for_range_step:
+		{
+		    const LoopInfo &loop = program.m_loops[ins.a];
+
+		    operands = expr(loop.start);
+
+		    if(loop.end >= 0)
+			operands += " .. " + expr(loop.end);
+
+		    if(loop.step >= 0)
+			operands += " step " + expr(loop.step);
+
+		    operands += " do " + chunk_name(loop.block_index);
+
+		    if(loop.has_named_loop_var)
+			notes = "loop var";
+
+		    cost += expr_cost(loop.start)
+			  + expr_cost(loop.end)
+			  + expr_cost(loop.step);
+		    break;
+		}
+
+		case Opcode::native:
+		    operands = std::format("native #{}", ins.a);
+		    break;
+
+		case Opcode::breakpoint:
+		    break;
+	    }
+
+	    std::string line = std::format("  {:>4}  {:<26} {}",
+					   pc, get_opcode_name(ins.op), operands);
+
+	    if(!notes.empty())
+		line += "  (" + notes + ")";
+
+	    lines.emplace_back(std::move(line), cost);
+	}
+
+	int total_cost = 0;
+
+	for(const auto &line : lines)
+	    total_cost += line.second;
+
+	out << std::format("{}: ", i);
+
+	switch(c.type)
+	{
+	    case ChunkType::builtin_function:
+		out << "builtin " << plain_name(i);
+		break;
+
+	    case ChunkType::function:
+		out << std::format("function {}, params {}",
+				   plain_name(i),
+				   c.info.f.params_size);
+
+		if(c.info.f.is_closure())
+		    out << ", closure";
+
+		if(c.is_pure)
+		    out << ", pure";
+		break;
+
+	    case ChunkType::local_block:
+	    {
+		auto unwind = c.info.b.get_unwind_size();
+
+		out << std::format("block, unwinds {}/{}",
+				   unwind.locals, unwind.captures);
+		break;
+	    }
+	}
+
+	out << std::format(", cost {}\n", total_cost);
+
+	for(const auto &[line, cost] : lines)
+	    out << std::format("{:<72} {:>3}\n", line, cost);
+    }
+
+    out << " --------- End of IR -------------------------------\n";
+}
@@ -0,0 +1,266 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "EngineMemo.h"
+
+#include <cassert>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Memoization (--memoize)
+//
+//   A call to a pure function, with the same arguments, makes the same
+//   builtin calls (turtle commands) every time.  Only the turtle they start
+//   from differs, and the turtle takes care of that by itself - its position,
+//   direction and transform are applied to each command as it's made.  So
+//   the first call records its builtin calls and their arguments, and later
+//   calls with the same arguments just make those calls again, without
+//   running the function at all.
+//
+//   A function is pure unless something in it (or in anything it calls, or
+//   any local block it runs) reads the turtle's state or the unique numbers,
+//   calls a lambda, or starts a new path (see mark_impure()).  Closures
+//   aren't memoized, since their captures aren't among their arguments, and
+//   neither are calls with anonymous lambdas among their arguments.
+//
+//   The closure backend records a call around exec_call().  The bytecode
+//   backend can't, since a call only enters the callee's frame, so the frame
+//   is a memo_call, and the recording finishes when it returns (and calls
+//   made from it aren't tail calls, which would replace it).
+//
+//   Neither backend memoizes with a debugger.  That's decided when the calls
+//   are compiled.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void ExecutionEngine::set_memoize(bool memoize)
+{
+    m_memoize = memoize;
+}
+
+bool ExecutionEngine::is_memoizing() const
+{
+    return m_memoize && !m_debugger;
+}
+
+void ExecutionEngine::clear_memo()
+{
+    if(m_memo)
+	m_memo->clear();
+}
+
+// The current chunk may make other builtin calls, for the same arguments,
+// and so may anything that calls it.
+void ExecutionEngine::mark_impure()
+{
+    mark_impure(m_current_chunk);
+}
+
+void ExecutionEngine::mark_impure(size_t chunk_index)
+{
+    std::vector<size_t> pending{ chunk_index };
+
+    while(!pending.empty())
+    {
+	auto index = pending.back();
+
+	pending.pop_back();
+
+	Chunk &c = get_build_chunk(index);
+
+	if(!c.is_pure)
+	    continue;
+
+	c.is_pure = false;
+
+	if(index < m_callers.size())
+	    pending.insert(pending.end(),
+			   m_callers[index].begin(),
+			   m_callers[index].end());
+    }
+}
+
+// The current chunk calls (or, for a local block, runs) the chunk at
+// callee_index, so it's only pure if that chunk is, and it may not be
+// known yet, if it is still being compiled.
+void ExecutionEngine::note_caller(size_t callee_index)
+{
+    if(m_callers.size() <= callee_index)
+	m_callers.resize(callee_index + 1);
+
+    m_callers[callee_index].push_back(m_current_chunk);
+
+    if(!get_chunk(callee_index).is_pure)
+	mark_impure();
+}
+
+// Logs a builtin call, if a recording is under way.
+void ExecutionEngine::record_builtin_call(size_t fn_index,
+					   const StackSize &args_size)
+{
+    if(m_memo && m_memo->recording_depth > 0)
+    {
+	auto &log = m_memo->log;
+
+	auto frame_size = m_stack.get_frame_size().locals;
+
+	log.push_back(static_cast<double>(fn_index));
+
+	for(int i = frame_size - args_size.locals; i < frame_size; ++i)
+	    log.push_back(m_stack[i]);
+    }
+}
+
+void ExecutionEngine::exec_recorded_builtin(const Chunk &c,
+					     size_t fn_index,
+					     const StackSize &args_size)
+{
+    record_builtin_call(fn_index, args_size);
+
+    exec_call<false>(c, fn_index, args_size, false);
+}
+
+bool ExecutionEngine::can_memoize(const Chunk &c, const StackSize &args_size)
+{
+    return c.is_pure && !c.info.f.is_closure() && args_size.captures == 0;
+}
+
+// If the call (whose arguments are on the stack) was recorded before, its
+// arguments are popped, its builtin calls are made again, and true is
+// returned.  If not, the call's key is left in m_memo->key.
+bool ExecutionEngine::replay_memo_call(size_t fn_index,
+				       const StackSize &args_size)
+{
+    if(!m_memo)
+	m_memo = std::make_unique<MemoCache>();
+
+    MemoCache &memo = *m_memo;
+
+    auto frame_size = m_stack.get_frame_size().locals;
+
+    memo.key.fn_index = fn_index;
+    memo.key.args.clear();
+
+    for(int i = frame_size - args_size.locals; i < frame_size; ++i)
+	memo.key.args.push_back(m_stack[i]);
+
+    auto found = memo.entries.find(memo.key);
+
+    if(found == memo.entries.end())
+	return false;
+
+    m_stack.pop({ args_size.locals, 0 });
+
+    replay_memo(found->second);
+
+    return true;
+}
+
+// Returns where the recording starts in the log.
+size_t ExecutionEngine::start_memo_recording()
+{
+    ++m_memo->recording_depth;
+
+    return m_memo->log.size();
+}
+
+// The call that m_memo->key was for, which was recorded from 'start' in the
+// log, has returned.
+void ExecutionEngine::finish_memo_recording(memo_detail::MemoKey &&key,
+					    size_t start)
+{
+    MemoCache &memo = *m_memo;
+
+    --memo.recording_depth;
+
+    auto entry_size = memo.log.size() - start;
+
+    if(entry_size <= max_memo_entry_size
+       && memo.size + entry_size <= max_memo_size)
+    {
+	memo.entries.emplace(std::move(key),
+			     std::vector<double>(memo.log.begin() + start,
+						 memo.log.end()));
+
+	memo.size += entry_size;
+    }
+
+    if(memo.recording_depth == 0)
+	memo.log.clear();
+}
+
+void ExecutionEngine::exec_memo_call(const Chunk &c,
+				      size_t fn_index,
+				      const StackSize &args_size)
+{
+    if(!can_memoize(c, args_size))
+    {
+	exec_call<false>(c, fn_index, args_size, c.info.f.is_closure());
+	return;
+    }
+
+    if(replay_memo_call(fn_index, args_size))
+	return;
+
+    auto key = m_memo->key;
+
+    auto start = start_memo_recording();
+
+    try
+    {
+	exec_call<false>(c, fn_index, args_size, false);
+    }
+    catch(...)
+    {
+	m_memo->log.clear();
+	m_memo->recording_depth = 0;
+	throw;
+    }
+
+    finish_memo_recording(std::move(key), start);
+}
+
+void ExecutionEngine::replay_memo(const std::vector<double> &calls)
+{
+    for(size_t i = 0; i < calls.size(); )
+    {
+	auto fn_index = static_cast<size_t>(calls[i++]);
+
+	const Chunk &c = get_chunk(fn_index);
+
+	int params_size = c.info.f.params_size;
+
+	for(int n = 0; n < params_size; ++n)
+	    m_stack.push(calls[i++]);
+
+	if(is_bytecode())
+	{
+	    record_builtin_call(fn_index, { params_size, 0 });
+
+	    exec_bytecode_call(fn_index, { params_size, 0 });
+	}
+	else
+	    exec_recorded_builtin(c, fn_index, { params_size, 0 });
+    }
+}
@@ -0,0 +1,109 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Engine.h"
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The memoization cache (see EngineMemo.cpp)
+
+namespace memo_detail
+{
+    struct MemoKey
+    {
+	size_t fn_index = 0;
+	std::vector<double> args;
+
+	// Bitwise, so that -0 and 0 are different arguments (as they can be,
+	// to the turtle), and a NaN argument matches itself.
+	bool operator==(const MemoKey &other) const
+	{
+	    return fn_index == other.fn_index
+		&& args.size() == other.args.size()
+		&& std::memcmp(args.data(),
+			       other.args.data(),
+			       args.size() * sizeof(double)) == 0;
+	}
+    };
+
+    struct MemoKeyHash
+    {
+	size_t operator()(const MemoKey &key) const
+	{
+	    size_t h = std::hash<size_t>{}(key.fn_index);
+
+	    for(double arg : key.args)
+	    {
+		std::uint64_t bits;
+
+		std::memcpy(&bits, &arg, sizeof(bits));
+
+		h ^= std::hash<std::uint64_t>{}(bits) + 0x9e3779b97f4a7c15ULL
+		   + (h << 6) + (h >> 2);
+	    }
+
+	    return h;
+	}
+    };
+}
+
+struct ExecutionEngine::MemoCache
+{
+    // Each entry is a list of builtin calls: the builtin's chunk index,
+    // followed by its arguments.
+    std::unordered_map<memo_detail::MemoKey,
+		       std::vector<double>,
+		       memo_detail::MemoKeyHash> entries;
+
+    // The builtin calls made since the outermost recording started.  Each
+    // recording takes its own part of it, when its call returns.
+    std::vector<double> log;
+
+    int recording_depth = 0;
+
+    // The doubles held by all entries
+    size_t size = 0;
+
+    // Reused, to look up entries without allocating
+    memo_detail::MemoKey key;
+
+    // The bytecode backend's recordings under way, innermost last: the key
+    // of each one's call, and where it starts in the log.
+    std::vector<std::pair<memo_detail::MemoKey, size_t>> pending;
+
+    void clear()
+    {
+	entries.clear();
+	log.clear();
+	recording_depth = 0;
+	size = 0;
+	pending.clear();
+    }
+};
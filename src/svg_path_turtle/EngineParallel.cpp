@@ -0,0 +1,376 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <sstream>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Parallel blocks - parallel { statement... }
+//
+//   Each statement is a local block of its own.  They are run at once by
+//   other engines (on the same Program), each starting from a snapshot of
+//   this engine's turtle, stack and unique numbers, and each writing to its
+//   own buffer.  Then the results are taken in program order.
+//
+//   A statement's result is only taken if this engine is still in the state
+//   that the snapshot was taken from, so the output is always what a serial
+//   run would produce.  Statements that save and restore the turtle (like
+//   'stamp' and 'place') leave it in that state.  Any other statement is
+//   simply run again, here, in its turn.
+//
+//   The statements are taken in windows, which start small and then grow.
+//   When a statement has to be run again, the rest of its window is dropped,
+//   and a new (small) window is forked from the state that it left.  This
+//   happens after the first statement quite often, since the turtle is
+//   rarely in the middle of a subpath afterwards, as it was before it.
+//
+//   Unique numbers are taken in the order they're used, so a statement that
+//   used any can only be taken if it was the first to, since the window was
+//   forked.  With unique ranges (see set_unique_range()), each statement
+//   has its own numbers instead, whichever order they run in.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // A new_path statement ends the path in this engine's output, so it
+    // can't be run elsewhere.
+    struct NewPathInParallelTask {};
+}
+
+struct ExecutionEngine::ParallelTask
+{
+    size_t block_index = 0;
+
+    // False if the statement failed, or couldn't be run elsewhere.  Either
+    // way, it's run again here, which reports any error as usual.
+    bool ok = false;
+
+    std::string output;
+
+    OstreamTurtle::ForkResult turtle;
+
+    // The statement's unique numbers are from here up to (not including)
+    // the limit.
+    UniqueNum unique_start = 0;
+    UniqueNum unique_limit = no_unique_limit;
+
+    UniqueNum next_unique_num = 0;
+
+    bool pen_height_became_negative = false;
+
+    // Counted towards the parent's statement limit, when it's joined
+    std::uint64_t statements_run = 0;
+};
+
+struct ExecutionEngine::ParallelWorker
+{
+    std::stringbuf buffer;
+    std::ostream out;
+
+    ExecutionEngine engine;
+
+    explicit ParallelWorker(SharedProgram program)
+	: out(&buffer)
+	, engine(std::move(program), out)
+    {
+	engine.set_new_path_handler(
+	    [](const std::string &, const std::string &)
+	    {
+		throw NewPathInParallelTask{};
+	    });
+    }
+};
+
+void ExecutionEngine::set_parallel_threads(unsigned threads)
+{
+    if(threads == 0)
+	threads = std::max(1u, std::thread::hardware_concurrency());
+
+    m_parallel_threads = threads;
+}
+
+void ExecutionEngine::set_unique_range(int size)
+{
+    m_unique_range = size;
+}
+
+void ExecutionEngine::compile_parallel(std::vector<size_t> blocks)
+{
+    add_native_statement( [blocks = std::move(blocks)](ExecutionEngine &engine)
+			  {
+			      engine.exec_parallel(blocks);
+			  });
+}
+
+void ExecutionEngine::exec_block_now(size_t block_index)
+{
+    // The blocks after it run after its calls, so none are tail calls.
+    m_tail_position = false;
+
+    if(is_bytecode())
+	exec_bytecode_block(block_index);
+    else
+	exec_call_local_block(block_index);
+}
+
+void ExecutionEngine::exec_parallel(const std::vector<size_t> &blocks)
+{
+    auto can_fork = [this]
+    {
+	return m_parallel_threads > 1 && !m_debugger && m_turtle.can_fork();
+    };
+
+    // The unique numbers for statement n (see set_unique_range())
+    auto unique_base = m_next_unique_num;
+
+    auto unique_start = [&](size_t n)
+    {
+	return unique_base + static_cast<UniqueNum>(n) * m_unique_range;
+    };
+
+    auto run_here = [&](size_t n)
+    {
+	if(m_unique_range)
+	{
+	    m_next_unique_num = unique_start(n);
+	    m_unique_limit = unique_start(n + 1);
+	}
+
+	exec_block_now(blocks[n]);
+    };
+
+    size_t next = 0;
+
+    // Until the output has started (at least), the statements run here.
+    while(next < blocks.size() && !can_fork())
+	run_here(next++);
+
+    if(next < blocks.size())
+	exec_parallel_windows(blocks, next, run_here, unique_start);
+
+    if(m_unique_range)
+    {
+	m_next_unique_num = unique_start(blocks.size());
+	m_unique_limit = no_unique_limit;
+    }
+}
+
+void ExecutionEngine::exec_parallel_windows(
+		const std::vector<size_t> &blocks,
+		size_t next,
+		const std::function<void(size_t)> &run_here,
+		const std::function<UniqueNum(size_t)> &unique_start)
+{
+
+    std::vector<std::unique_ptr<ParallelWorker>> workers;
+
+    for(unsigned i = 0; i < m_parallel_threads; ++i)
+	workers.push_back(std::make_unique<ParallelWorker>(m_program));
+
+    std::vector<ParallelTask> tasks;
+
+    size_t window = m_parallel_threads;
+
+    while(next < blocks.size())
+    {
+	tasks.clear();
+	tasks.resize(std::min(window, blocks.size() - next));
+
+	for(size_t i = 0; i < tasks.size(); ++i)
+	{
+	    auto &task = tasks[i];
+
+	    task.block_index = blocks[next + i];
+
+	    if(m_unique_range)
+	    {
+		task.unique_start = unique_start(next + i);
+		task.unique_limit = unique_start(next + i + 1);
+	    }
+	    else
+		task.unique_start = m_next_unique_num;
+	}
+
+	auto start = m_turtle.get_fork_snapshot();
+	auto start_unique_num = m_next_unique_num;
+
+	run_parallel_tasks(start, tasks, workers);
+
+	window = std::min(window * 2, max_parallel_window);
+
+	for(auto &task : tasks)
+	{
+	    if(!join_parallel_task(start, start_unique_num, task))
+	    {
+		run_here(next++);
+
+		window = m_parallel_threads;
+		break;
+	    }
+
+	    ++next;
+	}
+    }
+}
+
+void ExecutionEngine::run_parallel_tasks(
+		    const OstreamTurtle::Snapshot &start,
+		    std::vector<ParallelTask> &tasks,
+		    std::vector<std::unique_ptr<ParallelWorker>> &workers)
+{
+    std::atomic<size_t> next_task = 0;
+
+    // This engine is only read, until they're all done.
+    auto work = [&](ParallelWorker &worker)
+    {
+	for(;;)
+	{
+	    auto i = next_task.fetch_add(1, std::memory_order_relaxed);
+
+	    if(i >= tasks.size())
+		break;
+
+	    worker.engine.run_parallel_task(*this, start, tasks[i], worker.buffer);
+	}
+    };
+
+    std::vector<std::thread> threads;
+
+    size_t num_threads = std::min(workers.size(), tasks.size());
+
+    for(size_t i = 1; i < num_threads; ++i)
+	threads.emplace_back(work, std::ref(*workers[i]));
+
+    work(*workers[0]);
+
+    for(auto &thread : threads)
+	thread.join();
+}
+
+// Runs on a worker's engine, on the worker's thread.
+void ExecutionEngine::run_parallel_task(const ExecutionEngine &parent,
+					const OstreamTurtle::Snapshot &start,
+					ParallelTask &task,
+					std::stringbuf &output)
+{
+    m_stack.copy_from(parent.m_stack);
+    m_param_values = parent.m_param_values;
+    m_next_unique_num = task.unique_start;
+    m_unique_limit = task.unique_limit;
+    m_pen_height_became_negative = false;
+
+    m_turtle.fork(parent.m_turtle, start);
+
+    inherit_limits(parent);
+
+    m_is_executing = true;
+
+    try
+    {
+	exec_block_now(task.block_index);
+
+	task.ok = true;
+    }
+    catch(...)
+    {
+	task.ok = false;
+    }
+
+    task.output = output.str();
+    output.str({});
+
+    task.turtle = m_turtle.get_fork_result();
+    task.next_unique_num = m_next_unique_num;
+    task.pen_height_became_negative = m_pen_height_became_negative;
+    task.statements_run = get_statements_run();
+}
+
+// A task gets what is left of the parent's limits.  If it goes past them,
+// it is run again on the parent, which stops there.
+void ExecutionEngine::inherit_limits(const ExecutionEngine &parent)
+{
+    auto left = [](std::uint64_t limit, std::uint64_t used) -> std::uint64_t
+    {
+	if(!limit)
+	    return 0;
+
+	return used < limit ? limit - used : 1;
+    };
+
+    Limits limits = parent.m_limits;
+
+    limits.max_statements = left(limits.max_statements,
+				 parent.get_statements_run());
+
+    limits.max_output_bytes = left(limits.max_output_bytes,
+				   parent.get_output_bytes());
+
+    set_limits(limits);
+
+    start_limits();
+
+    m_deadline = parent.m_deadline;
+}
+
+// Returns false if the statement has to be run again, here.
+bool ExecutionEngine::join_parallel_task(const OstreamTurtle::Snapshot &start,
+					 UniqueNum start_unique_num,
+					 ParallelTask &task)
+{
+    // Without unique ranges, a statement that used unique numbers needs the
+    // ones it would have had here.
+    bool used_unique_nums = task.next_unique_num != task.unique_start;
+
+    bool same_unique_nums = m_unique_range
+			 || !used_unique_nums
+			 || m_next_unique_num == start_unique_num;
+
+    if(!task.ok
+       || !same_unique_nums
+       || !m_turtle.can_fork()
+       || !m_turtle.can_join(start, task.turtle))
+	return false;
+
+    m_turtle.join(task.turtle, task.output);
+
+    if(used_unique_nums)
+	m_next_unique_num = task.next_unique_num;
+
+    if(task.pen_height_became_negative)
+	m_pen_height_became_negative = true;
+
+    m_statements_run += task.statements_run;
+
+    // The output is no longer needed, and there may be a lot of it.
+    std::string().swap(task.output);
+
+    return true;
+}
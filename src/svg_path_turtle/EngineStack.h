@@ -24,20 +24,105 @@
 
 #pragma once
 
-#include "FrameStack.h"
-
+#include <algorithm>
+#include <memory>
+#include <vector>
 #include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <assert.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// EngineStack - the value stack of the ExecutionEngine
+//
+//   - Locals and captures share one contiguous arena.  Locals grow up from
+//     the bottom, and captures grow down from the top, so a function call
+//     touches a single block of memory no matter which kind of values it
+//     uses.  When the two meet, the arena is reallocated at twice the size.
+//
+//   - Each frame is one fixed-size record holding both frame starts, so
+//     pushing and popping a frame is a single push/pop, rather than one per
+//     stack plus one per frame list.  The records are kept beside the arena
+//     rather than in it, since a call's arguments are already on the stack
+//     when its frame is pushed, and a record would have to go beneath them.
+//     The stack limit counts the bytes of both (see check_stack_size()).
+//
+//   - The initial reserve is configurable, so that deep recursion (e.g. a
+//     high level fractal) doesn't have to grow the arena repeatedly.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Note: Frames and offsets are represented with 'int' externally, to simplify
+// support for stack offsets of -1 and such.  For a hobby language, this seems
+// fine.
 
 class EngineStack
 {
     // Note: in a single-pass compiler that supports anonymous functions in
     // function call argument lists, captures must be on a separate stack to
     // prevent them from intruding amidst the function arguments themselves.
+    // Here they are "separate" by virtue of growing from the other end.
+
+    struct Frame
+    {
+	int locals_start = 0;
+	int captures_start = 0;
+    };
+
+    std::unique_ptr<double[]> m_arena;
+
+    int m_capacity = 0;
+
+    int m_locals_size = 0;
+    int m_captures_size = 0;
+
+    Frame m_frame;
+
+    std::vector<Frame> m_frames;
+
+    // Capture position 0 is the last slot of the arena.
+    double *get_captures_base() const
+    {
+	return m_arena.get() + m_capacity - 1;
+    }
+
+    void ensure_room(int size)
+    {
+	if(m_locals_size + m_captures_size + size > m_capacity)
+	    grow(m_locals_size + m_captures_size + size);
+    }
 
-    FrameStack<double> m_locals;
-    FrameStack<double> m_captures;
+    void grow(int min_capacity)
+    {
+	int capacity = std::max(min_capacity, m_capacity * 2);
+
+	auto arena = std::make_unique<double[]>(static_cast<size_t>(capacity));
+
+	std::memcpy(arena.get(),
+		    m_arena.get(),
+		    sizeof(double) * m_locals_size);
+
+	std::memcpy(arena.get() + capacity - m_captures_size,
+		    m_arena.get() + m_capacity - m_captures_size,
+		    sizeof(double) * m_captures_size);
+
+	m_arena = std::move(arena);
+	m_capacity = capacity;
+    }
 
 public:
+    static constexpr int default_reserve = 64 * 1024;
+    static constexpr int default_frames_reserve = 4 * 1024;
+
+    explicit EngineStack(int reserve = default_reserve,
+			 int frames_reserve = default_frames_reserve)
+	: m_arena(std::make_unique<double[]>(static_cast<size_t>(std::max(reserve, 1)))),
+	  m_capacity(std::max(reserve, 1))
+    {
+	m_frames.reserve(static_cast<size_t>(std::max(frames_reserve, 0)));
+    }
+
     struct Size
     {
 	int locals = 0;
@@ -56,10 +141,59 @@ public:
 	}
     };
 
+private:
+    // The most values and frames that the stack has held
+    Size m_peak;
+    int m_peak_frames = 1;
+
+    // Values only leave the stack through pop(), pop_frame(),
+    // replace_frame() and reset(), so noting the size there (rather than at
+    // each push) still finds the peak.
+    void note_peak()
+    {
+	m_peak.locals = std::max(m_peak.locals, m_locals_size);
+	m_peak.captures = std::max(m_peak.captures, m_captures_size);
+    }
+
+    void note_peak_frames()
+    {
+	m_peak_frames = std::max(m_peak_frames, get_num_frames());
+    }
+
+public:
     void reset()
     {
-	m_locals.reset();
-	m_captures.reset();
+	note_peak();
+
+	m_locals_size = 0;
+	m_captures_size = 0;
+	m_frame = {};
+	m_frames.clear();
+    }
+
+    // Makes this stack a copy of 'other', values and frames, so that another
+    // engine can carry on from the same point (see parallel blocks).
+    void copy_from(const EngineStack &other)
+    {
+	int size = other.m_locals_size + other.m_captures_size;
+
+	reset();
+
+	if(size > m_capacity)
+	    grow(size);
+
+	std::memcpy(m_arena.get(),
+		    other.m_arena.get(),
+		    sizeof(double) * other.m_locals_size);
+
+	std::memcpy(m_arena.get() + m_capacity - other.m_captures_size,
+		    other.m_arena.get() + other.m_capacity - other.m_captures_size,
+		    sizeof(double) * other.m_captures_size);
+
+	m_locals_size = other.m_locals_size;
+	m_captures_size = other.m_captures_size;
+	m_frame = other.m_frame;
+	m_frames = other.m_frames;
     }
 
     ////////////////////////////////////////
@@ -68,31 +202,60 @@ public:
 
     Size get_frame_size() const
     {
-	return { m_locals.get_frame_size(),
-		 m_captures.get_frame_size() };
+	return { m_locals_size - m_frame.locals_start,
+		 m_captures_size - m_frame.captures_start };
     }
 
     Size get_stack_size() const
     {
-	return { m_locals.get_stack_size(), m_captures.get_stack_size() };
+	return { m_locals_size, m_captures_size };
+    }
+
+    // The bytes taken up by the values and the frame records
+    std::size_t get_used_bytes() const
+    {
+	return sizeof(double) * static_cast<std::size_t>(m_locals_size + m_captures_size)
+	     + sizeof(Frame) * static_cast<std::size_t>(get_num_frames());
     }
 
+    // The limit is max_size values' worth of bytes.  Frame records count
+    // towards it too, since a function with no parameters can recurse
+    // without pushing any values.
     bool check_stack_size(int max_size) const
     {
-	return m_locals.get_stack_size() < max_size
-	    && m_captures.get_stack_size() < max_size;
+	return get_used_bytes() < sizeof(double) * static_cast<std::size_t>(max_size);
     }
 
     int get_capture_frame_start() const
     {
-	return m_captures.get_frame_start();
+	return m_frame.captures_start;
+    }
+
+    int get_local_frame_start() const
+    {
+	return m_frame.locals_start;
     }
 
     int get_num_frames() const
     {
-	assert(m_locals.get_num_frames() == m_captures.get_num_frames());
+	// m_frame counts as a frame
+	return static_cast<int>(m_frames.size() + 1);
+    }
+
+    int get_capacity() const
+    {
+	return m_capacity;
+    }
 
-	return m_locals.get_num_frames();
+    Size get_peak_size() const
+    {
+	return { std::max(m_peak.locals, m_locals_size),
+		 std::max(m_peak.captures, m_captures_size) };
+    }
+
+    int get_peak_frames() const
+    {
+	return m_peak_frames;
     }
 
     ////////////////////////////////////////
@@ -104,17 +267,25 @@ public:
 
     double operator[](int stack_offset) const
     {
-	return m_locals[stack_offset];
+	assert(m_frame.locals_start + stack_offset >= 0);
+	assert(m_frame.locals_start + stack_offset < m_locals_size);
+
+	return m_arena[m_frame.locals_start + stack_offset];
     }
 
     double &operator[](int stack_offset)
     {
-	return m_locals[stack_offset];
+	assert(m_frame.locals_start + stack_offset >= 0);
+	assert(m_frame.locals_start + stack_offset < m_locals_size);
+
+	return m_arena[m_frame.locals_start + stack_offset];
     }
 
     double read_global(int stack_offset) const
     {
-	return m_locals.read_global(stack_offset);
+	assert(stack_offset >= 0 && stack_offset < m_locals_size);
+
+	return m_arena[stack_offset];
     }
 
     int get_closure_position() const
@@ -122,7 +293,7 @@ public:
 	// The closure object, when it can be accessed, is always stored just
 	// before the current frame.
 
-	double pos = m_locals[-1];
+	double pos = (*this)[-1];
 
 	assert(pos >= 0);
 	assert(std::fmod(pos, 1.0) == 0.0);
@@ -134,7 +305,20 @@ public:
     {
 	auto position = get_closure_position() + capture_offset;
 
-	return m_captures.read_global(position);
+	assert(position >= 0 && position < m_captures_size);
+
+	return get_captures_base()[-position];
+    }
+
+    // A value in the frame that the current closure was created in.  The
+    // start of that frame is the first value of the closure.
+    double read_enclosing(int stack_offset) const
+    {
+	auto position = static_cast<int>(read_capture(0)) + stack_offset;
+
+	assert(position >= 0 && position < m_locals_size);
+
+	return m_arena[position];
     }
 
     ////////////////////////////////////////
@@ -143,8 +327,11 @@ public:
 
     void push_frame()
     {
-	m_locals.push_frame();
-	m_captures.push_frame();
+	m_frames.push_back(m_frame);
+
+	m_frame = { m_locals_size, m_captures_size };
+
+	note_peak_frames();
     }
 
     // This supports calling functions with more arguments than the expected
@@ -152,62 +339,187 @@ public:
     // a large argument could be chopped in two!
     void push_frame(const Size &args, const Size &params)
     {
-	m_locals.push_frame(args.locals, params.locals);
-	m_captures.push_frame(args.captures, params.captures);
+	assert(args.locals >= 0 && args.captures >= 0);
+	assert(params.locals >= 0 && params.captures >= 0);
+	assert(params.locals <= args.locals);
+	assert(params.captures <= args.captures);
+	assert(m_locals_size - args.locals >= m_frame.locals_start);
+	assert(m_captures_size - args.captures >= m_frame.captures_start);
+
+	m_frames.push_back(m_frame);
+
+	m_frame = { m_locals_size - args.locals,
+		    m_captures_size - args.captures };
+
+	m_locals_size = m_frame.locals_start + params.locals;
+	m_captures_size = m_frame.captures_start + params.captures;
+
+	note_peak_frames();
     }
 
     Size pop_frame()
     {
-	auto locals = m_locals.pop_frame();
-	auto captures = m_captures.pop_frame();
+	assert(!m_frames.empty());
+
+	note_peak();
+
+	auto size = get_frame_size();
+
+	m_locals_size = m_frame.locals_start;
+	m_captures_size = m_frame.captures_start;
+
+	m_frame = m_frames.back();
+
+	m_frames.pop_back();
+
+	return size;
+    }
+
+    // For tail calls: the current frame, along with the 'below' values just
+    // beneath it, is replaced by the top 'size' values of the frame (the
+    // arguments of the new call).  The frame must have no captures.
+    void replace_frame(int size, int below)
+    {
+	assert(!m_frames.empty());
+	assert(size >= 0 && below >= 0);
+	assert(m_locals_size - size >= m_frame.locals_start);
+	assert(m_captures_size == m_frame.captures_start);
+
+	note_peak();
+
+	int dest = m_frame.locals_start - below;
+
+	assert(dest >= m_frames.back().locals_start);
 
-	return Size{ locals, captures };
+	std::memmove(m_arena.get() + dest,
+		     m_arena.get() + m_locals_size - size,
+		     sizeof(double) * size);
+
+	m_locals_size = dest + size;
+
+	m_frame = m_frames.back();
+
+	m_frames.pop_back();
     }
 
     void push(double val)
     {
-	m_locals.push(val);
+	ensure_room(1);
+
+	m_arena[m_locals_size++] = val;
     }
 
     void push_capture(double val)
     {
-	m_captures.push(val);
+	ensure_room(1);
+
+	get_captures_base()[-m_captures_size++] = val;
     }
 
     void pop(const Size &size)
     {
-	m_locals.pop(size.locals);
-	m_captures.pop(size.captures);
+	assert(size.locals >= 0 && size.captures >= 0);
+	assert(m_frame.locals_start + size.locals <= m_locals_size);
+	assert(m_frame.captures_start + size.captures <= m_captures_size);
+
+	note_peak();
+
+	m_locals_size -= size.locals;
+	m_captures_size -= size.captures;
     }
 
     ////////////////////////////////////////
     // Debugging
     ////////////////////////////////////////
 
-    FrameStack<double>::Scanner get_locals_scanner() const
+    // Walks either the locals or the captures, in push order, noting where
+    // each frame starts.
+    class Scanner
+    {
+	friend class EngineStack;
+
+	const EngineStack &stack;
+
+	const bool captures;
+
+	int position = 0;
+	size_t frame = 0;
+
+	Scanner(const EngineStack &stack, bool captures)
+	    : stack(stack), captures(captures)
+	{
+	}
+
+	int get_size() const
+	{
+	    return captures ? stack.m_captures_size : stack.m_locals_size;
+	}
+
+	int get_start(const Frame &f) const
+	{
+	    return captures ? f.captures_start : f.locals_start;
+	}
+
+    public:
+	bool more() const
+	{
+	    return frame < stack.m_frames.size()
+		|| position < get_size();
+	}
+
+	void next()
+	{
+	    if(is_outer_frame())
+		++frame;
+	    else if(position < get_size())
+		++position;
+	}
+
+	double operator*() const
+	{
+	    return captures ? stack.get_captures_base()[-position]
+			    : stack.m_arena[position];
+	}
+
+	// Note: when is_outer_frame() is true, calling next() only advances the
+	// frame position to the next frame, and not the stack position.  This
+	// is because there can be multiple frames at the same position.
+	bool is_outer_frame() const
+	{
+	    return frame < stack.m_frames.size()
+		&& position == get_start(stack.m_frames[frame]);
+	}
+
+	bool is_current_frame() const
+	{
+	    return position == get_start(stack.m_frame);
+	}
+    };
+
+    Scanner get_locals_scanner() const
     {
-	return m_locals.get_stack_scanner();
+	return Scanner{*this, false};
     }
 
-    FrameStack<double>::Scanner get_captures_scanner() const
+    Scanner get_captures_scanner() const
     {
-	return m_captures.get_stack_scanner();
+	return Scanner{*this, true};
     }
 
     bool global_object_exists(int offset, int size)
     {
-	return m_locals.get_stack_size() >= offset + size;
+	return m_locals_size >= offset + size;
     }
 
     bool local_object_exists(int offset, int size)
     {
-	return m_locals.get_frame_size() >= offset + size;
+	return get_frame_size().locals >= offset + size;
     }
 
     bool captured_object_exists(int offset, int size)
     {
-	auto closure_position = m_locals[-1];
+	auto closure_position = (*this)[-1];
 		
-	return m_captures.get_stack_size() >= closure_position + offset + size;
+	return m_captures_size >= closure_position + offset + size;
     }
 };
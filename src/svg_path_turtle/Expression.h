@@ -24,6 +24,219 @@
 
 #pragma once
 
-#include <functional>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
 
-using Expr = std::function<double()>;
+///////////////////////////////////////////////////////////////////////////////
+//
+// Expr - a compiled expression
+//
+//   - An Expr is a flat postfix program.  ExecutionEngine::eval() runs it with
+//     a small value stack, so evaluating an expression is a single tight
+//     loop rather than a tree of nested std::function calls.
+//
+//   - Every Expr leaves exactly one value on the stack.  Its maximum stack
+//     depth is computed as it is built, so eval() can usually use a fixed
+//     size array.
+//
+//   - Jumps (for ?:) are relative, so Expr objects can be concatenated
+//     without any fixups.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+enum class ExprOp : std::uint8_t
+{
+    // Leaves - these push one value
+
+    constant,           // value
+    read_local,         // offset
+    read_global,        // offset
+    read_capture,       // offset
+    read_enclosing,     // offset
+    read_param,         // offset (the index of the param)
+    turtle_x,
+    turtle_y,
+    turtle_dir,
+    unique,
+
+    // Prefix ops
+
+    negate,
+    logical_not,
+
+    // Binary ops
+
+    add,
+    subtract,
+    multiply,
+    divide,
+    power,
+    equal,
+    not_equal,
+    less,
+    greater,
+    less_equal,
+    greater_equal,
+    logical_or,
+    logical_and,
+
+    // Control flow, for ?: (offset is relative to the jump instruction)
+
+    jump_if_false,      // pops the condition
+    jump,
+};
+
+///////////////////////////////////////////////////////////////////////
+// Operator semantics - shared by constant folding and by eval()
+///////////////////////////////////////////////////////////////////////
+
+template<ExprOp op>
+inline double prefix_op(double rhs);
+
+template<> inline double prefix_op<ExprOp::negate     >(double rhs) { return -rhs; }
+template<> inline double prefix_op<ExprOp::logical_not>(double rhs) { return rhs ? 0 : 1; }
+
+template<ExprOp op>
+inline double binary_op(double lhs, double rhs);
+
+template<> inline double binary_op<ExprOp::add          >(double lhs, double rhs) { return lhs + rhs; };
+template<> inline double binary_op<ExprOp::subtract     >(double lhs, double rhs) { return lhs - rhs; };
+template<> inline double binary_op<ExprOp::multiply     >(double lhs, double rhs) { return lhs * rhs; };
+template<> inline double binary_op<ExprOp::divide       >(double lhs, double rhs) { return lhs / rhs; };
+template<> inline double binary_op<ExprOp::power        >(double lhs, double rhs) { return std::pow(lhs, rhs); };
+template<> inline double binary_op<ExprOp::equal        >(double lhs, double rhs) { return lhs == rhs ? 1.0 : 0.0; };
+template<> inline double binary_op<ExprOp::not_equal    >(double lhs, double rhs) { return lhs != rhs ? 1.0 : 0.0; };
+template<> inline double binary_op<ExprOp::less         >(double lhs, double rhs) { return lhs < rhs ? 1.0 : 0.0; };
+template<> inline double binary_op<ExprOp::greater      >(double lhs, double rhs) { return lhs > rhs ? 1.0 : 0.0; };
+template<> inline double binary_op<ExprOp::less_equal   >(double lhs, double rhs) { return lhs <= rhs ? 1.0 : 0.0; };
+template<> inline double binary_op<ExprOp::greater_equal>(double lhs, double rhs) { return lhs >= rhs ? 1.0 : 0.0; };
+
+// Note: &&/|| could short-circuit, but this seems low priority since this
+// language does not currently have user-defined functions that return values.
+template<> inline double binary_op<ExprOp::logical_or   >(double lhs, double rhs) { return lhs ? lhs : (rhs ? rhs : 0.0); };
+template<> inline double binary_op<ExprOp::logical_and  >(double lhs, double rhs) { return (lhs && rhs) ? rhs : 0.0; };
+
+///////////////////////////////////////////////////////////////////////
+// Expr
+///////////////////////////////////////////////////////////////////////
+
+struct ExprInstruction
+{
+    ExprOp op;
+    int offset = 0;
+    double value = 0.0;
+};
+
+class Expr
+{
+    std::vector<ExprInstruction> m_code;
+
+    int m_max_depth = 0;
+
+    void append(const Expr &e)
+    {
+	m_code.insert(m_code.end(), e.m_code.begin(), e.m_code.end());
+    }
+
+    void append(ExprOp op, int offset = 0)
+    {
+	m_code.push_back({ .op = op, .offset = offset });
+    }
+
+public:
+    Expr() = default;
+
+    explicit operator bool() const
+    {
+	return !m_code.empty();
+    }
+
+    const ExprInstruction *begin() const
+    {
+	return m_code.data();
+    }
+
+    const ExprInstruction *end() const
+    {
+	return m_code.data() + m_code.size();
+    }
+
+    size_t size() const
+    {
+	return m_code.size();
+    }
+
+    int get_max_depth() const
+    {
+	return m_max_depth;
+    }
+
+    bool is_single(ExprOp op) const
+    {
+	return m_code.size() == 1 && m_code[0].op == op;
+    }
+
+    ////////////////////////////////////////
+    // Building
+    ////////////////////////////////////////
+
+    static Expr leaf(ExprOp op, int offset = 0)
+    {
+	Expr e;
+
+	e.append(op, offset);
+	e.m_max_depth = 1;
+
+	return e;
+    }
+
+    static Expr constant(double val)
+    {
+	Expr e = leaf(ExprOp::constant);
+
+	e.m_code.back().value = val;
+
+	return e;
+    }
+
+    static Expr prefix(ExprOp op, const Expr &rhs)
+    {
+	Expr e = rhs;
+
+	e.append(op);
+
+	return e;
+    }
+
+    static Expr binary(ExprOp op, const Expr &lhs, const Expr &rhs)
+    {
+	Expr e = lhs;
+
+	e.append(rhs);
+	e.append(op);
+
+	e.m_max_depth = std::max(lhs.m_max_depth, 1 + rhs.m_max_depth);
+
+	return e;
+    }
+
+    // As with the original std::function implementation, only the selected
+    // branch is evaluated.
+    static Expr conditional(const Expr &cond, const Expr &lhs, const Expr &rhs)
+    {
+	Expr e = cond;
+
+	e.append(ExprOp::jump_if_false, static_cast<int>(lhs.size()) + 2);
+	e.append(lhs);
+	e.append(ExprOp::jump, static_cast<int>(rhs.size()) + 1);
+	e.append(rhs);
+
+	e.m_max_depth = std::max({ cond.m_max_depth,
+				   lhs.m_max_depth,
+				   rhs.m_max_depth });
+
+	return e;
+    }
+};
@@ -26,14 +26,18 @@
 
 #include <fstream>
 #include <memory>
+#include <vector>
+#include <algorithm>
 #include <cstring>
+#include <cstdlib>
 
 template<class STREAM>
-static std::unique_ptr<STREAM> open_file(const std::string &filename)
+static std::unique_ptr<STREAM> open_file(const std::string &filename,
+					 std::ios_base::openmode mode)
 {
     auto p = std::make_unique<STREAM>();
 
-    p->open(filename);
+    p->open(filename, mode);
 
     if(p->fail())
     {
@@ -44,26 +48,163 @@ static std::unique_ptr<STREAM> open_file(const std::string &filename)
     return p;
 }
 
-Infile::Infile(const std::string &filename)
+Infile::Infile(const std::string &filename, bool binary)
 {
     if(filename.empty() || filename == "-")
 	m_ptr = &std::cin;
     else
     {
-	m_file = open_file<std::ifstream>(filename);
+	m_file = open_file<std::ifstream>(filename,
+					  binary ? std::ios::in | std::ios::binary
+						 : std::ios::in);
 
 	m_ptr = m_file.get();
     }
 }
 
-Outfile::Outfile(const std::string &filename)
+//////////////////////////////////////////////////////////////////////////////
+// OutputBuffer
+//////////////////////////////////////////////////////////////////////////////
+
+static std::vector<OutputBuffer *> s_live_buffers;
+
+static void flush_live_buffers()
+{
+    for(auto *buf : s_live_buffers)
+	buf->flush();
+}
+
+OutputBuffer::OutputBuffer(std::FILE *file, bool owns_file)
+    : m_file(file)
+    , m_owns_file(owns_file)
+    , m_buffer(std::make_unique<char[]>(buffer_size))
+    , m_last_flush(std::chrono::steady_clock::now())
+{
+    setp(m_buffer.get(), m_buffer.get() + buffer_size);
+
+    static bool registered = (std::atexit(flush_live_buffers) == 0);
+    (void)registered;
+
+    s_live_buffers.push_back(this);
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    flush();
+
+    std::erase(s_live_buffers, this);
+
+    if(m_owns_file)
+	std::fclose(m_file);
+}
+
+// The end of the put area, for when 'pending' bytes are already in the
+// buffer.  overflow() gets called when it is reached.
+size_t OutputBuffer::get_put_limit(size_t pending) const
+{
+    if(!m_streaming)
+	return buffer_size;
+
+    if(m_flush_interval.count() == 0)
+	return m_high_water_mark;
+
+    return std::min(pending + interval_check_size, m_high_water_mark);
+}
+
+bool OutputBuffer::write_out()
+{
+    size_t size = pptr() - pbase();
+
+    setp(m_buffer.get(), m_buffer.get() + get_put_limit(0));
+
+    m_bytes_written += size;
+
+    return size == 0 || std::fwrite(m_buffer.get(), 1, size, m_file) == size;
+}
+
+OutputBuffer::int_type OutputBuffer::overflow(int_type ch)
+{
+    if(m_streaming)
+    {
+	size_t pending = pptr() - pbase();
+
+	if(pending < m_high_water_mark
+	   && std::chrono::steady_clock::now() - m_last_flush < m_flush_interval)
+	{
+	    // Not yet - just make room for some more.
+	    setp(m_buffer.get(), m_buffer.get() + get_put_limit(pending));
+	    pbump(static_cast<int>(pending));
+	}
+	else if(!flush())
+	    return traits_type::eof();
+    }
+    else if(!write_out())
+	return traits_type::eof();
+
+    if(!traits_type::eq_int_type(ch, traits_type::eof()))
+	return sputc(traits_type::to_char_type(ch));
+
+    return traits_type::not_eof(ch);
+}
+
+// Only tells the position (as tellp() does), which is what has been
+// produced so far.
+OutputBuffer::pos_type OutputBuffer::seekoff(off_type off,
+					     std::ios_base::seekdir dir,
+					     std::ios_base::openmode which)
+{
+    if(off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::out))
+	return pos_type(off_type(-1));
+
+    return pos_type(static_cast<off_type>(get_bytes_emitted()));
+}
+
+int OutputBuffer::sync()
+{
+    return flush() ? 0 : -1;
+}
+
+bool OutputBuffer::flush()
+{
+    m_last_flush = std::chrono::steady_clock::now();
+
+    return write_out() && std::fflush(m_file) == 0;
+}
+
+void OutputBuffer::set_streaming(size_t high_water_mark,
+				 std::chrono::milliseconds flush_interval)
+{
+    m_streaming = true;
+    m_high_water_mark = std::clamp<size_t>(high_water_mark, 1, buffer_size);
+    m_flush_interval = flush_interval;
+
+    // Whatever is already buffered goes out now, and the put area shrinks
+    // to the new limit.
+    flush();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Outfile
+//////////////////////////////////////////////////////////////////////////////
+
+Outfile::Outfile(const std::string &filename, bool binary)
 {
     if(filename.empty() || filename == "-")
-	m_ptr = &std::cout;
+	m_buffer = std::make_unique<OutputBuffer>(stdout, false);
     else
     {
-	m_file = open_file<std::ofstream>(filename);
+	auto *file = std::fopen(filename.c_str(), binary ? "wb" : "w");
 
-	m_ptr = m_file.get();
+	if(!file)
+	{
+	    std::cerr << filename << ": " << strerror(errno) << '\n';
+	    exit(1);
+	}
+
+	m_buffer = std::make_unique<OutputBuffer>(file, true);
     }
+
+    m_stream = std::make_unique<std::ostream>(m_buffer.get());
+
+    m_ptr = m_stream.get();
 }
@@ -26,6 +26,9 @@
 
 #include <iostream>
 #include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
 
 // The Infile and Outfile classes simplify working with std::cin and std::cout
 // or with actual files.
@@ -37,7 +40,7 @@ class Infile
     std::istream *m_ptr = nullptr;
 
 public:
-    Infile(const std::string &filename);
+    explicit Infile(const std::string &filename, bool binary = false);
 
     operator std::istream &()
     {
@@ -50,14 +53,84 @@ public:
     }
 };
 
+// OutputBuffer is a std::streambuf that gathers output into one large
+// buffer, and hands it to a FILE with a single fwrite() when it fills up.
+// Writing a character (e.g. OstreamTurtle's sputc() calls) is then just a
+// store, with no sentry, locale or per-character stdio work.
+//
+// Live buffers are also flushed by exit(), which the error paths use.
+//
+// In streaming mode (see set_streaming()), the buffer is instead written out
+// and flushed whenever it holds high_water_mark bytes, or when output is
+// produced more than flush_interval after the previous flush.  That keeps
+// what is held back small, so that a downstream reader can consume the
+// output while the program is still running.
+
+class OutputBuffer : public std::streambuf
+{
+    static constexpr size_t buffer_size = 256 * 1024;
+
+    // In streaming mode with a flush interval, the clock is checked each time
+    // this much more output has been produced.
+    static constexpr size_t interval_check_size = 4 * 1024;
+
+    std::FILE *m_file;
+    bool m_owns_file;
+
+    std::unique_ptr<char[]> m_buffer;
+
+    bool m_streaming = false;
+    size_t m_high_water_mark = buffer_size;
+    std::chrono::milliseconds m_flush_interval{0};
+    std::chrono::steady_clock::time_point m_last_flush;
+
+    std::uint64_t m_bytes_written = 0;
+
+    size_t get_put_limit(size_t pending) const;
+
+    bool write_out();
+
+protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+
+    pos_type seekoff(off_type off,
+		     std::ios_base::seekdir dir,
+		     std::ios_base::openmode which) override;
+
+public:
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+    OutputBuffer(std::FILE *file, bool owns_file);
+    ~OutputBuffer();
+
+    bool flush();
+
+    // A flush_interval of zero flushes only at the high water mark, which is
+    // at most buffer_size.
+    void set_streaming(size_t high_water_mark,
+		       std::chrono::milliseconds flush_interval);
+
+    // Everything produced so far, including what is still in the buffer.
+    std::uint64_t get_bytes_emitted() const
+    {
+	return m_bytes_written + (pptr() - pbase());
+    }
+};
+
+// Outfile writes stdout through an OutputBuffer too, rather than std::cout,
+// so nothing else should write to std::cout while one is open.
+
 class Outfile
 {
-    std::unique_ptr<std::ofstream> m_file;
+    std::unique_ptr<OutputBuffer> m_buffer;
+    std::unique_ptr<std::ostream> m_stream;
 
     std::ostream *m_ptr = nullptr;
 
 public:
-    Outfile(const std::string &filename);
+    explicit Outfile(const std::string &filename, bool binary = false);
 
     operator std::ostream &()
     {
@@ -68,5 +141,10 @@ public:
     {
 	return m_ptr;
     }
+
+    OutputBuffer &get_buffer()
+    {
+	return *m_buffer;
+    }
 };
 
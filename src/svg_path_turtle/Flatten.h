@@ -0,0 +1,285 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "MathUtil.h"
+#include "PathCommand.h"
+
+#include <algorithm>
+#include <cmath>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Flattening curves into lines, for whatever draws them as polygons (see
+// PathRasterizer), or wants polylines (see PolylineWriter)
+//
+//   Each function calls line_to(x, y) for the points after p0, ending with
+//   exactly p1 (or p2, p3), so that no point of the curve is further than
+//   'tolerance' from the lines.
+//
+//   The subdivision is adaptive: a Bezier curve is split in half until each
+//   half is within the tolerance of its chord, and an arc gets more points
+//   where it bends more tightly.  So the gentle parts of a curve get few
+//   points, and the tight parts enough.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+using CurvePoint = PathPoint;
+
+namespace flatten_detail
+{
+    // A Bezier curve is split no more than this many times over, however
+    // far it is from its chord (which only a huge or broken one would be).
+    constexpr int max_depth = 16;
+
+    // Nor is an arc's quarter split into more lines than this.
+    constexpr double max_arc_segments = 10000.0;
+
+    inline CurvePoint midpoint(CurvePoint a, CurvePoint b)
+    {
+	return { (a.x + b.x) / 2, (a.y + b.y) / 2 };
+    }
+
+    inline double length2(double x, double y)
+    {
+	return x*x + y*y;
+    }
+
+    // Flat enough, or not a number (so that NaNs don't subdivide forever).
+    // Squared distances are compared, as std::hypot() is slow.
+    inline bool is_flat(double distance2, double tolerance, int depth)
+    {
+	return !(distance2 > tolerance * tolerance) || depth == max_depth;
+    }
+
+    // Each test is how far the curve's point at t can be from the chord's
+    // point at t (p0 + t * (p2 - p0)), which no point of the curve is
+    // nearer the chord than.  The halves are found with de Casteljau's
+    // construction at t = 1/2.
+
+    // For a quadratic, that's 2t(1-t) times p1's distance from the middle
+    // of the chord, at most half of it.
+    template<typename LineTo>
+    void subdivide_quadratic(CurvePoint p0, CurvePoint p1, CurvePoint p2,
+			     double tolerance, int depth, LineTo &line_to)
+    {
+	double distance2 = length2(p1.x - (p0.x + p2.x) / 2,
+				   p1.y - (p0.y + p2.y) / 2) / 4;
+
+	if(is_flat(distance2, tolerance, depth))
+	{
+	    line_to(p2.x, p2.y);
+	    return;
+	}
+
+	CurvePoint p01 = midpoint(p0, p1);
+	CurvePoint p12 = midpoint(p1, p2);
+	CurvePoint mid = midpoint(p01, p12);
+
+	subdivide_quadratic(p0, p01, mid, tolerance, depth + 1, line_to);
+	subdivide_quadratic(mid, p12, p2, tolerance, depth + 1, line_to);
+    }
+
+    // For a cubic, it's 3t(1-t) times a blend of p1's and p2's distances
+    // from the points a third and two thirds of the way along the chord, at
+    // most 3/4 of the larger.
+    template<typename LineTo>
+    void subdivide_cubic(CurvePoint p0, CurvePoint p1,
+			 CurvePoint p2, CurvePoint p3,
+			 double tolerance, int depth, LineTo &line_to)
+    {
+	double u2 = length2(p1.x - (2*p0.x + p3.x) / 3,
+			    p1.y - (2*p0.y + p3.y) / 3);
+
+	double v2 = length2(p2.x - (p0.x + 2*p3.x) / 3,
+			    p2.y - (p0.y + 2*p3.y) / 3);
+
+	if(is_flat(std::max(u2, v2) * (9.0 / 16.0), tolerance, depth))
+	{
+	    line_to(p3.x, p3.y);
+	    return;
+	}
+
+	CurvePoint p01 = midpoint(p0, p1);
+	CurvePoint p12 = midpoint(p1, p2);
+	CurvePoint p23 = midpoint(p2, p3);
+	CurvePoint p012 = midpoint(p01, p12);
+	CurvePoint p123 = midpoint(p12, p23);
+	CurvePoint mid = midpoint(p012, p123);
+
+	subdivide_cubic(p0, p01, p012, mid, tolerance, depth + 1, line_to);
+	subdivide_cubic(mid, p123, p23, p3, tolerance, depth + 1, line_to);
+    }
+}
+
+template<typename LineTo>
+void flatten_quadratic(CurvePoint p0, CurvePoint p1, CurvePoint p2,
+		       double tolerance, LineTo &&line_to)
+{
+    flatten_detail::subdivide_quadratic(p0, p1, p2, tolerance, 0, line_to);
+}
+
+template<typename LineTo>
+void flatten_cubic(CurvePoint p0, CurvePoint p1, CurvePoint p2, CurvePoint p3,
+		   double tolerance, LineTo &&line_to)
+{
+    flatten_detail::subdivide_cubic(p0, p1, p2, p3, tolerance, 0, line_to);
+}
+
+// An SVG arc (A rx ry rotation large_arc sweep x y), converted to its center
+// and angles as in the SVG spec's implementation notes.  A radius of zero
+// makes it a line.
+template<typename LineTo>
+void flatten_arc(CurvePoint p0, double rx, double ry, double rotation,
+		 bool large_arc, bool sweep, CurvePoint p1,
+		 double tolerance, LineTo &&line_to)
+{
+    rx = std::abs(rx);
+    ry = std::abs(ry);
+
+    if(rx == 0 || ry == 0 || (p0.x == p1.x && p0.y == p1.y))
+    {
+	line_to(p1.x, p1.y);
+	return;
+    }
+
+    double sin_phi, cos_phi;
+
+    sinCosD(rotation, sin_phi, cos_phi);
+
+    double dx2 = (p0.x - p1.x) / 2;
+    double dy2 = (p0.y - p1.y) / 2;
+
+    double x1 =  cos_phi * dx2 + sin_phi * dy2;
+    double y1 = -sin_phi * dx2 + cos_phi * dy2;
+
+    // Radii that are too small are scaled up, just enough.
+    double lambda = (x1*x1) / (rx*rx) + (y1*y1) / (ry*ry);
+
+    if(lambda > 1)
+    {
+	rx *= std::sqrt(lambda);
+	ry *= std::sqrt(lambda);
+    }
+
+    double num = rx*rx*ry*ry - rx*rx*y1*y1 - ry*ry*x1*x1;
+    double den = rx*rx*y1*y1 + ry*ry*x1*x1;
+
+    double coef = std::sqrt(std::max(0.0, num / den));
+
+    if(large_arc == sweep)
+	coef = -coef;
+
+    double cx1 =  coef * rx * y1 / ry;
+    double cy1 = -coef * ry * x1 / rx;
+
+    double cx = cos_phi * cx1 - sin_phi * cy1 + (p0.x + p1.x) / 2;
+    double cy = sin_phi * cx1 + cos_phi * cy1 + (p0.y + p1.y) / 2;
+
+    double theta1 = std::atan2((y1 - cy1) / ry, (x1 - cx1) / rx);
+    double theta2 = std::atan2((-y1 - cy1) / ry, (-x1 - cx1) / rx);
+
+    double sweep_angle = theta2 - theta1;
+
+    if(sweep && sweep_angle < 0)
+	sweep_angle += 2 * PI;
+    else if(!sweep && sweep_angle > 0)
+	sweep_angle -= 2 * PI;
+
+    // The arc is taken a quarter of the ellipse at a time (between its
+    // axes), since the distance from the center only grows, or only
+    // shrinks, along a quarter.  That distance is also how sharply the
+    // point turns with the angle, so a chord spanning an angle h is within
+    // h^2/8 times the larger of its ends' distances of the arc.
+    auto point_at = [&](double theta)
+    {
+	double c = std::cos(theta);
+	double s = std::sin(theta);
+
+	return CurvePoint{ cx + rx * cos_phi * c - ry * sin_phi * s,
+			   cy + rx * sin_phi * c + ry * cos_phi * s };
+    };
+
+    auto distance_at = [&](double theta)
+    {
+	return std::hypot(rx * std::cos(theta), ry * std::sin(theta));
+    };
+
+    constexpr double quarter = PI / 2;
+
+    double end_angle = theta1 + sweep_angle;
+
+    if(!std::isfinite(end_angle))
+    {
+	line_to(p1.x, p1.y);
+	return;
+    }
+
+    // The axes are at multiples of a quarter turn.
+    int step = sweep_angle > 0 ? 1 : -1;
+
+    double axis = step > 0 ? std::floor(theta1 / quarter) + 1
+			   : std::ceil(theta1 / quarter) - 1;
+
+    for(double a0 = theta1; ; axis += step)
+    {
+	double a1 = axis * quarter;
+
+	bool last = step > 0 ? a1 >= end_angle : a1 <= end_angle;
+
+	if(last)
+	    a1 = end_angle;
+
+	double h = std::abs(a1 - a0);
+	double d = std::max(distance_at(a0), distance_at(a1));
+
+	double n = std::ceil(h * std::sqrt(d / (8 * tolerance)));
+
+	int segments = static_cast<int>(
+		    std::clamp(n, 1.0, flatten_detail::max_arc_segments));
+
+	for(int i = 1; i < segments; ++i)
+	{
+	    CurvePoint pt = point_at(a0 + (a1 - a0) * i / segments);
+
+	    line_to(pt.x, pt.y);
+	}
+
+	if(last)
+	    break;
+
+	// (An axis that the arc only grazes adds no point.)
+	if(h > 1e-9)
+	{
+	    CurvePoint pt = point_at(a1);
+
+	    line_to(pt.x, pt.y);
+	}
+
+	a0 = a1;
+    }
+
+    line_to(p1.x, p1.y);
+}
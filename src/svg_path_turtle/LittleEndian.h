@@ -0,0 +1,79 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <streambuf>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// The binary formats' values (see BinaryPath.h and Polyline.h) are stored
+// little-endian, whatever the host is.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+template<class T>
+void to_little_endian(T val, char *bytes)
+{
+    std::memcpy(bytes, &val, sizeof(val));
+
+    if constexpr(std::endian::native == std::endian::big)
+	std::reverse(bytes, bytes + sizeof(val));
+}
+
+template<class T>
+T from_little_endian(char *bytes)
+{
+    if constexpr(std::endian::native == std::endian::big)
+	std::reverse(bytes, bytes + sizeof(T));
+
+    T val;
+
+    std::memcpy(&val, bytes, sizeof(val));
+
+    return val;
+}
+
+// On a little-endian host, the values are written as they are, in one go.
+template<class T>
+void write_little_endian(std::streambuf &out, const T *values, size_t count)
+{
+    if constexpr(std::endian::native == std::endian::little)
+	out.sputn(reinterpret_cast<const char *>(values),
+		  static_cast<std::streamsize>(count * sizeof(T)));
+    else
+	for(size_t i = 0; i < count; ++i)
+	{
+	    char bytes[sizeof(T)];
+
+	    to_little_endian(values[i], bytes);
+
+	    out.sputn(bytes, sizeof(T));
+	}
+}
@@ -30,16 +30,70 @@
 inline constexpr double PI = std::numbers::pi;
 inline constexpr double toRadians = PI / 180.0;
 
+// Multiples of 45 degrees are the angles that most programs use, so sinD()
+// and cosD() look them up, exactly, rather than calling the library
+// functions (which give cos(90) == 6.1e-17, for example).
+namespace math_detail
+{
+    inline constexpr double half_sqrt2 = std::numbers::sqrt2 / 2;
+
+    // The sine of k*45 degrees, and (from k+2) the cosine
+    inline constexpr double sin_eighths[10] =
+    {
+	0, half_sqrt2, 1, half_sqrt2, 0, -half_sqrt2, -1, -half_sqrt2,
+	0, half_sqrt2
+    };
+
+    // Returns k (0..7) if degrees is k*45, plus any multiple of 360, or -1.
+    inline int eighth_turns(double degrees)
+    {
+	double eighths = degrees / 45;
+
+	if(eighths != std::trunc(eighths) || std::abs(eighths) > 1e15)
+	    return -1;
+
+	return (static_cast<int>(std::fmod(eighths, 8)) + 8) % 8;
+    }
+}
+
 inline double sinD(double degrees)
 {
+    int k = math_detail::eighth_turns(degrees);
+
+    if(k >= 0)
+	return math_detail::sin_eighths[k];
+
     return std::sin(degrees * toRadians);
 }
 
 inline double cosD(double degrees)
 {
+    int k = math_detail::eighth_turns(degrees);
+
+    if(k >= 0)
+	return math_detail::sin_eighths[k + 2];
+
     return std::cos(degrees * toRadians);
 }
 
+// Both at once, for a direction
+inline void sinCosD(double degrees, double &s, double &c)
+{
+    int k = math_detail::eighth_turns(degrees);
+
+    if(k >= 0)
+    {
+	s = math_detail::sin_eighths[k];
+	c = math_detail::sin_eighths[k + 2];
+	return;
+    }
+
+    double radians = degrees * toRadians;
+
+    s = std::sin(radians);
+    c = std::cos(radians);
+}
+
 inline double tanD(double degrees)
 {
     return std::tan(degrees * toRadians);
@@ -55,3 +109,8 @@ inline double atanD(double num)
     return std::atan(num) / toRadians;
 }
 
+inline double atan2D(double y, double x)
+{
+    return std::atan2(y, x) / toRadians;
+}
+
@@ -34,22 +34,19 @@ Matrix2d Matrix2d::rotation(double degrees)
     double a = degrees * toRadians;
 
     return { cos(a), -sin(a), 0,
-	     sin(a),  cos(a), 0,
-	     0,       0,      1  };
+	     sin(a),  cos(a), 0  };
 }
 
 Matrix2d Matrix2d::scaling(double x, double y)
 {
     return { x, 0, 0,
-	     0, y, 0,
-	     0, 0, 1  };
+	     0, y, 0  };
 }
 
 Matrix2d Matrix2d::shearing(double x, double y)
 {
     return { 1, x, 0,
-	     y, 1, 0,
-	     0, 0, 1  };
+	     y, 1, 0  };
 }
 
 Matrix2d Matrix2d::reflection(double x, double y)
@@ -57,15 +54,13 @@ Matrix2d Matrix2d::reflection(double x, double y)
     double l2 = x*x + y*y;
 
     return { (x*x-y*y)/l2, (2*x*y)/l2,   0,
-	     (2*x*y)/l2,   (y*y-x*x)/l2, 0,
-	     0,            0,            1 };
+	     (2*x*y)/l2,   (y*y-x*x)/l2, 0 };
 }
 
 Matrix2d Matrix2d::translation(double x, double y)
 {
     return { 1, 0, x,
-	     0, 1, y,
-	     0, 0, 1 };
+	     0, 1, y };
 }
 
 Matrix2d &Matrix2d::rotate(double degrees)
@@ -102,3 +97,4 @@ Matrix2d &Matrix2d::translate(double x, double y)
     
     return *this;
 }
+
@@ -24,36 +24,56 @@
 
 #pragma once
 
-// 2d with homogeneous coordinates
+#include <array>
+
+// 2d affine transformations, in homogeneous coordinates.  There are no
+// projective transformations, so the bottom row is always [ 0 0 1 ], and
+// isn't stored.
+//
+// Most points are drawn with no transformation at all, or only a
+// translation, so each matrix knows which kind it is, and apply() only does
+// the work that its kind needs.  The results are the same as those of the
+// full calculation (except, possibly, for the sign of a zero).
 class Matrix2d
 {
-    friend Matrix2d operator*(const Matrix2d &m, const Matrix2d &n);
-    friend Matrix2d operator*(double v, const Matrix2d &m);
-
-    double m_data[9];
+public:
+    enum class Kind:char
+    {
+	identity,
+	translation,
+	general,
+    };
 
-    mutable bool m_determinant_cached = false;
+private:
+    friend Matrix2d operator*(const Matrix2d &m, const Matrix2d &n);
 
-    mutable double m_determinant = 0.0;
-    
     // [ a b c ]
     // [ d e f ]
-    // [ g h i ]
+    // [ 0 0 1 ]
     //
     // is stored as
     //
-    // [ a b c d e f g h i ]
+    // [ a b c d e f ]
+
+    double m_data[6];
+
+    Kind m_kind;
 
     void combine(const Matrix2d &other)
     {
 	*this = other * *this;
-
-	clear_determinant();
     }
 
-    void clear_determinant()
+    static Kind classify(double a, double b, double c,
+			 double d, double e, double f)
     {
-	m_determinant_cached = false;
+	if(a != 1 || b != 0 || d != 0 || e != 1)
+	    return Kind::general;
+
+	if(c != 0 || f != 0)
+	    return Kind::translation;
+
+	return Kind::identity;
     }
 
 public:
@@ -64,18 +84,17 @@ public:
     static Matrix2d translation(double x, double y);
 
     Matrix2d()
-	: Matrix2d{ 1, 0, 0,
-	            0, 1, 0,
-		    0, 0, 1 }
+	: m_data{ 1, 0, 0,
+		  0, 1, 0 }
+	, m_kind(Kind::identity)
     {
     }
 
     Matrix2d(double a, double b, double c,
-	     double d, double e, double f,
-	     double g, double h, double i)
+	     double d, double e, double f)
 	: m_data{a, b, c,
-		 d, e, f,
-		 g, h, i}
+		 d, e, f}
+	, m_kind(classify(a, b, c, d, e, f))
     {
     }
 
@@ -85,6 +104,16 @@ public:
     Matrix2d &reflect(double x, double y);
     Matrix2d &translate(double x, double y);
 
+    Kind get_kind() const
+    {
+	return m_kind;
+    }
+
+    bool is_identity() const
+    {
+	return m_kind == Kind::identity;
+    }
+
     // Note: Passing 0 for z is useful for scaling calculations - it means the
     // translation will not be applied.
     void apply(double &x, double &y, double z = 1) const
@@ -96,46 +125,70 @@ public:
 	const double &e = m_data[4];
 	const double &f = m_data[5];
 
-	// No projective transformations allowed for now.
-	// const double &g = m_data[6];
-	// const double &h = m_data[7];
-	// const double &i = m_data[8];
-
-	double x1 = a*x + b*y + c*z;
-	double y1 = d*x + e*y + f*z;
+	switch(m_kind)
+	{
+	    case Kind::identity:
+		break;
+
+	    case Kind::translation:
+		x += c*z;
+		y += f*z;
+		break;
+
+	    case Kind::general:
+	    {
+		double x1 = a*x + b*y + c*z;
+		double y1 = d*x + e*y + f*z;
+
+		x = x1;
+		y = y1;
+		break;
+	    }
+	}
+    }
 
-	x = x1;
-	y = y1;
+    // The coefficients in the order of SVG's transform="matrix(a b c d e f)",
+    // which goes down the columns: its a c e are the top row here.
+    std::array<double, 6> get_svg_matrix() const
+    {
+	return { m_data[0], m_data[3],
+		 m_data[1], m_data[4],
+		 m_data[2], m_data[5] };
     }
 
     double determinant() const
     {
-	if(!m_determinant_cached)
-	{
-	    const double &a = m_data[0];
-	    const double &b = m_data[1];
-	    const double &c = m_data[2];
-	    const double &d = m_data[3];
-	    const double &e = m_data[4];
-	    const double &f = m_data[5];
-	    const double &g = m_data[6];
-	    const double &h = m_data[7];
-	    const double &i = m_data[8];
-
-	    m_determinant = a*e*i + b*f*g + c*d*h - (c*e*g + a*f*h + b*d*i);
-
-	    m_determinant_cached = true;
-	}
+	const double &a = m_data[0];
+	const double &b = m_data[1];
+	const double &d = m_data[3];
+	const double &e = m_data[4];
+
+	return a*e - b*d;
+    }
 
-	return m_determinant;
+    // An exact comparison
+    bool operator==(const Matrix2d &other) const
+    {
+	for(int i = 0; i < 6; ++i)
+	    if(m_data[i] != other.m_data[i])
+		return false;
+
+	return true;
     }
 };
 
 inline Matrix2d operator*(const Matrix2d &m, const Matrix2d &n)
 {
-    // [a b c]    [a b c]
-    // [d e f] x  [d e f]
-    // [g h i]    [g h i]
+    using Kind = Matrix2d::Kind;
+
+    // Multiplying by the identity is common (push_matrix starts each level
+    // with one), and translations only add up.
+
+    if(m.m_kind == Kind::identity)
+	return n;
+
+    if(n.m_kind == Kind::identity)
+	return m;
 
     const double &ma = m.m_data[0];
     const double &mb = m.m_data[1];
@@ -143,9 +196,6 @@ inline Matrix2d operator*(const Matrix2d &m, const Matrix2d &n)
     const double &md = m.m_data[3];
     const double &me = m.m_data[4];
     const double &mf = m.m_data[5];
-    const double &mg = m.m_data[6];
-    const double &mh = m.m_data[7];
-    const double &mi = m.m_data[8];
 
     const double &na = n.m_data[0];
     const double &nb = n.m_data[1];
@@ -153,36 +203,13 @@ inline Matrix2d operator*(const Matrix2d &m, const Matrix2d &n)
     const double &nd = n.m_data[3];
     const double &ne = n.m_data[4];
     const double &nf = n.m_data[5];
-    const double &ng = n.m_data[6];
-    const double &nh = n.m_data[7];
-    const double &ni = n.m_data[8];
 
-    return {
-	ma*na + mb*nd + mc*ng,  ma*nb + mb*ne + mc*nh,  ma*nc + mb*nf + mc*ni, 
-	md*na + me*nd + mf*ng,  md*nb + me*ne + mf*nh,  md*nc + me*nf + mf*ni, 
-	mg*na + mh*nd + mi*ng,  mg*nb + mh*ne + mi*nh,  mg*nc + mh*nf + mi*ni
-    };
-}
+    // [a b c]    [a b c]
+    // [d e f] x  [d e f]
+    // [0 0 1]    [0 0 1]
 
-inline Matrix2d operator*(double v, const Matrix2d &m)
-{
-    const double &a = m.m_data[0];
-    const double &b = m.m_data[1];
-    const double &c = m.m_data[2];
-    const double &d = m.m_data[3];
-    const double &e = m.m_data[4];
-    const double &f = m.m_data[5];
-    const double &g = m.m_data[6];
-    const double &h = m.m_data[7];
-    const double &i = m.m_data[8];
-
-    return { v*a, v*b, v*c,
-	     v*d, v*e, v*f,
-	     v*g, v*h, v*i
+    return {
+	ma*na + mb*nd,  ma*nb + mb*ne,  ma*nc + mb*nf + mc,
+	md*na + me*nd,  md*nb + me*ne,  md*nc + me*nf + mf
     };
 }
-
-inline Matrix2d operator*(const Matrix2d &a, double v)
-{
-    return v * a;
-}
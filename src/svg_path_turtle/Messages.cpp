@@ -25,6 +25,7 @@
 #include "Messages.h"
 
 #include <iostream>
+#include <sstream>
 
 using std::ostream;
 
@@ -50,10 +51,24 @@ void report_message(ostream &out,
 		    const std::string &label,
 		    const std::string &errmsg)
 {
+    Message message{ where, label, errmsg };
+
+    out << message.to_string() << '\n';
+
+    if(auto *log = dynamic_cast<MessageLog *>(&out))
+	log->add(std::move(message));
+}
+
+std::string Message::to_string() const
+{
+    std::ostringstream out;
+
     report_location(out, where);
 
     if(!label.empty())
 	out << label << ": ";
 
-    out << errmsg << '\n';
+    out << text;
+
+    return out.str();
 }
@@ -27,6 +27,9 @@
 #include "SourceLocation.h"
 
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 struct SourceFileLocation
 {
@@ -40,6 +43,52 @@ struct SourceFileLocation
     }
 };
 
+// A message as a value, for callers that handle them themselves (see
+// TurtleApi.h)
+struct Message
+{
+    SourceFileLocation where;
+
+    std::string label; // "Error", "Warning" or "Info"
+
+    std::string text;
+
+    bool is_error() const
+    {
+	return label == "Error";
+    }
+
+    // As report_message() writes it, without the newline
+    std::string to_string() const;
+};
+
+// Messages are written to an ostream wherever they are reported.  This one
+// also keeps them as values: report_message() adds each message to the log
+// that it writes to.
+class MessageLog : public std::ostream
+{
+    std::stringbuf m_buffer;
+
+    std::vector<Message> m_messages;
+
+public:
+    MessageLog()
+	: std::ostream(nullptr)
+    {
+	rdbuf(&m_buffer);
+    }
+
+    void add(Message message)
+    {
+	m_messages.push_back(std::move(message));
+    }
+
+    const std::vector<Message> &get_messages() const
+    {
+	return m_messages;
+    }
+};
+
 void report_message(std::ostream &out,
 		    const SourceFileLocation &where,
 		    const std::string &label,
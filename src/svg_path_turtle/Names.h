@@ -29,8 +29,13 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include <assert.h>
 
+// An imported function that isn't compiled until it's used (see
+// Parser::defer_fn_definition())
+struct DeferredFnDefinition;
+
 enum class NameType
 {
     Value,
@@ -264,6 +269,12 @@ class Function : public FunctionBase
 {
     std::vector<NameDefinition *> m_captures;
 
+    // The captures that are copied into the closure.  The rest are read
+    // from the frame of the enclosing function, where they already are.
+    std::vector<NameDefinition *> m_copied_captures;
+
+    std::shared_ptr<DeferredFnDefinition> m_deferred;
+
 public:
     explicit Function(std::string name = {})
 	: FunctionBase(NameType::Function, name)
@@ -272,9 +283,12 @@ public:
 
     // Captures
 
-    void add_capture(NameDefinition *capture)
+    void add_capture(NameDefinition *capture, bool copied)
     {
 	m_captures.push_back(capture);
+
+	if(copied)
+	    m_copied_captures.push_back(capture);
     }
 
     bool has_captures() const
@@ -298,6 +312,29 @@ public:
     {
 	return m_captures;
     }
+
+    const std::vector<NameDefinition *> &copied_captures() const
+    {
+	return m_copied_captures;
+    }
+
+    // Deferred definitions
+
+    void set_deferred(std::shared_ptr<DeferredFnDefinition> deferred)
+    {
+	m_deferred = std::move(deferred);
+    }
+
+    // The definition, once it's needed, and only once.
+    std::shared_ptr<DeferredFnDefinition> take_deferred()
+    {
+	return std::move(m_deferred);
+    }
+
+    bool is_deferred() const
+    {
+	return m_deferred != nullptr;
+    }
 };
 
 class LambdaParameter : public FunctionBase
@@ -25,9 +25,13 @@
 #include "Options.h"
 #include "version.h"
 
+#include <algorithm>
 #include <string>
 #include <cstring>
+#include <cmath>
 #include <utility>
+#include <sstream>
+#include <limits>
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -48,10 +52,90 @@ static void exit_w_usage(const std::string &msg = {})
     std::cerr << R"(
 Output
  --optimize           - drop unnecessary whitespace in output
- --decimal-places <N> - decimal places in output
+ --decimal-places <N> - decimal places in output (0 to 17, default 2)
  --prettyprint        - each SVG command on a separate line
+ --compact            - smallest output: relative or absolute per command,
+			H/V for lines, no repeated letters or leading zeros
+ --simplify           - merge collinear lines, and drop moves and lines
+			that draw nothing (within the decimal places)
+ --integer-grid       - snap to a grid of 10^-N (N = decimal places), and
+			write integers in grid units (-s scales the SVG)
+ --binary             - binary path IR output (float32), for renderers
+ --binary64           - binary path IR output (float64)
+ --from-binary        - read binary path IR (instead of a program), and
+			write it as SVG path data, in any of the above formats
+ --png                - OUTFILE is a PNG picture of the path data, as -s or
+			--svg-out would show it (500x500 without either),
+			in place of the path data.  With --from-binary, of
+			the binary path IR.
+ --polylines <TOLERANCE>
+		      - OUTFILE is the path data as polylines, each an
+			array of float32 vertices, with the curves
+			flattened so that none is further than TOLERANCE
+			from its lines (see src/svg_path_turtle/Polyline.h).
+			With --from-binary, of the binary path IR.
+ --clip "x y w h"     - leave out what is drawn outside this rectangle (as
+			in a viewbox, so "x,y,w,h" works too), for rendering
+			tiles of a large drawing.  Allow for half the stroke
+			width.
  --no-pen-error       - disable the pen height warning
 
+Parameters
+ --param NAME=VALUE   - set the program's 'param NAME' (may be repeated)
+
+Compositing
+ --composite          - INFILE is an SVG template, and OUTFILE is the SVG
+			file made from it: the src="file" (path data) and
+			turtle="program" attributes of its paths are
+			replaced by their path data
+
+Server
+ --server             - run programs one after another, as requests arrive
+			on INFILE, writing each one's output to OUTFILE.
+			Each request is "<O> <P>\n" followed by O bytes of
+			output options and P bytes of program, and each
+			response is "ok|error <N> <M>\n" followed by N bytes
+			of output and M bytes of messages.  Imported modules
+			stay parsed between requests.
+
+Limits (for programs that can't be trusted to finish)
+ --max-statements <N> - stop with an error after running N statements
+ --max-time <MS>      - stop with an error after running for MS milliseconds
+ --max-output <BYTES> - stop with an error after writing BYTES of path data,
+			and at most one more command
+ --max-stack <N>      - stop with an error when the stack holds N values,
+			counting each call and block as one (the default,
+			and the most, is 1000000, or 20000 with --server
+			and --batch)
+			With --server, a request can give these too, but
+			only to lower the server's own, and SIGUSR1 cancels
+			the request being run.
+
+Batch
+ --batch              - each filename is a program, whose output goes to the
+			same name with a .svg (with -s) or .path extension,
+			running one program per core at a time
+ --manifest <FILE>    - batch run the programs listed in FILE, one
+			"INFILE [OUTFILE]" per line (OUTFILE "-" is stdout)
+ --jobs <N>           - run at most N programs at a time
+
+Watching
+ --watch              - run the program again whenever it, or a module that
+			it imports, is changed, rewriting OUTFILE from the
+			first byte that differs.  Only the changed files are
+			parsed again.  Runs until it's killed.
+
+Streaming
+ --stream             - write output as it is produced, rather than in large
+			blocks, so it can be consumed while running
+ --high-water-mark <BYTES>
+		      - with --stream, flush when this much is buffered
+			(default 16384, implies --stream)
+ --flush-interval <MS>
+		      - with --stream, also flush output that is older than
+			this (default 100, 0 = never, implies --stream)
+ --output-stats       - report bytes written and segments drawn
+
 Debugging
  -s                   - wrap output in basic 500x500 SVG file
  --svg-out "w h [bg-color path-fill path-stroke stroke-width linejoin linecap]"
@@ -63,14 +147,47 @@ Debugging
 			  stroke-width       = 1.5
 			  linejoin           = round
 			  linecap            = round
+ --fit                - with -s or --svg-out, fit the viewbox to what is
+			drawn (the path data is held until the end)
+ --symbols            - with -s or --svg-out, write each shape drawn inside
+			push_matrix ... pop_matrix (as by stamp) once, as a
+			<symbol>, and place each copy of it with a <use>
 
  --debug              - line numbers on all errors; backtrace on exceptions
  --trace              - trace execution
  --trace-parse        - trace parsing
  --show-breaks        - show when the 'breakpoint' command is encountered
  --list-chunks        - show list of all functions and local blocks
+ --dump-ir            - show the compiled instructions of each function and
+			block, with their costs and the fast paths taken
+			(runs with --bytecode, whose instructions match the
+			default backend's statements one for one)
+ --profile            - after running, show the calls, time, statements and
+			segments of each function and block, costliest first
+ --profile-folded <FILE>
+		      - with --profile, also write the call stacks' times
+			to FILE, in the folded format of flame graph tools
+ --sample <N>         - a much faster --debug, for large programs: only the
+			call stack is kept, and with --profile, it is
+			sampled every N statements (not with --trace)
+
+ --threads <N>        - run the statements of parallel blocks on N threads
+			(default 1, 0 = one per core)
+ --unique-range <N>   - give each statement of a parallel block N unique
+			numbers of its own, so they're the same however
+			many threads run them (default 0 = off)
 
 Other
+ --bytecode           - execute with the bytecode interpreter, which does the
+			same as the default one, a little slower, but with
+			a stack of its own rather than the native one
+ --memoize            - replay the turtle commands of earlier calls to pure
+			functions with the same arguments, rather than
+			running them again (not with --debug)
+ --arena-stats        - show the memory used by the compiled program
+ --metrics <FILE>     - after running, write the parse and execution times,
+			output size, commands written, peak stack size,
+			and such to FILE, as JSON
  -h,--help            - show this help
  --version            - print program version
 
@@ -96,13 +213,34 @@ static void exit_w_version()
 //
 //////////////////////////////////////////////////////////////////////////////
 
+// Reads the number that follows option argv[i]
+static long number_arg(int &i, int argc, char **argv)
+{
+    std::string name = argv[i];
+
+    ++i;
+    if(i == argc)
+	exit_w_usage(name + " requires a number");
+
+    try
+    {
+	return std::stol(argv[i]);
+    }
+    catch(...)
+    {
+	exit_w_usage(name + ": invalid number");
+    }
+
+    return 0;
+}
+
 void Options::parse_command_line(int argc, char **argv)
 {
     s_command_name = argv[0];
 
     bool end_of_options = false;
-    bool has_input_file = false;
-    bool has_output_file = false;
+
+    std::vector<std::string> filenames;
 
     for(int i = 1; i < argc; ++i)
     {
@@ -120,25 +258,127 @@ void Options::parse_command_line(int argc, char **argv)
 	else if(opt("--trace"))             ++call_trace_level;
 	else if(opt("--trace-parse"))       ++parse_trace_level;
 	else if(opt("--list-chunks"))       list_chunks = true;
+	else if(opt("--dump-ir"))           dump_ir = bytecode = true;
+	else if(opt("--profile"))           profile = true;
 	else if(opt("--show-breaks"))       report_breakpoints = true;
 	else if(opt("--optimize"))          optimize = true;
 	else if(opt("--prettyprint"))       prettyprint = true;
+	else if(opt("--compact"))           compact = true;
+	else if(opt("--simplify"))          simplify = true;
+	else if(opt("--integer-grid"))      integer_grid = true;
+	else if(opt("--binary"))            binary = true;
+	else if(opt("--binary64"))          binary64 = true;
+	else if(opt("--from-binary"))       from_binary = true;
+	else if(opt("--png"))               png = true;
+	else if(opt("--composite"))         composite = true;
+	else if(opt("--server"))            server = true;
+	else if(opt("--batch"))             batch = true;
+	else if(opt("--watch"))             watch = true;
 	else if(opt("--no-pen-error"))      disable_pen_warning = true;
+	else if(opt("--bytecode"))          bytecode = true;
+	else if(opt("--memoize"))           memoize = true;
+	else if(opt("--arena-stats"))       arena_stats = true;
+	else if(opt("--output-stats"))      output_stats = true;
+	else if(opt("--stream"))            stream = true;
 	else if(opt("-s"))                  svg_out.enable();
+	else if(opt("--fit"))               fit = true;
+	else if(opt("--symbols"))           symbols = true;
 	else if(opt("--decimal-places"))
+	    decimal_places = static_cast<int>(  // out of range either way
+				std::clamp(number_arg(i, argc, argv), -1L,
+					   long(max_decimal_places) + 1));
+	else if(opt("--high-water-mark"))
+	{
+	    high_water_mark = number_arg(i, argc, argv);
+	    stream = true;
+	}
+	else if(opt("--jobs"))
+	    jobs = number_arg(i, argc, argv);
+	else if(opt("--threads"))
+	    threads = number_arg(i, argc, argv);
+	else if(opt("--max-statements"))
+	    max_statements = number_arg(i, argc, argv);
+	else if(opt("--max-time"))
+	    max_time_ms = number_arg(i, argc, argv);
+	else if(opt("--max-output"))
+	    max_output_bytes = number_arg(i, argc, argv);
+	else if(opt("--max-stack"))
+	    max_stack = number_arg(i, argc, argv);
+	else if(opt("--unique-range"))
+	    unique_range = number_arg(i, argc, argv);
+	else if(opt("--sample"))
+	{
+	    sample_interval = number_arg(i, argc, argv);
+
+	    if(sample_interval <= 0)
+		exit_w_usage("--sample requires a positive number");
+	}
+	else if(opt("--metrics"))
 	{
 	    ++i;
 	    if(i == argc)
-		exit_w_usage("--decimal-places requires a number");
+		exit_w_usage("--metrics requires a filename");
+
+	    metrics_filename = argv[i];
+	}
+	else if(opt("--profile-folded"))
+	{
+	    ++i;
+	    if(i == argc)
+		exit_w_usage("--profile-folded requires a filename");
+
+	    profile_folded_filename = argv[i];
+	    profile = true;
+	}
+	else if(opt("--manifest"))
+	{
+	    ++i;
+	    if(i == argc)
+		exit_w_usage("--manifest requires a filename");
+
+	    manifest_filename = argv[i];
+	    batch = true;
+	}
+	else if(opt("--flush-interval"))
+	{
+	    flush_interval_ms = number_arg(i, argc, argv);
+	    stream = true;
+	}
+	else if(opt("--param"))
+	{
+	    ++i;
+	    if(i == argc)
+		exit_w_usage("--param requires NAME=VALUE");
+
+	    if(!add_param(argv[i]))
+		exit_w_usage("Invalid --param: " + std::string(argv[i]));
+	}
+	else if(opt("--polylines"))
+	{
+	    ++i;
+	    if(i == argc)
+		exit_w_usage("--polylines requires a tolerance");
 
 	    try
 	    {
-		decimal_places = std::stol(argv[i]);
+		polyline_tolerance = std::stod(argv[i]);
 	    }
 	    catch(...)
 	    {
-		exit_w_usage("--decimal-places: invalid number");
+		exit_w_usage("--polylines: invalid number");
 	    }
+
+	    polylines = true;
+	}
+	else if(opt("--clip"))
+	{
+	    ++i;
+	    if(i == argc)
+		exit_w_usage("--clip requires \"x y width height\"");
+
+	    if(!set_clip(argv[i]))
+		exit_w_usage("Invalid rectangle for --clip: "
+			     + std::string(argv[i]));
 	}
 	else if(opt("--svg-out"))
 	{
@@ -151,17 +391,329 @@ void Options::parse_command_line(int argc, char **argv)
 	}
 	else if(!end_of_options && arg[0] == '-' && arg[1])
 	    exit_w_usage("Unrecognized option: " + std::string(arg));
-	else if(!std::exchange(has_input_file, true))
-	    input_filename = arg;
-	else if(!std::exchange(has_output_file, true))
-	    output_filename = arg;
 	else
-	    exit_w_usage("Too many filenames.");
+	    filenames.push_back(arg);
     }
 
-    if(call_trace_level || parse_trace_level || list_chunks || report_breakpoints)
+    if(batch)
+	batch_filenames = std::move(filenames);
+    else if(filenames.size() > 2)
+	exit_w_usage("Too many filenames.");
+    else
+    {
+	if(filenames.size() > 0) input_filename = filenames[0];
+	if(filenames.size() > 1) output_filename = filenames[1];
+    }
+
+    if(call_trace_level || parse_trace_level || list_chunks || report_breakpoints
+       || profile || sample_interval)
 	debug = true;
 
-    if(optimize && prettyprint)
-	exit_w_usage("Only one of --optimize or --prettyprint is allowed");
+    // Sampling is what skips the per-statement trace.
+    if(sample_interval && call_trace_level)
+	exit_w_usage("--sample can't be combined with --trace");
+
+    if(int(optimize) + int(prettyprint) + int(compact) + int(binary) + int(binary64) > 1)
+	exit_w_usage("Only one of --optimize, --prettyprint, --compact, "
+		     "--binary or --binary64 is allowed");
+
+    // The simplifier holds back output, so it wouldn't line up with the
+    // trace any more.
+    if(simplify && call_trace_level)
+	exit_w_usage("--simplify can't be combined with --trace");
+
+    if(auto error = apply_decimal_places(); !error.empty())
+	exit_w_usage(error);
+
+    if(high_water_mark < 1)
+	exit_w_usage("--high-water-mark must be at least 1");
+
+    if(flush_interval_ms < 0)
+	exit_w_usage("--flush-interval can't be negative");
+
+    if(clip)
+    {
+	if(binary || binary64 || from_binary)
+	    exit_w_usage("--clip only works with text path data");
+
+	if(batch || server || composite)
+	    exit_w_usage("--clip only applies to a single program");
+
+	// The culler holds back output, like the simplifier.
+	if(call_trace_level)
+	    exit_w_usage("--clip can't be combined with --trace");
+    }
+
+    if(fit)
+    {
+	if(!svg_out)
+	    exit_w_usage("--fit requires -s or --svg-out");
+
+	// The header, with the viewbox, can't be written until the end.
+	if(stream)
+	    exit_w_usage("--fit can't be streamed");
+
+	if(call_trace_level)
+	    exit_w_usage("--fit can't be combined with --trace");
+
+	if(batch || server || composite || from_binary)
+	    exit_w_usage("--fit only applies to a single program");
+    }
+
+    if(symbols)
+    {
+	if(!svg_out)
+	    exit_w_usage("--symbols requires -s or --svg-out");
+
+	// The clip and the bounds are in world space, and a fragment's data
+	// isn't.
+	if(clip || fit)
+	    exit_w_usage("--symbols can't be combined with --clip or --fit");
+    }
+
+    if(binary || binary64)
+    {
+	if(svg_out)
+	    exit_w_usage("Binary output can't be wrapped in an SVG file");
+
+	if(call_trace_level)
+	    exit_w_usage("Binary output can't be traced");
+
+	if(from_binary)
+	    exit_w_usage("--from-binary outputs text");
+    }
+
+    if(png)
+    {
+	if(binary || binary64)
+	    exit_w_usage("--png can't be combined with binary output");
+
+	if(batch || server || composite || watch)
+	    exit_w_usage("--png only applies to a single program");
+
+	// The picture is drawn as the path data is produced, so its viewbox
+	// must be known from the start.
+	if(fit)
+	    exit_w_usage("--png can't be combined with --fit");
+
+	if(symbols || stream)
+	    exit_w_usage("--png can't be combined with --symbols or --stream");
+
+	if(call_trace_level)
+	    exit_w_usage("--png can't be combined with --trace");
+    }
+
+    if(polylines)
+    {
+	if(!(polyline_tolerance > 0) || !std::isfinite(polyline_tolerance))
+	    exit_w_usage("--polylines requires a positive tolerance");
+
+	if(binary || binary64 || png)
+	    exit_w_usage("--polylines can't be combined with binary output "
+			 "or --png");
+
+	if(svg_out)
+	    exit_w_usage("Polylines can't be wrapped in an SVG file");
+
+	if(integer_grid)
+	    exit_w_usage("--polylines can't be combined with --integer-grid");
+
+	if(batch || server || composite || watch)
+	    exit_w_usage("--polylines only applies to a single program");
+
+	if(call_trace_level)
+	    exit_w_usage("--polylines can't be combined with --trace");
+    }
+
+    if(composite)
+    {
+	if(svg_out)
+	    exit_w_usage("--composite already writes an SVG file");
+
+	if(binary || binary64 || from_binary)
+	    exit_w_usage("--composite only works with text path data");
+
+	if(debug)
+	    exit_w_usage("--composite can't be debugged or traced");
+    }
+
+    if(batch)
+    {
+	if(batch_filenames.empty() && manifest_filename.empty())
+	    exit_w_usage("--batch requires the programs' filenames");
+
+	if(composite || server || from_binary)
+	    exit_w_usage("--batch only runs programs");
+
+	if(binary || binary64)
+	    exit_w_usage("--batch only works with text path data");
+
+	if(debug || stream)
+	    exit_w_usage("--batch can't be debugged, traced or streamed");
+
+	if(jobs < 0)
+	    exit_w_usage("--jobs can't be negative");
+    }
+
+    if(threads < 0)
+	exit_w_usage("--threads can't be negative");
+
+    if(threads != 1 && (batch || server || composite))
+	exit_w_usage("--threads only applies to a single program");
+
+    if(unique_range < 0 || unique_range > std::numeric_limits<int>::max())
+	exit_w_usage("--unique-range is out of range");
+
+    if(unique_range != 0 && (batch || server || composite))
+	exit_w_usage("--unique-range only applies to a single program");
+
+    if(max_statements < 0 || max_time_ms < 0 || max_output_bytes < 0
+       || max_stack < 0)
+	exit_w_usage("--max-statements, --max-time, --max-output and "
+		     "--max-stack can't be negative");
+
+    // Server and batch programs are the ones least likely to be trusted,
+    // so they stop well short of where deep recursion could crash.
+    if(!max_stack && (batch || server))
+	max_stack = untrusted_max_stack;
+
+    if(memoize && (batch || server || composite))
+	exit_w_usage("--memoize only applies to a single program");
+
+    if(dump_ir && (batch || server || composite || from_binary))
+	exit_w_usage("--dump-ir only applies to a single program");
+
+    if(!metrics_filename.empty() && (batch || server || composite || from_binary))
+	exit_w_usage("--metrics only applies to a single program");
+
+    if(watch)
+    {
+	// The output file is rewritten in place.
+	if(input_filename.empty() || input_filename == "-"
+	   || output_filename.empty() || output_filename == "-")
+	    exit_w_usage("--watch requires INFILE and OUTFILE filenames");
+
+	if(batch || server || composite || from_binary)
+	    exit_w_usage("--watch only runs a single program");
+
+	if(binary || binary64)
+	    exit_w_usage("--watch only works with text path data");
+
+	if(debug || stream)
+	    exit_w_usage("--watch can't be debugged, traced or streamed");
+
+	if(clip || fit || memoize || threads != 1 || unique_range != 0
+	   || dump_ir || !metrics_filename.empty())
+	    exit_w_usage("--watch can't be combined with --clip, --fit, "
+			 "--memoize, --threads, --unique-range, --dump-ir "
+			 "or --metrics");
+    }
+
+    if(server)
+    {
+	if(composite || from_binary)
+	    exit_w_usage("--server only runs programs");
+
+	if(binary || binary64)
+	    exit_w_usage("--server only works with text path data");
+
+	if(debug || stream)
+	    exit_w_usage("--server can't be debugged, traced or streamed");
+    }
+}
+
+bool Options::set_clip(const std::string &rect)
+{
+    // As in a viewbox, the numbers may be separated by commas.
+    std::string numbers = rect;
+
+    std::replace(numbers.begin(), numbers.end(), ',', ' ');
+
+    std::istringstream in(numbers);
+
+    double x, y, width, height;
+
+    if(!(in >> x >> y >> width >> height) || width < 0 || height < 0)
+	return false;
+
+    std::string rest;
+
+    if(in >> rest)
+	return false;
+
+    clip = true;
+    clip_rect = { x, y, x + width, y + height };
+
+    return true;
+}
+
+std::string Options::apply_decimal_places()
+{
+    if(decimal_places < 0 || decimal_places > max_decimal_places)
+	return "--decimal-places must be from 0 to "
+	       + std::to_string(max_decimal_places);
+
+    // The SVG wrapper's viewbox is in grid units too.
+    if(integer_grid)
+    {
+	double scale = std::pow(10.0, decimal_places);
+
+	if(!std::isfinite(scale) || scale == 0)
+	    return "--integer-grid: no grid of 10^-"
+		   + std::to_string(decimal_places);
+
+	svg_out.set_scale(scale);
+    }
+
+    return {};
+}
+
+bool Options::add_param(const std::string &assignment)
+{
+    auto eq = assignment.find('=');
+
+    if(eq == 0 || eq == std::string::npos)
+	return false;
+
+    std::string value = assignment.substr(eq + 1);
+
+    size_t used = 0;
+    double number = 0;
+
+    try
+    {
+	number = std::stod(value, &used);
+    }
+    catch(...)
+    {
+	return false;
+    }
+
+    if(used != value.size())
+	return false;
+
+    params.emplace_back(assignment.substr(0, eq), number);
+
+    return true;
+}
+
+OstreamTurtle::OutputFormatType Options::get_output_format() const
+{
+    if(optimize)    return OstreamTurtle::optimized_output;
+    if(prettyprint) return OstreamTurtle::prettyprint_output;
+    if(compact)     return OstreamTurtle::compact_output;
+    if(binary)      return OstreamTurtle::binary32_output;
+    if(binary64)    return OstreamTurtle::binary64_output;
+
+    return OstreamTurtle::normal_output;
+}
+
+ExecutionEngine::Limits Options::get_limits() const
+{
+    return { .max_statements = static_cast<std::uint64_t>(max_statements),
+	     .max_time = std::chrono::milliseconds(max_time_ms),
+	     .max_output_bytes = static_cast<std::uint64_t>(max_output_bytes),
+	     .max_stack_depth = static_cast<int>(
+		    std::min<long>(max_stack, std::numeric_limits<int>::max())),
+	     .cancel = cancel };
 }
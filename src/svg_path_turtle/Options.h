@@ -25,8 +25,13 @@
 #pragma once
 
 #include "BasicSVG.h"
+#include "OstreamTurtle.h"
+#include "Engine.h"
 
+#include <atomic>
 #include <string>
+#include <utility>
+#include <vector>
 
 struct Options
 {
@@ -35,16 +40,115 @@ struct Options
 
     bool optimize = false;
     bool prettyprint = false;
+    bool compact = false;
+    bool simplify = false;
+    bool integer_grid = false;
+
+    // From --clip "x y width height"
+    bool clip = false;
+    PathCuller::Rect clip_rect;
+    bool binary = false;
+    bool binary64 = false;
+
+    // A picture of the path data, in place of the path data
+    bool png = false;
+
+    // Polylines (see PolylineWriter), with the curves flattened within this
+    // distance, in place of the path data
+    bool polylines = false;
+    double polyline_tolerance = 0.0;
+
+    bool from_binary = false;
+    bool composite = false;
+    bool server = false;
+    bool watch = false;
+
+    // Batch - see BatchRenderer
+    bool batch = false;
+    std::vector<std::string> batch_filenames;
+    std::string manifest_filename;
+    long jobs = 0;
+
     int decimal_places = 2;
     bool disable_pen_warning = false;
 
+    // --decimal-places is at most this, as doubles have no more digits.
+    static constexpr int max_decimal_places = 17;
+
+    // From --param NAME=VALUE, for the program's 'param' values
+    std::vector<std::pair<std::string, double>> params;
+
+    bool bytecode = false;
+    bool memoize = false;
+
+    // For parallel blocks (0 = one per core)
+    long threads = 1;
+    long unique_range = 0;
+    bool arena_stats = false;
+    bool output_stats = false;
+
+    // --metrics FILE: the run's costs, as JSON (see RunMetrics.h)
+    std::string metrics_filename;
+
+    // Streaming - see OutputBuffer::set_streaming()
+    bool stream = false;
+    long high_water_mark = 16 * 1024;
+    long flush_interval_ms = 100;
+
     bool debug = false;
     int call_trace_level = 0;
     int parse_trace_level = 0;
     bool list_chunks = false;
+    bool dump_ir = false;
     bool report_breakpoints = false;
 
+    // --profile, and --profile-folded FILE
+    bool profile = false;
+    std::string profile_folded_filename;
+
+    // --sample N: debug with a sample of the call stack every N statements
+    // (see ExecutionEngine::set_sample_interval()), or 0 to trace them all
+    long sample_interval = 0;
+
+    // Limits on each run (see ExecutionEngine::set_limits()), 0 = none
+    long max_statements = 0;
+    long max_time_ms = 0;
+    long max_output_bytes = 0;
+    long max_stack = 0;
+
+    // --max-stack for --server and --batch, unless it's given
+    static constexpr long untrusted_max_stack = 20000;
+
+    // Not from the command line: --server sets this, so that a signal can
+    // cancel the request being run (see RenderServer).
+    const std::atomic<bool> *cancel = nullptr;
+
     SVGConfig svg_out;
 
+    // With svg_out, the viewbox is fitted to the drawing.
+    bool fit = false;
+
+    // With svg_out, repeated fragments are written once, as symbols (see
+    // SVGSymbols in BasicSVG.h).
+    bool symbols = false;
+
     void parse_command_line(int argc, char **argv);
+
+    // Sets the clip from "x y width height".  Returns false if it's
+    // malformed.
+    bool set_clip(const std::string &rect);
+
+    // Adds a param from "NAME=VALUE".  Returns false if it's malformed.
+    bool add_param(const std::string &assignment);
+
+    // Checks --decimal-places, and with --integer-grid, the grid's scale
+    // (10^N, which everything written is multiplied by), and sets the SVG
+    // wrapper's scale to it.  Returns what's wrong, or an empty string.
+    std::string apply_decimal_places();
+
+    // From --optimize, --prettyprint, --compact, --binary and --binary64
+    OstreamTurtle::OutputFormatType get_output_format() const;
+
+    // From --max-statements, --max-time, --max-output and --max-stack
+    ExecutionEngine::Limits get_limits() const;
 };
@@ -23,23 +23,131 @@
  */
 
 #include "OstreamTurtle.h"
+#include "TurtleImpl.h"
 
 #include "DoubleToString.h"
+#include "BinaryPath.h"
+#include "PathSimplifier.h"
+#include "PathCuller.h"
+#include "PathCommand.h"
 
 #include <cassert>
 #include <cmath>
+#include <cctype>
+#include <cstring>
+#include <charconv>
 #include <utility>
 
 OstreamTurtle::OstreamTurtle(std::ostream &out)
-    : out(out)
+    : out(out.rdbuf())
+    , m_stream(*out.rdbuf())
 {
 }
 
+// PathSimplifier's sink: the OstreamTurtle's own formatting
+struct OstreamTurtle::SimplifiedOutput final : public TurtleEmitInterface
+{
+    OstreamTurtle &t;
+
+    explicit SimplifiedOutput(OstreamTurtle &t)
+	: t(t)
+    {
+    }
+
+    void emit_char(char ch) override     { t.write_char(ch); }
+    void emit_flag(bool flag) override   { t.write_flag(flag); }
+    void emit_number(double val) override { t.write_number(val); }
+};
+
+// PathCuller's sink: simplification (if any), and then formatting
+struct OstreamTurtle::CulledOutput final : public TurtleEmitInterface
+{
+    OstreamTurtle &t;
+
+    explicit CulledOutput(OstreamTurtle &t)
+	: t(t)
+    {
+    }
+
+    void emit_char(char ch) override     { t.simplify_char(ch); }
+    void emit_flag(bool flag) override   { t.simplify_flag(flag); }
+    void emit_number(double val) override { t.simplify_number(val); }
+};
+
+OstreamTurtle::~OstreamTurtle() = default;
+
 void OstreamTurtle::set_decimal_places(int n)
 {
     assert(n >= 0);
 
     m_decimal_places = n;
+    m_grid_scale = std::pow(10.0, n);
+
+    if(m_simplifier)
+	m_simplifier->set_tolerance(get_simplify_tolerance());
+}
+
+double OstreamTurtle::get_simplify_tolerance() const
+{
+    return 0.5 * std::pow(10.0, -m_decimal_places);
+}
+
+void OstreamTurtle::set_integer_grid(bool integer_grid)
+{
+    m_integer_grid = integer_grid;
+}
+
+// Returns true if val was snapped, and so is now a whole number.
+bool OstreamTurtle::snap_to_grid(double &val)
+{
+    // A's arguments are rx ry rotation large-arc sweep x y, and the flags
+    // aren't always passed to emit_flag().
+    if(m_grid_cmd == 'A' && m_grid_arg >= 2 && m_grid_arg <= 4)
+	return false;
+
+    val = std::round(val * m_grid_scale);
+
+    return true;
+}
+
+void OstreamTurtle::set_simplify(bool simplify)
+{
+    if(simplify && !m_simplifier)
+    {
+	m_simplified_output = std::make_unique<SimplifiedOutput>(*this);
+	m_simplifier = std::make_unique<PathSimplifier>(
+			    *m_simplified_output, get_simplify_tolerance());
+    }
+    else if(!simplify && m_simplifier)
+    {
+	m_simplifier->flush();
+	m_simplifier.reset();
+	m_simplified_output.reset();
+    }
+}
+
+void OstreamTurtle::set_track_bounds(bool track_bounds)
+{
+    m_track_bounds = track_bounds;
+}
+
+void OstreamTurtle::set_clip(const PathCuller::Rect &clip)
+{
+    if(m_culler)
+	m_culler->flush();
+
+    m_culled_output = std::make_unique<CulledOutput>(*this);
+    m_culler = std::make_unique<PathCuller>(*m_culled_output, clip);
+}
+
+void OstreamTurtle::clear_clip()
+{
+    if(m_culler)
+    {
+	m_culler->flush();
+	m_culler.reset();
+	m_culled_output.reset();
+    }
 }
 
 void OstreamTurtle::set_output_format(OutputFormatType format)
@@ -49,14 +157,202 @@ void OstreamTurtle::set_output_format(OutputFormatType format)
 	case normal_output:
 	case prettyprint_output:
 	case optimized_output:
+	case compact_output:
 	    m_output_format = format;
 	    break;
 
+	case binary32_output:
+	case binary64_output:
+	    // The binary header is written now, so this must come before any
+	    // other output.
+	    assert(m_first_command && !m_structured_output);
+
+	    m_output_format = format;
+	    m_binary = std::make_unique<BinaryPathWriter>(
+			    *out, format == binary32_output ? 4 : 8);
+	    m_structured_output = m_binary.get();
+	    break;
+
 	default:
 	    assert(false);
     }
 }
 
+void OstreamTurtle::set_segment_sink(TurtleEmitInterface &sink)
+{
+    assert(m_first_command && !m_structured_output);
+
+    m_structured_output = &sink;
+}
+
+void OstreamTurtle::set_fragment_sink(TurtleFragmentSink *sink)
+{
+    assert(!m_culler && !m_track_bounds);
+
+    discard_fragment();
+
+    m_fragment_sink = sink;
+
+    m_sink_waits_for_output = (sink != nullptr);
+}
+
+void OstreamTurtle::push_matrix()
+{
+    if(!m_fragment_sink)
+    {
+	SvgPathTurtleBase::push_matrix();
+	return;
+    }
+
+    if(m_in_fragment)
+	flush_fragment();
+    else
+	begin_fragments();
+
+    SvgPathTurtleBase::push_matrix();
+
+    m_placement = get_world_xform();
+}
+
+void OstreamTurtle::pop_matrix()
+{
+    if(!m_in_fragment)
+    {
+	SvgPathTurtleBase::pop_matrix();
+	return;
+    }
+
+    flush_fragment();
+
+    SvgPathTurtleBase::pop_matrix();
+
+    if(m_matrix_stack.empty())
+	end_fragments();
+    else
+	m_placement = get_world_xform();
+}
+
+void OstreamTurtle::rotation(double angle)
+{
+    change_placement([&] { SvgPathTurtleBase::rotation(angle); });
+}
+
+void OstreamTurtle::scaling(double x, double y)
+{
+    change_placement([&] { SvgPathTurtleBase::scaling(x, y); });
+}
+
+void OstreamTurtle::shearing(double x, double y)
+{
+    change_placement([&] { SvgPathTurtleBase::shearing(x, y); });
+}
+
+void OstreamTurtle::reflection(double x, double y)
+{
+    change_placement([&] { SvgPathTurtleBase::reflection(x, y); });
+}
+
+void OstreamTurtle::translation(double x, double y)
+{
+    change_placement([&] { SvgPathTurtleBase::translation(x, y); });
+}
+
+// The path so far is finished, and the output goes to m_fragment_data, in
+// the turtle's own coordinates, until the matrix stack is empty again.
+void OstreamTurtle::begin_fragments()
+{
+    finish_output();
+
+    start_path();
+
+    out = &m_fragment_data;
+    m_local_output = true;
+    m_in_fragment = true;
+
+    // If nothing was drawn since the last fragments, these go with them.
+    m_sink_waits_for_output = false;
+}
+
+// Passes what has been drawn since the placement last changed to the
+// sink, and starts over, so that what's drawn next begins with a move of
+// its own.
+void OstreamTurtle::flush_fragment()
+{
+    finish_output();
+
+    auto data = m_fragment_data.view();
+
+    if(data.find_first_not_of(" \n") != data.npos)
+    {
+	if(!std::exchange(m_sink_is_open, true))
+	    m_fragment_sink->begin_fragments();
+
+	m_fragment_sink->fragment(data, m_placement);
+    }
+
+    m_fragment_data.str({});
+
+    start_path();
+}
+
+// The sink is left open until there's other output, so that it gets the
+// fragments of one stamp after another together.
+void OstreamTurtle::end_fragments()
+{
+    out = &m_stream;
+    m_local_output = false;
+    m_in_fragment = false;
+
+    m_sink_waits_for_output = true;
+}
+
+void OstreamTurtle::close_fragment_sink()
+{
+    if(std::exchange(m_sink_is_open, false))
+	m_fragment_sink->end_fragments();
+}
+
+// Path data that isn't in a fragment is about to be written.
+void OstreamTurtle::start_sink_output()
+{
+    m_sink_waits_for_output = false;
+
+    close_fragment_sink();
+
+    m_fragment_sink->begin_path_data();
+}
+
+// For a fragment that an error cut short
+void OstreamTurtle::discard_fragment()
+{
+    if(m_in_fragment)
+    {
+	end_fragments();
+
+	m_fragment_data.str({});
+    }
+
+    m_sink_is_open = false;
+    m_sink_waits_for_output = (m_fragment_sink != nullptr);
+}
+
+// A transform changes the placement, so what was drawn before it is a
+// fragment of its own.
+void OstreamTurtle::change_placement(auto &&change)
+{
+    if(!m_in_fragment)
+    {
+	change();
+	return;
+    }
+
+    flush_fragment();
+
+    change();
+
+    m_placement = get_world_xform();
+}
+
 bool OstreamTurtle::prev_is_whitespace() const
 {
   return previous == whitespace || previous == newline;
@@ -66,26 +362,259 @@ void OstreamTurtle::finish_emit()
 {
     if(m_output_format != optimized_output && !prev_is_whitespace())
     {
-	out << ' ';
+	out->sputc(' ');
 	previous = whitespace;
     }
 }
 
 void OstreamTurtle::finish()
 {
+    // A fragment whose pop_matrix never came is still written, and the
+    // sink is closed before whatever follows the path.
+    if(m_in_fragment)
+	flush_fragment();
+
+    close_fragment_sink();
+
+    finish_output();
+
+    // The next path's data starts anew.
+    if(m_fragment_sink && !m_in_fragment)
+	m_sink_waits_for_output = true;
+}
+
+void OstreamTurtle::finish_output()
+{
+  if(m_culler)
+    m_culler->flush();
+
+  if(m_simplifier)
+    m_simplifier->flush();
+
+  // A segment sink gets everything in place of the stream, which is left
+  // alone (it may be the sink's own output, like --png's).
+  if(m_structured_output)
+    return;
+
+  // A fragment sink only gets path data that something was drawn in.
+  if(m_sink_waits_for_output)
+    return;
+
   if(m_output_format == normal_output && previous != newline)
-    out << '\n';
+    out->sputc('\n');
+
+  // Compact output is a single line, but still ends like a text file.
+  if(m_output_format == compact_output && m_last_token != TokenType::none)
+    out->sputc('\n');
+}
+
+void OstreamTurtle::end_path()
+{
+    finish();
+
+    start_path();
+}
+
+void OstreamTurtle::start_path()
+{
+    restart_output();
+
+    // The next path must begin with a move, even if the turtle pops back to
+    // a point it saved in this one.
+    m_state.path.set_has_moved();
+    m_turtle_stack.clear_saved_points();
+}
+
+void OstreamTurtle::reset()
+{
+    discard_fragment();
+
+    restart_output();
+
+    reset_turtle();
+}
+
+std::uint64_t OstreamTurtle::get_bytes_written() const
+{
+    auto pos = m_stream.pubseekoff(0, std::ios_base::cur, std::ios_base::out);
+
+    if(pos == std::streampos(std::streamoff(-1)))
+	return 0;
+
+    return static_cast<std::uint64_t>(std::streamoff(pos));
+}
+
+void OstreamTurtle::restart_output()
+{
+    m_first_command = true;
+    previous = newline;
+
+    m_last_letter = 0;
+    m_last_token = TokenType::none;
+    m_cur_x = m_cur_y = m_start_x = m_start_y = 0.0;
+}
+
+bool OstreamTurtle::can_fork() const
+{
+    return !m_first_command
+	&& !m_structured_output
+	&& !m_fragment_sink
+	&& !m_simplifier
+	&& !m_culler
+	&& m_output_format != compact_output;
+}
+
+void OstreamTurtle::fork(const OstreamTurtle &parent, const Snapshot &start)
+{
+    assert(parent.can_fork());
+
+    restore_snapshot(start);
+
+    m_initial_pt_is_inherited = true;
+    m_used_inherited_initial_pt = false;
+
+    m_decimal_places = parent.m_decimal_places;
+    m_output_format = parent.m_output_format;
+    m_integer_grid = parent.m_integer_grid;
+    m_grid_scale = parent.m_grid_scale;
+
+    previous = parent.previous;
+    m_first_command = false;
+
+    m_track_bounds = parent.m_track_bounds;
+    m_bounds = parent.m_bounds;
+
+    m_segment_count = 0;
+    m_command_counts = {};
+}
+
+OstreamTurtle::ForkResult OstreamTurtle::get_fork_result() const
+{
+    return { get_snapshot(),
+	     m_initial_pt_is_inherited,
+	     m_used_inherited_initial_pt,
+	     previous,
+	     m_segment_count,
+	     m_command_counts,
+	     m_bounds };
+}
+
+void OstreamTurtle::join(const ForkResult &result, std::string_view output)
+{
+    auto initial_pt = m_initial_pt;
+
+    restore_snapshot(result.end);
+
+    // The fork's start point was the snapshot's, which may not be this one.
+    if(result.initial_pt_is_inherited)
+	m_initial_pt = initial_pt;
+
+    if(!output.empty())
+    {
+	out->sputn(output.data(), static_cast<std::streamsize>(output.size()));
+
+	previous = result.previous;
+    }
+
+    m_segment_count += result.segment_count;
+
+    for(size_t i = 0; i < m_command_counts.size(); ++i)
+	m_command_counts[i] += result.command_counts[i];
+
+    if(m_track_bounds)
+	m_bounds.join(result.bounds);
 }
 
 void OstreamTurtle::emit_char(char ch)
 {
+    if(m_culler)
+	m_culler->emit_char(ch);
+    else
+	simplify_char(ch);
+}
+
+void OstreamTurtle::emit_flag(bool flag)
+{
+    if(m_culler)
+	m_culler->emit_flag(flag);
+    else
+	simplify_flag(flag);
+}
+
+void OstreamTurtle::emit_number(double val)
+{
+    if(m_culler)
+	m_culler->emit_number(val);
+    else
+	simplify_number(val);
+}
+
+void OstreamTurtle::simplify_char(char ch)
+{
+    if(m_simplifier)
+	m_simplifier->emit_char(ch);
+    else
+	write_char(ch);
+}
+
+void OstreamTurtle::simplify_flag(bool flag)
+{
+    if(m_simplifier)
+	m_simplifier->emit_flag(flag);
+    else
+	write_flag(flag);
+}
+
+void OstreamTurtle::simplify_number(double val)
+{
+    if(m_simplifier)
+	m_simplifier->emit_number(val);
+    else
+	write_number(val);
+}
+
+void OstreamTurtle::write_char(char ch)
+{
+    if(m_output_limit && get_bytes_written() > m_output_limit)
+	throw OutputLimitException{};
+
+    if(m_sink_waits_for_output)
+	start_sink_output();
+
+    if(m_track_bounds)
+	m_bounds.emit_char(ch);
+
+    if(m_integer_grid && ch != ' ' && ch != '\n')
+    {
+	m_grid_cmd = ch;
+	m_grid_arg = 0;
+    }
+    if(ch != 'M' && ch != ' ' && ch != '\n')
+	++m_segment_count;
+
+    if(ch >= 'A' && ch <= 'Z')
+	++m_command_counts[static_cast<size_t>(ch - 'A')];
+
+    if(m_structured_output)
+    {
+	m_first_command = false;
+	m_structured_output->emit_char(ch);
+	return;
+    }
+
+    if(m_output_format == compact_output)
+    {
+	compact_char(ch);
+	return;
+    }
+
     switch(ch)
     {
 	case ' ':
 	case '\n':
 	    if(m_output_format != optimized_output)
 	    {
-		out << ch;
+		out->sputc(ch);
 		previous = (ch == ' ') ? whitespace : newline;
 	    }
 	    break;
@@ -94,7 +623,7 @@ void OstreamTurtle::emit_char(char ch)
 	    if(std::exchange(m_first_command, false))
 		if(ch != 'm' && ch != 'M')
 		{
-		    out << "M0 0";
+		    out->sputn("M0 0", 4);
 		    previous = number;
 		}
 
@@ -104,20 +633,20 @@ void OstreamTurtle::emit_char(char ch)
 	    switch(m_output_format)
 	    {
 		case prettyprint_output:
-		    out << '\n';
+		    out->sputc('\n');
 		    previous = newline;
 		    break;
 
 		case normal_output:
 		    if(!prev_is_whitespace())
-			out << ' ';
+			out->sputc(' ');
 		    break;
 
 		default:
 		    break;
 	    }
 
-	    out << ch;
+	    out->sputc(ch);
 
 	    if(ch == 'z' || ch == 'Z')
 		previous = z_command;
@@ -129,30 +658,353 @@ void OstreamTurtle::emit_char(char ch)
     }
 }
 
-void OstreamTurtle::emit_flag(bool flag)
+void OstreamTurtle::write_flag(bool flag)
 {
     assert(!m_first_command);
 
+    if(m_track_bounds)
+	m_bounds.emit_flag(flag);
+
+    ++m_grid_arg;
+
+    if(m_structured_output)
+    {
+	m_structured_output->emit_flag(flag);
+	return;
+    }
+
+    if(m_output_format == compact_output)
+    {
+	compact_arg(flag ? 1.0 : 0.0, true);
+	return;
+    }
+
     if(previous == number)
-	out << ' ';
+	out->sputc(' ');
     else
 	previous = number;
 
-    out << (flag ? '1' : '0');
+    out->sputc(flag ? '1' : '0');
 
     finish_emit();
 }
 
-void OstreamTurtle::emit_number(double val)
+void OstreamTurtle::write_number(double val)
 {
     assert(!m_first_command);
 
+    // The box is in world space, so it's given the value before it's
+    // snapped to the grid.
+    if(m_track_bounds)
+	m_bounds.emit_number(val);
+
+    bool is_integer = m_integer_grid && snap_to_grid(val);
+
+    ++m_grid_arg;
+
+    if(m_structured_output)
+    {
+	m_structured_output->emit_number(val);
+	return;
+    }
+
+    if(m_output_format == compact_output)
+    {
+	compact_arg(val, false);
+	return;
+    }
+
     if(previous == number)
-	out << ' ';
+	out->sputc(' ');
     else
 	previous = number;
 
-    out << double_to_string(val, m_decimal_places);
+    char buf[double_to_chars_size];
+
+    // Grid values are whole numbers, so the integer conversion applies as
+    // long as they fit (and -0 is written as 0).
+    if(is_integer && std::abs(val) < 1e15)
+    {
+	auto [end, ec] = std::to_chars(buf, buf + sizeof(buf),
+				       static_cast<long long>(val));
+	out->sputn(buf, end - buf);
+    }
+    else if(auto end = double_to_chars(buf, buf + sizeof(buf), val, m_decimal_places))
+	out->sputn(buf, end - buf);
+    else
+    {
+	auto s = double_to_string(val, m_decimal_places);
+
+	out->sputn(s.data(), s.size());
+    }
 
     finish_emit();
 }
+
+//////////////////////////////////////////////////////////////////////////////
+// Compact output
+//////////////////////////////////////////////////////////////////////////////
+
+// One candidate encoding of a command.  It starts from the state the output
+// is in, to know which separators and command letters can be left out.
+struct OstreamTurtle::CompactText
+{
+    std::string &text;
+
+    int decimal_places;
+
+    TokenType last_token;
+    char last_letter;
+
+    CompactText(std::string &text, const OstreamTurtle &t)
+	: text(text)
+	, decimal_places(t.m_decimal_places)
+	, last_token(t.m_last_token)
+	, last_letter(t.m_last_letter)
+    {
+	text.clear();
+    }
+
+    void letter(char ch)
+    {
+	// A repeated command needs no letter, and neither does a line right
+	// after a moveto, since M/m continue with implied L/l.  A repeated M/m
+	// does need one, though, or it would be one of those implied lines.
+	bool implied = (ch == last_letter && ch != 'M' && ch != 'm' && ch != 'Z')
+		    || (ch == 'L' && last_letter == 'M')
+		    || (ch == 'l' && last_letter == 'm');
+
+	last_letter = ch;
+
+	if(!implied)
+	{
+	    text += ch;
+	    last_token = TokenType::letter;
+	}
+    }
+
+    void number(double val)
+    {
+	char buf[double_to_chars_size];
+	std::string big;
+
+	char *begin = buf;
+	char *end = double_to_chars(buf, buf + sizeof(buf), val, decimal_places);
+
+	if(!end)
+	{
+	    big = double_to_string(val, decimal_places);
+	    begin = big.data();
+	    end = begin + big.size();
+	}
+
+	// 0.5 -> .5 and -0.5 -> -.5
+	if(end - begin > 2 && begin[0] == '0' && begin[1] == '.')
+	    ++begin;
+	else if(end - begin > 3 && begin[0] == '-' && begin[1] == '0' && begin[2] == '.')
+	{
+	    begin[1] = '-';
+	    ++begin;
+	}
+
+	flag_or_number(begin, end);
+    }
+
+    void flag(double val)
+    {
+	const char *digit = val ? "1" : "0";
+
+	flag_or_number(digit, digit + 1);
+    }
+
+    void flag_or_number(const char *begin, const char *end)
+    {
+	// A separator is needed unless the number can't be read as part of
+	// the previous one: a '-', or a '.' after a number that has its '.'
+	bool needs_separator = (last_token == TokenType::number
+				|| last_token == TokenType::number_with_dot)
+			    && *begin != '-'
+			    && !(*begin == '.' && last_token == TokenType::number_with_dot);
+
+	if(needs_separator)
+	    text += ' ';
+
+	text.append(begin, end);
+
+	last_token = std::memchr(begin, '.', end - begin)
+		   ? TokenType::number_with_dot
+		   : TokenType::number;
+    }
+};
+
+// The offsets of the x,y pairs that change for a relative command.
+static std::pair<const int *, int> get_command_points(char cmd)
+{
+    static const int first[] = { 0 };
+    static const int two[]   = { 0, 2 };
+    static const int three[] = { 0, 2, 4 };
+    static const int arc[]   = { 5 };
+
+    switch(cmd)
+    {
+	case 'Q': case 'S': return { two,   2 };
+	case 'C':           return { three, 3 };
+	case 'A':           return { arc,   1 };
+	default:            return { first, 1 };
+    }
+}
+
+double OstreamTurtle::round_for_output(double val) const
+{
+    char buf[double_to_chars_size];
+
+    auto end = double_to_chars(buf, buf + sizeof(buf), val, m_decimal_places);
+
+    if(end)
+	std::from_chars(buf, end, val);
+
+    return val;
+}
+
+void OstreamTurtle::compact_char(char ch)
+{
+    // Whitespace is dropped, as for optimized_output.
+    if(ch == ' ' || ch == '\n')
+	return;
+
+    assert(m_compact_nargs == m_compact_args_needed);
+
+    if(std::exchange(m_first_command, false))
+	if(ch != 'm' && ch != 'M')
+	{
+	    m_compact_cmd = 'M';
+	    m_compact_args_needed = 2;
+	    m_compact_nargs = 2;
+	    m_compact_args[0] = m_compact_args[1] = 0.0;
+	    m_compact_arg_is_flag[0] = m_compact_arg_is_flag[1] = false;
+
+	    compact_finish_command();
+	}
+
+    m_compact_cmd = ch;
+    m_compact_nargs = 0;
+    m_compact_args_needed = get_command_args_size(ch);
+
+    if(m_compact_args_needed == 0)
+	compact_finish_command();
+}
+
+void OstreamTurtle::compact_arg(double val, bool is_flag)
+{
+    assert(m_compact_nargs < m_compact_args_needed);
+
+    m_compact_args[m_compact_nargs] = is_flag ? val : round_for_output(val);
+    m_compact_arg_is_flag[m_compact_nargs] = is_flag;
+
+    if(++m_compact_nargs == m_compact_args_needed)
+	compact_finish_command();
+}
+
+void OstreamTurtle::compact_finish_command()
+{
+    const char cmd = m_compact_cmd;
+    const int n = m_compact_nargs;
+    const double *args = m_compact_args;
+
+    CompactText absolute(m_absolute_text, *this);
+    CompactText relative(m_relative_text, *this);
+
+    if(n == 0)
+    {
+	// z/Z
+	absolute.letter(cmd);
+
+	out->sputn(m_absolute_text.data(), m_absolute_text.size());
+
+	m_last_letter = absolute.last_letter;
+	m_last_token = absolute.last_token;
+
+	m_cur_x = m_start_x;
+	m_cur_y = m_start_y;
+
+	return;
+    }
+
+    const double x = args[n - 2];
+    const double y = args[n - 1];
+
+    if(cmd == 'L' && y == m_cur_y)
+    {
+	absolute.letter('H');
+	absolute.number(x);
+
+	relative.letter('h');
+	relative.number(x - m_cur_x);
+    }
+    else if(cmd == 'L' && x == m_cur_x)
+    {
+	absolute.letter('V');
+	absolute.number(y);
+
+	relative.letter('v');
+	relative.number(y - m_cur_y);
+    }
+    else
+    {
+	auto [points, npoints] = get_command_points(cmd);
+
+	absolute.letter(cmd);
+	relative.letter(static_cast<char>(std::tolower(cmd)));
+
+	for(int i = 0, next_point = 0; i < n; ++i)
+	{
+	    double rel = args[i];
+
+	    if(next_point < npoints && i == points[next_point])
+		rel -= m_cur_x;
+	    else if(next_point < npoints && i == points[next_point] + 1)
+	    {
+		rel -= m_cur_y;
+		++next_point;
+	    }
+
+	    if(m_compact_arg_is_flag[i])
+	    {
+		absolute.flag(args[i]);
+		relative.flag(args[i]);
+	    }
+	    else
+	    {
+		absolute.number(args[i]);
+		relative.number(rel);
+	    }
+	}
+    }
+
+    // Absolute wins ties, since it doesn't depend on the previous point.
+    const auto &best = m_relative_text.size() < m_absolute_text.size()
+		     ? relative
+		     : absolute;
+
+    out->sputn(best.text.data(), best.text.size());
+
+    m_last_letter = best.last_letter;
+    m_last_token = best.last_token;
+
+    m_cur_x = x;
+    m_cur_y = y;
+
+    if(cmd == 'M')
+    {
+	m_start_x = x;
+	m_start_y = y;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  The drawing commands, with the emit_*() calls above inlined
+//
+///////////////////////////////////////////////////////////////////////////////
+
+template class BasicSvgPathTurtle<OstreamTurtle>;
@@ -25,11 +25,29 @@
 #pragma once
 
 #include "Turtle.h"
+#include "PathBounds.h"
+#include "PathCuller.h"
 
 #include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
 
-class OstreamTurtle : public SvgPathTurtle
+class BinaryPathWriter;
+class PathSimplifier;
+
+// OstreamTurtle is final, so that BasicSvgPathTurtle's calls to emit_char()
+// and friends are not virtual, and get inlined into the drawing commands.  It
+// is still a TurtleEmitInterface, so it can be the sink for read_binary_path().
+class OstreamTurtle final : public BasicSvgPathTurtle<OstreamTurtle>,
+			    public TurtleEmitInterface
 {
+    friend class BasicSvgPathTurtle<OstreamTurtle>;
+
     //// Types
 
 public:
@@ -37,7 +55,10 @@ public:
     {
 	normal_output,
 	optimized_output,
-	prettyprint_output
+	prettyprint_output,
+	compact_output,     // shortest encoding of each command (see below)
+	binary32_output,    // binary path IR (see BinaryPath.h), float32
+	binary64_output     // binary path IR, float64
     };
 
 private:
@@ -52,7 +73,12 @@ private:
 
     //// Data
 
-    std::ostream &out;
+    // Output goes straight to the stream's buffer, skipping the per-call
+    // sentry and formatting work of the std::ostream itself.  While a
+    // fragment is drawn (see set_fragment_sink()), it goes to
+    // m_fragment_data instead.
+    std::streambuf *out;
+    std::streambuf &m_stream;
 
     ItemType previous = whitespace;
 
@@ -62,24 +88,296 @@ private:
 
     bool m_first_command = true;
 
+    // Every command except M - counted for progress reports.
+    std::uint64_t m_segment_count = 0;
+
+    // Each command written, by letter
+    std::array<std::uint64_t, 26> m_command_counts{};
+
+    // See set_output_limit()
+    std::uint64_t m_output_limit = 0;
+
+    // With set_integer_grid(), coordinates are multiplied by m_grid_scale
+    // (10^decimal places) and rounded, so only integers are written.  The
+    // command and argument index are tracked to leave A's rotation and
+    // flags alone.
+    bool m_integer_grid = false;
+    double m_grid_scale = 1.0;
+
+    char m_grid_cmd = 0;
+    int m_grid_arg = 0;
+
+    bool snap_to_grid(double &val);
+
+    // For the binary formats, and set_segment_sink(), everything is passed
+    // on to this instead of being written as text.
+    TurtleEmitInterface *m_structured_output = nullptr;
+
+    std::unique_ptr<BinaryPathWriter> m_binary;
+
+    // With set_simplify(), the turtle's output goes through this first, and
+    // it passes the simplified path on to the write_*() functions.
+    struct SimplifiedOutput;
+
+    std::unique_ptr<SimplifiedOutput> m_simplified_output;
+    std::unique_ptr<PathSimplifier> m_simplifier;
+
+    // With set_clip(), the turtle's output goes through this before the
+    // simplifier, and what it passes on goes to the simplify_*() functions.
+    struct CulledOutput;
+
+    std::unique_ptr<CulledOutput> m_culled_output;
+    std::unique_ptr<PathCuller> m_culler;
+
+    // With set_fragment_sink()
+    //
+    // m_in_fragment is set while the matrix stack isn't empty, and the output
+    // is in the turtle's own coordinates, which m_placement places.
+    // m_sink_is_open is set from the sink's begin_fragments() to its
+    // end_fragments(), which comes at the next output that isn't in a
+    // fragment, or the end of the path.  That output first goes through
+    // start_sink_output(), with m_sink_waits_for_output.
+    TurtleFragmentSink *m_fragment_sink = nullptr;
+
+    bool m_in_fragment = false;
+    bool m_sink_is_open = false;
+    bool m_sink_waits_for_output = false;
+    Matrix2d m_placement;
+    std::stringbuf m_fragment_data;
+
+    void begin_fragments();
+    void flush_fragment();
+    void end_fragments();
+    void close_fragment_sink();
+    void start_sink_output();
+    void discard_fragment();
+
+    void change_placement(auto &&change);
+
+    // With set_track_bounds(), the (simplified) output also goes to this.
+    bool m_track_bounds = false;
+    PathBounds m_bounds;
+
+    //// Compact output
+    //
+    // The turtle always emits absolute commands.  For compact_output, the
+    // arguments of each command are gathered, and then the command is written
+    // in whichever form is shortest: absolute or relative, H/V for lines
+    // that only move along one axis, with repeated command letters dropped
+    // and leading zeros elided.
+    //
+    // Relative values are computed from the rounded absolute values, so that
+    // a reader adding them up lands exactly on the rounded absolute points,
+    // and rounding errors don't accumulate along the path.
+
+    enum class TokenType
+    {
+	none,
+	letter,
+	number,
+	number_with_dot,
+    };
+
+    struct CompactText;
+
+    static constexpr int max_command_args = 7;
+
+    char m_compact_cmd = 0;
+    int m_compact_nargs = 0;
+    int m_compact_args_needed = 0;
+    double m_compact_args[max_command_args];
+    bool m_compact_arg_is_flag[max_command_args];
+
+    char m_last_letter = 0;
+    TokenType m_last_token = TokenType::none;
+
+    // The current point and the subpath start, as an SVG reader sees them.
+    double m_cur_x = 0.0;
+    double m_cur_y = 0.0;
+    double m_start_x = 0.0;
+    double m_start_y = 0.0;
+
+    // Reused for each command, so they don't allocate after warming up.
+    std::string m_absolute_text;
+    std::string m_relative_text;
+
+    void compact_char(char ch);
+    void compact_arg(double val, bool is_flag);
+    void compact_finish_command();
+
+    double round_for_output(double val) const;
+
     //// TurtleEmitInterface
 
     void emit_char(char ch) override;
     void emit_flag(bool flag) override;
     void emit_number(double val) override;
 
+    void simplify_char(char ch);
+    void simplify_flag(bool flag);
+    void simplify_number(double val);
+
+    void write_char(char ch);
+    void write_flag(bool flag);
+    void write_number(double val);
+
+    double get_simplify_tolerance() const;
+
     //// Utilities
 
     bool prev_is_whitespace() const;
 
     void finish_emit();
 
+    void finish_output();
+
+    void start_path();
+
+    void restart_output();
+
 public:
     explicit OstreamTurtle(std::ostream &out);
+    ~OstreamTurtle();
 
     void set_decimal_places(int n);
 
     void set_output_format(OutputFormatType format);
 
+    // Merges collinear lines and drops empty moves and lines (see
+    // PathSimplifier.h), within half of the last decimal place.
+    void set_simplify(bool simplify);
+
+    // Snaps coordinates and lengths to a grid of 10^-decimal_places, and
+    // writes them in grid units, as integers.  (The rotation of an arc is an
+    // angle, so it is written as usual.)
+    void set_integer_grid(bool integer_grid);
+
+    // Drops what is drawn outside the clip rectangle (in world space), so
+    // the output only has what can be seen in it (see PathCuller.h).
+    void set_clip(const PathCuller::Rect &clip);
+    void clear_clip();
+
+    // Passes the output to 'sink' (as absolute commands and their
+    // arguments, after simplifying, culling and snapping to the grid) in
+    // place of writing it to the stream.  This must come before any output.
+    void set_segment_sink(TurtleEmitInterface &sink);
+
+    // Keeps the bounding box of the path data, in world space, as it is
+    // written (see PathBounds.h).  It covers every path, until it's cleared.
+    void set_track_bounds(bool track_bounds);
+
+    // Splits the path data into fragments, to be written once and placed
+    // wherever they're repeated (see SVGSymbols in BasicSVG.h).  Whatever
+    // is drawn inside push_matrix ... pop_matrix is a fragment, drawn in the
+    // turtle's own coordinates, and the transform of all of the matrix
+    // levels is its placement.  It ends at the next push_matrix, pop_matrix
+    // or transform, or new path, and is passed to 'sink' in place of being
+    // written to the stream.  Each fragment starts with a move.  The clip
+    // and the bounds are in world space, so this can't be used with
+    // set_clip() or set_track_bounds(), nor with binary output or a segment
+    // sink.  nullptr turns it off.
+    void set_fragment_sink(TurtleFragmentSink *sink);
+
+    // These are the base class's, but with a fragment sink, they end the
+    // fragment that was being drawn.
+    void push_matrix();
+    void pop_matrix();
+
+    void rotation(double angle);
+    void scaling(double x, double y);
+    void shearing(double x, double y);
+    void reflection(double x, double y);
+    void translation(double x, double y);
+
+    const PathBounds::Box &get_bounds() const { return m_bounds.get_box(); }
+
+    void clear_bounds() { m_bounds.clear_box(); }
+
     void finish();
+
+    // Finishes the current path's data (as finish() does), and starts over,
+    // so that what follows can be the data of another path.
+    void end_path();
+
+    // After finish(), to write another path from scratch: both the turtle
+    // and the output start over.
+    void reset();
+
+    std::uint64_t get_segment_count() const { return m_segment_count; }
+
+    // The output stream's position, which is what has been written to it,
+    // if it can tell (std::stringbuf and OutputBuffer can), or else 0.
+    // Fragments (see set_fragment_sink()) and set_segment_sink() output
+    // aren't written to it.
+    std::uint64_t get_bytes_written() const;
+
+    // Thrown when a command would be written after get_bytes_written() has
+    // gone past the limit, so a run writes at most one command too many.
+    struct OutputLimitException : public std::runtime_error
+    {
+	OutputLimitException()
+	    : std::runtime_error("Output limit reached")
+	{
+	}
+    };
+
+    // 0 for none
+    void set_output_limit(std::uint64_t limit) { m_output_limit = limit; }
+
+    // The commands written so far, 'A' first
+    using CommandCounts = std::array<std::uint64_t, 26>;
+
+    const CommandCounts &get_command_counts() const
+    {
+	return m_command_counts;
+    }
+
+    //// Forking (for parallel blocks - see ExecutionEngine::exec_parallel())
+    //
+    // A forked turtle starts from a Snapshot of this one, and writes to its
+    // own stream.  What it did can be joined back into this turtle, in place
+    // of doing it here, if this turtle is still in the snapshot's state.
+    //
+    // That only works when a command's output depends on nothing but the
+    // turtle's state, which isn't so for compact output (relative commands
+    // and dropped letters), simplification, culling, binary output, or the
+    // "M0 0" that the first command may need.
+
+    struct ForkResult
+    {
+	Snapshot end;
+
+	bool initial_pt_is_inherited = false;
+	bool used_inherited_initial_pt = false;
+
+	ItemType previous = whitespace;
+
+	std::uint64_t segment_count = 0;
+	CommandCounts command_counts{};
+
+	PathBounds bounds;
+    };
+
+    bool can_fork() const;
+
+    Snapshot get_fork_snapshot() const
+    {
+	return get_snapshot();
+    }
+
+    // Starts this turtle as a fork of parent, which is in the state 'start'.
+    void fork(const OstreamTurtle &parent, const Snapshot &start);
+
+    ForkResult get_fork_result() const;
+
+    // Whether a fork from 'start' did just what this turtle would do now.
+    bool can_join(const Snapshot &start, const ForkResult &result) const
+    {
+	return is_in_state(start, result.used_inherited_initial_pt);
+    }
+
+    // Takes on the fork's state, and writes its output.
+    void join(const ForkResult &result, std::string_view output);
 };
+
+extern template class BasicSvgPathTurtle<OstreamTurtle>;
@@ -25,6 +25,7 @@
 #include "Parser.h"
 #include "Messages.h"
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <tuple>
@@ -34,6 +35,9 @@
 #include <cmath>
 #include <sstream>
 #include <iomanip>
+#include <iterator>
+#include <filesystem>
+#include <system_error>
 
 using namespace ParserStarterKit;
 
@@ -59,7 +63,7 @@ static Expr get_ast_node_expression(const ASTNode &n)
 	    return n.get_expression();
 
 	case ASTNode::Type::Constant:
-	    return [val = n.get_constant()]()->double { return val; };
+	    return ExecutionEngine::compile_access_constant(n.get_constant());
 
 	default:
 	    return {};
@@ -151,6 +155,9 @@ void Parser::set_engine_loc(const char *label, Location loc)
 	if(!loc)
 	    loc = token_loc();
 
+	m_engine_loc_label = label;
+	m_engine_loc = loc;
+
 	SourceLocation where{ m_current_file_id, loc.linenum, loc.charnum };
 
 	m_debugger->set_source_location(where, label);
@@ -172,13 +179,18 @@ void Parser::report_error(Errtype type,
     source_loc.filename = get_filename();
     source_loc.loc = where;
 
-    ::report_message(std::cerr, source_loc, error_message_label(type), errmsg);
+    ::report_message(*m_error_out, source_loc, error_message_label(type), errmsg);
 
     if(type == Error || type == Panic)
 	m_has_error = true;
 
     if(type == Panic)
+    {
+	if(m_throw_on_error)
+	    throw ParseError();
+
 	exit(1);
+    }
 }
 
 void Parser::push_context()
@@ -202,28 +214,48 @@ ASTNode Parser::make_numerical_constant_expr()
     return ASTNode{val};
 }
 
-int Parser::add_capture(Function *fndef, NameDefinition *def)
+// A value in the frame of the enclosing function is read from there, through
+// the link at the start of the closure, so creating the closure doesn't copy
+// it.  Anything else is copied into the closure, after the link: values from
+// further out (which cascades them to the enclosing function's captures),
+// and named functions, which aren't values on the stack.
+std::tuple<Parser::ValueDomain, int> Parser::add_capture(NameDefinition *def)
 {
     assert(def && def->get_value_size() != 0);
+    assert(m_function_def_stack.size() >= 2);
+
+    auto *fndef = get_current_function();
+
+    const auto *enclosing = m_function_def_stack.end()[-2];
+
+    const auto &captures = fndef->captures();
+
+    bool found = std::find(captures.begin(), captures.end(), def)
+		    != captures.end();
+
+    if(!def->is<Function>()
+       && def->get_context_depth() > enclosing->get_context_depth())
+    {
+	if(!found)
+	    fndef->add_capture(def, false);
+
+	return { ValueDomain::Enclosing, def->get_stack_offset() };
+    }
 
-    auto offset = 0;
-    bool found = false;
+    auto offset = 1; // after the link
 
-    for(const auto *capture : fndef->captures())
+    for(const auto *capture : fndef->copied_captures())
     {
 	if(def == capture)
-	{
-	    found = true;
 	    break;
-	}
 	else
 	    offset += capture->get_value_size();
     }
 
     if(!found)
-	fndef->add_capture(def);
+	fndef->add_capture(def, true);
 
-    return offset;
+    return { ValueDomain::Capture, offset };
 }
 
 std::tuple<Parser::ValueDomain, int>
@@ -239,8 +271,8 @@ std::tuple<Parser::ValueDomain, int>
 
 	if(domain == ValueDomain::Capture)
 	    // If it must be captured, then we have to add the capture, and
-	    // use its capture offset instead.
-	    offset = add_capture(get_current_function(), def);
+	    // read it from wherever the closure keeps it.
+	    return add_capture(def);
     }
 
     return { domain, offset };
@@ -284,19 +316,36 @@ void Parser::compile_push_capture(NameDefinition *def)
     compile_push_object(def, ValueDomain::Capture);
 }
 
-Function *Parser::lookup_builtin(const std::string &name)
+Function *Parser::lookup_builtin(Symbol sym)
 {
-    auto f = m_builtins.find(name);
+    auto f = m_builtins->find(sym);
 
-    return f == m_builtins.end() ? nullptr : &f->second;
+    return f == m_builtins->end() ? nullptr : &f->second;
 }
 
 NameDefinition *Parser::lookup_name(const std::string &name, bool required)
 {
-    auto *def = Base::lookup_name(name);
+    return lookup_symbol(m_names.get_symbol_table().find(name), name, required);
+}
 
-    if(!def)
-	def = lookup_builtin(name);
+NameDefinition *Parser::lookup_symbol(Symbol sym,
+				      const std::string &name,
+				      bool required)
+{
+    NameDefinition *def = nullptr;
+
+    if(sym != ParserStarterKit::no_symbol)
+    {
+	if(auto *p = m_names.lookup_symbol(sym))
+	    def = p->get();
+	else
+	    def = lookup_builtin(sym);
+    }
+
+    // An imported function is compiled the first time it's named.
+    if(def && def->is(NameType::Function))
+	if(auto *fndef = static_cast<Function *>(def); fndef->is_deferred())
+	    compile_deferred_fn(fndef);
 
     if(required && !def)
 	error("Name '", name, "' is undefined");
@@ -304,12 +353,24 @@ NameDefinition *Parser::lookup_name(const std::string &name, bool required)
     return def;
 }
 
+NameDefinition *Parser::lookup_token_name(bool required)
+{
+    assert(is(tk_identifier));
+
+    return lookup_symbol(token_symbol(), token_str(), required);
+}
+
 NameDefinition *Parser::lookup_global_name(const std::string &name, bool required)
 {
     auto *def = Base::lookup_global_name(name);
 
     if(!def)
-	def = lookup_builtin(name);
+    {
+	auto sym = m_names.get_symbol_table().find(name);
+
+	if(sym != ParserStarterKit::no_symbol)
+	    def = lookup_builtin(sym);
+    }
 
     if(required && !def)
 	error("Global name '", name, "' is undefined");
@@ -345,7 +406,7 @@ ASTNode Parser::parse_named_value_expression()
 
     const auto &name = token_str();
 
-    auto *def = lookup_name(name);
+    auto *def = lookup_token_name();
 
     if(!def)
 	error("Undefined name: ", name);
@@ -661,6 +722,13 @@ void Parser::create_closure_object(Function *fndef)
     //   on that stack, and captured values are referenced relative to
     //   that absolute position.
     //
+    //   Since the closure can't outlive the frame it's created in (which
+    //   makes no tail calls while it's there - see is_tail_call()), the
+    //   values it captures from that frame aren't copied.  The closure
+    //   starts with a link to the frame, and they're read from there
+    //   (see add_capture()).  So a closure created in a loop costs one
+    //   push per iteration, however much it captures.
+    //
     //   Also, this cascades captures upwards to outer enclosing
     //   functions, by calling locate_name() to read the value that
     //   must be added to the closure object. This results in cascading
@@ -675,7 +743,7 @@ void Parser::create_closure_object(Function *fndef)
 
 	m_engine.create_closure(fndef->get_chunk_index());
 
-	for(auto *def : fndef->captures())
+	for(auto *def : fndef->copied_captures())
 	    compile_push_capture(def);
     }
 }
@@ -706,6 +774,13 @@ void Parser::parse_fn_definition(const string &name, Location loc)
 
     auto *fndef = declare_name<Function>(name, loc);
 
+    parse_fn_params_and_body(fndef);
+
+    set_engine_loc("fnafter");
+}
+
+void Parser::parse_fn_params_and_body(Function *fndef)
+{
     {
 	EnterBlockRAII block(this, fndef);
 
@@ -723,8 +798,394 @@ void Parser::parse_fn_definition(const string &name, Location loc)
 
 	require('}');
     }
+}
 
-    set_engine_loc("fnafter");
+//////////////////////////////////////////////////////////////////////
+//
+//  Deferred function definitions
+//
+//   The functions of an imported module are only compiled when they are
+//   first named, so a program that uses a few functions of a large module
+//   doesn't pay for the rest (and neither does the engine, which never gets
+//   their chunks).  Until then, each definition is only scanned for its
+//   end, and kept as text.
+//
+//   When it's compiled, it sees the same names it would have seen in the
+//   module: those that were defined (or imported) before it.  And the
+//   names it uses are checked as it's scanned, so an undefined one is
+//   reported when the module is imported, whether the function is used or
+//   not (see skip_fn_definition()).
+//
+//   This is the same with a debugger, so that --debug, --profile and
+//   --dump-ir accept and reject the same programs as a plain run.
+//
+//////////////////////////////////////////////////////////////////////
+
+// The offset in m_source of loc, which is never before the last one.
+size_t Parser::get_source_offset(Location loc)
+{
+    assert(loc.linenum >= m_source_linenum);
+
+    while(m_source_linenum < loc.linenum)
+    {
+	auto eol = m_source.find('\n', m_source_line_offset);
+
+	assert(eol != std::string_view::npos);
+
+	m_source_line_offset = eol + 1;
+	++m_source_linenum;
+    }
+
+    return m_source_line_offset + static_cast<size_t>(loc.charnum - 1);
+}
+
+// Skips the parameters and body of a function definition, through the '}'
+// that ends it.  Returns the offset in m_source just after that, or npos if
+// the definition isn't well formed (which leaves the token after where it
+// went wrong).
+//
+// On the way, it looks up the names that the definition uses, so that an
+// undefined name is reported when the module is imported, as it would be
+// if the definition were compiled there.  This only has the tokens to go
+// by, so it errs on the side of caution: names_resolved is cleared unless
+// each name is certainly defined where it's used, and the definition is
+// then compiled at once, to report whatever is wrong.
+//
+//   - Each '{' is a scope, whose names go away at its '}'.  The params of a
+//     def, or of "{=>", are in the scope of its body.
+//   - "name =" declares a value in the scope it's in.  The body of an if,
+//     else or for without braces is a scope that ends with its statement,
+//     though, so from one of those to the next '{', nothing is declared.
+//   - A for's loop variable is in the scope of its body, if that's a '{'
+//     straight after the range (which never holds a function name).
+size_t Parser::skip_fn_definition(bool &names_resolved)
+{
+    names_resolved = true;
+
+    if(!is('('))
+	return string::npos;
+
+    struct LocalName
+    {
+	Symbol sym;
+	bool is_value;
+    };
+
+    struct Scope
+    {
+	std::vector<LocalName> names;
+
+	// From an if, else or for to its body's '{'
+	bool in_header = false;
+    };
+
+    std::vector<Scope> scopes;
+
+    // The names of the next scope: a def's params, or a for's loop variable
+    std::vector<LocalName> next_names;
+
+    bool for_var_pending = false;
+
+    // Anything but a value starts the body of a for, so its loop variable
+    // isn't in the scope of the next '{'.
+    auto drop_for_var = [&]
+    {
+	if(for_var_pending)
+	    next_names.clear();
+
+	for_var_pending = false;
+    };
+
+    auto declare = [&](Symbol sym, bool is_value)
+    {
+	if(!scopes.empty() && !scopes.back().in_header)
+	    scopes.back().names.push_back({ sym, is_value });
+    };
+
+    enum class Found { none, value, function };
+
+    auto find = [&](Symbol sym)
+    {
+	for(auto s = scopes.rbegin(); s != scopes.rend(); ++s)
+	    for(auto n = s->names.rbegin(); n != s->names.rend(); ++n)
+		if(n->sym == sym)
+		    return n->is_value ? Found::value : Found::function;
+
+	NameDefinition *def = nullptr;
+
+	if(sym != ParserStarterKit::no_symbol)
+	{
+	    if(auto *p = m_names.lookup_symbol(sym))
+		def = p->get();
+	    else
+		def = lookup_builtin(sym);
+	}
+
+	if(!def)
+	    return Found::none;
+
+	return def->is<Value>() ? Found::value : Found::function;
+    };
+
+    // From a '(' through its ')'.  The signatures of lambda params, as in
+    // "body(x y)", declare nothing.
+    auto scan_params = [&](std::vector<LocalName> &params)
+    {
+	consume();
+
+	int depth = 1;
+
+	while(depth > 0)
+	{
+	    if(is(tk_identifier))
+	    {
+		if(depth == 1)
+		    params.push_back({ token_symbol(), peek() != '(' });
+	    }
+	    else if(is('('))
+		++depth;
+	    else if(is(')'))
+		--depth;
+	    else
+		return false;
+
+	    consume();
+	}
+
+	return true;
+    };
+
+    if(!scan_params(next_names) || !is('{'))
+	names_resolved = false;
+
+    while(!is(tk_EOF))
+    {
+	switch(token())
+	{
+	    case '{':
+		if(!scopes.empty())
+		    scopes.back().in_header = false;
+
+		scopes.push_back({ std::move(next_names) });
+
+		next_names.clear();
+		for_var_pending = false;
+
+		consume();
+
+		if(consume(tk_eq_arrow))
+		    if(!is('(') || !scan_params(scopes.back().names))
+			names_resolved = false;
+		continue;
+
+	    case '}':
+		if(scopes.empty())
+		    return string::npos;
+
+		scopes.pop_back();
+
+		if(scopes.empty())
+		{
+		    auto end = get_source_offset(token_loc()) + 1;
+
+		    consume();
+
+		    return end;
+		}
+		break;
+
+	    case tk_def:
+		drop_for_var();
+		consume();
+
+		if(!is(tk_identifier))
+		{
+		    names_resolved = false;
+		    continue;
+		}
+
+		declare(token_symbol(), false);
+
+		consume();
+
+		next_names.clear();
+
+		if(!is('(') || !scan_params(next_names) || !is('{'))
+		{
+		    names_resolved = false;
+		    next_names.clear();
+		}
+		continue;
+
+	    case tk_if:
+	    case tk_else:
+	    case tk_for:
+		drop_for_var();
+
+		if(!scopes.empty())
+		    scopes.back().in_header = true;
+
+		if(is(tk_for) && peek() == tk_identifier && peek(2) == '=')
+		{
+		    consume();
+
+		    next_names = { { token_symbol(), true } };
+		    for_var_pending = true;
+
+		    consume();
+		}
+		break;
+
+	    case tk_turtle:
+		consume();
+
+		if(consume('.'))
+		    consume(tk_identifier);
+		continue;
+
+	    case tk_identifier:
+		if(peek() == '=')
+		{
+		    drop_for_var();
+		    declare(token_symbol(), true);
+
+		    consume();
+		}
+		else if(auto found = find(token_symbol()); found == Found::none)
+		    names_resolved = false;
+		else if(found == Found::function)
+		    drop_for_var();
+		break;
+
+	    case tk_new_path:
+	    case tk_breakpoint:
+		drop_for_var();
+		break;
+
+	    case tk_import:
+	    case tk_param:
+	    case tk_parallel:
+		// Not allowed in a function
+		names_resolved = false;
+		break;
+
+	    default:
+		break;
+	}
+
+	consume();
+    }
+
+    return string::npos;
+}
+
+void Parser::defer_fn_definition(const string &name, Location loc)
+{
+    auto *fndef = declare_name<Function>(name, loc);
+
+    auto deferred = std::make_shared<DeferredFnDefinition>();
+
+    deferred->start = loc;
+    deferred->file_id = m_current_file_id;
+    deferred->global_names = m_global_names;
+    deferred->num_visible_names = m_global_names->size();
+
+    auto begin = get_source_offset(loc);
+
+    bool names_resolved = false;
+
+    auto end = skip_fn_definition(names_resolved);
+
+    bool well_formed = (end != string::npos);
+
+    if(!well_formed)
+	end = is(tk_EOF) ? m_source.size() : get_source_offset(token_loc());
+
+    deferred->source = m_source.substr(begin, end - begin);
+
+    fndef->set_deferred(std::move(deferred));
+
+    // Its errors are reported now, as they would have been.
+    if(!well_formed || !names_resolved)
+	compile_deferred_fn(fndef, &m_names.get_innermost_context());
+}
+
+// Compiles a deferred definition, with the global names that it can see,
+// which are taken from its module's global context, unless they're given.
+void Parser::compile_deferred_fn(Function *fndef, const ContextType *globals)
+{
+    auto deferred = fndef->take_deferred();
+
+    assert(deferred);
+
+    ContextType visible;
+
+    if(!globals)
+    {
+	const auto &module = m_files->get_file(deferred->file_id).global_context;
+
+	for(size_t i = 0; i < deferred->num_visible_names; ++i)
+	{
+	    auto sym = (*deferred->global_names)[i];
+
+	    if(auto f = module.find(sym); f != module.end())
+		visible.try_emplace(sym, f->second);
+	}
+
+	globals = &visible;
+    }
+
+    Lexer lex(deferred->source, deferred->start);
+
+    Parser p(lex, m_engine, m_debugger);
+
+    p.setup_for_import(m_files, deferred->file_id);
+
+    p.m_error_out = m_error_out;
+    p.m_throw_on_error = m_throw_on_error;
+
+    p.parse_deferred_fn(fndef, *deferred, *globals, *this);
+
+    if(p.has_error())
+	m_has_error = true;
+
+    // The debugger's location is this parser's again.
+    if(m_debugger && m_engine_loc)
+	set_engine_loc(m_engine_loc_label, m_engine_loc);
+}
+
+void Parser::parse_deferred_fn(Function *fndef,
+			       const DeferredFnDefinition &deferred,
+			       const ContextType &globals,
+			       Parser &parent)
+{
+    auto &symbols = m_files->get_symbols();
+
+    m_names.set_symbol_table(symbols);
+    m_lex.set_symbol_table(symbols);
+
+    Base::initialize();
+
+    prepare_builtin_names(&parent);
+
+    // The module's global context, as far as the definition can see it
+    push_context();
+
+    m_names.import_names(globals);
+
+    assert(is(tk_identifier) && token_loc().linenum == deferred.start.linenum);
+
+    // Before its chunk is made, so that the debugger puts it in its file
+    set_engine_loc("fndef", deferred.start);
+
+    consume(); // the name
+
+    parse_fn_params_and_body(fndef);
+
+    if(!is(tk_EOF))
+	unexpected();
+
+    pop_context();
 }
 
 Function *Parser::parse_anonymous_fn_definition(Location loc)
@@ -784,7 +1245,7 @@ bool Parser::parse_argument(FunctionBase *fndef,
 
 	if(is(tk_identifier))
 	{
-	    auto *def = lookup_name(token_str());
+	    auto *def = lookup_token_name();
 
 	    if(!def)
 		err.error("Undefined name: ", token_str());
@@ -891,7 +1352,7 @@ void Parser::parse_command_statement()
     auto name = token_str();
     auto loc = token_loc();
 
-    auto *namedef = lookup_name(name, true);
+    auto *namedef = lookup_token_name(true);
 
     if(!namedef)
 	throw PanicException(""); // error already reported
@@ -929,6 +1390,7 @@ void Parser::synchronize_after_panic()
 	    case tk_if:
 	    case tk_for:
 	    case tk_breakpoint:
+	    case tk_new_path:
 	    case tk_rcurly:
 		return;
 
@@ -947,6 +1409,7 @@ void Parser::synchronize_for_fn_params()
 	    case tk_if:
 	    case tk_for:
 	    case tk_breakpoint:
+	    case tk_new_path:
 	    case tk_rcurly:
 		throw PanicException(""); // err already reported
 		break;
@@ -1084,7 +1547,10 @@ void Parser::parse_definition()
 
     consume();
 
-    parse_fn_definition(name, loc);
+    if(m_global_names && m_context_depth == 1)
+	defer_fn_definition(name, loc);
+    else
+	parse_fn_definition(name, loc);
 }
 
 void Parser::parse_if_statement()
@@ -1150,6 +1616,21 @@ void Parser::parse_statement()
 		m_engine.compile_breakpoint();
 		break;
 
+	    case tk_new_path:
+		disallow_statements_in_modules();
+		parse_new_path_statement();
+		break;
+
+	    case tk_param:
+		disallow_statements_in_modules();
+		parse_param_statement();
+		break;
+
+	    case tk_parallel:
+		disallow_statements_in_modules();
+		parse_parallel_statement();
+		break;
+
 	    case tk_identifier:
 		if(peek() == '=')
 		    parse_value_definition();
@@ -1193,13 +1674,17 @@ void Parser::parse_statement_list()
     }
 }
 
-void Parser::import_names(size_t file_id)
+void Parser::import_names(size_t file_id, bool report_duplicates)
 {
     const auto &file = m_files->get_file(file_id);
 
     auto duplicates = m_names.import_names(file.global_context);
 
-    if(!duplicates.empty())
+    if(m_global_names && m_context_depth == 1)
+	for(const auto &name : file.global_context)
+	    m_global_names->push_back(name.first);
+
+    if(report_duplicates && !duplicates.empty())
     {
 	string names;
 
@@ -1234,25 +1719,156 @@ void Parser::parse_import_statement()
     {
 	auto [file_id, is_new] = add_file(filename);
 
+	m_files->get_file(m_current_file_id).imports.push_back(file_id);
+
 	if(is_new)
 	{
-	    std::ifstream in(filename);
+	    auto parsed = m_files->find_module(filename);
+
+	    if(parsed != FileMap::no_file)
+	    {
+		auto &file = m_files->get_file(file_id);
+		const auto &module = m_files->get_file(parsed);
+
+		file.global_context = module.global_context;
+		file.imports = module.imports;
+
+		m_files->add_imports_of(parsed);
 
-	    if(in.fail())
+		import_names(file_id);
+	    }
+	    else if(std::ifstream in(filename); in.fail())
 		error("Importing ",
 		       	filename, ": ", strerror(errno));
 	    else
 	    {
-		import_module(in, file_id);
+		// Taken before it's read, so that a change while it's being
+		// read is seen the next time.
+		auto stamp = FileMap::get_stamp(filename);
+
+		std::string content(std::istreambuf_iterator<char>(in), {});
+
+		import_module(content, file_id);
+
+		m_files->add_module(file_id, stamp);
 
 		import_names(file_id);
 	    }
 	}
+	else if(m_shares_files && !m_is_imported_module)
+	    // Duplicates are most likely the same names, already imported
+	    // through another module that imports this one.
+	    import_names(file_id, false);
     }
 
     consume(); // the filename
 }
 
+// new_path 'name' ['attributes']
+void Parser::parse_new_path_statement()
+{
+    consume();
+
+    expect(tk_string_constant);
+
+    auto name = unquote_token();
+
+    // The name becomes an XML attribute value, and so does not get escaped.
+    if(name.find_first_of("\"'<>&") != std::string::npos)
+	error("Invalid path name (no quotes, '<', '>' or '&')");
+
+    consume();
+
+    std::string attributes;
+
+    if(is(tk_string_constant))
+    {
+	attributes = unquote_token();
+	consume();
+    }
+
+    m_engine.compile_new_path(name, attributes);
+}
+
+// param name = default
+//
+// A value which is set when the program is run (see
+// ExecutionEngine::set_param()), instead of when it is compiled.
+void Parser::parse_param_statement()
+{
+    set_engine_loc("param");
+
+    if(m_context_depth != 1)
+	error("Parameters are only allowed at the global level");
+
+    consume();
+
+    expect(tk_identifier);
+
+    auto *def = declare_name<Value>(token_str(), token_loc());
+
+    string name = token_str();
+
+    consume();
+    require('=');
+
+    auto default_loc = token_loc();
+
+    auto e = parse_prefix_expression();
+
+    if(!e.is_constexpr())
+    {
+	get_error_reporter(default_loc).error("The default value of parameter '", name, "' must be a constant");
+
+	// allow parsing to continue
+	def->set_constexpr_value(0.0);
+	return;
+    }
+
+    auto offset =
+      m_engine.compile_push_value(ValueDomain::Local,
+				  m_engine.compile_param_expr(get_main(), name,
+							      e.get_constant()));
+
+    def->set_stack_offset(offset);
+}
+
+// parallel { statement... }
+//
+// Each statement is a local block of its own, so that they can be run on
+// other engines (see ExecutionEngine::compile_parallel()).
+void Parser::parse_parallel_statement()
+{
+    set_engine_loc("parallel");
+
+    if(m_context_depth != 1)
+	error("Parallel blocks are only allowed at the global level");
+
+    consume();
+
+    require('{');
+
+    std::vector<size_t> blocks;
+
+    while(!is(tk_EOF) && !is(tk_rcurly))
+    {
+	// Names defined here would only be seen by their own statement.
+	if(is(tk_def) || is(tk_import) || is(tk_param) || is(tk_parallel)
+	   || (is(tk_identifier) && peek() == '='))
+	    error("Only commands can be run in a parallel block");
+
+	EnterBlockRAII block(this);
+
+	parse_statement();
+
+	blocks.push_back(block.get_chunk_index());
+    }
+
+    require('}');
+
+    m_engine.compile_parallel(std::move(blocks));
+}
+
 void Parser::setup_for_import(std::shared_ptr<FileMap> files, size_t file_id)
 {
     assert(!file_is_initialized());
@@ -1263,14 +1879,20 @@ void Parser::setup_for_import(std::shared_ptr<FileMap> files, size_t file_id)
     m_current_file_id = file_id;
 }
 
-void Parser::import_module(std::ifstream &in, size_t file_id)
+void Parser::import_module(std::string_view source, size_t file_id)
 {
-    Lexer lex(in);
+    Lexer lex(source);
 
     Parser p(lex, m_engine, m_debugger);
 
     p.setup_for_import(m_files, file_id);
 
+    p.m_error_out = m_error_out;
+    p.m_throw_on_error = m_throw_on_error;
+
+    p.m_source = source;
+    p.m_global_names = std::make_shared<std::vector<Symbol>>();
+
     p.parse(this);
 
     if(p.has_error())
@@ -1310,7 +1932,7 @@ bool Parser::has_error() const
 
 Function *Parser::declare_builtin_cmd(const std::string &name)
 {
-    auto res = m_builtins.try_emplace(name);
+    auto res = m_builtins->try_emplace(m_names.get_symbol_table().intern(name));
 
     assert(res.second);
 
@@ -1323,8 +1945,11 @@ Function *Parser::declare_builtin_cmd(const std::string &name)
 
 void Parser::define_builtin_names()
 {
-    // turtle commands
-    using Turtle = SvgPathTurtle;
+    m_builtins = std::make_shared<std::unordered_map<Symbol, Function>>();
+
+    // turtle commands - these are the engine's OstreamTurtle's members, so
+    // their output isn't dispatched through TurtleEmitInterface.
+    using Turtle = OstreamTurtle;
 
     add_turtle_cmd("rotation",    &Turtle::rotation, "angle");
     add_turtle_cmd("scaling",     &Turtle::scaling, "x", "y");
@@ -1365,7 +1990,7 @@ void Parser::define_builtin_names()
     add_turtle_cmd("ellipse", &Turtle::ellipse, "rx", "ry");
 
     add_turtle_cmd("up", &Turtle::pen_up);
-    add_turtle_cmd("down", &Turtle::pen_down);
+    add_engine_cmd("down", &ExecutionEngine::pen_down);
     add_turtle_cmd("push", &Turtle::push);
     add_turtle_cmd("pop", &Turtle::pop);
 
@@ -1388,9 +2013,11 @@ Parser::Parser(Lexer &lex,
 	       ExecutionEngine &engine,
 	       ParserDebugSink *debugger)
     : Base(lex)
+    , m_lex(lex)
     , m_engine(engine)
     , m_debugger(debugger)
 {
+    set_name_resource(engine.get_program_memory());
 }
 
 void Parser::set_filename(const std::string &name)
@@ -1406,6 +2033,23 @@ void Parser::set_filename(const std::string &name)
     m_current_file_id = file_id;
 }
 
+bool Parser::set_filename(const std::string &name, SharedFiles files)
+{
+    assert(!file_is_initialized());
+    assert(files);
+
+    auto [file_id, is_new] = files->add_file(name);
+
+    if(!is_new)
+	return false;
+
+    m_files = std::move(files);
+    m_current_file_id = file_id;
+    m_shares_files = true;
+
+    return true;
+}
+
 const std::string &Parser::get_filename() const
 {
     assert(file_is_initialized());
@@ -1417,6 +2061,13 @@ void Parser::parse(Parser *parent_of_import)
 {
     assert(file_is_initialized());
 
+    // Identifiers are interned as they are tokenized, and looked up by
+    // Symbol from then on.
+    auto &symbols = m_files->get_symbols();
+
+    m_names.set_symbol_table(symbols);
+    m_lex.set_symbol_table(symbols);
+
     Base::initialize();
 
     prepare_builtin_names(parent_of_import);
@@ -1432,7 +2083,12 @@ void Parser::parse(Parser *parent_of_import)
 	    unexpected();
 
 	if(!parent_of_import && m_has_error)
+	{
+	    if(m_throw_on_error)
+		throw ParseError();
+
 	    exit(1);
+	}
 
 	store_global_context();
     }
@@ -1450,7 +2106,7 @@ void Parser::show_execution_errmsg(const Location &loc, std::string msg)
     if(loc)
 	get_error_reporter(loc).error(msg);
     else
-	std::cerr << "Error: " << msg << '\n';
+	*m_error_out << "Error: " << msg << '\n';
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1461,14 +2117,15 @@ void Parser::show_execution_errmsg(const Location &loc, std::string msg)
 
 std::pair<size_t, bool> Parser::FileMap::add_file(const string &name)
 {
-    auto new_id = m_by_name.size();
+    // After forget_files(), the old ids stay in use by the modules that are
+    // still cached.
+    auto new_id = m_by_id.size();
 
     auto res = m_by_name.try_emplace(name, new_id);
 
     if(res.second)
     {
-	if(new_id >= m_by_id.size())
-	    m_by_id.resize(new_id + 1);
+	m_by_id.resize(new_id + 1);
 
 	m_by_id[new_id].filename = name;
 
@@ -1494,6 +2151,105 @@ size_t Parser::FileMap::get_file_id(const string &name) const
     return f->second;
 }
 
+size_t Parser::FileMap::find_module(const string &filename) const
+{
+    auto f = m_modules.find(filename);
+
+    return f == m_modules.end() ? no_file : f->second;
+}
+
+Parser::FileMap::Stamp Parser::FileMap::get_stamp(const string &filename)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+
+    Stamp stamp;
+
+    stamp.mtime = fs::last_write_time(filename, ec);
+
+    if(!ec)
+	stamp.size = fs::file_size(filename, ec);
+
+    stamp.exists = !ec;
+
+    return stamp;
+}
+
+void Parser::FileMap::add_module(size_t file_id, const Stamp &stamp)
+{
+    auto &file = get_file(file_id);
+
+    file.stamp = stamp;
+
+    m_modules.try_emplace(file.filename, file_id);
+}
+
+std::set<string> Parser::FileMap::find_changed_modules() const
+{
+    std::set<string> changed;
+
+    for(const auto &[filename, id] : m_modules)
+	if(get_stamp(filename) != m_by_id[id].stamp)
+	    changed.insert(filename);
+
+    return changed;
+}
+
+void Parser::FileMap::forget_files(const std::set<string> &changed)
+{
+    // A module is stale if its file changed, or if it imports a stale module
+    // (whose names it has imported).
+    std::set<string> stale = changed;
+
+    auto is_stale = [&](const File &file)
+    {
+	if(stale.contains(file.filename))
+	    return true;
+
+	for(auto id : file.imports)
+	    if(stale.contains(m_by_id[id].filename))
+		return true;
+
+	return false;
+    };
+
+    for(bool more = true; more; )
+    {
+	more = false;
+
+	for(const auto &[filename, id] : m_modules)
+	    if(is_stale(m_by_id[id]) && stale.insert(filename).second)
+		more = true;
+    }
+
+    std::erase_if(m_modules, [&](const auto &module)
+    {
+	return stale.contains(module.first);
+    });
+
+    m_by_name.clear();
+}
+
+void Parser::FileMap::add_imports_of(size_t file_id)
+{
+    // Only after forget_files() can the names be missing.  Their modules
+    // weren't stale (or neither would this one be), so their old ids stay.
+    for(auto id : get_file(file_id).imports)
+	if(m_by_name.try_emplace(m_by_id[id].filename, id).second)
+	    add_imports_of(id);
+}
+
+std::vector<string> Parser::FileMap::get_filenames() const
+{
+    std::vector<string> names;
+
+    for(const auto &[name, id] : m_by_name)
+	names.push_back(name);
+
+    return names;
+}
+
 //////////////////////////////////////////////////////////////////////
 //
 //  Parser::EnterBlockRAII
@@ -1510,6 +2266,16 @@ void Parser::EnterBlockRAII::enter_fn_def()
     m_chunk_index = m_parser->m_engine.push_call_frame_chunk();
 
     m_fndef->set_chunk_index(m_chunk_index);
+
+    if(m_parser->m_debugger)
+    {
+	const auto &name = m_fndef->get_name();
+
+	if(m_fndef == m_parser->m_global_func.get())
+	    m_parser->m_debugger->set_chunk_name(m_chunk_index, "(main)");
+	else if(!name.empty())
+	    m_parser->m_debugger->set_chunk_name(m_chunk_index, name);
+    }
 }
 
 void Parser::EnterBlockRAII::enter_local_block()
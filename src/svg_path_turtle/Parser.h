@@ -34,13 +34,37 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <unordered_map>
+#include <set>
+#include <limits>
 #include <tuple>
 #include <fstream>
+#include <iostream>
 #include <stdexcept>
+#include <filesystem>
+#include <cstdint>
 
 using ParserBaseClass = ParserStarterKit::EasyParser<NameDefinition, ASTNode>;
 
+// An imported function's definition, from its name to its closing '}', kept
+// as text until the function is used (see Parser::defer_fn_definition()).
+struct DeferredFnDefinition
+{
+    std::string source;
+
+    ParserStarterKit::Location start;
+
+    size_t file_id = 0;
+
+    // The module's global names, in the order they were added, and how many
+    // of them the definition can see.
+    std::shared_ptr<std::vector<ParserStarterKit::Symbol>> global_names;
+
+    size_t num_visible_names = 0;
+};
+
 class Parser : public ParserBaseClass
 {
     //////////////////////////////////////////////////////////////////////
@@ -67,20 +91,55 @@ private:
 
     using ContextType = LexicalContextStackType::ContextType;
 
+    using Symbol = ParserStarterKit::Symbol;
+    using SymbolTable = ParserStarterKit::SymbolTable;
+
     class FileMap
     {
+    public:
+	// A file's modification time and size, to tell whether it has
+	// changed since it was read
+	struct Stamp
+	{
+	    bool exists = false;
+	    std::filesystem::file_time_type mtime{};
+	    std::uintmax_t size = 0;
+
+	    bool operator==(const Stamp &) const = default;
+	};
+
+	static Stamp get_stamp(const std::string &filename);
+
+    private:
 	struct File
 	{
 	    std::string filename;
 
+	    // For a module: its file, as it was when it was read
+	    Stamp stamp;
+
 	    ContextType global_context;
+
+	    // The modules that this one imports (as ids, since an id keeps
+	    // the name that it was imported as)
+	    std::vector<size_t> imports;
 	};
 
 	std::vector<File> m_by_id;
 
 	std::map<std::string, size_t> m_by_name;
+
+	// The modules that have been parsed, by filename.  Unlike m_by_name,
+	// they outlast forget_files(), unless their files have changed.
+	std::map<std::string, size_t> m_modules;
+
+	// The names of all of the files, since their contexts are imported
+	// into each other.
+	SymbolTable m_symbols;
 	
     public:
+	static constexpr size_t no_file = std::numeric_limits<size_t>::max();
+
 	// Returns [file_id, is_new]
 	std::pair<size_t, bool> add_file(const std::string &name);
 
@@ -88,10 +147,43 @@ private:
 
 	size_t get_file_id(const std::string &name) const;
 
+	// The module that was parsed from the file, or no_file
+	size_t find_module(const std::string &filename) const;
+
+	void add_module(size_t file_id, const Stamp &stamp);
+
+	// The modules whose files have changed since they were read (see
+	// ProgramRunner), for forget_files()
+	std::set<std::string> find_changed_modules() const;
+
+	// For a module found by find_module(): the modules that it imported
+	// (and that they imported) are taken to have been read again too, as
+	// they would have been if it had been parsed.
+	void add_imports_of(size_t file_id);
+
+	// For parsing programs again after some of the files have changed
+	// (see ProgramWatcher): every name is forgotten, so that it will be
+	// read again, but the modules whose files haven't changed, and don't
+	// import one that has, are still found by find_module().
+	void forget_files(const std::set<std::string> &changed);
+
+	// The files that have been read, as programs or as modules
+	std::vector<std::string> get_filenames() const;
+
+	SymbolTable &get_symbols()
+	{
+	    return m_symbols;
+	}
+
 	bool empty() const
 	{
 	    return m_by_id.empty();
 	}
+
+	size_t get_num_modules() const
+	{
+	    return m_modules.size();
+	}
     };
 
     class EnterBlockRAII
@@ -138,20 +230,33 @@ private:
     //
     //////////////////////////////////////////////////////////////////////
 
+    Lexer &m_lex;
+
     ExecutionEngine &m_engine;
 
     // Imported modules only allow declarations at the top level - no code.
     bool m_is_imported_module = false;
 
+    // A program whose files are shared with earlier programs (see
+    // set_filename()) takes the names of modules that are already parsed.
+    bool m_shares_files = false;
+
     bool m_has_error = false;
 
+    // Where errors are reported, and whether they throw ParseError rather
+    // than exiting (see set_error_output()).
+    std::ostream *m_error_out = &std::cerr;
+
+    bool m_throw_on_error = false;
+
     size_t m_current_file_id = std::numeric_limits<size_t>::max();
 
     std::shared_ptr<FileMap> m_files;
 
     int m_context_depth = 0;
 
-    std::map<std::string, Function> m_builtins;
+    // Shared with the parsers of imported modules, which only look them up.
+    std::shared_ptr<std::unordered_map<Symbol, Function>> m_builtins;
 
     std::unique_ptr<Function> m_global_func;
 
@@ -163,6 +268,22 @@ private:
 
     ParserDebugSink *m_debugger = nullptr;
 
+    // The last set_engine_loc(), to go back to after a deferred definition
+    // is compiled in the middle of a statement (see compile_deferred_fn()).
+    const char *m_engine_loc_label = nullptr;
+    Location m_engine_loc;
+
+    // An imported module's source, while it's parsed, so that its function
+    // definitions can be kept as text (see defer_fn_definition()), and
+    // where the last one was found in it.
+    std::string_view m_source;
+
+    size_t m_source_line_offset = 0;
+    int m_source_linenum = 1;
+
+    // With m_source, the module's global names, in the order they're added.
+    std::shared_ptr<std::vector<Symbol>> m_global_names;
+
     //////////////////////////////////////////////////////////////////////
     //
     //  Support functions
@@ -201,7 +322,7 @@ private:
 
     ASTNode make_numerical_constant_expr();
 
-    static int add_capture(Function *fndef, NameDefinition *def);
+    std::tuple<ValueDomain, int> add_capture(NameDefinition *def);
 
     // locate_name()
     //
@@ -209,7 +330,7 @@ private:
     //
     // Return value: tuple<name domain, offset>.
     //
-    // The name domain is Global, Local, or Capture.  Note that self-recursion
+    // The name domain is Global, Local, Capture, or Enclosing.  Note that self-recursion
     // is defined as Local - no need to capture a fn when it is called from its
     // own local context.
     //
@@ -262,14 +383,25 @@ private:
 
 	def->setup_decl(name, loc, get_context_depth());
 
+	if(m_global_names && get_context_depth() == 1)
+	    m_global_names->push_back(m_names.get_symbol_table().find(name));
+
 	return def;
     }
 
-    Function *lookup_builtin(const std::string &name);
+    Function *lookup_builtin(Symbol sym);
 
     NameDefinition *lookup_name(const std::string &name,
 				bool required = false);
 
+    // The same, with the symbol already interned ('name' is for errors)
+    NameDefinition *lookup_symbol(Symbol sym,
+				  const std::string &name,
+				  bool required = false);
+
+    // The name that is the current token
+    NameDefinition *lookup_token_name(bool required = false);
+
     NameDefinition *lookup_global_name(const std::string &name,
 				       bool required = false);
 
@@ -303,6 +435,21 @@ private:
 
     void parse_fn_definition(const std::string &name, Location loc);
 
+    void parse_fn_params_and_body(Function *fndef);
+
+    size_t get_source_offset(Location loc);
+
+    size_t skip_fn_definition(bool &names_resolved);
+
+    void defer_fn_definition(const std::string &name, Location loc);
+
+    void compile_deferred_fn(Function *fndef, const ContextType *globals = nullptr);
+
+    void parse_deferred_fn(Function *fndef,
+			   const DeferredFnDefinition &deferred,
+			   const ContextType &globals,
+			   Parser &parent);
+
     Function *parse_anonymous_fn_definition(Location loc);
 
     void parse_fn_call_arguments(FunctionBase *fndef);
@@ -333,6 +480,12 @@ private:
 
     void parse_import_statement();
 
+    void parse_new_path_statement();
+
+    void parse_param_statement();
+
+    void parse_parallel_statement();
+
     //////////////////////////////////////////////////////////////////////
     //
     //  Import support
@@ -343,9 +496,9 @@ private:
 
     void store_global_context();
 
-    void import_names(size_t file_id);
+    void import_names(size_t file_id, bool report_duplicates = true);
 
-    void import_module(std::ifstream &in, size_t file_id);
+    void import_module(std::string_view source, size_t file_id);
 
     bool has_error() const;
 
@@ -391,6 +544,9 @@ private:
 
 	fndef->set_chunk_index(m_engine.push_builtin_fn_chunk(nparams));
 
+	if(m_debugger)
+	    m_debugger->set_chunk_name(fndef->get_chunk_index(), name);
+
 	std::make_integer_sequence<int, nparams> positions;
 
 	builtin_cmd_helper(builder_fn, fn, positions);
@@ -425,14 +581,51 @@ private:
     }
 
 public:
+    struct ParseError : public std::runtime_error
+    {
+	ParseError()
+	    : std::runtime_error("The program has errors")
+	{
+	}
+    };
+
     Parser(Lexer &lex,
 	   ExecutionEngine &engine,
 	   ParserDebugSink *debugger = nullptr);
 
+    // By default, errors are reported on std::cerr, and the first panic (or
+    // the end of a parse with errors) exits.  A caller that outlives its
+    // programs (see RenderServer) can have the messages written to out
+    // instead, and get a ParseError exception in place of the exit.
+    void set_error_output(std::ostream &out)
+    {
+	m_error_out = &out;
+	m_throw_on_error = true;
+    }
+
     void set_filename(const std::string &name);
 
+    // For parsing several programs into one engine: files are shared with the
+    // parsers of the other programs, so a module they all import is only
+    // parsed once.  Returns false (and does nothing) if the file has already
+    // been parsed with these files, as a program or as a module.
+    using SharedFiles = std::shared_ptr<FileMap>;
+
+    bool set_filename(const std::string &name, SharedFiles files);
+
+    SharedFiles get_files() const
+    {
+	return m_files;
+    }
+
     const std::string &get_filename() const;
 
+    // The modules that were imported, counting each once
+    size_t get_num_modules() const
+    {
+	return m_files->get_num_modules();
+    }
+
     void parse(Parser *parent_of_import = nullptr);
 
     size_t get_main() const;
@@ -0,0 +1,338 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "PathBounds.h"
+#include "MathUtil.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+//////////////////////////////////////////////////////////////////////////////
+// Gathering commands
+//////////////////////////////////////////////////////////////////////////////
+
+void PathBounds::emit_char(char ch)
+{
+    if(ch != ' ' && ch != '\n' && m_command.start(ch))
+	finish_command();
+}
+
+void PathBounds::emit_flag(bool flag)
+{
+    if(m_command.add_flag(flag))
+	finish_command();
+}
+
+void PathBounds::emit_number(double val)
+{
+    if(m_command.add(val))
+	finish_command();
+}
+
+void PathBounds::finish_command()
+{
+    const PathCommand &c = m_command;
+    const double *a = c.args;
+
+    Point end = m_current;
+
+    if(c.nargs >= 2)
+	end = c.end();
+
+    ControlPoint control;
+
+    switch(c.cmd)
+    {
+	case 'M':
+	    m_start = end;
+	    break;
+
+	case 'L':
+	    add(m_current);
+	    add(end);
+	    break;
+
+	case 'H':
+	    end = { a[0], m_current.y };
+	    add(m_current);
+	    add(end);
+	    break;
+
+	case 'V':
+	    end = { m_current.x, a[0] };
+	    add(m_current);
+	    add(end);
+	    break;
+
+	case 'Z':
+	    add(m_current);
+	    end = m_start;
+	    break;
+
+	case 'Q':
+	    control = { 'Q', { a[0], a[1] } };
+	    add_quadratic(m_current, control.point, end);
+	    break;
+
+	case 'T':
+	    control = { 'Q', m_control.reflected('T', m_current) };
+	    add_quadratic(m_current, control.point, end);
+	    break;
+
+	case 'C':
+	    add_cubic(m_current, { a[0], a[1] }, { a[2], a[3] }, end);
+	    control = { 'C', { a[2], a[3] } };
+	    break;
+
+	case 'S':
+	    add_cubic(m_current, m_control.reflected('S', m_current),
+		      { a[0], a[1] }, end);
+	    control = { 'C', { a[0], a[1] } };
+	    break;
+
+	case 'A':
+	    add_arc(m_current, a[0], a[1], a[2], a[3] != 0, a[4] != 0, end);
+	    break;
+
+	default:
+	    assert(false);
+	    break;
+    }
+
+    m_current = end;
+    m_control = control;
+}
+
+void PathBounds::join(const PathBounds &other)
+{
+    Box box = m_box;
+
+    *this = other;
+
+    if(!box.empty)
+    {
+	add({ box.min_x, box.min_y });
+	add({ box.max_x, box.max_y });
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Growing the box
+//////////////////////////////////////////////////////////////////////////////
+
+void PathBounds::add(Point pt)
+{
+    if(m_box.empty)
+    {
+	m_box = { pt.x, pt.y, pt.x, pt.y, false };
+	return;
+    }
+
+    m_box.min_x = std::min(m_box.min_x, pt.x);
+    m_box.min_y = std::min(m_box.min_y, pt.y);
+    m_box.max_x = std::max(m_box.max_x, pt.x);
+    m_box.max_y = std::max(m_box.max_y, pt.y);
+}
+
+void PathBounds::add_quadratic(Point p0, Point p1, Point p2)
+{
+    add(p0);
+    add(p2);
+
+    auto at = [&](double t)
+    {
+	double u = 1 - t;
+
+	return Point{ u*u*p0.x + 2*u*t*p1.x + t*t*p2.x,
+		      u*u*p0.y + 2*u*t*p1.y + t*t*p2.y };
+    };
+
+    // Where the derivative of each coordinate is zero
+    auto extremum = [&](double v0, double v1, double v2)
+    {
+	double denom = v0 - 2*v1 + v2;
+
+	if(denom != 0)
+	{
+	    double t = (v0 - v1) / denom;
+
+	    if(t > 0 && t < 1)
+		add(at(t));
+	}
+    };
+
+    extremum(p0.x, p1.x, p2.x);
+    extremum(p0.y, p1.y, p2.y);
+}
+
+void PathBounds::add_cubic(Point p0, Point p1, Point p2, Point p3)
+{
+    add(p0);
+    add(p3);
+
+    auto at = [&](double t)
+    {
+	double u = 1 - t;
+
+	double b0 = u*u*u;
+	double b1 = 3*u*u*t;
+	double b2 = 3*u*t*t;
+	double b3 = t*t*t;
+
+	return Point{ b0*p0.x + b1*p1.x + b2*p2.x + b3*p3.x,
+		      b0*p0.y + b1*p1.y + b2*p2.y + b3*p3.y };
+    };
+
+    auto add_if_inside = [&](double t)
+    {
+	if(t > 0 && t < 1)
+	    add(at(t));
+    };
+
+    // The derivative of each coordinate is (proportional to) a*t^2 + b*t + c
+    auto extrema = [&](double v0, double v1, double v2, double v3)
+    {
+	double a = -v0 + 3*v1 - 3*v2 + v3;
+	double b = 2 * (v0 - 2*v1 + v2);
+	double c = v1 - v0;
+
+	if(std::abs(a) < 1e-12)
+	{
+	    if(b != 0)
+		add_if_inside(-c / b);
+
+	    return;
+	}
+
+	double discriminant = b*b - 4*a*c;
+
+	if(discriminant < 0)
+	    return;
+
+	double root = std::sqrt(discriminant);
+
+	add_if_inside((-b + root) / (2*a));
+	add_if_inside((-b - root) / (2*a));
+    };
+
+    extrema(p0.x, p1.x, p2.x, p3.x);
+    extrema(p0.y, p1.y, p2.y, p3.y);
+}
+
+// The arc is converted to its center and angles, as in the SVG spec's
+// implementation notes, and then the box includes the points where x and y
+// are at their extremes, if the arc gets that far around.
+void PathBounds::add_arc(Point p0, double rx, double ry, double rotation,
+			 bool large_arc, bool sweep, Point p1)
+{
+    add(p0);
+    add(p1);
+
+    rx = std::abs(rx);
+    ry = std::abs(ry);
+
+    // These are drawn as lines, or not at all.
+    if(rx == 0 || ry == 0 || (p0.x == p1.x && p0.y == p1.y))
+	return;
+
+    double sin_phi, cos_phi;
+
+    sinCosD(rotation, sin_phi, cos_phi);
+
+    double dx2 = (p0.x - p1.x) / 2;
+    double dy2 = (p0.y - p1.y) / 2;
+
+    double x1 =  cos_phi * dx2 + sin_phi * dy2;
+    double y1 = -sin_phi * dx2 + cos_phi * dy2;
+
+    // Radii that are too small are scaled up, just enough.
+    double lambda = (x1*x1) / (rx*rx) + (y1*y1) / (ry*ry);
+
+    if(lambda > 1)
+    {
+	rx *= std::sqrt(lambda);
+	ry *= std::sqrt(lambda);
+    }
+
+    double num = rx*rx*ry*ry - rx*rx*y1*y1 - ry*ry*x1*x1;
+    double den = rx*rx*y1*y1 + ry*ry*x1*x1;
+
+    double coef = std::sqrt(std::max(0.0, num / den));
+
+    if(large_arc == sweep)
+	coef = -coef;
+
+    double cx1 =  coef * rx * y1 / ry;
+    double cy1 = -coef * ry * x1 / rx;
+
+    double cx = cos_phi * cx1 - sin_phi * cy1 + (p0.x + p1.x) / 2;
+    double cy = sin_phi * cx1 + cos_phi * cy1 + (p0.y + p1.y) / 2;
+
+    double theta1 = std::atan2((y1 - cy1) / ry, (x1 - cx1) / rx);
+    double theta2 = std::atan2((-y1 - cy1) / ry, (-x1 - cx1) / rx);
+
+    double sweep_angle = theta2 - theta1;
+
+    if(sweep && sweep_angle < 0)
+	sweep_angle += 2 * PI;
+    else if(!sweep && sweep_angle > 0)
+	sweep_angle -= 2 * PI;
+
+    auto add_if_swept = [&](double theta)
+    {
+	double d = std::fmod(theta - theta1, 2 * PI);
+
+	if(sweep_angle >= 0)
+	{
+	    if(d < 0)
+		d += 2 * PI;
+
+	    if(d > sweep_angle)
+		return;
+	}
+	else
+	{
+	    if(d > 0)
+		d -= 2 * PI;
+
+	    if(d < sweep_angle)
+		return;
+	}
+
+	double c = std::cos(theta);
+	double s = std::sin(theta);
+
+	add({ cx + rx * cos_phi * c - ry * sin_phi * s,
+	      cy + rx * sin_phi * c + ry * cos_phi * s });
+    };
+
+    double theta_x = std::atan2(-ry * sin_phi, rx * cos_phi);
+    double theta_y = std::atan2( ry * cos_phi, rx * sin_phi);
+
+    add_if_swept(theta_x);
+    add_if_swept(theta_x + PI);
+    add_if_swept(theta_y);
+    add_if_swept(theta_y + PI);
+}
@@ -0,0 +1,99 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Turtle.h"
+#include "PathCommand.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// PathBounds - the bounding box of the path data, as it is produced
+//
+//   This reads the turtle's (absolute, world space) commands, like the
+//   PathSimplifier does, and grows a box around everything they draw.
+//   Lines are exact, and curves (Q, T, C, S and A) are bounded by their
+//   endpoints and extrema, so the box is as tight as the path.  Moves that
+//   aren't followed by drawing don't count.
+//
+//   The stroke width isn't known here, so it isn't included.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class PathBounds final : public TurtleEmitInterface
+{
+public:
+    struct Box
+    {
+	double min_x = 0.0;
+	double min_y = 0.0;
+	double max_x = 0.0;
+	double max_y = 0.0;
+
+	bool empty = true;
+
+	double width() const  { return max_x - min_x; }
+	double height() const { return max_y - min_y; }
+    };
+
+private:
+    using Point = PathPoint;
+
+    Box m_box;
+
+    // The command being gathered
+    PathCommand m_command;
+
+    Point m_current;
+    Point m_start;
+
+    // The control point that T or S reflects, if the last command was one
+    // that leaves one.
+    ControlPoint m_control;
+
+    void finish_command();
+
+    void add(Point pt);
+    void add_quadratic(Point p0, Point p1, Point p2);
+    void add_cubic(Point p0, Point p1, Point p2, Point p3);
+    void add_arc(Point p0, double rx, double ry, double rotation,
+		 bool large_arc, bool sweep, Point p1);
+
+public:
+    void emit_char(char ch) override;
+    void emit_flag(bool flag) override;
+    void emit_number(double val) override;
+
+    const Box &get_box() const { return m_box; }
+
+    // Forgets the box (but not the current point).
+    void clear_box()
+    {
+	m_box = {};
+    }
+
+    // Goes on from where 'other' is, which started as a copy of this one
+    // (or of an earlier state of it), keeping what both boxes hold.
+    void join(const PathBounds &other);
+};
@@ -0,0 +1,146 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <assert.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// PathCommand - gathering the turtle's path data back into commands
+//
+//   The passes that read the turtle's (absolute) output, rather than write
+//   it (PathSimplifier, PathCuller, PathBounds, PathRasterizer and
+//   PolylineWriter), get it one character, flag or number at a time.  A
+//   PathCommand collects them until a command is complete:
+//
+//	void emit_char(char ch) override
+//	{
+//	    if(ch != ' ' && ch != '\n' && m_command.start(ch))
+//		finish_command();
+//	}
+//
+//	void emit_number(double val) override
+//	{
+//	    if(m_command.add(val))
+//		finish_command();
+//	}
+//
+//   ControlPoint is what T and S need of the command before them.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+struct PathPoint
+{
+    double x = 0.0;
+    double y = 0.0;
+};
+
+// The arguments of each (absolute) command, including the destination
+// point, or -1 if it isn't one.
+inline int get_command_args_size(char cmd)
+{
+    switch(cmd)
+    {
+	case 'M': case 'L': case 'T': return 2;
+	case 'H': case 'V':           return 1;
+	case 'Q': case 'S':           return 4;
+	case 'C':                     return 6;
+	case 'A':                     return 7;
+	case 'Z':                     return 0;
+
+	default:
+	    return -1;
+    }
+}
+
+class PathCommand
+{
+public:
+    static constexpr int max_args = 7;
+
+    char cmd = 0;
+    int nargs = 0;
+    int args_needed = 0;
+    double args[max_args];
+    bool arg_is_flag[max_args];
+
+    // Starts gathering the command, and returns whether it's complete
+    // already (as Z is).
+    bool start(char ch)
+    {
+	assert(nargs == args_needed);
+
+	cmd = ch;
+	nargs = 0;
+	args_needed = get_command_args_size(ch);
+
+	assert(args_needed >= 0);
+
+	return args_needed == 0;
+    }
+
+    // Adds the next argument, and returns whether the command is complete.
+    bool add(double val, bool is_flag = false)
+    {
+	assert(nargs < args_needed);
+
+	args[nargs] = val;
+	arg_is_flag[nargs] = is_flag;
+
+	return ++nargs == args_needed;
+    }
+
+    bool add_flag(bool flag)
+    {
+	return add(flag ? 1.0 : 0.0, true);
+    }
+
+    // Where the command goes, if it has a point (H, V and Z don't).
+    PathPoint end() const
+    {
+	assert(nargs >= 2);
+
+	return { args[nargs - 2], args[nargs - 1] };
+    }
+};
+
+// T reflects the control point of a Q or T before it, and S reflects the
+// second control point of a C or S.  Otherwise, it's the current point.
+struct ControlPoint
+{
+    char cmd = 0;       // Q (for Q or T), C (for C or S), or 0 for neither
+    PathPoint point;
+
+    PathPoint reflected(char after, PathPoint current) const
+    {
+	char wanted = (after == 'T') ? 'Q' : 'C';
+
+	if(cmd != wanted)
+	    return current;
+
+	return { 2 * current.x - point.x, 2 * current.y - point.y };
+    }
+};
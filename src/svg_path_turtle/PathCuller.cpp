@@ -0,0 +1,403 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "PathCuller.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+PathCuller::PathCuller(TurtleEmitInterface &sink, const Rect &clip)
+    : m_sink(sink)
+    , m_clip(clip)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Gathering commands
+//////////////////////////////////////////////////////////////////////////////
+
+void PathCuller::emit_char(char ch)
+{
+    if(ch == ' ' || ch == '\n')
+    {
+	// The formatting stays where it was, among the commands.
+	release_move();
+	release_run();
+	m_sink.emit_char(ch);
+	return;
+    }
+
+    if(m_command.start(ch))
+	finish_command();
+}
+
+void PathCuller::emit_flag(bool flag)
+{
+    if(m_command.add_flag(flag))
+	finish_command();
+}
+
+void PathCuller::emit_number(double val)
+{
+    if(m_command.add(val))
+	finish_command();
+}
+
+void PathCuller::finish_command()
+{
+    const PathCommand &c = m_command;
+    const double *a = c.args;
+
+    switch(c.cmd)
+    {
+	case 'M':
+	    if(can_drop_subpath(false))
+		m_has_run = m_has_move = false;
+	    else
+	    {
+		release_move();
+		release_run();
+	    }
+
+	    start_subpath({ a[0], a[1] });
+	    return;
+
+	case 'Z':
+	    if(can_drop_subpath(true))
+	    {
+		// The next subpath starts here, so the move is needed again
+		// if anything is drawn.
+		m_has_run = false;
+		start_subpath(m_start);
+		return;
+	    }
+
+	    release_move();
+	    release_run();
+
+	    m_sink.emit_char('Z');
+
+	    m_current = m_start;
+	    m_control = {};
+	    m_reflection_lost = false;
+
+	    m_subpath_culled = false;
+	    m_subpath_all_culled = true;
+	    m_subpath_side = Side::inside;
+	    return;
+
+	default:
+	    break;
+    }
+
+    Side side = get_side();
+
+    if(side == Side::inside)
+	pass_on_command();
+    else
+	cull(side);
+
+    Point end;
+    ControlPoint control;
+
+    switch(c.cmd)
+    {
+	case 'H':
+	    end = { a[0], m_current.y };
+	    break;
+
+	case 'V':
+	    end = { m_current.x, a[0] };
+	    break;
+
+	case 'Q':
+	    control = { 'Q', { a[0], a[1] } };
+	    break;
+
+	case 'T':
+	    control = { 'Q', m_control.reflected('T', m_current) };
+	    break;
+
+	case 'C':
+	    control = { 'C', { a[2], a[3] } };
+	    break;
+
+	case 'S':
+	    control = { 'C', { a[0], a[1] } };
+	    break;
+
+	default:
+	    break;
+    }
+
+    if(c.cmd != 'H' && c.cmd != 'V')
+	end = c.end();
+
+    m_current = end;
+    m_control = control;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Culling
+//////////////////////////////////////////////////////////////////////////////
+
+// Which side of the clip the box around the points (grown by the margin) is
+// entirely on, if any.
+PathCuller::Side PathCuller::get_side(const Point *pts, int count,
+				      double margin) const
+{
+    double min_x = pts[0].x;
+    double min_y = pts[0].y;
+    double max_x = pts[0].x;
+    double max_y = pts[0].y;
+
+    for(int i = 1; i < count; ++i)
+    {
+	min_x = std::min(min_x, pts[i].x);
+	min_y = std::min(min_y, pts[i].y);
+	max_x = std::max(max_x, pts[i].x);
+	max_y = std::max(max_y, pts[i].y);
+    }
+
+    if(max_x + margin < m_clip.min_x) return Side::left;
+    if(min_x - margin > m_clip.max_x) return Side::right;
+    if(max_y + margin < m_clip.min_y) return Side::above;
+    if(min_y - margin > m_clip.max_y) return Side::below;
+
+    return Side::inside;
+}
+
+// A curve is inside the hull of its points and control points.  An arc is
+// within a diameter of its start, and its radii only grow (when they're too
+// small for the arc) by as much as the chord needs.
+PathCuller::Side PathCuller::get_side() const
+{
+    const PathCommand &c = m_command;
+    const double *a = c.args;
+
+    // H and V have just the one argument.
+    Point end;
+
+    if(c.nargs >= 2)
+	end = c.end();
+
+    switch(c.cmd)
+    {
+	case 'L':
+	{
+	    Point pts[] = { m_current, end };
+	    return get_side(pts, 2);
+	}
+
+	case 'H':
+	{
+	    Point pts[] = { m_current, { a[0], m_current.y } };
+	    return get_side(pts, 2);
+	}
+
+	case 'V':
+	{
+	    Point pts[] = { m_current, { m_current.x, a[0] } };
+	    return get_side(pts, 2);
+	}
+
+	case 'Q':
+	{
+	    Point pts[] = { m_current, { a[0], a[1] }, end };
+	    return get_side(pts, 3);
+	}
+
+	case 'T':
+	{
+	    Point pts[] = { m_current, m_control.reflected('T', m_current), end };
+	    return get_side(pts, 3);
+	}
+
+	case 'C':
+	{
+	    Point pts[] = { m_current, { a[0], a[1] }, { a[2], a[3] }, end };
+	    return get_side(pts, 4);
+	}
+
+	case 'S':
+	{
+	    Point pts[] = { m_current, m_control.reflected('S', m_current),
+			    { a[0], a[1] }, end };
+	    return get_side(pts, 4);
+	}
+
+	case 'A':
+	{
+	    Point pts[] = { m_current, end };
+
+	    double rx = std::abs(a[0]);
+	    double ry = std::abs(a[1]);
+
+	    double radius = 0.0;
+
+	    if(rx != 0 && ry != 0)
+	    {
+		double chord = std::hypot(end.x - m_current.x,
+					  end.y - m_current.y);
+
+		radius = std::max(rx, ry)
+		       * std::max(1.0, chord / (2 * std::min(rx, ry)));
+	    }
+
+	    return get_side(pts, 2, 2 * radius);
+	}
+
+	default:
+	    assert(false);
+	    return Side::inside;
+    }
+}
+
+void PathCuller::cull(Side side)
+{
+    if(!m_subpath_culled)
+	m_subpath_side = side;
+    else if(side != m_subpath_side)
+	m_subpath_all_culled = false;
+
+    m_subpath_culled = true;
+
+    if(m_has_run && side != m_run_side)
+    {
+	// The subpath can't be dropped now, so its move is needed first.
+	release_move();
+	release_run();
+    }
+
+    m_has_run = true;
+    m_run_side = side;
+
+    m_reflection_lost = true;
+}
+
+void PathCuller::pass_on_command()
+{
+    m_subpath_all_culled = false;
+
+    release_move();
+    release_run();
+
+    const PathCommand &c = m_command;
+
+    if(m_reflection_lost && c.cmd == 'T')
+    {
+	pass_on('Q', m_control.reflected('T', m_current));
+	pass_on(c.args, c.arg_is_flag, 2);
+    }
+    else if(m_reflection_lost && c.cmd == 'S')
+    {
+	pass_on('C', m_control.reflected('S', m_current));
+	pass_on(c.args, c.arg_is_flag, 4);
+    }
+    else
+    {
+	m_sink.emit_char(c.cmd);
+	pass_on(c.args, c.arg_is_flag, c.nargs);
+    }
+
+    m_reflection_lost = false;
+}
+
+// Everything in the subpath, since its move, was culled on one side.  When
+// nothing was drawn at all, a move can be dropped (as another one replaces
+// it), but a Z draws a dot.
+bool PathCuller::can_drop_subpath(bool closing) const
+{
+    if(!m_has_move || !m_subpath_all_culled)
+	return false;
+
+    return m_subpath_culled || !closing;
+}
+
+void PathCuller::start_subpath(Point start)
+{
+    m_has_move = true;
+    m_current = m_start = start;
+
+    m_control = {};
+    m_reflection_lost = false;
+
+    m_subpath_culled = false;
+    m_subpath_all_culled = true;
+    m_subpath_side = Side::inside;
+}
+
+void PathCuller::release_move()
+{
+    if(!m_has_move)
+	return;
+
+    m_has_move = false;
+
+    pass_on('M', m_start);
+}
+
+// The run ends at the current point, since the command after it hasn't
+// been taken yet.
+void PathCuller::release_run()
+{
+    if(!m_has_run)
+	return;
+
+    m_has_run = false;
+
+    pass_on('L', m_current);
+}
+
+void PathCuller::flush()
+{
+    if(can_drop_subpath(false))
+	m_has_run = m_has_move = false;
+    else
+    {
+	release_move();
+	release_run();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Output
+//////////////////////////////////////////////////////////////////////////////
+
+void PathCuller::pass_on(const double *args, const bool *is_flag, int nargs)
+{
+    for(int i = 0; i < nargs; ++i)
+	if(is_flag[i])
+	    m_sink.emit_flag(args[i] != 0.0);
+	else
+	    m_sink.emit_number(args[i]);
+}
+
+void PathCuller::pass_on(char cmd, Point pt)
+{
+    m_sink.emit_char(cmd);
+    m_sink.emit_number(pt.x);
+    m_sink.emit_number(pt.y);
+}
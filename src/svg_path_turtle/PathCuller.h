@@ -0,0 +1,138 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Turtle.h"
+#include "PathCommand.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// PathCuller - drops what is drawn outside a clip rectangle
+//
+//   This sits between the turtle and the rest of the output, like the
+//   PathSimplifier, so the turtle itself moves exactly as it would without
+//   it.  Each command's conservative bounds (its points, and for curves,
+//   their control points or radii) are checked against the clip:
+//
+//   - A segment that is entirely to one side of the clip is culled.  A run
+//     of them on the same side becomes one line, to where the run ends.
+//     That line is on the same side, so fills inside the clip don't change.
+//
+//   - A subpath with everything culled on one side is dropped, with its
+//     move, since it can't draw anything inside the clip at all.
+//
+//   - T and S after a culled command are written as Q and C, since the
+//     control point they would reflect isn't there any more.
+//
+//   Strokes are wider than the path, so the clip should be larger than the
+//   area that's wanted, by half the stroke width.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class PathCuller final : public TurtleEmitInterface
+{
+public:
+    struct Rect
+    {
+	double min_x = 0.0;
+	double min_y = 0.0;
+	double max_x = 0.0;
+	double max_y = 0.0;
+    };
+
+private:
+    using Point = PathPoint;
+
+    // Which side of the clip a culled command is on
+    enum class Side
+    {
+	inside,
+	left,
+	right,
+	above,
+	below
+    };
+
+    TurtleEmitInterface &m_sink;
+
+    Rect m_clip;
+
+    // The command being gathered
+    PathCommand m_command;
+
+    Point m_current;
+    Point m_start;
+
+    // The control point that T or S reflects, if the last command left one.
+    ControlPoint m_control;
+
+    // Whether the control point that a T or S after this would reflect was
+    // culled (or is otherwise not what the output has).
+    bool m_reflection_lost = false;
+
+    // The subpath's move, if it hasn't been passed on yet
+    bool m_has_move = false;
+
+    // Whether anything was culled in this subpath, and whether all of it
+    // was (so far), on m_subpath_side.
+    bool m_subpath_culled = false;
+    bool m_subpath_all_culled = true;
+    Side m_subpath_side = Side::inside;
+
+    // A run of culled commands, all on m_run_side, ending at m_current
+    bool m_has_run = false;
+    Side m_run_side = Side::inside;
+
+    void finish_command();
+
+    Side get_side(const Point *pts, int count, double margin = 0.0) const;
+    Side get_side() const;
+
+    void cull(Side side);
+    void pass_on_command();
+
+    bool can_drop_subpath(bool closing) const;
+
+    void release_move();
+    void release_run();
+
+    void start_subpath(Point start);
+
+    void pass_on(const double *args, const bool *is_flag, int nargs);
+    void pass_on(char cmd, Point pt);
+
+public:
+    PathCuller(const PathCuller &) = delete;
+    PathCuller &operator=(const PathCuller &) = delete;
+
+    PathCuller(TurtleEmitInterface &sink, const Rect &clip);
+
+    void emit_char(char ch) override;
+    void emit_flag(bool flag) override;
+    void emit_number(double val) override;
+
+    // Passes on whatever is held back, at the end of the output.
+    void flush();
+};
@@ -0,0 +1,234 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "PathSimplifier.h"
+
+#include <cassert>
+#include <cmath>
+
+PathSimplifier::PathSimplifier(TurtleEmitInterface &sink, double tolerance)
+    : m_sink(sink)
+    , m_tolerance(tolerance)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Gathering commands
+//////////////////////////////////////////////////////////////////////////////
+
+void PathSimplifier::emit_char(char ch)
+{
+    if(ch == ' ' || ch == '\n')
+    {
+	// Lines aren't merged across the formatting commands, but a held move
+	// can wait until something is drawn.
+	release_line();
+	m_sink.emit_char(ch);
+	return;
+    }
+
+    if(m_command.start(ch))
+	finish_command();
+}
+
+void PathSimplifier::emit_flag(bool flag)
+{
+    if(m_command.add_flag(flag))
+	finish_command();
+}
+
+void PathSimplifier::emit_number(double val)
+{
+    if(m_command.add(val))
+	finish_command();
+}
+
+void PathSimplifier::finish_command()
+{
+    const PathCommand &c = m_command;
+
+    switch(c.cmd)
+    {
+	case 'M':
+	    move_to({ c.args[0], c.args[1] });
+	    break;
+
+	case 'L':
+	    line_to({ c.args[0], c.args[1] });
+	    break;
+
+	case 'H':
+	    line_to({ c.args[0], m_current.y });
+	    break;
+
+	case 'V':
+	    line_to({ m_current.x, c.args[0] });
+	    break;
+
+	case 'Z':
+	    release_line();
+	    release_move();
+
+	    m_sink.emit_char('Z');
+
+	    m_current = m_start;
+	    break;
+
+	default:
+	    release_line();
+	    release_move();
+
+	    pass_on(c.cmd, c.args, c.arg_is_flag, c.nargs);
+
+	    m_current = c.end();
+	    break;
+    }
+}
+
+void PathSimplifier::flush()
+{
+    release_line();
+
+    // A move with nothing drawn after it is dropped, but a dot isn't.
+    if(m_has_dot)
+	release_move(true);
+
+    m_has_move = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Simplifying
+//////////////////////////////////////////////////////////////////////////////
+
+void PathSimplifier::move_to(Point pt)
+{
+    release_line();
+
+    // A previous move that drew nothing is simply replaced, unless it drew a
+    // dot.
+    if(m_has_dot)
+	release_move(true);
+
+    m_has_move = true;
+    m_current = m_start = pt;
+}
+
+void PathSimplifier::line_to(Point pt)
+{
+    const double dx = pt.x - m_current.x;
+    const double dy = pt.y - m_current.y;
+
+    const double length = std::sqrt(dx*dx + dy*dy);
+
+    if(length <= m_tolerance)
+    {
+	if(m_has_move && !m_has_dot)
+	    m_has_dot = true;
+
+	return;
+    }
+
+    if(m_has_line && extends_line(pt))
+    {
+	m_line_length = (pt.x - m_line_start.x) * m_line_dir.x
+		      + (pt.y - m_line_start.y) * m_line_dir.y;
+	m_current = pt;
+	return;
+    }
+
+    release_line();
+    release_move();
+
+    m_has_line = true;
+    m_line_start = m_current;
+    m_line_dir = { dx / length, dy / length };
+    m_line_length = length;
+
+    m_current = pt;
+}
+
+// Whether pt continues the held line, in the same direction.
+//
+// Each point of the line is kept within half the tolerance of the line's
+// first segment (extended).  The line that is passed on ends at one of
+// those points, so it stays within the tolerance of all of them.
+bool PathSimplifier::extends_line(Point pt) const
+{
+    const double dx = pt.x - m_line_start.x;
+    const double dy = pt.y - m_line_start.y;
+
+    const double along = dx * m_line_dir.x + dy * m_line_dir.y;
+    const double across = dx * m_line_dir.y - dy * m_line_dir.x;
+
+    return along > m_line_length && std::abs(across) <= m_tolerance / 2;
+}
+
+// The dot is only needed when nothing else is drawn after it (anything
+// that is would cover it).
+void PathSimplifier::release_move(bool with_dot)
+{
+    if(!m_has_move)
+	return;
+
+    pass_on('M', m_start);
+
+    if(m_has_dot && with_dot)
+	pass_on('L', m_start);
+
+    m_has_move = false;
+    m_has_dot = false;
+}
+
+void PathSimplifier::release_line()
+{
+    if(!m_has_line)
+	return;
+
+    m_has_line = false;
+
+    pass_on('L', m_current);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Output
+//////////////////////////////////////////////////////////////////////////////
+
+void PathSimplifier::pass_on(char cmd, const double *args, const bool *is_flag,
+			     int nargs)
+{
+    m_sink.emit_char(cmd);
+
+    for(int i = 0; i < nargs; ++i)
+	if(is_flag[i])
+	    m_sink.emit_flag(args[i] != 0.0);
+	else
+	    m_sink.emit_number(args[i]);
+}
+
+void PathSimplifier::pass_on(char cmd, Point pt)
+{
+    m_sink.emit_char(cmd);
+    m_sink.emit_number(pt.x);
+    m_sink.emit_number(pt.y);
+}
@@ -0,0 +1,109 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Turtle.h"
+#include "PathCommand.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// PathSimplifier - a peephole pass over the path data
+//
+//   This sits between the turtle and whatever formats its output, and passes
+//   on a simpler path that draws the same thing (within the tolerance):
+//
+//   - A run of collinear lines, drawn in one direction, becomes one line.
+//
+//   - Zero-length lines are dropped.  A lone one right after a move is kept,
+//     since that is how a dot is drawn.
+//
+//   - Moves that aren't followed by any drawing are dropped, so a chain of
+//     moves collapses into the last one.
+//
+//   Everything is held back only as long as it takes to decide, so it works
+//   on a stream of any length.  The turtle's commands are all absolute, and
+//   so are the commands passed on.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class PathSimplifier final : public TurtleEmitInterface
+{
+    using Point = PathPoint;
+
+    TurtleEmitInterface &m_sink;
+
+    double m_tolerance;
+
+    // The command being gathered
+    PathCommand m_command;
+
+    // The current point and the subpath start, including what is held back
+    Point m_current;
+    Point m_start;
+
+    // A move that hasn't been passed on yet, maybe with a dot after it
+    bool m_has_move = false;
+    bool m_has_dot = false;
+
+    // A line that hasn't been passed on yet, from m_line_start to m_current.
+    // m_line_dir is the unit vector of its first segment, and m_line_length
+    // is how far along it m_current is.
+    bool m_has_line = false;
+    Point m_line_start;
+    Point m_line_dir;
+    double m_line_length = 0.0;
+
+    void finish_command();
+
+    void move_to(Point pt);
+    void line_to(Point pt);
+
+    bool extends_line(Point pt) const;
+
+    void release_move(bool with_dot = false);
+    void release_line();
+
+    void pass_on(char cmd, const double *args, const bool *is_flag, int nargs);
+    void pass_on(char cmd, Point pt);
+
+public:
+    PathSimplifier(const PathSimplifier &) = delete;
+    PathSimplifier &operator=(const PathSimplifier &) = delete;
+
+    // tolerance is the largest distance that any point drawn may move
+    PathSimplifier(TurtleEmitInterface &sink, double tolerance);
+
+    void set_tolerance(double tolerance)
+    {
+	m_tolerance = tolerance;
+    }
+
+    void emit_char(char ch) override;
+    void emit_flag(bool flag) override;
+    void emit_number(double val) override;
+
+    // Passes on whatever is held back, at the end of the output.
+    void flush();
+};
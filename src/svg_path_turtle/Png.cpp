@@ -0,0 +1,438 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Png.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdlib>
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////////
+// Checksums
+//////////////////////////////////////////////////////////////////////////////
+
+std::uint32_t crc32(const std::uint8_t *data, size_t size,
+		    std::uint32_t crc = 0)
+{
+    static const auto table = []
+    {
+	std::array<std::uint32_t, 256> t;
+
+	for(std::uint32_t n = 0; n < 256; ++n)
+	{
+	    std::uint32_t c = n;
+
+	    for(int k = 0; k < 8; ++k)
+		c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+
+	    t[n] = c;
+	}
+
+	return t;
+    }();
+
+    crc = ~crc;
+
+    for(size_t i = 0; i < size; ++i)
+	crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+std::uint32_t adler32(const std::vector<std::uint8_t> &data)
+{
+    std::uint32_t a = 1, b = 0;
+
+    // The sums can go this far before they must be reduced.
+    constexpr size_t block = 5552;
+
+    for(size_t i = 0; i < data.size(); )
+    {
+	size_t end = std::min(data.size(), i + block);
+
+	for(; i < end; ++i)
+	{
+	    a += data[i];
+	    b += a;
+	}
+
+	a %= 65521;
+	b %= 65521;
+    }
+
+    return (b << 16) | a;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Deflate, with the fixed Huffman codes
+//////////////////////////////////////////////////////////////////////////////
+
+class BitWriter
+{
+    std::vector<std::uint8_t> &m_out;
+
+    std::uint32_t m_bits = 0;
+    int m_count = 0;
+
+public:
+    explicit BitWriter(std::vector<std::uint8_t> &out)
+	: m_out(out)
+    {
+    }
+
+    // Least significant bit first, as deflate packs its values
+    void write(std::uint32_t value, int count)
+    {
+	m_bits |= value << m_count;
+	m_count += count;
+
+	while(m_count >= 8)
+	{
+	    m_out.push_back(static_cast<std::uint8_t>(m_bits));
+	    m_bits >>= 8;
+	    m_count -= 8;
+	}
+    }
+
+    // Huffman codes go most significant bit first.
+    void write_code(std::uint32_t code, int length)
+    {
+	std::uint32_t reversed = 0;
+
+	for(int i = 0; i < length; ++i)
+	    reversed |= ((code >> i) & 1) << (length - 1 - i);
+
+	write(reversed, length);
+    }
+
+    void flush()
+    {
+	if(m_count > 0)
+	    m_out.push_back(static_cast<std::uint8_t>(m_bits));
+
+	m_bits = 0;
+	m_count = 0;
+    }
+};
+
+void write_literal(BitWriter &bits, int symbol)
+{
+    if(symbol < 144)
+	bits.write_code(0x30 + symbol, 8);
+    else if(symbol < 256)
+	bits.write_code(0x190 + symbol - 144, 9);
+    else if(symbol < 280)
+	bits.write_code(symbol - 256, 7);
+    else
+	bits.write_code(0xc0 + symbol - 280, 8);
+}
+
+constexpr int length_base[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+constexpr int length_extra[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+constexpr int distance_base[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+
+constexpr int distance_extra[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+void write_match(BitWriter &bits, int length, int distance)
+{
+    int l = 28;
+
+    while(length_base[l] > length)
+	--l;
+
+    write_literal(bits, 257 + l);
+    bits.write(length - length_base[l], length_extra[l]);
+
+    int d = 29;
+
+    while(distance_base[d] > distance)
+	--d;
+
+    bits.write_code(d, 5);
+    bits.write(distance - distance_base[d], distance_extra[d]);
+}
+
+// One fixed-code block, with matches found through a hash of the next three
+// bytes, trying the last few places they came up.
+std::vector<std::uint8_t> deflate(const std::vector<std::uint8_t> &data)
+{
+    constexpr int window = 32768;
+    constexpr int min_match = 3;
+    constexpr int max_match = 258;
+    constexpr int max_chain = 16;
+    constexpr int hash_bits = 15;
+
+    std::vector<std::uint8_t> out;
+
+    out.reserve(data.size() / 4 + 64);
+
+    BitWriter bits(out);
+
+    bits.write(1, 1); // the final block
+    bits.write(1, 2); // fixed codes
+
+    std::vector<int> head(1 << hash_bits, -1);
+    std::vector<int> prev(window, -1);
+
+    const int size = static_cast<int>(data.size());
+
+    auto hash = [&](int i)
+    {
+	std::uint32_t h = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+
+	return (h * 2654435761u) >> (32 - hash_bits);
+    };
+
+    auto insert = [&](int i)
+    {
+	if(i + min_match > size)
+	    return;
+
+	auto h = hash(i);
+
+	prev[i % window] = head[h];
+	head[h] = i;
+    };
+
+    for(int i = 0; i < size; )
+    {
+	int best_length = 0;
+	int best_distance = 0;
+
+	if(i + min_match <= size)
+	{
+	    int limit = std::min(max_match, size - i);
+
+	    int candidate = head[hash(i)];
+
+	    for(int chain = 0; candidate >= 0 && i - candidate <= window
+			       && chain < max_chain; ++chain)
+	    {
+		int length = 0;
+
+		while(length < limit
+		      && data[candidate + length] == data[i + length])
+		    ++length;
+
+		if(length > best_length)
+		{
+		    best_length = length;
+		    best_distance = i - candidate;
+
+		    if(length == limit)
+			break;
+		}
+
+		candidate = prev[candidate % window];
+	    }
+	}
+
+	if(best_length >= min_match)
+	{
+	    write_match(bits, best_length, best_distance);
+
+	    for(int end = i + best_length; i < end; ++i)
+		insert(i);
+	}
+	else
+	{
+	    write_literal(bits, data[i]);
+	    insert(i);
+	    ++i;
+	}
+    }
+
+    write_literal(bits, 256); // the end of the block
+
+    bits.flush();
+
+    return out;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// PNG
+//////////////////////////////////////////////////////////////////////////////
+
+void put_u32(std::vector<std::uint8_t> &v, std::uint32_t n)
+{
+    v.push_back(static_cast<std::uint8_t>(n >> 24));
+    v.push_back(static_cast<std::uint8_t>(n >> 16));
+    v.push_back(static_cast<std::uint8_t>(n >> 8));
+    v.push_back(static_cast<std::uint8_t>(n));
+}
+
+void write_chunk(std::ostream &out, const char *type,
+		 const std::vector<std::uint8_t> &data)
+{
+    std::vector<std::uint8_t> chunk;
+
+    put_u32(chunk, static_cast<std::uint32_t>(data.size()));
+
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+
+    put_u32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+
+    out.write(reinterpret_cast<const char *>(chunk.data()),
+	      static_cast<std::streamsize>(chunk.size()));
+}
+
+std::uint8_t paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+
+    if(pa <= pb && pa <= pc)
+	return static_cast<std::uint8_t>(a);
+
+    return static_cast<std::uint8_t>(pb <= pc ? b : c);
+}
+
+// Each row is filtered the way that leaves the smallest differences (as
+// signed bytes), as the PNG spec suggests.
+std::vector<std::uint8_t> filter_rows(long width, long height,
+				      const std::vector<std::uint8_t> &rgba)
+{
+    const size_t stride = static_cast<size_t>(width) * 4;
+
+    std::vector<std::uint8_t> filtered;
+
+    filtered.reserve((stride + 1) * static_cast<size_t>(height));
+
+    std::vector<std::uint8_t> zero_row(stride, 0);
+    std::array<std::vector<std::uint8_t>, 5> candidates;
+
+    for(auto &c : candidates)
+	c.resize(stride);
+
+    for(long y = 0; y < height; ++y)
+    {
+	const std::uint8_t *row = rgba.data() + y * stride;
+	const std::uint8_t *up = y > 0 ? row - stride : zero_row.data();
+
+	for(size_t x = 0; x < stride; ++x)
+	{
+	    int a = x >= 4 ? row[x - 4] : 0;
+	    int b = up[x];
+	    int c = x >= 4 ? up[x - 4] : 0;
+
+	    candidates[0][x] = row[x];
+	    candidates[1][x] = static_cast<std::uint8_t>(row[x] - a);
+	    candidates[2][x] = static_cast<std::uint8_t>(row[x] - b);
+	    candidates[3][x] = static_cast<std::uint8_t>(row[x] - (a + b) / 2);
+	    candidates[4][x] = static_cast<std::uint8_t>(row[x] - paeth(a, b, c));
+	}
+
+	size_t best = 0;
+	long best_sum = -1;
+
+	for(size_t f = 0; f < candidates.size(); ++f)
+	{
+	    long sum = 0;
+
+	    for(auto byte : candidates[f])
+		sum += std::abs(static_cast<std::int8_t>(byte));
+
+	    if(best_sum < 0 || sum < best_sum)
+	    {
+		best = f;
+		best_sum = sum;
+	    }
+	}
+
+	filtered.push_back(static_cast<std::uint8_t>(best));
+	filtered.insert(filtered.end(), candidates[best].begin(),
+					candidates[best].end());
+    }
+
+    return filtered;
+}
+
+} // namespace
+
+void write_png(std::ostream &out, long width, long height,
+	       const std::vector<std::uint8_t> &rgba)
+{
+    assert(rgba.size() == static_cast<size_t>(width * height * 4));
+
+    static const std::uint8_t signature[8] =
+    {
+	0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+    };
+
+    out.write(reinterpret_cast<const char *>(signature), sizeof signature);
+
+    std::vector<std::uint8_t> header;
+
+    put_u32(header, static_cast<std::uint32_t>(width));
+    put_u32(header, static_cast<std::uint32_t>(height));
+
+    header.push_back(8); // bits per channel
+    header.push_back(6); // RGBA
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // not interlaced
+
+    write_chunk(out, "IHDR", header);
+
+    auto filtered = filter_rows(width, height, rgba);
+
+    // A zlib stream: its header (deflate, 32K window, no dictionary), the
+    // compressed data, and the Adler-32 of what was compressed
+    std::vector<std::uint8_t> zlib = { 0x78, 0x01 };
+
+    auto compressed = deflate(filtered);
+
+    zlib.insert(zlib.end(), compressed.begin(), compressed.end());
+
+    put_u32(zlib, adler32(filtered));
+
+    write_chunk(out, "IDAT", zlib);
+    write_chunk(out, "IEND", {});
+}
@@ -0,0 +1,241 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Polyline.h"
+#include "LittleEndian.h"
+
+#include <cassert>
+#include <limits>
+
+static constexpr char s_magic[4] = { 'S', 'P', 'T', 'L' };
+static constexpr char s_version = 1;
+
+PolylineWriter::PolylineWriter(std::streambuf &out, double tolerance)
+    : out(out)
+    , m_tolerance(tolerance)
+{
+    assert(tolerance > 0);
+
+    const char header[8] = { s_magic[0], s_magic[1], s_magic[2], s_magic[3],
+			     s_version, sizeof(float), 0, 0 };
+
+    out.sputn(header, sizeof(header));
+}
+
+void PolylineWriter::new_path()
+{
+    end_polyline();
+
+    write_record(new_path_start, nullptr, 0);
+}
+
+void PolylineWriter::finish()
+{
+    end_polyline();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Gathering commands
+//////////////////////////////////////////////////////////////////////////////
+
+void PolylineWriter::emit_char(char ch)
+{
+    if(ch != ' ' && ch != '\n' && m_command.start(ch))
+	finish_command();
+}
+
+void PolylineWriter::emit_flag(bool flag)
+{
+    if(m_command.add_flag(flag))
+	finish_command();
+}
+
+void PolylineWriter::emit_number(double val)
+{
+    if(m_command.add(val))
+	finish_command();
+}
+
+void PolylineWriter::finish_command()
+{
+    const PathCommand &c = m_command;
+    const double *a = c.args;
+
+    Point end = m_current;
+
+    if(c.nargs >= 2)
+	end = c.end();
+
+    ControlPoint control;
+
+    auto line = [this](double x, double y)
+    {
+	line_to({ x, y });
+    };
+
+    switch(c.cmd)
+    {
+	case 'M':
+	    move_to(end);
+	    break;
+
+	case 'L':
+	    line_to(end);
+	    break;
+
+	case 'H':
+	    end = { a[0], m_current.y };
+	    line_to(end);
+	    break;
+
+	case 'V':
+	    end = { m_current.x, a[0] };
+	    line_to(end);
+	    break;
+
+	case 'Z':
+	    close_subpath();
+	    end = m_start;
+	    break;
+
+	case 'Q':
+	    control = { 'Q', { a[0], a[1] } };
+	    flatten_quadratic(m_current, control.point, end, m_tolerance, line);
+	    break;
+
+	case 'T':
+	    control = { 'Q', m_control.reflected('T', m_current) };
+	    flatten_quadratic(m_current, control.point, end, m_tolerance, line);
+	    break;
+
+	case 'C':
+	{
+	    Point c1{ a[0], a[1] };
+	    Point c2{ a[2], a[3] };
+
+	    flatten_cubic(m_current, c1, c2, end, m_tolerance, line);
+
+	    control = { 'C', c2 };
+	    break;
+	}
+
+	case 'S':
+	{
+	    Point c2{ a[0], a[1] };
+
+	    flatten_cubic(m_current, m_control.reflected('S', m_current), c2, end,
+			  m_tolerance, line);
+
+	    control = { 'C', c2 };
+	    break;
+	}
+
+	case 'A':
+	    flatten_arc(m_current, a[0], a[1], a[2], a[3] != 0, a[4] != 0,
+			end, m_tolerance, line);
+	    break;
+
+	default:
+	    assert(false);
+	    break;
+    }
+
+    m_current = end;
+    m_control = control;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Polylines
+//////////////////////////////////////////////////////////////////////////////
+
+void PolylineWriter::move_to(Point pt)
+{
+    end_polyline();
+
+    m_current = m_start = pt;
+}
+
+void PolylineWriter::line_to(Point pt)
+{
+    // A record's vertex count is 32 bits, so a longer subpath goes on in
+    // the next one.
+    static constexpr size_t max_values
+	    = 2 * size_t(std::numeric_limits<std::uint32_t>::max());
+
+    if(m_vertices.size() == max_values)
+    {
+	float x = m_vertices[max_values - 2];
+	float y = m_vertices[max_values - 1];
+
+	end_polyline();
+
+	m_vertices.push_back(x);
+	m_vertices.push_back(y);
+    }
+
+    if(m_vertices.empty())
+    {
+	m_start = m_current;
+
+	m_vertices.push_back(static_cast<float>(m_current.x));
+	m_vertices.push_back(static_cast<float>(m_current.y));
+    }
+
+    m_vertices.push_back(static_cast<float>(pt.x));
+    m_vertices.push_back(static_cast<float>(pt.y));
+
+    m_current = pt;
+}
+
+void PolylineWriter::close_subpath()
+{
+    if(m_vertices.empty())
+	return;
+
+    if(m_current.x != m_start.x || m_current.y != m_start.y)
+	line_to(m_start);
+
+    end_polyline(closed);
+}
+
+void PolylineWriter::end_polyline(std::uint32_t flags)
+{
+    if(m_vertices.empty())
+	return;
+
+    write_record(flags, m_vertices.data(), m_vertices.size());
+
+    m_vertices.clear();
+}
+
+void PolylineWriter::write_record(std::uint32_t flags,
+				  const float *values,
+				  size_t size)
+{
+    const std::uint32_t header[2] = { static_cast<std::uint32_t>(size / 2),
+				      flags };
+
+    write_little_endian(out, header, 2);
+    write_little_endian(out, values, size);
+}
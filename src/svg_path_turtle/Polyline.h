@@ -0,0 +1,120 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Turtle.h"
+#include "Flatten.h"
+#include "PathCommand.h"
+
+#include <streambuf>
+#include <vector>
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// PolylineWriter - the path data as polylines, with the curves flattened
+//
+//   For pen plotters and GPU renderers, which only draw lines, and would
+//   otherwise parse the path data and flatten its curves themselves.  It
+//   reads the turtle's (absolute) commands, as PathRasterizer does,
+//   flattens Q, T, C, S and A as they come (see Flatten.h), so that no
+//   point of a curve is further than the tolerance from the lines, and
+//   writes each subpath as an array of floats, with no commands at all.
+//
+//   Header (8 bytes):
+//
+//     "SPTL"           magic
+//     version          1 byte (1)
+//     value size       1 byte (4 = float32)
+//     reserved         2 bytes (0)
+//
+//   Then one record per polyline:
+//
+//     vertex count     uint32, little-endian
+//     flags            uint32, little-endian: closed (1) if the subpath
+//                      was closed (and its last vertex is its first again),
+//                      or new path (2) for a record with no vertices, which
+//                      starts a new path (see new_path)
+//     vertices         x, y for each, as little-endian float32
+//
+//   So every value is 4-byte aligned, and a record's vertices can be handed
+//   to a vertex buffer (or a plotter's driver) just as they are.  A subpath
+//   of a lone M draws nothing, and is left out.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class PolylineWriter final : public TurtleEmitInterface
+{
+public:
+    enum Flags : std::uint32_t
+    {
+	closed = 1,
+	new_path_start = 2,
+    };
+
+private:
+    using Point = CurvePoint;
+
+    std::streambuf &out;
+
+    // In the path data's units
+    double m_tolerance;
+
+    // The command being gathered
+    PathCommand m_command;
+
+    Point m_current;
+    Point m_start;
+
+    ControlPoint m_control;
+
+    // The subpath's vertices (x, y, x, y...), until it ends
+    std::vector<float> m_vertices;
+
+    void finish_command();
+
+    void move_to(Point pt);
+    void line_to(Point pt);
+    void close_subpath();
+
+    // Writes the subpath so far (if it has any lines), and starts another.
+    void end_polyline(std::uint32_t flags = 0);
+
+    void write_record(std::uint32_t flags, const float *values, size_t size);
+
+public:
+    PolylineWriter(std::streambuf &out, double tolerance);
+
+    // The subpath so far is written, then the record that starts a new
+    // path.
+    void new_path();
+
+    // Writes the last subpath.
+    void finish();
+
+    void emit_char(char ch) override;
+    void emit_flag(bool flag) override;
+    void emit_number(double val) override;
+};
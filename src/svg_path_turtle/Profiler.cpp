@@ -0,0 +1,260 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <format>
+
+Profiler::Profiler(unsigned sample_interval)
+    : m_sample_interval(sample_interval)
+{
+}
+
+Profiler::ChunkStats &Profiler::get_stats(size_t chunk_index)
+{
+    if(chunk_index >= m_chunks.size())
+	m_chunks.resize(chunk_index + 1);
+
+    return m_chunks[chunk_index];
+}
+
+size_t Profiler::get_child_node(size_t parent, size_t chunk_index)
+{
+    auto [i, is_new] = m_nodes[parent].children.try_emplace(chunk_index,
+							     m_nodes.size());
+
+    if(is_new)
+    {
+	Node node;
+
+	node.chunk_index = chunk_index;
+	node.parent = parent;
+
+	m_nodes.push_back(std::move(node));
+    }
+
+    return i->second;
+}
+
+void Profiler::enter(size_t chunk_index, std::uint64_t segment_count)
+{
+    auto &stats = get_stats(chunk_index);
+
+    ++stats.calls;
+
+    Frame frame;
+
+    frame.chunk_index = chunk_index;
+    frame.node = get_child_node(m_frames.empty() ? 0 : m_frames.back().node,
+				chunk_index);
+    frame.is_outermost = (stats.active++ == 0);
+    frame.start_segments = segment_count;
+
+    m_frames.push_back(frame);
+
+    // Last, so that the time above counts as the caller's.
+    m_frames.back().start = Clock::now();
+}
+
+void Profiler::exit(size_t chunk_index, std::uint64_t segment_count)
+{
+    auto now = Clock::now();
+
+    assert(!m_frames.empty());
+    assert(m_frames.back().chunk_index == chunk_index);
+
+    Frame frame = m_frames.back();
+
+    m_frames.pop_back();
+
+    auto &stats = m_chunks[chunk_index];
+
+    auto elapsed = now - frame.start;
+    auto self = elapsed - frame.in_children;
+
+    auto segments = segment_count - frame.start_segments;
+
+    stats.self += self;
+    stats.segments += segments - frame.child_segments;
+
+    if(frame.is_outermost)
+	stats.total += elapsed;
+
+    --stats.active;
+
+    m_nodes[frame.node].self += self;
+
+    if(!m_frames.empty())
+    {
+	m_frames.back().in_children += elapsed;
+	m_frames.back().child_segments += segments;
+    }
+}
+
+void Profiler::count_statement(size_t chunk_index)
+{
+    ++get_stats(chunk_index).statements;
+}
+
+void Profiler::sample(const std::vector<EngineLocation> &stack)
+{
+    if(stack.empty())
+	return;
+
+    ++m_samples;
+
+    size_t node = 0;
+
+    for(const auto &loc : stack)
+    {
+	auto &stats = get_stats(loc.chunk_index);
+
+	if(stats.last_sample != m_samples)
+	{
+	    stats.last_sample = m_samples;
+	    ++stats.samples;
+	}
+
+	node = get_child_node(node, loc.chunk_index);
+    }
+
+    ++m_chunks[stack.back().chunk_index].self_samples;
+    ++m_nodes[node].samples;
+}
+
+void Profiler::write_report(std::ostream &out, const NameFn &name) const
+{
+    if(m_sample_interval)
+    {
+	write_sampled_report(out, name);
+	return;
+    }
+
+    std::vector<size_t> order;
+
+    for(size_t i = 0; i < m_chunks.size(); ++i)
+	if(m_chunks[i].calls)
+	    order.push_back(i);
+
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+	return m_chunks[a].self > m_chunks[b].self;
+    });
+
+    auto ms = [](Clock::duration d)
+    {
+	return std::chrono::duration<double, std::milli>(d).count();
+    };
+
+    out << std::format("{:>12} {:>12} {:>12} {:>12} {:>12}  {}\n",
+		       "calls", "total ms", "self ms", "statements",
+		       "segments", "function");
+
+    for(auto i : order)
+    {
+	const auto &stats = m_chunks[i];
+
+	out << std::format("{:>12} {:>12.3f} {:>12.3f} {:>12} {:>12}  {}\n",
+			   stats.calls, ms(stats.total), ms(stats.self),
+			   stats.statements, stats.segments, name(i));
+    }
+}
+
+void Profiler::write_sampled_report(std::ostream &out,
+				    const NameFn &name) const
+{
+    std::vector<size_t> order;
+
+    for(size_t i = 0; i < m_chunks.size(); ++i)
+	if(m_chunks[i].samples)
+	    order.push_back(i);
+
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+	return m_chunks[a].self_samples > m_chunks[b].self_samples;
+    });
+
+    auto percent = [this](std::uint64_t samples)
+    {
+	return 100.0 * static_cast<double>(samples)
+		     / static_cast<double>(m_samples);
+    };
+
+    out << std::format("{} samples, one every {} statements\n",
+		       m_samples, m_sample_interval);
+
+    out << std::format("{:>12} {:>12} {:>12} {:>12}  {}\n",
+		       "total", "self", "total %", "self %", "function");
+
+    for(auto i : order)
+    {
+	const auto &stats = m_chunks[i];
+
+	out << std::format("{:>12} {:>12} {:>12.1f} {:>12.1f}  {}\n",
+			   stats.samples, stats.self_samples,
+			   percent(stats.samples), percent(stats.self_samples),
+			   name(i));
+    }
+}
+
+void Profiler::write_folded_stacks(std::ostream &out,
+				   const NameFn &name) const
+{
+    std::vector<std::string> names(m_chunks.size());
+
+    for(size_t i = 0; i < m_chunks.size(); ++i)
+	if(m_chunks[i].was_run())
+	    names[i] = name(i);
+
+    std::vector<size_t> path;
+
+    for(size_t n = 1; n < m_nodes.size(); ++n)
+    {
+	// Samples, or the self time in microseconds
+	auto count = m_sample_interval
+		       ? static_cast<long long>(m_nodes[n].samples)
+		       : std::chrono::duration_cast<std::chrono::microseconds>(
+						    m_nodes[n].self).count();
+
+	if(count <= 0)
+	    continue;
+
+	path.clear();
+
+	for(size_t i = n; i != 0; i = m_nodes[i].parent)
+	    path.push_back(m_nodes[i].chunk_index);
+
+	for(auto i = path.rbegin(); i != path.rend(); ++i)
+	{
+	    if(i != path.rbegin())
+		out << ';';
+
+	    out << names[*i];
+	}
+
+	out << ' ' << count << '\n';
+    }
+}
@@ -0,0 +1,161 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "EngineTypes.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Profiler - where the time goes, per chunk
+//
+//   The engine tells the debugger as each chunk's frame is entered and
+//   left, and the debugger passes that on to this (with --profile).  So it
+//   only costs anything when a debugger is attached: the engine's ordinary
+//   path doesn't change.
+//
+//   For each chunk, it keeps:
+//
+//   - calls: how many times its frame was entered (for a loop's body, that
+//     is once per iteration)
+//
+//   - total: the time spent in it, including what it called.  Recursive
+//     calls aren't counted twice.
+//
+//   - self: the time spent in it, not counting what it called
+//
+//   - statements, segments: the statements it ran, and the path segments
+//     drawn while it was the innermost frame
+//
+//   It also keeps the tree of calls, for the folded stacks that flame graph
+//   tools read ("main;draw;f 123", with the self time in microseconds).
+//
+//   With a sample interval, the engine only passes the call stack every n
+//   statements instead (see ExecutionEngine::set_sample_interval()).  Then
+//   each chunk has the number of samples that it was on the stack for
+//   (total), and that it was the innermost frame for (self), and the folded
+//   stacks have sample counts.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class Profiler
+{
+public:
+    // Names each chunk in the reports.
+    using NameFn = std::function<std::string(size_t chunk_index)>;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct ChunkStats
+    {
+	std::uint64_t calls = 0;
+	std::uint64_t statements = 0;
+	std::uint64_t segments = 0;
+
+	Clock::duration total{};
+	Clock::duration self{};
+
+	// Frames of this chunk that are currently on the stack
+	int active = 0;
+
+	std::uint64_t samples = 0;
+	std::uint64_t self_samples = 0;
+
+	// The last sample that counted this chunk (see 'total')
+	std::uint64_t last_sample = 0;
+
+	bool was_run() const
+	{
+	    return calls || samples;
+	}
+    };
+
+    // A node of the call tree: one path of chunks from the outermost frame
+    struct Node
+    {
+	size_t chunk_index = 0;
+	size_t parent = 0;
+
+	Clock::duration self{};
+	std::uint64_t samples = 0;
+
+	std::map<size_t, size_t> children;
+    };
+
+    struct Frame
+    {
+	size_t chunk_index = 0;
+	size_t node = 0;
+
+	// Whether this is the outermost frame of its chunk (see 'total')
+	bool is_outermost = false;
+
+	Clock::time_point start;
+	Clock::duration in_children{};
+
+	std::uint64_t start_segments = 0;
+	std::uint64_t child_segments = 0;
+    };
+
+    std::vector<ChunkStats> m_chunks;
+
+    // m_nodes[0] is the root, above the outermost frame.
+    std::vector<Node> m_nodes{ Node{} };
+
+    std::vector<Frame> m_frames;
+
+    unsigned m_sample_interval = 0;
+    std::uint64_t m_samples = 0;
+
+    ChunkStats &get_stats(size_t chunk_index);
+
+    size_t get_child_node(size_t parent, size_t chunk_index);
+
+    void write_sampled_report(std::ostream &out, const NameFn &name) const;
+
+public:
+    // 0 for exact costs, or the engine's sample interval
+    explicit Profiler(unsigned sample_interval = 0);
+
+    void enter(size_t chunk_index, std::uint64_t segment_count);
+    void exit(size_t chunk_index, std::uint64_t segment_count);
+
+    void count_statement(size_t chunk_index);
+
+    void sample(const std::vector<EngineLocation> &stack);
+
+    // The chunks that were run, by self time (the most first)
+    void write_report(std::ostream &out, const NameFn &name) const;
+
+    void write_folded_stacks(std::ostream &out, const NameFn &name) const;
+};
@@ -0,0 +1,212 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory_resource>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ProgramArena - the memory that holds a compiled program
+//
+//   - Everything built while parsing (statement closures, chunk code, operand
+//     pools, name definitions) is allocated from one monotonic buffer, and is
+//     released in one shot when the arena is destroyed.  Nothing is freed
+//     individually before then.
+//
+//   - Objects with destructors (e.g. a closure that holds an Expr) are
+//     registered with the arena, and destroyed in reverse order of creation,
+//     before the memory itself is released.
+//
+//   - Allocation statistics are kept, for --arena-stats.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class ProgramArena
+{
+public:
+    struct Stats
+    {
+	size_t allocations = 0;     // requests made of the arena
+	size_t bytes = 0;           // bytes requested
+	size_t blocks = 0;          // blocks obtained from the heap
+	size_t block_bytes = 0;     // bytes obtained from the heap
+    };
+
+private:
+    // A pass-through memory_resource that counts what goes through it.
+    class CountingResource : public std::pmr::memory_resource
+    {
+	std::pmr::memory_resource *m_upstream;
+
+	size_t &m_count;
+	size_t &m_bytes;
+
+	void *do_allocate(size_t bytes, size_t alignment) override
+	{
+	    ++m_count;
+	    m_bytes += bytes;
+
+	    return m_upstream->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void *p, size_t bytes, size_t alignment) override
+	{
+	    m_upstream->deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+	{
+	    return this == &other;
+	}
+
+    public:
+	CountingResource(std::pmr::memory_resource *upstream,
+			 size_t &count,
+			 size_t &bytes)
+	    : m_upstream(upstream)
+	    , m_count(count)
+	    , m_bytes(bytes)
+	{
+	}
+    };
+
+    struct Destructor
+    {
+	void (*destroy)(void *);
+	void *object;
+    };
+
+    static constexpr size_t default_initial_size = 64 * 1024;
+
+    Stats m_stats;
+
+    // Heap -> m_blocks -> m_buffer -> m_front -> users
+    CountingResource m_blocks;
+    std::pmr::monotonic_buffer_resource m_buffer;
+    CountingResource m_front;
+
+    std::pmr::vector<Destructor> m_destructors;
+
+public:
+    ProgramArena(const ProgramArena &) = delete;
+    ProgramArena &operator=(const ProgramArena &) = delete;
+
+    explicit ProgramArena(size_t initial_size = default_initial_size)
+	: m_blocks(std::pmr::new_delete_resource(),
+		   m_stats.blocks,
+		   m_stats.block_bytes)
+	, m_buffer(initial_size, &m_blocks)
+	, m_front(&m_buffer, m_stats.allocations, m_stats.bytes)
+	, m_destructors(&m_front)
+    {
+    }
+
+    ~ProgramArena()
+    {
+	for(auto i = m_destructors.rbegin(); i != m_destructors.rend(); ++i)
+	    i->destroy(i->object);
+    }
+
+    std::pmr::memory_resource *get_resource()
+    {
+	return &m_front;
+    }
+
+    template<class T>
+    std::pmr::polymorphic_allocator<T> get_allocator()
+    {
+	return std::pmr::polymorphic_allocator<T>(&m_front);
+    }
+
+    template<class T, class... Args>
+    T *create(Args&&... args)
+    {
+	void *p = m_front.allocate(sizeof(T), alignof(T));
+
+	T *obj = new(p) T(std::forward<Args>(args)...);
+
+	if constexpr(!std::is_trivially_destructible_v<T>)
+	    m_destructors.push_back({
+		    [](void *p) { static_cast<T*>(p)->~T(); },
+		    obj
+		});
+
+	return obj;
+    }
+
+    const Stats &get_stats() const
+    {
+	return m_stats;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ArenaFunction - a void(Context &) callable whose closure lives in a
+//                 ProgramArena
+//
+//   - This replaces std::function for compiled statements.  It is just two
+//     pointers, so copying one (e.g. when a loop body is unrolled) shares the
+//     closure rather than copying it.
+//
+//   - The context (the ExecutionEngine running the statement) is passed in,
+//     rather than captured, so that one compiled program can be run by
+//     several engines.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+template<class Context>
+class ArenaFunction
+{
+    void (*m_invoke)(void *, Context &) = nullptr;
+    void *m_object = nullptr;
+
+public:
+    ArenaFunction() = default;
+
+    template<class F>
+    ArenaFunction(ProgramArena &arena, F &&fn)
+    {
+	using Fn = std::decay_t<F>;
+
+	m_object = arena.create<Fn>(std::forward<F>(fn));
+	m_invoke = [](void *p, Context &context) { (*static_cast<Fn*>(p))(context); };
+    }
+
+    explicit operator bool() const
+    {
+	return m_invoke != nullptr;
+    }
+
+    void operator()(Context &context) const
+    {
+	m_invoke(m_object, context);
+    }
+};
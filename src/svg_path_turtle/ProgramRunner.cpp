@@ -0,0 +1,241 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "ProgramRunner.h"
+
+#include "Tokenizer.h"
+#include "Messages.h"
+
+using std::string;
+
+bool execute_program(ExecutionEngine &engine,
+		     size_t main_chunk_index,
+		     const string &name,
+		     const Options &opt,
+		     std::ostream &out,
+		     std::ostream &messages)
+{
+    engine.set_decimal_places(opt.decimal_places);
+    engine.set_output_format(opt.get_output_format());
+    engine.set_simplify(opt.simplify);
+    engine.set_integer_grid(opt.integer_grid);
+    engine.set_limits(opt.get_limits());
+
+    for(const auto &[param, value] : opt.params)
+	if(!engine.set_param(main_chunk_index, param, value))
+	{
+	    report_message(messages, { name, {} }, "Error",
+			   "The program has no param named '" + param + "'");
+
+	    engine.reset_params();
+
+	    return false;
+	}
+
+    // The engine may run other programs after this one, so the sink is
+    // cleared below.
+    SVGSymbols symbols(opt.svg_out, out, opt.decimal_places);
+
+    if(opt.symbols)
+	engine.set_fragment_sink(&symbols);
+
+    engine.set_new_path_handler(
+	[&opt, &out, &symbols](const string &path_name,
+			       const string &attributes)
+	{
+	    if(opt.symbols)
+		symbols.new_path(path_name, attributes);
+	    else if(opt.svg_out)
+		opt.svg_out.output_new_path(out, path_name, attributes);
+	});
+
+    bool ok = true;
+
+    catch_execution_errors([&]
+    {
+	if(opt.svg_out)
+	    opt.svg_out.output_header(out, !opt.symbols);
+
+	engine.execute_main(main_chunk_index);
+
+	symbols.finish();
+
+	if(opt.svg_out)
+	    opt.svg_out.output_footer(out, !opt.symbols);
+    },
+    [&](const string &msg)
+    {
+	report_message(messages, { name, {} }, "Error", msg);
+
+	ok = false;
+    });
+
+    engine.reset_params();
+
+    if(opt.symbols)
+	engine.set_fragment_sink(nullptr);
+
+    if(!ok)
+	return false;
+
+    if(engine.had_pen_height_error() && !opt.disable_pen_warning)
+	report_message(messages, { name, {} }, "Warning",
+		       "Pen height became negative. Results may be incorrect.");
+
+    engine.reset_turtle();
+
+    return true;
+}
+
+ProgramRunner::ProgramRunner(bool bytecode)
+    : m_bytecode(bytecode)
+    , m_program_out(&m_program_buffer)
+{
+}
+
+void ProgramRunner::start_engine()
+{
+    m_engine = std::make_unique<ExecutionEngine>(
+		    m_program_out,
+		    nullptr,
+		    m_bytecode ? ExecutionEngine::Backend::bytecode
+			       : ExecutionEngine::Backend::closures);
+
+    m_files.reset();
+
+    m_last_main = ExecutionEngine::no_chunk;
+}
+
+size_t ProgramRunner::compile(const string &name,
+			      std::string_view program,
+			      std::ostream &messages)
+{
+    if(!m_engine || m_engine->get_arena_stats().bytes > s_max_arena_bytes)
+	start_engine();
+
+    // A module whose file has changed since it was parsed is parsed again,
+    // along with the modules that import it, as if --watch had seen it.
+    if(m_files)
+	if(auto changed = m_files->find_changed_modules(); !changed.empty())
+	    reread_files(changed);
+
+    // The same program again (with other params or output options, most
+    // likely) runs the code that is already compiled.
+    if(m_last_main != ExecutionEngine::no_chunk && program == m_last_program)
+	return m_last_main;
+
+    for(;;)
+    {
+	bool is_new_file = true;
+
+	{
+	    Lexer lex(program);
+
+	    Parser p(lex, *m_engine);
+
+	    p.set_error_output(messages);
+
+	    if(!m_files)
+	    {
+		p.set_filename(name);
+
+		m_files = p.get_files();
+	    }
+	    else
+		is_new_file = p.set_filename(name, m_files);
+
+	    if(is_new_file)
+	    {
+		try
+		{
+		    p.parse();
+
+		    m_last_program = program;
+		    m_last_main = p.get_main();
+
+		    return m_last_main;
+		}
+		catch(const Parser::ParseError &)
+		{
+		    // Already reported.  The engine may be part way through
+		    // compiling something, so it starts over.
+		}
+		catch(const std::runtime_error &err)
+		{
+		    report_message(messages, { name, {} }, "Error", err.what());
+		}
+
+		m_engine.reset();
+		m_last_main = ExecutionEngine::no_chunk;
+
+		return ExecutionEngine::no_chunk;
+	    }
+	}
+
+	// This file has been parsed already (as a program, or as a module
+	// imported by another one), so it gets a fresh engine.
+	start_engine();
+    }
+}
+
+void ProgramRunner::reread_files(const std::set<string> &changed)
+{
+    if(m_files)
+	m_files->forget_files(changed);
+
+    m_last_program.clear();
+    m_last_main = ExecutionEngine::no_chunk;
+}
+
+std::vector<string> ProgramRunner::get_filenames() const
+{
+    return m_files ? m_files->get_filenames() : std::vector<string>{};
+}
+
+bool ProgramRunner::run(const string &name,
+			std::string_view program,
+			const Options &opt,
+			std::ostream &messages,
+			string &output)
+{
+    size_t main_chunk_index = compile(name, program, messages);
+
+    bool ok = main_chunk_index != ExecutionEngine::no_chunk
+	   && execute_program(*m_engine, main_chunk_index, name, opt,
+			      m_program_out, messages);
+
+    output = m_program_buffer.str();
+
+    m_program_buffer.str({});
+
+    if(!ok)
+    {
+	output.clear();
+
+	m_engine.reset();
+	m_last_main = ExecutionEngine::no_chunk;
+    }
+
+    return ok;
+}
@@ -0,0 +1,135 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Engine.h"
+#include "Parser.h"
+#include "Options.h"
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <ostream>
+#include <memory>
+#include <set>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ProgramRunner - parses and runs one program after another, in a warm engine
+//
+//   - All of the programs are compiled into one ExecutionEngine, sharing their
+//     imports (see Parser::set_filename()), so a module like library.svgt is
+//     only parsed once, however many programs import it.  Before each
+//     compile, the modules' files are checked: one whose modification time
+//     or size has changed is parsed again, with the modules that import it.
+//
+//   - Errors don't exit: they are reported on the messages stream, and the
+//     program's output is dropped.
+//
+//   - Compiling the same program text twice in a row reuses the first
+//     compile, so a program can be re-run with new params (see
+//     ExecutionEngine::set_param()) without being parsed again.
+//
+//   - The engine (with its stack and program arena) is replaced after an
+//     error, which can leave it part way through a parse or a run, and once
+//     it has grown past a limit, since the chunks of old programs are never
+//     freed.
+//
+//   A ProgramRunner is not shared between threads, but the programs that it
+//   has compiled can be run by other engines, on any thread (see
+//   BatchRenderer).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Runs a compiled program in engine, with the output options of opt.  Its
+// output (including the SVG wrapper, with -s) goes to out, which must be the
+// engine's output stream.  Errors and warnings are reported on messages, for
+// the program named 'name'.  Returns false after an error, which can leave
+// the engine part way through the run, so it's best replaced.
+bool execute_program(ExecutionEngine &engine,
+		     size_t main_chunk_index,
+		     const std::string &name,
+		     const Options &opt,
+		     std::ostream &out,
+		     std::ostream &messages);
+
+class ProgramRunner
+{
+    bool m_bytecode;
+
+    // Programs write here, and their output is taken after each one.
+    std::stringbuf m_program_buffer;
+    std::ostream m_program_out;
+
+    std::unique_ptr<ExecutionEngine> m_engine;
+
+    Parser::SharedFiles m_files;
+
+    // The last program compiled, and its main chunk (no_chunk if none)
+    std::string m_last_program;
+    size_t m_last_main = ExecutionEngine::no_chunk;
+
+    static constexpr std::size_t s_max_arena_bytes = 64 * 1024 * 1024;
+
+    void start_engine();
+
+public:
+    ProgramRunner(const ProgramRunner &) = delete;
+    ProgramRunner &operator=(const ProgramRunner &) = delete;
+
+    explicit ProgramRunner(bool bytecode);
+
+    // Only compiles the program.  Returns its main chunk, or no_chunk if
+    // there were errors.
+    size_t compile(const std::string &name,
+		   std::string_view program,
+		   std::ostream &messages);
+
+    // What has been compiled so far, for other engines to run (see
+    // ExecutionEngine::get_program()) once this runner is done compiling.
+    ExecutionEngine::SharedProgram get_program() const
+    {
+	return m_engine ? m_engine->get_program() : nullptr;
+    }
+
+    // After some files have changed (see ProgramWatcher): the next compile
+    // reads its program and the changed modules again, and the modules that
+    // depend on them, but reuses the rest.
+    void reread_files(const std::set<std::string> &changed);
+
+    // The files read by the compiles since the last reread_files(), as
+    // programs or as modules
+    std::vector<std::string> get_filenames() const;
+
+    // Runs the program with the output options of opt, and returns its
+    // output in 'output'.  The name is the program's filename, for messages.
+    // Returns false if there were errors.
+    bool run(const std::string &name,
+	     std::string_view program,
+	     const Options &opt,
+	     std::ostream &messages,
+	     std::string &output);
+};
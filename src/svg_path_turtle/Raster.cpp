@@ -0,0 +1,1058 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Raster.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cassert>
+#include <cstdlib>
+#include <sstream>
+
+using std::string;
+
+// Curves are flattened within this many pixels.
+static constexpr double flatness = 0.1;
+
+//////////////////////////////////////////////////////////////////////////////
+// Colors and attributes
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    struct NamedColor
+    {
+	const char *name;
+	std::uint32_t rgb;
+    };
+
+    // The CSS color names
+    constexpr NamedColor named_colors[] =
+    {
+	{ "aliceblue", 0xf0f8ff }, { "antiquewhite", 0xfaebd7 },
+	{ "aqua", 0x00ffff }, { "aquamarine", 0x7fffd4 },
+	{ "azure", 0xf0ffff }, { "beige", 0xf5f5dc },
+	{ "bisque", 0xffe4c4 }, { "black", 0x000000 },
+	{ "blanchedalmond", 0xffebcd }, { "blue", 0x0000ff },
+	{ "blueviolet", 0x8a2be2 }, { "brown", 0xa52a2a },
+	{ "burlywood", 0xdeb887 }, { "cadetblue", 0x5f9ea0 },
+	{ "chartreuse", 0x7fff00 }, { "chocolate", 0xd2691e },
+	{ "coral", 0xff7f50 }, { "cornflowerblue", 0x6495ed },
+	{ "cornsilk", 0xfff8dc }, { "crimson", 0xdc143c },
+	{ "cyan", 0x00ffff }, { "darkblue", 0x00008b },
+	{ "darkcyan", 0x008b8b }, { "darkgoldenrod", 0xb8860b },
+	{ "darkgray", 0xa9a9a9 }, { "darkgreen", 0x006400 },
+	{ "darkgrey", 0xa9a9a9 }, { "darkkhaki", 0xbdb76b },
+	{ "darkmagenta", 0x8b008b }, { "darkolivegreen", 0x556b2f },
+	{ "darkorange", 0xff8c00 }, { "darkorchid", 0x9932cc },
+	{ "darkred", 0x8b0000 }, { "darksalmon", 0xe9967a },
+	{ "darkseagreen", 0x8fbc8f }, { "darkslateblue", 0x483d8b },
+	{ "darkslategray", 0x2f4f4f }, { "darkslategrey", 0x2f4f4f },
+	{ "darkturquoise", 0x00ced1 }, { "darkviolet", 0x9400d3 },
+	{ "deeppink", 0xff1493 }, { "deepskyblue", 0x00bfff },
+	{ "dimgray", 0x696969 }, { "dimgrey", 0x696969 },
+	{ "dodgerblue", 0x1e90ff }, { "firebrick", 0xb22222 },
+	{ "floralwhite", 0xfffaf0 }, { "forestgreen", 0x228b22 },
+	{ "fuchsia", 0xff00ff }, { "gainsboro", 0xdcdcdc },
+	{ "ghostwhite", 0xf8f8ff }, { "gold", 0xffd700 },
+	{ "goldenrod", 0xdaa520 }, { "gray", 0x808080 },
+	{ "green", 0x008000 }, { "greenyellow", 0xadff2f },
+	{ "grey", 0x808080 }, { "honeydew", 0xf0fff0 },
+	{ "hotpink", 0xff69b4 }, { "indianred", 0xcd5c5c },
+	{ "indigo", 0x4b0082 }, { "ivory", 0xfffff0 },
+	{ "khaki", 0xf0e68c }, { "lavender", 0xe6e6fa },
+	{ "lavenderblush", 0xfff0f5 }, { "lawngreen", 0x7cfc00 },
+	{ "lemonchiffon", 0xfffacd }, { "lightblue", 0xadd8e6 },
+	{ "lightcoral", 0xf08080 }, { "lightcyan", 0xe0ffff },
+	{ "lightgoldenrodyellow", 0xfafad2 }, { "lightgray", 0xd3d3d3 },
+	{ "lightgreen", 0x90ee90 }, { "lightgrey", 0xd3d3d3 },
+	{ "lightpink", 0xffb6c1 }, { "lightsalmon", 0xffa07a },
+	{ "lightseagreen", 0x20b2aa }, { "lightskyblue", 0x87cefa },
+	{ "lightslategray", 0x778899 }, { "lightslategrey", 0x778899 },
+	{ "lightsteelblue", 0xb0c4de }, { "lightyellow", 0xffffe0 },
+	{ "lime", 0x00ff00 }, { "limegreen", 0x32cd32 },
+	{ "linen", 0xfaf0e6 }, { "magenta", 0xff00ff },
+	{ "maroon", 0x800000 }, { "mediumaquamarine", 0x66cdaa },
+	{ "mediumblue", 0x0000cd }, { "mediumorchid", 0xba55d3 },
+	{ "mediumpurple", 0x9370db }, { "mediumseagreen", 0x3cb371 },
+	{ "mediumslateblue", 0x7b68ee }, { "mediumspringgreen", 0x00fa9a },
+	{ "mediumturquoise", 0x48d1cc }, { "mediumvioletred", 0xc71585 },
+	{ "midnightblue", 0x191970 }, { "mintcream", 0xf5fffa },
+	{ "mistyrose", 0xffe4e1 }, { "moccasin", 0xffe4b5 },
+	{ "navajowhite", 0xffdead }, { "navy", 0x000080 },
+	{ "oldlace", 0xfdf5e6 }, { "olive", 0x808000 },
+	{ "olivedrab", 0x6b8e23 }, { "orange", 0xffa500 },
+	{ "orangered", 0xff4500 }, { "orchid", 0xda70d6 },
+	{ "palegoldenrod", 0xeee8aa }, { "palegreen", 0x98fb98 },
+	{ "paleturquoise", 0xafeeee }, { "palevioletred", 0xdb7093 },
+	{ "papayawhip", 0xffefd5 }, { "peachpuff", 0xffdab9 },
+	{ "peru", 0xcd853f }, { "pink", 0xffc0cb },
+	{ "plum", 0xdda0dd }, { "powderblue", 0xb0e0e6 },
+	{ "purple", 0x800080 }, { "rebeccapurple", 0x663399 },
+	{ "red", 0xff0000 }, { "rosybrown", 0xbc8f8f },
+	{ "royalblue", 0x4169e1 }, { "saddlebrown", 0x8b4513 },
+	{ "salmon", 0xfa8072 }, { "sandybrown", 0xf4a460 },
+	{ "seagreen", 0x2e8b57 }, { "seashell", 0xfff5ee },
+	{ "sienna", 0xa0522d }, { "silver", 0xc0c0c0 },
+	{ "skyblue", 0x87ceeb }, { "slateblue", 0x6a5acd },
+	{ "slategray", 0x708090 }, { "slategrey", 0x708090 },
+	{ "snow", 0xfffafa }, { "springgreen", 0x00ff7f },
+	{ "steelblue", 0x4682b4 }, { "tan", 0xd2b48c },
+	{ "teal", 0x008080 }, { "thistle", 0xd8bfd8 },
+	{ "tomato", 0xff6347 }, { "turquoise", 0x40e0d0 },
+	{ "violet", 0xee82ee }, { "wheat", 0xf5deb3 },
+	{ "white", 0xffffff }, { "whitesmoke", 0xf5f5f5 },
+	{ "yellow", 0xffff00 }, { "yellowgreen", 0x9acd32 },
+    };
+
+    PathRasterizer::Color from_rgb(std::uint32_t rgb, float alpha = 1)
+    {
+	return { ((rgb >> 16) & 0xff) / 255.0f,
+		 ((rgb >> 8) & 0xff) / 255.0f,
+		 (rgb & 0xff) / 255.0f,
+		 alpha };
+    }
+
+    // The components of rgb(r, g, b) or rgba(r, g, b, a), each a number or
+    // a percentage
+    bool parse_rgb_function(const string &args, PathRasterizer::Color &color)
+    {
+	string text = args;
+
+	std::replace(text.begin(), text.end(), ',', ' ');
+	std::replace(text.begin(), text.end(), '/', ' ');
+
+	std::istringstream in(text);
+
+	float values[4] = { 0, 0, 0, 1 };
+	int count = 0;
+
+	string word;
+
+	while(in >> word)
+	{
+	    if(count == 4)
+		return false;
+
+	    bool percent = word.back() == '%';
+
+	    if(percent)
+		word.pop_back();
+
+	    char *end = nullptr;
+	    float value = std::strtof(word.c_str(), &end);
+
+	    if(word.empty() || *end)
+		return false;
+
+	    if(count < 3)
+		value = percent ? value / 100 : value / 255;
+	    else if(percent)
+		value /= 100;
+
+	    values[count++] = std::clamp(value, 0.0f, 1.0f);
+	}
+
+	if(count < 3)
+	    return false;
+
+	color = { values[0], values[1], values[2], values[3] };
+
+	return true;
+    }
+
+    PathRasterizer::LineJoin parse_linejoin(const string &text)
+    {
+	if(text == "round") return PathRasterizer::LineJoin::round;
+	if(text == "bevel") return PathRasterizer::LineJoin::bevel;
+
+	return PathRasterizer::LineJoin::miter;
+    }
+
+    PathRasterizer::LineCap parse_linecap(const string &text)
+    {
+	if(text == "round")  return PathRasterizer::LineCap::round;
+	if(text == "square") return PathRasterizer::LineCap::square;
+
+	return PathRasterizer::LineCap::butt;
+    }
+
+    // A number, or 'otherwise'
+    double parse_number(const string &text, double otherwise)
+    {
+	char *end = nullptr;
+	double value = std::strtod(text.c_str(), &end);
+
+	return (text.empty() || *end) ? otherwise : value;
+    }
+}
+
+bool PathRasterizer::parse_color(const string &text, Color &color)
+{
+    string s;
+
+    for(char ch : text)
+	if(!std::isspace(static_cast<unsigned char>(ch)))
+	    s += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+
+    if(s == "none" || s == "transparent")
+    {
+	color = {};
+	return true;
+    }
+
+    if(!s.empty() && s[0] == '#')
+    {
+	string hex = s.substr(1);
+
+	if(hex.empty()
+	   || hex.find_first_not_of("0123456789abcdef") != string::npos)
+	    return false;
+
+	std::uint32_t value = std::stoul(hex, nullptr, 16);
+
+	switch(hex.size())
+	{
+	    case 3:
+		color = from_rgb(((value & 0xf00) << 12) | ((value & 0xf00) << 8)
+			       | ((value & 0x0f0) << 8) | ((value & 0x0f0) << 4)
+			       | ((value & 0x00f) << 4) | (value & 0x00f));
+		return true;
+
+	    case 6:
+		color = from_rgb(value);
+		return true;
+
+	    case 8:
+		color = from_rgb(value >> 8, (value & 0xff) / 255.0f);
+		return true;
+
+	    default:
+		return false;
+	}
+    }
+
+    for(const char *prefix : { "rgb(", "rgba(" })
+    {
+	string p = prefix;
+
+	if(s.starts_with(p) && s.back() == ')')
+	    return parse_rgb_function(s.substr(p.size(),
+					       s.size() - p.size() - 1),
+				      color);
+    }
+
+    for(const auto &named : named_colors)
+	if(s == named.name)
+	{
+	    color = from_rgb(named.rgb);
+	    return true;
+	}
+
+    return false;
+}
+
+// With no attributes, the style is the configured one.  Otherwise it is
+// only what they say, with SVG's defaults for the rest, as in the SVG file
+// (see SVGConfig::output_new_path()).
+void PathRasterizer::set_style(const string &attributes)
+{
+    Style style;
+
+    double stroke_width = 1.0;
+
+    if(attributes.empty())
+    {
+	if(!parse_color(m_config.get_fill_color(), style.fill))
+	    style.fill = from_rgb(0);
+
+	if(!parse_color(m_config.get_stroke_color(), style.stroke))
+	    style.stroke = {};
+
+	stroke_width = m_config.get_scaled_stroke_width(1.0);
+
+	style.join = parse_linejoin(m_config.get_stroke_linejoin());
+	style.cap = parse_linecap(m_config.get_stroke_linecap());
+    }
+    else
+    {
+	style.fill = from_rgb(0);
+
+	float opacity = 1, fill_opacity = 1, stroke_opacity = 1;
+
+	// name="value" or name='value', separated by spaces
+	size_t i = 0;
+
+	while(i < attributes.size())
+	{
+	    size_t eq = attributes.find('=', i);
+
+	    if(eq == string::npos || eq + 1 >= attributes.size())
+		break;
+
+	    size_t name_start = attributes.find_first_not_of(" \t\n", i);
+	    size_t name_end = attributes.find_last_not_of(" \t\n", eq - 1) + 1;
+
+	    size_t quote = attributes.find_first_of("\"'", eq + 1);
+
+	    if(quote == string::npos)
+		break;
+
+	    size_t end = attributes.find(attributes[quote], quote + 1);
+
+	    if(end == string::npos)
+		break;
+
+	    string name = attributes.substr(name_start, name_end - name_start);
+	    string value = attributes.substr(quote + 1, end - quote - 1);
+
+	    if(name == "fill")
+	    {
+		if(!parse_color(value, style.fill))
+		    style.fill = from_rgb(0);
+	    }
+	    else if(name == "stroke")
+	    {
+		if(!parse_color(value, style.stroke))
+		    style.stroke = {};
+	    }
+	    else if(name == "stroke-width")
+		stroke_width = parse_number(value, 1.0);
+	    else if(name == "stroke-linejoin")
+		style.join = parse_linejoin(value);
+	    else if(name == "stroke-linecap")
+		style.cap = parse_linecap(value);
+	    else if(name == "stroke-miterlimit")
+		style.miter_limit = std::max(1.0, parse_number(value, 4.0));
+	    else if(name == "opacity")
+		opacity = static_cast<float>(parse_number(value, 1.0));
+	    else if(name == "fill-opacity")
+		fill_opacity = static_cast<float>(parse_number(value, 1.0));
+	    else if(name == "stroke-opacity")
+		stroke_opacity = static_cast<float>(parse_number(value, 1.0));
+
+	    i = end + 1;
+	}
+
+	style.fill.a *= std::clamp(opacity * fill_opacity, 0.0f, 1.0f);
+	style.stroke.a *= std::clamp(opacity * stroke_opacity, 0.0f, 1.0f);
+    }
+
+    style.stroke_width = std::max(0.0, stroke_width * m_scale);
+
+    if(style.stroke_width == 0)
+	style.stroke.a = 0;
+
+    m_style = style;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Coverage
+//////////////////////////////////////////////////////////////////////////////
+
+void PathRasterizer::Coverage::resize(long width, long height)
+{
+    m_width = width;
+    m_height = height;
+
+    // Lines at the right edge reach two past it.
+    m_stride = width + 2;
+
+    m_area.assign(static_cast<size_t>(m_stride * height), 0.0f);
+}
+
+// What's to the left of the image is drawn at its left edge, since it
+// covers the same pixels to the right of it, and what's to the right is
+// left out.  So the line is split where it crosses either edge.
+void PathRasterizer::Coverage::add_line(Point p0, Point p1)
+{
+    if(p0.y == p1.y)
+	return;
+
+    const double right = static_cast<double>(m_width);
+
+    auto clamp_x = [&](Point p)
+    {
+	return Point{ std::clamp(p.x, 0.0, right), p.y };
+    };
+
+    double ts[2];
+    int count = 0;
+
+    for(double edge : { 0.0, right })
+	if((p0.x < edge) != (p1.x < edge))
+	{
+	    double t = (edge - p0.x) / (p1.x - p0.x);
+
+	    if(t > 0 && t < 1)
+		ts[count++] = t;
+	}
+
+    if(count == 2 && ts[0] > ts[1])
+	std::swap(ts[0], ts[1]);
+
+    Point from = p0;
+
+    for(int i = 0; i < count; ++i)
+    {
+	Point to{ p0.x + (p1.x - p0.x) * ts[i], p0.y + (p1.y - p0.y) * ts[i] };
+
+	add_clipped_line(clamp_x(from), clamp_x(to));
+
+	from = to;
+    }
+
+    add_clipped_line(clamp_x(from), clamp_x(p1));
+}
+
+// Each row that the line crosses gets the area to the right of the line,
+// spread over the pixels it crosses, and the rest of its height in the
+// pixel after them, to be summed along the row (as in the font-rs
+// rasterizer).  Lines that go up count against those that go down.
+void PathRasterizer::Coverage::add_clipped_line(Point p0, Point p1)
+{
+    if(p0.y == p1.y)
+	return;
+
+    double dir = 1.0;
+
+    if(p0.y > p1.y)
+    {
+	std::swap(p0, p1);
+	dir = -1.0;
+    }
+
+    if(p1.y <= 0 || p0.y >= m_height)
+	return;
+
+    double dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+    double x = p0.x;
+
+    long first_row = static_cast<long>(std::floor(p0.y));
+
+    if(p0.y < 0)
+    {
+	x = std::clamp(x - p0.y * dxdy, 0.0, double(m_width));
+	first_row = 0;
+    }
+
+    long end_row = std::min(m_height, static_cast<long>(std::ceil(p1.y)));
+
+    m_min_row = empty() ? first_row : std::min(m_min_row, first_row);
+    m_max_row = std::max(m_max_row, end_row - 1);
+
+    for(long y = first_row; y < end_row; ++y)
+    {
+	float *row = &m_area[static_cast<size_t>(y * m_stride)];
+
+	double dy = std::min(y + 1.0, p1.y) - std::max(double(y), p0.y);
+	double x_next = std::clamp(x + dxdy * dy, 0.0, double(m_width));
+	double d = dy * dir;
+
+	double x0 = std::min(x, x_next);
+	double x1 = std::max(x, x_next);
+
+	double x0_floor = std::floor(x0);
+	double x1_ceil = std::ceil(x1);
+
+	long x0i = static_cast<long>(x0_floor);
+	long x1i = static_cast<long>(x1_ceil);
+
+	if(x1i <= x0i + 1)
+	{
+	    // Within one pixel
+	    double mid = 0.5 * (x + x_next) - x0_floor;
+
+	    row[x0i] += static_cast<float>(d - d * mid);
+	    row[x0i + 1] += static_cast<float>(d * mid);
+	}
+	else
+	{
+	    double s = 1 / (x1 - x0);
+	    double x0_frac = x0 - x0_floor;
+	    double a0 = 0.5 * s * (1 - x0_frac) * (1 - x0_frac);
+	    double x1_frac = x1 - x1_ceil + 1;
+	    double a_end = 0.5 * s * x1_frac * x1_frac;
+
+	    row[x0i] += static_cast<float>(d * a0);
+
+	    if(x1i == x0i + 2)
+		row[x0i + 1] += static_cast<float>(d * (1 - a0 - a_end));
+	    else
+	    {
+		double a1 = s * (1.5 - x0_frac);
+
+		row[x0i + 1] += static_cast<float>(d * (a1 - a0));
+
+		for(long xi = x0i + 2; xi < x1i - 1; ++xi)
+		    row[xi] += static_cast<float>(d * s);
+
+		double a2 = a1 + (x1i - x0i - 3) * s;
+
+		row[x1i - 1] += static_cast<float>(d * (1 - a2 - a_end));
+	    }
+
+	    row[x1i] += static_cast<float>(d * a_end);
+	}
+
+	x = x_next;
+    }
+}
+
+// The pieces of a stroke overlap, so they must all wind the same way, to
+// add up rather than cancel out.
+void PathRasterizer::Coverage::add_polygon(const Point *points, size_t count)
+{
+    if(count < 3)
+	return;
+
+    double area = 0;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+	const Point &a = points[i];
+	const Point &b = points[(i + 1) % count];
+
+	area += a.x * b.y - b.x * a.y;
+    }
+
+    for(size_t i = 0; i < count; ++i)
+    {
+	size_t j = (i + 1) % count;
+
+	if(area >= 0)
+	    add_line(points[i], points[j]);
+	else
+	    add_line(points[j], points[i]);
+    }
+}
+
+template<typename Paint>
+void PathRasterizer::Coverage::paint_and_clear(Paint &&paint)
+{
+    // Less than this is rounding error.
+    constexpr double min_coverage = 1e-4;
+
+    for(long y = m_min_row; y <= m_max_row; ++y)
+    {
+	float *row = &m_area[static_cast<size_t>(y * m_stride)];
+
+	double sum = 0;
+
+	for(long x = 0; x < m_width; ++x)
+	{
+	    sum += row[x];
+	    row[x] = 0;
+
+	    double coverage = std::min(1.0, std::abs(sum));
+
+	    if(coverage > min_coverage)
+		paint(static_cast<size_t>(y * m_width + x), coverage);
+	}
+
+	row[m_width] = 0;
+	row[m_width + 1] = 0;
+    }
+
+    m_min_row = 0;
+    m_max_row = -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// The picture
+//////////////////////////////////////////////////////////////////////////////
+
+// The viewbox is fitted to the image, centered, keeping its aspect ratio (as
+// SVG's default preserveAspectRatio does).
+PathRasterizer::PathRasterizer(const SVGConfig &config)
+    : m_width(std::max(1L, config.get_width()))
+    , m_height(std::max(1L, config.get_height()))
+    , m_config(config)
+{
+    auto viewbox = config.get_viewbox();
+
+    if(viewbox[2] > 0 && viewbox[3] > 0)
+    {
+	m_scale = std::min(m_width / viewbox[2], m_height / viewbox[3]);
+
+	m_offset_x = (m_width - viewbox[2] * m_scale) / 2 - viewbox[0] * m_scale;
+	m_offset_y = (m_height - viewbox[3] * m_scale) / 2 - viewbox[1] * m_scale;
+    }
+
+    Color background;
+
+    if(!parse_color(config.get_background_color(), background))
+	background = {};
+
+    m_pixels.resize(static_cast<size_t>(m_width * m_height) * 4);
+
+    for(size_t i = 0; i < m_pixels.size(); i += 4)
+    {
+	m_pixels[i]     = background.r * background.a;
+	m_pixels[i + 1] = background.g * background.a;
+	m_pixels[i + 2] = background.b * background.a;
+	m_pixels[i + 3] = background.a;
+    }
+
+    m_fill.resize(m_width, m_height);
+    m_stroke.resize(m_width, m_height);
+
+    set_style({});
+}
+
+void PathRasterizer::new_path(const string &attributes)
+{
+    paint_path();
+
+    set_style(attributes);
+}
+
+void PathRasterizer::finish()
+{
+    paint_path();
+}
+
+void PathRasterizer::paint_path()
+{
+    end_subpath();
+
+    auto painter = [this](const Color &color)
+    {
+	return [this, color](size_t index, double coverage)
+	{
+	    float alpha = color.a * static_cast<float>(coverage);
+	    float *pixel = &m_pixels[index * 4];
+
+	    pixel[0] = color.r * alpha + pixel[0] * (1 - alpha);
+	    pixel[1] = color.g * alpha + pixel[1] * (1 - alpha);
+	    pixel[2] = color.b * alpha + pixel[2] * (1 - alpha);
+	    pixel[3] = alpha + pixel[3] * (1 - alpha);
+	};
+    };
+
+    m_fill.paint_and_clear(painter(m_style.fill));
+    m_stroke.paint_and_clear(painter(m_style.stroke));
+}
+
+std::vector<std::uint8_t> PathRasterizer::get_image() const
+{
+    std::vector<std::uint8_t> image(m_pixels.size());
+
+    auto to_byte = [](float value)
+    {
+	return static_cast<std::uint8_t>(
+		    std::lround(std::clamp(value, 0.0f, 1.0f) * 255));
+    };
+
+    for(size_t i = 0; i < m_pixels.size(); i += 4)
+    {
+	float alpha = m_pixels[i + 3];
+
+	for(size_t c = 0; c < 3; ++c)
+	    image[i + c] = alpha > 0 ? to_byte(m_pixels[i + c] / alpha) : 0;
+
+	image[i + 3] = to_byte(alpha);
+    }
+
+    return image;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Gathering commands
+//////////////////////////////////////////////////////////////////////////////
+
+void PathRasterizer::emit_char(char ch)
+{
+    if(ch != ' ' && ch != '\n' && m_command.start(ch))
+	finish_command();
+}
+
+void PathRasterizer::emit_flag(bool flag)
+{
+    if(m_command.add_flag(flag))
+	finish_command();
+}
+
+void PathRasterizer::emit_number(double val)
+{
+    if(m_command.add(val))
+	finish_command();
+}
+
+void PathRasterizer::finish_command()
+{
+    const PathCommand &c = m_command;
+    const double *a = c.args;
+
+    Point end = m_current;
+
+    if(c.nargs >= 2)
+	end = to_pixels(a[c.nargs - 2], a[c.nargs - 1]);
+
+    ControlPoint control;
+
+    auto line = [this](double x, double y)
+    {
+	line_to({ x, y });
+    };
+
+    switch(c.cmd)
+    {
+	case 'M':
+	    move_to(end);
+	    break;
+
+	case 'L':
+	    line_to(end);
+	    break;
+
+	case 'H':
+	    end = { a[0] * m_scale + m_offset_x, m_current.y };
+	    line_to(end);
+	    break;
+
+	case 'V':
+	    end = { m_current.x, a[0] * m_scale + m_offset_y };
+	    line_to(end);
+	    break;
+
+	case 'Z':
+	    close_subpath();
+	    end = m_start;
+	    break;
+
+	case 'Q':
+	    control = { 'Q', to_pixels(a[0], a[1]) };
+	    flatten_quadratic(m_current, control.point, end, flatness, line);
+	    break;
+
+	case 'T':
+	    control = { 'Q', m_control.reflected('T', m_current) };
+	    flatten_quadratic(m_current, control.point, end, flatness, line);
+	    break;
+
+	case 'C':
+	{
+	    Point c1 = to_pixels(a[0], a[1]);
+	    Point c2 = to_pixels(a[2], a[3]);
+
+	    flatten_cubic(m_current, c1, c2, end, flatness, line);
+
+	    control = { 'C', c2 };
+	    break;
+	}
+
+	case 'S':
+	{
+	    Point c2 = to_pixels(a[0], a[1]);
+
+	    flatten_cubic(m_current, m_control.reflected('S', m_current), c2, end,
+			  flatness, line);
+
+	    control = { 'C', c2 };
+	    break;
+	}
+
+	case 'A':
+	    flatten_arc(m_current, a[0] * m_scale, a[1] * m_scale, a[2],
+			a[3] != 0, a[4] != 0, end, flatness, line);
+	    break;
+
+	default:
+	    assert(false);
+	    break;
+    }
+
+    m_current = end;
+    m_control = control;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Subpaths
+//////////////////////////////////////////////////////////////////////////////
+
+void PathRasterizer::move_to(Point pt)
+{
+    end_subpath();
+
+    m_current = m_start = pt;
+}
+
+void PathRasterizer::line_to(Point pt)
+{
+    if(!m_in_subpath)
+    {
+	m_in_subpath = true;
+	m_has_segment = false;
+	m_has_dot = false;
+	m_start = m_current;
+    }
+
+    if(m_style.fill.a > 0)
+	m_fill.add_line(m_current, pt);
+
+    if(m_style.stroke.a > 0)
+    {
+	double dx = pt.x - m_current.x;
+	double dy = pt.y - m_current.y;
+	double length = std::hypot(dx, dy);
+
+	if(length > 1e-9)
+	{
+	    Point dir{ dx / length, dy / length };
+
+	    if(m_has_segment)
+		stroke_join(m_current, m_last_dir, dir);
+	    else
+		m_first_dir = dir;
+
+	    stroke_segment(m_current, pt, dir);
+
+	    m_last_dir = dir;
+	    m_has_segment = true;
+	}
+	else
+	    m_has_dot = true;
+    }
+
+    m_current = pt;
+}
+
+// The stroke joins the end to the start, rather than having caps.
+void PathRasterizer::close_subpath()
+{
+    if(!m_in_subpath)
+	return;
+
+    line_to(m_start);
+
+    if(m_style.stroke.a > 0)
+    {
+	if(m_has_segment)
+	    stroke_join(m_start, m_last_dir, m_first_dir);
+	else if(m_has_dot)
+	    stroke_dot(m_start);
+    }
+
+    m_in_subpath = false;
+}
+
+// The fill is closed, and the stroke gets its caps.
+void PathRasterizer::end_subpath()
+{
+    if(!m_in_subpath)
+	return;
+
+    if(m_style.fill.a > 0)
+	m_fill.add_line(m_current, m_start);
+
+    if(m_style.stroke.a > 0)
+    {
+	if(m_has_segment)
+	{
+	    stroke_cap(m_start, m_first_dir, true);
+	    stroke_cap(m_current, m_last_dir, false);
+	}
+	else if(m_has_dot)
+	    stroke_dot(m_current);
+    }
+
+    m_in_subpath = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Stroking
+//////////////////////////////////////////////////////////////////////////////
+
+void PathRasterizer::add_arc_points(std::vector<Point> &points, Point center,
+				    double radius, double a0, double a1) const
+{
+    double step = radius > flatness
+		? 2 * std::acos(1 - flatness / radius)
+		: PI / 2;
+
+    int n = static_cast<int>(std::ceil(std::abs(a1 - a0) / step));
+
+    n = std::clamp(n, 2, 1000);
+
+    for(int i = 1; i < n; ++i)
+    {
+	double angle = a0 + (a1 - a0) * i / n;
+
+	points.push_back({ center.x + radius * std::cos(angle),
+			   center.y + radius * std::sin(angle) });
+    }
+}
+
+void PathRasterizer::stroke_segment(Point p0, Point p1, Point dir)
+{
+    double half = m_style.stroke_width / 2;
+
+    Point n{ -dir.y * half, dir.x * half };
+
+    Point quad[4] =
+    {
+	{ p0.x + n.x, p0.y + n.y },
+	{ p1.x + n.x, p1.y + n.y },
+	{ p1.x - n.x, p1.y - n.y },
+	{ p0.x - n.x, p0.y - n.y }
+    };
+
+    m_stroke.add_polygon(quad, 4);
+}
+
+// The join fills the wedge on the outside of the turn.
+void PathRasterizer::stroke_join(Point at, Point dir_in, Point dir_out)
+{
+    double cross = dir_in.x * dir_out.y - dir_in.y * dir_out.x;
+    double dot = dir_in.x * dir_out.x + dir_in.y * dir_out.y;
+
+    // Straight on
+    if(std::abs(cross) < 1e-9 && dot > 0)
+	return;
+
+    double half = m_style.stroke_width / 2;
+
+    // The outside is to the right of a left turn, and the other way around.
+    double side = cross > 0 ? -half : half;
+
+    Point a{ at.x - dir_in.y * side, at.y + dir_in.x * side };
+    Point b{ at.x - dir_out.y * side, at.y + dir_out.x * side };
+
+    auto &wedge = m_polygon;
+
+    wedge.assign({ at, a });
+
+    switch(m_style.join)
+    {
+	case LineJoin::round:
+	{
+	    double a0 = std::atan2(a.y - at.y, a.x - at.x);
+	    double a1 = std::atan2(b.y - at.y, b.x - at.x);
+
+	    double delta = std::remainder(a1 - a0, 2 * PI);
+
+	    // The arc goes around the outside, which is the way the path
+	    // was going.
+	    double mid = a0 + delta / 2;
+
+	    if(std::cos(mid) * dir_in.x + std::sin(mid) * dir_in.y
+	       - std::cos(mid) * dir_out.x - std::sin(mid) * dir_out.y < 0)
+		delta += delta > 0 ? -2 * PI : 2 * PI;
+
+	    add_arc_points(wedge, at, half, a0, a0 + delta);
+	    break;
+	}
+
+	case LineJoin::miter:
+	{
+	    // The miter's length, over the stroke width
+	    double ratio = 1 / std::sqrt(std::max(1e-12, (1 + dot) / 2));
+
+	    if(ratio <= m_style.miter_limit)
+	    {
+		double mx = (a.x + b.x) / 2 - at.x;
+		double my = (a.y + b.y) / 2 - at.y;
+		double length = std::hypot(mx, my);
+
+		if(length > 1e-12)
+		    wedge.push_back({ at.x + mx / length * half * ratio,
+				      at.y + my / length * half * ratio });
+	    }
+	    break;
+	}
+
+	case LineJoin::bevel:
+	    break;
+    }
+
+    wedge.push_back(b);
+
+    m_stroke.add_polygon(wedge.data(), wedge.size());
+}
+
+// 'dir' is the direction of the path at that end.
+void PathRasterizer::stroke_cap(Point at, Point dir, bool at_start)
+{
+    if(m_style.cap == LineCap::butt)
+	return;
+
+    double half = m_style.stroke_width / 2;
+
+    // Outwards, and across
+    Point out = at_start ? Point{ -dir.x, -dir.y } : dir;
+    Point n{ -out.y * half, out.x * half };
+
+    auto &cap = m_polygon;
+
+    cap.assign({ { at.x + n.x, at.y + n.y } });
+
+    if(m_style.cap == LineCap::round)
+    {
+	double a0 = std::atan2(n.y, n.x);
+
+	// From one side, around the end, to the other
+	double cross = n.x * out.y - n.y * out.x;
+
+	add_arc_points(cap, at, half, a0, a0 + (cross > 0 ? PI : -PI));
+    }
+    else
+    {
+	cap.push_back({ at.x + n.x + out.x * half, at.y + n.y + out.y * half });
+	cap.push_back({ at.x - n.x + out.x * half, at.y - n.y + out.y * half });
+    }
+
+    cap.push_back({ at.x - n.x, at.y - n.y });
+
+    m_stroke.add_polygon(cap.data(), cap.size());
+}
+
+// A subpath that goes nowhere is drawn as its caps would be.
+void PathRasterizer::stroke_dot(Point at)
+{
+    double half = m_style.stroke_width / 2;
+
+    auto &dot = m_polygon;
+
+    dot.clear();
+
+    switch(m_style.cap)
+    {
+	case LineCap::round:
+	    dot.push_back({ at.x + half, at.y });
+	    add_arc_points(dot, at, half, 0, 2 * PI);
+	    break;
+
+	case LineCap::square:
+	    dot = { { at.x - half, at.y - half }, { at.x + half, at.y - half },
+		    { at.x + half, at.y + half }, { at.x - half, at.y + half } };
+	    break;
+
+	case LineCap::butt:
+	    return;
+    }
+
+    m_stroke.add_polygon(dot.data(), dot.size());
+}
@@ -0,0 +1,213 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Turtle.h"
+#include "BasicSVG.h"
+#include "Flatten.h"
+#include "PathCommand.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// PathRasterizer - draws the path data into an image, as it is produced
+//
+//   For previews and thumbnails (--png), without writing the path data as
+//   text and reading it back.  It reads the turtle's (absolute, world
+//   space) commands, like PathBounds does, and draws the picture that -s or
+//   --svg-out would make: the same size, viewbox, background, fill and
+//   stroke (its width, linejoin and linecap), and new_path's attributes.
+//
+//   - Curves and arcs are flattened into lines, within a tenth of a pixel.
+//
+//   - Each path is filled with the nonzero rule, and its stroke drawn over
+//     it, in the order they were drawn.  The coverage of each pixel is
+//     found exactly (the area of it inside the lines), so the edges are
+//     anti-aliased, but where the pieces of a stroke overlap, their edges
+//     can come out a little darker than a browser would draw them.
+//
+//   - Colors are names (as in CSS), #rgb, #rrggbb, or rgb(r, g, b).  A
+//     color that isn't understood is taken as SVG takes it: the fill is
+//     black, and the stroke is none.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class PathRasterizer final : public TurtleEmitInterface
+{
+public:
+    // Red, green, blue and alpha, from 0 to 1.  Alpha is 0 for none.
+    struct Color
+    {
+	float r = 0, g = 0, b = 0, a = 0;
+    };
+
+    enum class LineJoin { miter, round, bevel };
+    enum class LineCap { butt, round, square };
+
+private:
+    using Point = CurvePoint;
+
+    struct Style
+    {
+	Color fill;
+	Color stroke;
+
+	// In pixels
+	double stroke_width = 1.0;
+
+	LineJoin join = LineJoin::miter;
+	LineCap cap = LineCap::butt;
+	double miter_limit = 4.0;
+    };
+
+    // The area covered by the lines of a polygon (or of many), spread over
+    // the pixels that the lines cross.  Each row sums to each pixel's
+    // coverage, as the lines wind around it, from left to right.
+    class Coverage
+    {
+	long m_width = 0;
+	long m_height = 0;
+	long m_stride = 0;
+
+	std::vector<float> m_area;
+
+	// The rows that have been drawn in, since the last clear()
+	long m_min_row = 0;
+	long m_max_row = -1;
+
+	void add_clipped_line(Point p0, Point p1);
+
+    public:
+	void resize(long width, long height);
+
+	// In pixels, anywhere (what's outside the image is left out)
+	void add_line(Point p0, Point p1);
+
+	// Its edges, with any winding
+	void add_polygon(const Point *points, size_t count);
+
+	bool empty() const { return m_max_row < m_min_row; }
+
+	// Calls paint(index, coverage) for each pixel that has any, where the
+	// index is y * width + x.  Then all of the coverage is cleared.
+	template<typename Paint>
+	void paint_and_clear(Paint &&paint);
+    };
+
+    // The picture, premultiplied by alpha
+    long m_width = 0;
+    long m_height = 0;
+
+    std::vector<float> m_pixels;
+
+    // From path data units to pixels: x * m_scale + m_offset_x
+    double m_scale = 1.0;
+    double m_offset_x = 0.0;
+    double m_offset_y = 0.0;
+
+    // Each path's style comes from the config, or from new_path's
+    // attributes.
+    const SVGConfig &m_config;
+    Style m_style;
+
+    Coverage m_fill;
+    Coverage m_stroke;
+
+    // The command being gathered
+    PathCommand m_command;
+
+    // In pixels
+    Point m_current;
+    Point m_start;
+
+    ControlPoint m_control;
+
+    // The subpath being stroked.  Its first segment's direction is kept for
+    // the join when it's closed, and the last one's for the next join.
+    bool m_in_subpath = false;
+    bool m_has_segment = false;
+    bool m_has_dot = false; // a segment of no length (a dot, with caps)
+    Point m_first_dir;
+    Point m_last_dir;
+
+    Point to_pixels(double x, double y) const
+    {
+	return { x * m_scale + m_offset_x, y * m_scale + m_offset_y };
+    }
+
+    void finish_command();
+
+    void move_to(Point pt);
+    void line_to(Point pt);
+    void close_subpath();
+    void end_subpath();
+
+    // The pieces of the stroke.  Each polygon is built in m_polygon, which
+    // is kept to save allocating one for every join.
+    std::vector<Point> m_polygon;
+
+    void stroke_segment(Point p0, Point p1, Point dir);
+    void stroke_join(Point at, Point dir_in, Point dir_out);
+    void stroke_cap(Point at, Point dir, bool at_start);
+    void stroke_dot(Point at);
+
+    // The points of an arc around 'center', from angle a0 to a1
+    // (radians), not including the ends
+    void add_arc_points(std::vector<Point> &points, Point center,
+			double radius, double a0, double a1) const;
+
+    // Paints the path, and starts the next one.
+    void paint_path();
+
+    void set_style(const std::string &attributes);
+
+public:
+    explicit PathRasterizer(const SVGConfig &config);
+
+    // new_path's attributes, or none for the configured ones.  The path so
+    // far is painted first.
+    void new_path(const std::string &attributes);
+
+    // Paints what's left of the path.
+    void finish();
+
+    // 8 bit RGBA, not premultiplied, row by row from the top
+    std::vector<std::uint8_t> get_image() const;
+
+    long get_width() const  { return m_width; }
+    long get_height() const { return m_height; }
+
+    // Returns false if 'text' isn't a color.
+    static bool parse_color(const std::string &text, Color &color);
+
+    //// TurtleEmitInterface
+
+    void emit_char(char ch) override;
+    void emit_flag(bool flag) override;
+    void emit_number(double val) override;
+};
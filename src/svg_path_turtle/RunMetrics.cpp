@@ -0,0 +1,80 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "RunMetrics.h"
+
+#include <format>
+
+void RunMetrics::read_engine(const ExecutionEngine &engine)
+{
+    segments = engine.get_segment_count();
+    commands = engine.get_command_counts();
+
+    peak_stack = engine.get_peak_stack_size();
+    max_frames = engine.get_peak_frames();
+
+    chunks = engine.get_num_chunks();
+
+    arena = engine.get_arena_stats();
+}
+
+void RunMetrics::write_json(std::ostream &out) const
+{
+    out << "{\n";
+
+    out << std::format("  \"parse_ms\": {:.3f},\n", parse_ms);
+    out << std::format("  \"execute_ms\": {:.3f},\n", execute_ms);
+    out << std::format("  \"output_bytes\": {},\n", output_bytes);
+    out << std::format("  \"segments\": {},\n", segments);
+
+    // Only the commands that were written, by letter
+    out << "  \"commands\": {";
+
+    const char *separator = "";
+
+    for(size_t i = 0; i < commands.size(); ++i)
+	if(commands[i])
+	{
+	    out << std::format("{} \"{}\": {}",
+			       separator, static_cast<char>('A' + i),
+			       commands[i]);
+	    separator = ",";
+	}
+
+    out << " },\n";
+
+    out << std::format("  \"peak_stack\": {{ \"locals\": {}, "
+		       "\"captures\": {} }},\n",
+		       peak_stack.locals, peak_stack.captures);
+    out << std::format("  \"max_frames\": {},\n", max_frames);
+    out << std::format("  \"chunks\": {},\n", chunks);
+    out << std::format("  \"imports\": {},\n", imports);
+
+    out << std::format("  \"arena\": {{ \"allocations\": {}, \"bytes\": {}, "
+		       "\"blocks\": {}, \"block_bytes\": {} }}\n",
+		       arena.allocations, arena.bytes,
+		       arena.blocks, arena.block_bytes);
+
+    out << "}\n";
+}
@@ -0,0 +1,66 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Engine.h"
+
+#include <cstdint>
+#include <ostream>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// RunMetrics - what a run of a program cost, for --metrics
+//
+//   The counts are kept by the engine, its stack and its turtle as they go
+//   (see ExecutionEngine::get_peak_stack_size() and such), whether or not
+//   they are asked for, so that they cost next to nothing.  This just
+//   gathers them up, with the times and the output size, and writes them
+//   as a JSON object.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+struct RunMetrics
+{
+    double parse_ms = 0;
+    double execute_ms = 0;
+
+    std::uint64_t output_bytes = 0;
+
+    std::uint64_t segments = 0;
+    OstreamTurtle::CommandCounts commands{};
+
+    EngineStack::Size peak_stack;
+    int max_frames = 0;
+
+    size_t chunks = 0;
+    size_t imports = 0;
+
+    ProgramArena::Stats arena;
+
+    // Everything but the times, the output size and the imports
+    void read_engine(const ExecutionEngine &engine);
+
+    void write_json(std::ostream &out) const;
+};
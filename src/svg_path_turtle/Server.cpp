@@ -0,0 +1,306 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Server.h"
+
+#include "Messages.h"
+
+#include <algorithm>
+#include <vector>
+#include <sstream>
+#include <cmath>
+#include <atomic>
+#include <csignal>
+#include <cctype>
+
+using std::string;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Utilities
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Split request options as a shell would split them on spaces, except that
+// a quoted word, such as "200 200 white" for --svg-out, stays one argument.
+// Returns false for an unterminated quote.
+static bool split_options(const string &options, std::vector<string> &args)
+{
+    size_t i = 0;
+
+    for(;;)
+    {
+	while(i < options.size() && std::isspace((unsigned char)options[i]))
+	    ++i;
+
+	if(i == options.size())
+	    return true;
+
+	string arg;
+
+	while(i < options.size() && !std::isspace((unsigned char)options[i]))
+	{
+	    char c = options[i++];
+
+	    if(c == '"' || c == '\'')
+	    {
+		size_t end = options.find(c, i);
+
+		if(end == string::npos)
+		    return false;
+
+		arg.append(options, i, end - i);
+		i = end + 1;
+	    }
+	    else
+		arg += c;
+	}
+
+	args.push_back(std::move(arg));
+    }
+}
+
+// A size in a request header.  Only digits are taken, since >> would wrap
+// "-1" around to the largest size_t.
+static bool read_size(std::istream &in, std::size_t &size)
+{
+    in >> std::ws;
+
+    if(!std::isdigit(in.peek()))
+	return false;
+
+    return static_cast<bool>(in >> size);
+}
+
+// Set by SIGUSR1, to cancel the request being run (see serve())
+static std::atomic<bool> s_cancel_request = false;
+
+static_assert(std::atomic<bool>::is_always_lock_free);
+
+extern "C" void cancel_request_handler(int)
+{
+    s_cancel_request.store(true, std::memory_order_relaxed);
+}
+
+static void write_response(std::ostream &out,
+			   bool ok,
+			   const string &output,
+			   const string &messages)
+{
+    out << (ok ? "ok " : "error ")
+	<< output.size() << ' ' << messages.size() << '\n'
+	<< output << messages;
+
+    out.flush();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  RenderServer
+//
+//////////////////////////////////////////////////////////////////////////////
+
+RenderServer::RenderServer(const Options &opt)
+    : m_opt(opt)
+    , m_request_opt(opt)
+    , m_runner(opt.bytecode)
+{
+}
+
+// The output options of the command line, for one request.  Each request
+// starts from the options given to --server.
+bool RenderServer::parse_request_options(const string &options,
+					 std::ostream &messages)
+{
+    m_request_opt = m_opt;
+
+    auto set_format = [this](bool Options::*format)
+    {
+	m_request_opt.optimize = false;
+	m_request_opt.prettyprint = false;
+	m_request_opt.compact = false;
+
+	m_request_opt.*format = true;
+    };
+
+    auto error = [&messages](const string &msg)
+    {
+	report_message(messages, {}, "Error", msg);
+
+	return false;
+    };
+
+    std::vector<string> args;
+
+    if(!split_options(options, args))
+	return error("Unterminated quote in request options");
+
+    // A request can lower the server's limits, but not raise them.
+    auto set_limit = [this](long Options::*limit, const string &value)
+    {
+	long n = std::stol(value);
+
+	if(n <= 0)
+	    throw std::invalid_argument(value);
+
+	long server_limit = m_opt.*limit;
+
+	m_request_opt.*limit = server_limit ? std::min(n, server_limit) : n;
+    };
+
+    auto find_limit = [](const string &arg) -> long Options::*
+    {
+	if(arg == "--max-statements") return &Options::max_statements;
+	if(arg == "--max-time")       return &Options::max_time_ms;
+	if(arg == "--max-output")     return &Options::max_output_bytes;
+	if(arg == "--max-stack")      return &Options::max_stack;
+
+	return nullptr;
+    };
+
+    for(size_t i = 0; i < args.size(); ++i)
+    {
+	const string &arg = args[i];
+
+	bool has_value = i + 1 < args.size();
+
+	if(arg == "--optimize")             set_format(&Options::optimize);
+	else if(arg == "--prettyprint")     set_format(&Options::prettyprint);
+	else if(arg == "--compact")         set_format(&Options::compact);
+	else if(arg == "--simplify")        m_request_opt.simplify = true;
+	else if(arg == "--integer-grid")    m_request_opt.integer_grid = true;
+	else if(arg == "--no-pen-error")    m_request_opt.disable_pen_warning = true;
+	else if(arg == "-s")                m_request_opt.svg_out.enable();
+	else if(arg == "--decimal-places" && has_value)
+	{
+	    try
+	    {
+		m_request_opt.decimal_places = std::stoi(args[++i]);
+	    }
+	    catch(...)
+	    {
+		return error("--decimal-places: invalid number");
+	    }
+	}
+	else if(arg == "--svg-out" && has_value)
+	{
+	    if(!m_request_opt.svg_out.configure(args[++i]))
+		return error("Invalid config for --svg-out option");
+	}
+	else if(auto limit = find_limit(arg); limit && has_value)
+	{
+	    try
+	    {
+		set_limit(limit, args[++i]);
+	    }
+	    catch(...)
+	    {
+		return error(arg + ": invalid number");
+	    }
+	}
+	else if(arg == "--param" && has_value)
+	{
+	    if(!m_request_opt.add_param(args[++i]))
+		return error("Invalid --param: " + args[i]);
+	}
+	else
+	    return error("Unrecognized request option: " + arg);
+    }
+
+    // As on the command line
+    if(auto problem = m_request_opt.apply_decimal_places(); !problem.empty())
+	return error(problem);
+
+    return true;
+}
+
+bool RenderServer::render(const string &options,
+			  const string &program,
+			  std::ostream &messages,
+			  string &output)
+{
+    if(!parse_request_options(options, messages))
+	return false;
+
+    m_request_opt.cancel = &s_cancel_request;
+
+    // Each program gets its own name in the shared files, for its messages.
+    string name = "request " + std::to_string(m_request_count);
+
+    return m_runner.run(name, program, m_request_opt, messages, output);
+}
+
+int RenderServer::serve(std::istream &in, std::ostream &out)
+{
+#ifdef SIGUSR1
+    // A supervisor can stop a request that runs too long, without losing
+    // the warm process.
+    std::signal(SIGUSR1, cancel_request_handler);
+#endif
+
+    for(;;)
+    {
+	if((in >> std::ws).peek() == std::istream::traits_type::eof())
+	    return 0;
+
+	std::size_t options_size = 0;
+	std::size_t program_size = 0;
+
+	if(!read_size(in, options_size) || !read_size(in, program_size)
+	   || in.get() != '\n'
+	   || options_size > s_max_request_bytes
+	   || program_size > s_max_request_bytes - options_size)
+	{
+	    write_response(out, false, {},
+			   "Error: Invalid request header - expected "
+			   "\"<options bytes> <program bytes>\"\n");
+	    return 1;
+	}
+
+	string options(options_size, '\0');
+	string program(program_size, '\0');
+
+	in.read(options.data(), options_size);
+	in.read(program.data(), program_size);
+
+	if(!in)
+	{
+	    write_response(out, false, {}, "Error: Incomplete request\n");
+	    return 1;
+	}
+
+	++m_request_count;
+
+	std::ostringstream messages;
+
+	string output;
+
+	// A signal that came between requests is for no one.
+	s_cancel_request.store(false, std::memory_order_relaxed);
+
+	bool ok = render(options, program, messages, output);
+
+	write_response(out, ok, output, messages.str());
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "ProgramRunner.h"
+#include "Options.h"
+
+#include <string>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// RenderServer - runs one program after another, from a stream (--server)
+//
+//   For a caller that would otherwise run svg_path_turtle once per path: the
+//   process, and the modules that the programs import, stay warm between
+//   requests.
+//
+//   Requests and responses are length-prefixed, so that programs and path
+//   data don't need any quoting:
+//
+//     request:   <options bytes> <program bytes>\n<options><program>
+//     response:  ok <output bytes> <message bytes>\n<output><messages>
+//                error <output bytes> <message bytes>\n<output><messages>
+//
+//   - The options are the output options of the command line, and --param,
+//     separated by spaces, e.g. "--optimize --decimal-places 3 -s".  A value
+//     with spaces is quoted, e.g. --svg-out "200 200 white".  Options given
+//     to --server itself are the defaults.
+//
+//   - The messages are what would otherwise have gone to stderr: errors, and
+//     warnings.  For an error response, the output is empty.
+//
+//   - A request's limits (--max-statements and such) can only be lower than
+//     the server's, and SIGUSR1 cancels the request being run, which stops
+//     with an error response (see ExecutionEngine::set_limits()).
+//
+//   - The server exits at the end of its input, or when a request header is
+//     not understood (since the next request can't be found after that).
+//
+//   The programs are run by one ProgramRunner, so they share their imports,
+//   and each one costs its own parse, and no more.  A request that repeats
+//   the previous request's program (with other params, say) isn't parsed.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class RenderServer
+{
+    const Options &m_opt;
+
+    // The options of the request being run
+    Options m_request_opt;
+
+    ProgramRunner m_runner;
+
+    std::uint64_t m_request_count = 0;
+
+    // Larger requests are taken to be a garbled header.
+    static constexpr std::size_t s_max_request_bytes = 256 * 1024 * 1024;
+
+    bool parse_request_options(const std::string &options,
+			       std::ostream &messages);
+
+    bool render(const std::string &options,
+		const std::string &program,
+		std::ostream &messages,
+		std::string &output);
+
+public:
+    RenderServer(const RenderServer &) = delete;
+    RenderServer &operator=(const RenderServer &) = delete;
+
+    explicit RenderServer(const Options &opt);
+
+    // Returns the exit code: 0 at the end of the input, 1 for a bad request.
+    int serve(std::istream &in, std::ostream &out);
+};
@@ -25,12 +25,9 @@
 #include "Tokenizer.h"
 #include "Tokens.h"
 
-using namespace ParserStarterKit;
+#include <sstream>
 
-int Lexer::get_next_char()
-{
-    return m_istream.get();
-}
+using namespace ParserStarterKit;
 
 bool Lexer::push_next_token()
 {
@@ -63,7 +60,34 @@ bool Lexer::consume_multichar_punctuation()
 }
 
 Lexer::Lexer(std::istream &in)
-    : m_istream(in)
+{
+    std::ostringstream contents;
+
+    contents << in.rdbuf();
+
+    m_source = std::move(contents).str();
+
+    set_input_buffer(m_source.data(), m_source.data() + m_source.size());
+
+    setup_language();
+}
+
+Lexer::Lexer(std::string_view source)
+{
+    const char *begin = source.empty() ? "" : source.data();
+
+    set_input_buffer(begin, begin + source.size());
+
+    setup_language();
+}
+
+Lexer::Lexer(std::string_view source, ParserStarterKit::Location start)
+    : Lexer(source)
+{
+    set_input_start(start);
+}
+
+void Lexer::setup_language()
 {
     set_shell_style_comments();
 
@@ -75,6 +99,9 @@ Lexer::Lexer(std::istream &in)
     add_keyword(tk_turtle,     "turtle");
     add_keyword(tk_unique,     "unique");
     add_keyword(tk_breakpoint, "breakpoint");
+    add_keyword(tk_new_path,   "new_path");
+    add_keyword(tk_param,      "param");
+    add_keyword(tk_parallel,   "parallel");
 
     // This one is recognized manually, because the base tokenizer won't label
     // it as a tk_identifer.
@@ -27,16 +27,17 @@
 #include "BasicTokenizer.h"
 
 #include <istream>
+#include <string>
+#include <string_view>
 
+// The Lexer reads all of its input into memory first, so that the tokenizer
+// scans one contiguous buffer (see InputBase::set_input_buffer()).
 class Lexer : public ParserStarterKit::BasicTokenizer
 {
     using Base = ParserStarterKit::BasicTokenizer;
 
-    std::istream &m_istream;
+    std::string m_source;
 
-    // input_interface implementation
-
-    int get_next_char() override;
     bool push_next_token() override;
 
     // Utility functions
@@ -44,6 +45,16 @@ class Lexer : public ParserStarterKit::BasicTokenizer
     bool consume_2char(int ch1, int ch2, int token);
     bool consume_multichar_punctuation();
 
+    void setup_language();
+
 public:
+    // Reads all of 'in' at once.
     explicit Lexer(std::istream &in);
+
+    // Scans 'source' in place, without a copy.  It must outlive the Lexer.
+    explicit Lexer(std::string_view source);
+
+    // As above, for a part of a larger source, which starts at 'start'
+    // there (so that tokens have their locations in the whole source).
+    Lexer(std::string_view source, ParserStarterKit::Location start);
 };
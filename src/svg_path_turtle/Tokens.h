@@ -42,6 +42,9 @@ enum SvgPathTurtleTokens:int
     tk_turtle,
     tk_unique,
     tk_breakpoint,
+    tk_new_path,
+    tk_param,
+    tk_parallel,
 
     // operators
     tk_equality,
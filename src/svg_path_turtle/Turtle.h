@@ -25,11 +25,14 @@
 #pragma once
 
 #include "Matrix.h"
+#include "MathUtil.h"
 
 #include <assert.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
+#include <tuple>
 
 class TurtleEmitInterface
 {
@@ -52,8 +55,46 @@ public:
     }
 };
 
-class SvgPathTurtle : public TurtleEmitInterface
+// The receiver of OstreamTurtle's fragments (see set_fragment_sink()
+// there).  begin_fragments() comes before the first fragment that follows
+// other path data, and end_fragments() before the path data that follows
+// fragments (or the end of the path).  begin_path_data() comes before the
+// first path data that isn't in a fragment, at the start of each path and
+// after each end_fragments(), so the sink only ever sees path data that
+// something was drawn in.
+class TurtleFragmentSink
 {
+public:
+    virtual ~TurtleFragmentSink() = default;
+
+    virtual void begin_path_data() = 0;
+
+    virtual void begin_fragments() = 0;
+
+    // 'data' is a fragment's path data, in the coordinates that
+    // 'placement' places in world space.
+    virtual void fragment(std::string_view data,
+			  const Matrix2d &placement) = 0;
+
+    virtual void end_fragments() = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SvgPathTurtleBase - the turtle's state, and the commands that don't draw
+//
+//   - The commands that do draw are in BasicSvgPathTurtle<Emitter>, below,
+//     which sends its output to the Emitter with ordinary (non-virtual)
+//     calls.
+//
+//   - The engine's debugger only inspects the turtle, so it works with this
+//     base class, regardless of the emitter.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class SvgPathTurtleBase
+{
+protected:
     //// Types
 
     struct TurtleExceptionBase : public std::runtime_error
@@ -80,6 +121,8 @@ class SvgPathTurtle : public TurtleEmitInterface
 	    x = new_x;
 	    y = new_y;
 	}
+
+	bool operator==(const Point &) const = default;
     };
 
     // These are utility types, to distinguish these values when passing to
@@ -127,6 +170,15 @@ class SvgPathTurtle : public TurtleEmitInterface
 	    return { m_next_q_control_pt_is_valid,
 		     m_next_q_control_pt };
 	}
+
+	// An invalid control point is left as it was, and doesn't count.
+	bool operator==(const PathState &other) const
+	{
+	    return m_has_moved == other.m_has_moved
+		&& m_next_q_control_pt_is_valid == other.m_next_q_control_pt_is_valid
+		&& (!m_next_q_control_pt_is_valid
+		    || m_next_q_control_pt == other.m_next_q_control_pt);
+	}
     };
 
     struct TurtleState
@@ -140,19 +192,21 @@ class SvgPathTurtle : public TurtleEmitInterface
 	PathState path;
 
 	bool saved_point_is_valid = true;
+
+	bool operator==(const TurtleState &) const = default;
     };
 
     // A class for using movement and drawing commands to calculate final positions.
     class MoveCalcRAII
     {
-	SvgPathTurtle &t;
+	SvgPathTurtleBase &t;
 	PathState saved_path_state;
 
 	MoveCalcRAII(const MoveCalcRAII &) = delete;
 	MoveCalcRAII &operator=(const MoveCalcRAII &) = delete;
 
     public:
-	explicit MoveCalcRAII(SvgPathTurtle &t)
+	explicit MoveCalcRAII(SvgPathTurtleBase &t)
 	    : t(t)
 	    , saved_path_state(t.m_state.path)
 	{
@@ -213,12 +267,16 @@ class SvgPathTurtle : public TurtleEmitInterface
 	    for(auto &state : m_stack)
 		state.saved_point_is_valid = false;
 	}
+
+	bool operator==(const Stack &) const = default;
     };
 
     struct MatrixStackItem
     {
 	Matrix2d m;
 	bool reflected = false;
+
+	bool operator==(const MatrixStackItem &) const = default;
     };
 
     //// Data
@@ -228,6 +286,11 @@ class SvgPathTurtle : public TurtleEmitInterface
 
     TurtleState m_state;
 
+    // The unit vector of m_state.dir, which is only recalculated when
+    // the heading has changed since.
+    double m_unit_dir_angle = 0.0;
+    Point m_unit_dir{ 1.0, 0.0 };
+
     // Matrix transform
     Matrix2d m_xform;
 
@@ -239,43 +302,70 @@ class SvgPathTurtle : public TurtleEmitInterface
 
     Stack<MatrixStackItem> m_matrix_stack;
 
-protected:
+    // For a turtle started from a Snapshot: whether m_initial_pt is still
+    // the snapshot's, and whether z has used it while it was.
+    bool m_initial_pt_is_inherited = false;
+    bool m_used_inherited_initial_pt = false;
+
+    // For OstreamTurtle's fragments (see set_fragment_sink() there):
+    // while this is set, the output stays in the turtle's own coordinates,
+    // and get_world_xform() is what would place it in world space.
+    bool m_local_output = false;
+
     //// Internals
 
+    SvgPathTurtleBase() = default;
+
     bool is_reflection_viewport() const;
 
-    // For calling TurtleEmitInterface
-    void emit_item(char ch);
-    void emit_item(double val);
-    void emit_item(bool flag);
-    void emit_item(Point pt);
-    void emit_item(Length len);
-    void emit_item(Angle angle);
+    // Convert a point or a length to worldspace
+    void convert_to_world(Point &pt, double z = 1);
+    void convert_to_world(Length &length);
+    void convert_to_world(Angle &angle);
 
-    bool prepare_draw(const Point &current_pt);
+    // The transform from the turtle's coordinates to world space: all of
+    // the matrix levels', combined.
+    Matrix2d get_world_xform() const;
 
-    void draw(const Point &current_pt, auto&&...args)
+    void reflect_q_control_pt(Point control_pt);
+
+    const Point &get_unit_dir()
     {
-	if(prepare_draw(current_pt))
+	if(m_state.dir != m_unit_dir_angle)
 	{
-	    (emit_item(args), ...);
+	    sinCosD(m_state.dir, m_unit_dir.y, m_unit_dir.x);
 
-	    // Note: all SVG commands (except z/Z) end with the destination
-	    // point, and so it is presumed here, and should not be passed in.
-	    emit_item(m_state.point);
+	    m_unit_dir_angle = m_state.dir;
 	}
+
+	return m_unit_dir;
     }
 
-    // Convert a point or a length to worldspace
-    void convert_to_world(Point &pt, double z = 1);
-    void convert_to_world(Length &length);
-    void convert_to_world(Angle &angle);
+public:
+    // The turtle's whole state (but not its output's), so that another
+    // turtle can start where this one is (see OstreamTurtle::fork()).
+    class Snapshot
+    {
+	friend class SvgPathTurtleBase;
 
-    void reflect_q_control_pt(Point control_pt);
+	Point initial_pt;
+	TurtleState state;
+	Matrix2d xform;
+	bool reflected = false;
+	Stack<TurtleState> turtle_stack;
+	Stack<MatrixStackItem> matrix_stack;
+    };
+
+protected:
+    Snapshot get_snapshot() const;
+    void restore_snapshot(const Snapshot &snapshot);
+
+    // Whether the turtle is in the snapshot's state.  The subpath's start
+    // point can be left out, for a fork that didn't use it.
+    bool is_in_state(const Snapshot &snapshot, bool compare_initial_pt) const;
 
 public:
     //// Public Interface
-    SvgPathTurtle() = default;
 
     struct ParallelLinesException : public TurtleExceptionBase {};
     struct EmptyTurtleStackException : public TurtleExceptionBase {};
@@ -309,14 +399,91 @@ public:
     void l(double angle);           // relative
     void aim(double dx, double dy); // relative dx,dy
 
-    // Changing the position (these cause output)
+    // Changing the position without drawing
     //
     // dx,dy are relative, while x,y are absolute.
 
     void m(double dx, double dy);
     void M(double x, double y);
-    void f(double distance);
     void jump(double distance);
+
+    // Adjustments
+
+    void pen_up();   // ++pen_height
+    void pen_down(); // --pen_height
+
+    bool pen_is_on_paper() const
+    {
+	return m_state.pen_height == 0;
+    }
+
+    void push();
+    void pop();
+    void push_matrix();
+    void pop_matrix();
+
+    // Back to the initial state: at 0,0 facing 0, pen down, no transform,
+    // and empty stacks.
+    void reset_turtle();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// BasicSvgPathTurtle<Emitter> - the drawing commands
+//
+//   - Emitter is the most derived class (CRTP), and must provide
+//     emit_char(), emit_flag() and emit_number(), with the same meaning as in
+//     TurtleEmitInterface.  They are called directly, so when the Emitter is
+//     a final class (like OstreamTurtle), the output code can be inlined into
+//     f(), arc(), q() and the rest.
+//
+//   - The member definitions are in TurtleImpl.h, and each Emitter is
+//     explicitly instantiated once (see the extern templates below).  Raw C++
+//     code that drives a turtle of its own can include TurtleImpl.h and
+//     instantiate BasicSvgPathTurtle<> for its own emitter.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+template<class Emitter>
+class BasicSvgPathTurtle : public SvgPathTurtleBase
+{
+    Emitter &emitter() { return static_cast<Emitter &>(*this); }
+
+protected:
+    //// Internals
+
+    BasicSvgPathTurtle() = default;
+
+    // For calling the Emitter
+    void emit_item(char ch);
+    void emit_item(double val);
+    void emit_item(bool flag);
+    void emit_item(Point pt);
+    void emit_item(Length len);
+    void emit_item(Angle angle);
+
+    bool prepare_draw(const Point &current_pt);
+
+    void draw(const Point &current_pt, auto&&...args)
+    {
+	if(prepare_draw(current_pt))
+	{
+	    (emit_item(args), ...);
+
+	    // Note: all SVG commands (except z/Z) end with the destination
+	    // point, and so it is presumed here, and should not be passed in.
+	    emit_item(m_state.point);
+	}
+    }
+
+public:
+    //// Public Interface
+
+    // Changing the position (these cause output)
+    //
+    // dx,dy are relative, while x,y are absolute.
+
+    void f(double distance);
     void arc(double radius, double angle);
 
     // q() and Q() can throw ParallelLinesException
@@ -348,23 +515,27 @@ public:
 
     void z();
 
-    // Adjustments
-
-    void pen_up();   // ++pen_height
-    void pen_down(); // --pen_height
-
-    bool pen_is_on_paper() const
-    {
-	return m_state.pen_height == 0;
-    }
-
-    void push();
-    void pop();
-    void push_matrix();
-    void pop_matrix();
-
     // These are useful for formatted output, if desired.
 
     void nl(); // emit a newline
     void sp(); // emit a space
 };
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SvgPathTurtle - a turtle that emits through TurtleEmitInterface
+//
+//   - This is the virtual version: derive from it and override emit_char(),
+//     emit_flag() and emit_number() to receive the output.  Each token costs
+//     a virtual call.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class SvgPathTurtle : public BasicSvgPathTurtle<SvgPathTurtle>,
+		      public TurtleEmitInterface
+{
+public:
+    SvgPathTurtle() = default;
+};
+
+extern template class BasicSvgPathTurtle<SvgPathTurtle>;
@@ -0,0 +1,356 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "TurtleApi.h"
+
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+#include <functional>
+#include <system_error>
+
+using std::string;
+
+static void take_messages(const MessageLog &log, std::vector<Message> &messages)
+{
+    const auto &logged = log.get_messages();
+
+    messages.insert(messages.end(), logged.begin(), logged.end());
+}
+
+CompiledProgram TurtleCompiler::compile(const string &name,
+					std::string_view source,
+					std::vector<Message> &messages)
+{
+    MessageLog log;
+
+    CompiledProgram program;
+
+    program.m_name = name;
+    program.m_main_chunk_index = m_runner.compile(name, source, log);
+
+    if(program.m_main_chunk_index != ExecutionEngine::no_chunk)
+	program.m_program = m_runner.get_program();
+
+    take_messages(log, messages);
+
+    return program;
+}
+
+bool CompiledProgram::execute(const Options &opt,
+			      std::ostream &out,
+			      std::vector<Message> &messages) const
+{
+    MessageLog log;
+
+    if(!m_program)
+    {
+	report_message(log, { m_name, {} }, "Error", "The program did not compile");
+
+	take_messages(log, messages);
+
+	return false;
+    }
+
+    ExecutionEngine engine(m_program, out);
+
+    bool ok = execute_program(engine, m_main_chunk_index, m_name, opt, out, log);
+
+    take_messages(log, messages);
+
+    return ok;
+}
+
+bool CompiledProgram::execute(const Options &opt,
+			      string &output,
+			      std::vector<Message> &messages) const
+{
+    std::stringbuf buffer;
+    std::ostream out(&buffer);
+
+    bool ok = execute(opt, out, messages);
+
+    if(ok)
+	output = std::move(buffer).str();
+    else
+	output.clear();
+
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// SegmentStream
+//////////////////////////////////////////////////////////////////////////////
+
+struct SegmentStream::Pipe
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    std::deque<std::vector<PathSegment>> batches;
+
+    // The program waits while this many batches haven't been taken.
+    static constexpr size_t max_batches = 4;
+
+    bool done = false;
+    bool stopped = false;
+
+    bool ok = false;
+    std::vector<Message> messages;
+};
+
+// Thrown out of the program when the stream is destroyed before the end.
+// It's a CancelledException, so that execute_program() reports it as a
+// cancelled run, rather than as an unknown error.
+struct StoppedException : ExecutionEngine::CancelledException {};
+
+// Runs on the program's thread: gathers what the turtle emits into segments,
+// and passes them through the pipe a batch at a time.
+class SegmentStream::Producer final : public TurtleEmitInterface
+{
+    Pipe &m_pipe;
+
+    size_t m_batch_size;
+
+    std::vector<PathSegment> m_batch;
+
+    void emit_arg(double val)
+    {
+	auto &segment = m_batch.back();
+
+	assert(segment.num_args < static_cast<int>(std::size(segment.args)));
+
+	segment.args[segment.num_args++] = val;
+    }
+
+public:
+    Producer(Pipe &pipe, size_t batch_size)
+	: m_pipe(pipe)
+	, m_batch_size(batch_size)
+    {
+	m_batch.reserve(batch_size);
+    }
+
+    // Each command starts a segment.  The space and newline commands are
+    // only for the text.
+    void emit_char(char ch) override
+    {
+	if(ch == ' ' || ch == '\n')
+	    return;
+
+	if(m_batch.size() == m_batch_size)
+	    send();
+
+	m_batch.push_back({ ch });
+    }
+
+    void emit_flag(bool flag) override
+    {
+	emit_arg(flag ? 1.0 : 0.0);
+    }
+
+    void emit_number(double val) override
+    {
+	emit_arg(val);
+    }
+
+    // Passes the batch on, once there's room for it.
+    void send()
+    {
+	if(m_batch.empty())
+	    return;
+
+	std::unique_lock lock(m_pipe.mutex);
+
+	m_pipe.changed.wait(lock, [this]
+	{
+	    return m_pipe.stopped || m_pipe.batches.size() < Pipe::max_batches;
+	});
+
+	if(m_pipe.stopped)
+	    throw StoppedException{};
+
+	m_pipe.batches.push_back(std::move(m_batch));
+
+	m_pipe.changed.notify_all();
+
+	m_batch = {};
+	m_batch.reserve(m_batch_size);
+    }
+};
+
+// The program's thread, which owns what it runs
+static void *run_thread(void *arg)
+{
+    std::unique_ptr<std::function<void()>> run(
+			static_cast<std::function<void()> *>(arg));
+
+    (*run)();
+
+    return nullptr;
+}
+
+SegmentStream::SegmentStream(const CompiledProgram &program,
+			     const Options &opt,
+			     size_t batch_size)
+    : m_pipe(std::make_shared<Pipe>())
+{
+    if(!program)
+    {
+	MessageLog log;
+
+	report_message(log, { program.m_name, {} }, "Error",
+		       "The program did not compile");
+
+	m_pipe->messages = log.get_messages();
+	m_pipe->done = true;
+
+	return;
+    }
+
+    // Only the output options that apply to the path data itself
+    Options run_opt = opt;
+
+    run_opt.binary = false;
+    run_opt.binary64 = false;
+
+    if(!run_opt.max_stack)
+	run_opt.max_stack = Options::untrusted_max_stack;
+
+    auto run = std::make_unique<std::function<void()>>(
+	[pipe = m_pipe,
+	 program = program.m_program,
+	 main_chunk_index = program.m_main_chunk_index,
+	 name = program.m_name,
+	 run_opt,
+	 batch_size = std::max<size_t>(batch_size, 1)]
+	{
+	    // Only the SVG wrapper (with -s) is written here.
+	    std::stringbuf buffer;
+	    std::ostream discard(&buffer);
+
+	    ExecutionEngine engine(program, discard);
+
+	    Producer producer(*pipe, batch_size);
+
+	    engine.set_segment_sink(producer);
+
+	    MessageLog log;
+
+	    bool ok = execute_program(engine, main_chunk_index, name, run_opt,
+				      discard, log);
+
+	    try
+	    {
+		if(ok)
+		    producer.send();
+	    }
+	    catch(const StoppedException &)
+	    {
+	    }
+
+	    std::lock_guard lock(pipe->mutex);
+
+	    pipe->ok = ok;
+	    pipe->messages = log.get_messages();
+	    pipe->done = true;
+
+	    pipe->changed.notify_all();
+	});
+
+    pthread_attr_t attr;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, ExecutionEngine::thread_stack_size);
+
+    int error = pthread_create(&m_thread, &attr, run_thread, run.get());
+
+    pthread_attr_destroy(&attr);
+
+    // As std::thread would
+    if(error)
+	throw std::system_error(error, std::generic_category(),
+				"SegmentStream");
+
+    run.release();
+
+    m_running = true;
+}
+
+SegmentStream::~SegmentStream()
+{
+    if(m_running)
+    {
+	{
+	    std::lock_guard lock(m_pipe->mutex);
+
+	    m_pipe->stopped = true;
+
+	    m_pipe->changed.notify_all();
+	}
+
+	pthread_join(m_thread, nullptr);
+    }
+}
+
+bool SegmentStream::next(std::vector<PathSegment> &batch)
+{
+    batch.clear();
+
+    std::unique_lock lock(m_pipe->mutex);
+
+    m_pipe->changed.wait(lock, [this]
+    {
+	return m_pipe->done || !m_pipe->batches.empty();
+    });
+
+    if(m_pipe->batches.empty())
+	return false;
+
+    batch = std::move(m_pipe->batches.front());
+
+    m_pipe->batches.pop_front();
+
+    m_pipe->changed.notify_all();
+
+    return true;
+}
+
+bool SegmentStream::ok() const
+{
+    std::lock_guard lock(m_pipe->mutex);
+
+    return m_pipe->done && m_pipe->ok;
+}
+
+const std::vector<Message> &SegmentStream::get_messages() const
+{
+    std::lock_guard lock(m_pipe->mutex);
+
+    return m_pipe->messages;
+}
@@ -0,0 +1,211 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "Engine.h"
+#include "Messages.h"
+#include "Options.h"
+#include "ProgramRunner.h"
+
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <vector>
+#include <memory>
+
+#include <pthread.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// The embedding API - for running programs in-process (libsvgpathturtle)
+//
+//   TurtleCompiler compiler;
+//   std::vector<Message> messages;
+//
+//   auto program = compiler.compile("star", source, messages);
+//
+//   std::string path_data;
+//
+//   if(program && program.execute(options, path_data, messages))
+//       ...
+//
+//   - Nothing exits, or writes to stderr: errors and warnings are returned
+//     as Messages (Message::to_string() gives the text that
+//     svg_path_turtle would have written).
+//
+//   - The programs of one TurtleCompiler share their imports, so
+//     library.svgt is only parsed once (see ProgramRunner).  Each program
+//     needs a name of its own for that, since a name that was used before
+//     starts over with new imports.  The name is also the filename in
+//     messages.  Imports are read from files, as usual, and read again
+//     once their files have changed.
+//
+//   - Only the output options of an Options are used (the format, decimal
+//     places, simplify, integer grid, SVG wrapper, pen warning and params),
+//     and its limits, as with the requests of --server.  Options::cancel
+//     can be set, to stop a run from another thread.
+//
+//   - A CompiledProgram can be run any number of times, and on any thread,
+//     each run with an engine of its own.  Its compiler must not be
+//     compiling at the same time, though, since the programs that it
+//     compiles are added to the same code.
+//
+//   - A SegmentStream runs a program as its segments are wanted, rather than
+//     all at once: see below.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// One command of the path data.  The commands are always absolute, and the
+// arguments are as in SVG, with A's flags (arguments 3 and 4) as 0 or 1.
+struct PathSegment
+{
+    char command = 0; // M L A Q T C S or Z
+
+    int num_args = 0;
+
+    double args[7] = {};
+};
+
+class CompiledProgram
+{
+    friend class TurtleCompiler;
+    friend class SegmentStream;
+
+    ExecutionEngine::SharedProgram m_program;
+
+    size_t m_main_chunk_index = ExecutionEngine::no_chunk;
+
+    std::string m_name;
+
+public:
+    // False if the program didn't compile
+    explicit operator bool() const
+    {
+	return m_program != nullptr;
+    }
+
+    const std::string &get_name() const
+    {
+	return m_name;
+    }
+
+    // Runs the program, writing its output (and the SVG wrapper, with
+    // opt.svg_out) to out.  After an error, out may have part of it.
+    // Messages are added to 'messages'.  Returns false if there were
+    // errors.
+    bool execute(const Options &opt,
+		 std::ostream &out,
+		 std::vector<Message> &messages) const;
+
+    // As above, but the output is returned in 'output', and is empty after
+    // an error.
+    bool execute(const Options &opt,
+		 std::string &output,
+		 std::vector<Message> &messages) const;
+};
+
+class TurtleCompiler
+{
+    ProgramRunner m_runner;
+
+public:
+    explicit TurtleCompiler(bool bytecode = false)
+	: m_runner(bytecode)
+    {
+    }
+
+    // Compiles the program text, named 'name' (see above).  Messages are
+    // added to 'messages'.  The program is false if there were errors.
+    CompiledProgram compile(const std::string &name,
+			    std::string_view source,
+			    std::vector<Message> &messages);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SegmentStream - a program's path data, as PathSegments, on demand
+//
+//   SegmentStream segments(program, options);
+//   std::vector<PathSegment> batch;
+//
+//   while(segments.next(batch))
+//       ... draw them, or stop at any point ...
+//
+//   if(!segments.ok())
+//       ... segments.get_messages() ...
+//
+//   The program runs on a thread of its own, which stops whenever it is a
+//   few batches ahead of next(), so only those batches are ever held in
+//   memory.  Destroying the stream before the end stops the program.
+//
+//   (The default backend recurses natively, and the bytecode one calls
+//   the turtle, and so the stream, in the middle of an instruction, so a
+//   run can't simply be suspended part way through, as a coroutine would
+//   be.  The thread gives the same effect.  It has a stack of
+//   ExecutionEngine::thread_stack_size, whatever the platform's default
+//   for threads is, so that too deep a recursion is a stack overflow
+//   error, as on the main thread.  Without opt.max_stack, the stack is
+//   limited as for --server.)
+//
+//   The output options apply as for CompiledProgram::execute(), except for
+//   the text formats (and -s), which have no effect.  The numbers are not
+//   rounded to the decimal places, unless they are on the integer grid.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class SegmentStream
+{
+    struct Pipe;
+    class Producer;
+
+    std::shared_ptr<Pipe> m_pipe;
+
+    // A pthread, for the size of its stack (see above)
+    pthread_t m_thread{};
+    bool m_running = false;
+
+public:
+    SegmentStream(const SegmentStream &) = delete;
+    SegmentStream &operator=(const SegmentStream &) = delete;
+
+    // Starts running the program.  Its segments come in batches of up to
+    // batch_size.
+    SegmentStream(const CompiledProgram &program,
+		  const Options &opt,
+		  size_t batch_size = 1024);
+
+    // Stops the program, if it's still running.
+    ~SegmentStream();
+
+    // Replaces the contents of batch with the next segments.  Returns false
+    // (and an empty batch) once there are no more.
+    bool next(std::vector<PathSegment> &batch);
+
+    // Once next() has returned false: whether the program ran without
+    // errors, and its errors and warnings.
+    bool ok() const;
+
+    const std::vector<Message> &get_messages() const;
+};
@@ -0,0 +1,528 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+// Definitions of the BasicSvgPathTurtle<> members - the ones that produce
+// output.  These are only included by the files that explicitly instantiate
+// BasicSvgPathTurtle<> for an emitter (Turtle.cpp for SvgPathTurtle, and
+// OstreamTurtle.cpp), so that each emitter's emit_*() calls get inlined into
+// f(), arc() and friends.
+
+#include "Turtle.h"
+#include "MathUtil.h"
+
+#include <cmath>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Utilities
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static constexpr double epsilon = 1e-5;
+
+static inline void normalize(double &angle)
+{
+    while(angle >= 360.0)
+	angle -= 360.0;
+    while(angle < 0)
+	angle += 360.0;
+}
+
+static inline bool same_double(double d1, double d2)
+{
+    return std::abs(d2 - d1) <= epsilon;
+}
+
+static inline char angle_type(double angle)
+{
+    normalize(angle);
+
+    if(same_double(angle, 0.0) || same_double(angle, 180.0))
+	return 'h';
+
+    if(same_double(angle, 90.0) || same_double(angle, 270.0))
+	return 'v';
+
+    return 0;
+}
+
+// adjust_angle() - adjust the turtle's direction to how it moved, unless it
+// did not move.
+static inline bool adjust_angle(double &angle, double dx, double dy)
+{
+    if(!same_double(dx, 0.0) || !same_double(dy, 0.0))
+    {
+	angle = atanD(dy / dx);
+
+	if(dx < 0)
+	{
+	    angle -= 180.0;
+	    normalize(angle);
+	}
+
+	return true;
+    }
+    else
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  BasicSvgPathTurtle
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// -- Path Management ----------------------------------
+
+template<class Emitter>
+bool BasicSvgPathTurtle<Emitter>::prepare_draw(const Point &current_pt)
+{
+    if(pen_is_on_paper())
+    {
+	if(m_state.path.clear_has_moved())
+	{
+	    emit_item('M');
+	    emit_item(current_pt);
+
+	    m_initial_pt = current_pt;
+	    m_initial_pt_is_inherited = false;
+	}
+
+	// will be drawing, so saved points become invalid
+	m_turtle_stack.clear_saved_points();
+
+	return true;
+    }
+
+    // when pen is not on paper, any draw command is a movement command.
+    m_state.path.set_has_moved();
+
+    return false;
+}
+
+// -- Emit ---------------------------------------------
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::emit_item(char ch)
+{
+    emitter().emit_char(ch);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::emit_item(double val)
+{
+    emitter().emit_number(val);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::emit_item(bool flag)
+{
+    emitter().emit_flag(flag);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::emit_item(Point pt)
+{
+    convert_to_world(pt);
+
+    emitter().emit_number(pt.x);
+    emitter().emit_number(pt.y);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::emit_item(Length l)
+{
+    convert_to_world(l);
+
+    emitter().emit_number(l.value);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::emit_item(Angle a)
+{
+    convert_to_world(a);
+
+    emitter().emit_number(a.value);
+}
+
+// -- Turtle Commands ----------------------------------
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::f(double distance)
+{
+    auto current_pt = m_state.point;
+
+    const auto &unit = get_unit_dir();
+
+    m_state.point.move(distance * unit.x, distance * unit.y);
+
+    draw(current_pt, 'L');
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::arc(double radius, double angle)
+{
+    auto current_pt = m_state.point;
+
+    bool sweep_dir = angle >= 0;
+
+    const double walk_rotation = sweep_dir ? 90 : -90;
+
+    if(is_reflection_viewport())
+	sweep_dir = !sweep_dir;
+
+    while(angle > 360.0)
+	angle -= 360.0;
+    while(angle < -360.0)
+	angle += 360.0;
+
+    if(!same_double(angle, 0.0))
+    {
+	const bool large_arc = std::abs(angle) >= 180;
+
+	// with a series of no-output commands, it is easy to calculate the final
+	// position.  OPTIMIZE: could just calculate it directly, and then
+	// would not need MoveCalcRAII.  But this is the "Turtle" way to do it.
+
+	{
+	    MoveCalcRAII mcr(*this);
+
+	    r(walk_rotation);
+
+	    jump(radius);
+
+	    r(angle - 180);
+
+	    jump(radius);
+
+	    r(walk_rotation);
+	}
+
+	draw(current_pt, 'A', Length{radius}, Length{radius}, 0.0,
+			      large_arc, sweep_dir);
+    }
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::q(double dx, double dy, double angle)
+{
+    auto current_pt = m_state.point;
+
+    normalize(angle);
+
+    const auto x = m_state.point.x;
+    const auto y = m_state.point.y;
+
+    // this is the calculated intersection point, or "control point"
+    Point control_pt;
+
+    double m1 = tanD(m_state.dir);
+    double m2 = tanD(angle);
+
+    auto t1 = angle_type(m_state.dir);
+    auto t2 = angle_type(angle);
+
+    if(t1 == 'v' || t2 == 'v')
+    {
+	if(t1 == t2)
+	    throw ParallelLinesException{};
+
+	if(t1 == 'v')
+	{
+	    // m1 is vertical, m2 is not
+
+	    control_pt.x = x;
+	    control_pt.y = m2 * -dx + y + dy;
+	}
+	else
+	{
+	    // m2 is vertical, m1 is not
+	    control_pt.x = x + dx;
+	    control_pt.y = m1 * dx + y;
+	}
+    }
+    else if(same_double(m1, m2))
+	throw ParallelLinesException{};
+    else
+    {
+	// intersection of two lines - x,y,dir, and x+dx,y+dy,angle
+	control_pt.x = ((m1*x - m2*(x+dx)) + dy) / (m1 - m2);
+	control_pt.y = m1 * (control_pt.x - x) + y;
+    }
+
+    m_state.point.move(dx, dy);
+    m_state.dir = angle;
+
+    draw(current_pt, 'Q', control_pt);
+
+    reflect_q_control_pt(control_pt);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::Q(double new_x, double new_y, double angle)
+{
+    q(new_x - m_state.point.x, new_y - m_state.point.y, angle);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::t(double distance)
+{
+    auto current_pt = m_state.point;
+
+    {
+	MoveCalcRAII mcr(*this);
+
+	jump(distance);
+    }
+
+    auto [has_next, control_pt] = m_state.path.get_next_q_control_pt();
+
+    if(has_next)
+    {
+	double dx = (m_state.point.x - control_pt.x);
+	double dy = (m_state.point.y - control_pt.y);
+
+	adjust_angle(m_state.dir, dx, dy);
+    }
+
+    draw(current_pt, 'T');
+
+    if(has_next)
+	reflect_q_control_pt(control_pt);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::c(double l1, double a1, double l2, double a2,
+				    double dx, double dy)
+{
+    if(pen_is_on_paper())
+    {
+	auto current_pt = m_state.point;
+
+	normalize(a1);
+	normalize(a2);
+
+	const auto x = m_state.point.x;
+	const auto y = m_state.point.y;
+
+	// a1 is from starting point
+	Point start_control_pt{
+			x + l1 * cosD(a1),
+			y + l1 * sinD(a1)
+		     };
+
+	// a2 is *into* ending point
+	Point end_control_pt{
+			x + dx - l2 * cosD(a2),
+			y + dy - l2 * sinD(a2)
+		     };
+
+	m_state.point.move(dx, dy);
+	m_state.dir = a2;
+
+	draw(current_pt, 'C', start_control_pt, end_control_pt);
+    }
+    else
+    {
+	m_state.point.move(dx, dy);
+	m_state.dir = a2;
+    }
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::C(double l1, double a1, double l2, double a2,
+				    double new_x, double new_y)
+{
+    c(l1, a1, l2, a2, new_x - m_state.point.x, new_y - m_state.point.y);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::s(double l2, double a2, double dx, double dy)
+{
+    if(pen_is_on_paper())
+    {
+	auto current_pt = m_state.point;
+
+	normalize(a2);
+
+	const auto x = m_state.point.x;
+	const auto y = m_state.point.y;
+
+	// a2 is *into* ending point
+	Point end_control_pt{
+			x + dx - l2 * cosD(a2),
+			y + dy - l2 * sinD(a2)
+		     };
+
+	m_state.point.move(dx, dy);
+	m_state.dir = a2;
+
+	draw(current_pt, 'S', end_control_pt);
+    }
+    else
+    {
+	m_state.point.move(dx, dy);
+	m_state.dir = a2;
+    }
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::S(double l2, double a2, double new_x, double new_y)
+{
+    s(l2, a2, new_x - m_state.point.x, new_y - m_state.point.y);
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::z()
+{
+    if(m_initial_pt_is_inherited)
+	m_used_inherited_initial_pt = true;
+
+    double dx = (m_initial_pt.x - m_state.point.x);
+    double dy = (m_initial_pt.y - m_state.point.y);
+
+    auto current_pt = m_state.point;
+
+    m_state.point = m_initial_pt;
+
+    adjust_angle(m_state.dir, dx, dy);
+
+    if(prepare_draw(current_pt))
+    {
+	// Z is special, because it does not emit a destination point.
+	emit_item('Z');
+
+	m_turtle_stack.clear_saved_points();
+    }
+}
+
+// -- Trigonometry Commands ----------------------------
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::adjacent_for_hypotenuse(double angle, double hypotenuse)
+{
+    f(hypotenuse * cosD(angle));
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::adjacent_for_opposite(double angle, double opposite)
+{
+    f(opposite / tanD(angle));
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::hypotenuse_for_adjacent(double angle, double adjacent)
+{
+    f(adjacent / cosD(angle));
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::hypotenuse_for_opposite(double angle, double opposite)
+{
+    f(opposite / sinD(angle));
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::hypotenuse_for_both(double adjacent, double opposite)
+{
+    double distance = sqrt(adjacent * adjacent + opposite * opposite);
+
+    if(distance != 0.0)
+      f(sqrt(adjacent * adjacent + opposite * opposite));
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::orbit(double cx, double cy, double angle)
+{
+    double dx = m_state.point.x - cx;
+    double dy = m_state.point.y - cy;
+
+    if(adjust_angle(m_state.dir, dx, dy))
+    {
+	r(angle < 0 ? -90 : 90);
+
+	auto radius = sqrt(dx*dx + dy*dy);
+
+	arc(radius, angle);
+    }
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::ellipse(double rx, double ry)
+{
+    // This draws a whole ellipse, centered around the turtle.  It won't
+    // be useful for implementing an 'e' command, which would have to smoothly
+    // continue an arc of an ellipse from the current turtle's position.
+
+    auto angle = m_state.dir;
+
+    double dx = rx * get_unit_dir().x;
+    double dy = rx * get_unit_dir().y;
+
+    push();
+
+    m(dx, dy);
+
+    r(90);
+
+    // OPTIMIZATION: convert angle to world once, and pass as raw value
+    // to the 2 draw() commands below.
+    {
+	Angle a{angle};
+
+	convert_to_world(a);
+
+	angle = a.value;
+    }
+
+    auto current_pt = m_state.point;
+
+    m_state.point.move(-dx*2, -dy*2);
+
+    draw(current_pt, 'A', Length{rx}, Length{ry}, angle, 0.0, 1.0);
+
+    current_pt = m_state.point;
+
+    m_state.point.move(dx*2, dy*2);
+
+    draw(current_pt, 'A', Length{rx}, Length{ry}, angle, 0.0, 1.0);
+
+    pop();
+}
+
+// -- Formatting Commands -- ---------------------------
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::nl()
+{
+    emit_item('\n');
+}
+
+template<class Emitter>
+void BasicSvgPathTurtle<Emitter>::sp()
+{
+    emit_item(' ');
+}
@@ -0,0 +1,231 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#include "Watch.h"
+
+#include "Messages.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <thread>
+#include <system_error>
+
+using std::string;
+
+namespace fs = std::filesystem;
+
+ProgramWatcher::ProgramWatcher(const Options &opt)
+    : m_opt(opt)
+    , m_runner(opt.bytecode)
+{
+}
+
+bool ProgramWatcher::read_file(const string &filename, WatchedFile &file)
+{
+    std::error_code ec;
+
+    file.mtime = fs::last_write_time(filename, ec);
+    file.exists = !ec;
+
+    if(!file.exists)
+	return false;
+
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+
+    if(!in)
+	return false;
+
+    file.content.assign(std::istreambuf_iterator<char>(in),
+			std::istreambuf_iterator<char>{});
+
+    return true;
+}
+
+std::set<string> ProgramWatcher::find_changes()
+{
+    std::set<string> changed;
+
+    for(auto &[filename, file] : m_files)
+    {
+	std::error_code ec;
+
+	auto mtime = fs::last_write_time(filename, ec);
+
+	if(ec)
+	{
+	    // Most likely being replaced; it's read when it's back.
+	    file.exists = false;
+	    continue;
+	}
+
+	if(file.exists && mtime == file.mtime)
+	    continue;
+
+	WatchedFile now;
+
+	if(read_file(filename, now) && now.content != file.content)
+	    changed.insert(filename);
+
+	file = std::move(now);
+    }
+
+    return changed;
+}
+
+void ProgramWatcher::watch_new_files()
+{
+    for(const auto &filename : m_runner.get_filenames())
+	if(!m_files.contains(filename))
+	    read_file(filename, m_files[filename]);
+}
+
+bool ProgramWatcher::write_output(const string &output, size_t &bytes_written)
+{
+    const auto &filename = m_opt.output_filename;
+
+    // The file is only rewritten from where it differs, unless it isn't what
+    // was last written to it (it's new, or someone else has written to it).
+    std::error_code ec;
+
+    bool rewrite = !m_have_output
+		|| fs::file_size(filename, ec) != m_output.size() || ec;
+
+    size_t start = 0;
+
+    if(!rewrite)
+	start = std::mismatch(output.begin(), output.end(),
+			      m_output.begin(), m_output.end()).first
+		- output.begin();
+
+    if(!rewrite && start == output.size() && output.size() == m_output.size())
+    {
+	bytes_written = 0;
+	return true;
+    }
+
+    std::fstream out;
+
+    if(rewrite)
+	out.open(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+    else
+	out.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+
+    if(out)
+    {
+	out.seekp(static_cast<std::streamoff>(start));
+	out.write(output.data() + start,
+		  static_cast<std::streamsize>(output.size() - start));
+	out.close();
+    }
+
+    if(!out)
+    {
+	report_message(std::cerr, {}, "Error", "Can't write '" + filename + "'");
+	return false;
+    }
+
+    if(output.size() < m_output.size() && !rewrite)
+    {
+	fs::resize_file(filename, output.size(), ec);
+
+	if(ec)
+	{
+	    report_message(std::cerr, {}, "Error",
+			   "Can't truncate '" + filename + "': " + ec.message());
+	    return false;
+	}
+    }
+
+    m_output = output;
+    m_have_output = true;
+
+    bytes_written = output.size() - start;
+
+    return true;
+}
+
+bool ProgramWatcher::build(const std::set<string> &changed)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const auto &input_filename = m_opt.input_filename;
+
+    m_runner.reread_files(changed);
+
+    string output;
+
+    bool ok = m_runner.run(input_filename, m_files[input_filename].content,
+			   m_opt, std::cerr, output);
+
+    size_t bytes_written = 0;
+
+    if(ok && !write_output(output, bytes_written))
+	return false;
+
+    watch_new_files();
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		  std::chrono::steady_clock::now() - start).count();
+
+    std::string status = ok ? "Built in " : "Failed in ";
+
+    status += std::to_string(ms) + " ms";
+
+    if(ok)
+	status += ", wrote " + std::to_string(bytes_written) + " of "
+		+ std::to_string(output.size()) + " bytes";
+
+    status += ", watching " + std::to_string(m_files.size()) + " files";
+
+    report_message(std::cerr, {}, "Info", status);
+
+    return true;
+}
+
+int ProgramWatcher::watch()
+{
+    const auto &input_filename = m_opt.input_filename;
+
+    if(!read_file(input_filename, m_files[input_filename]))
+    {
+	report_message(std::cerr, {}, "Error",
+		       "Can't read '" + input_filename + "'");
+	return 1;
+    }
+
+    if(!build({}))
+	return 1;
+
+    for(;;)
+    {
+	std::this_thread::sleep_for(s_poll_interval);
+
+	auto changed = find_changes();
+
+	if(!changed.empty() && !build(changed))
+	    return 1;
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ *  MIT License
+ *  
+ *  Copyright (c) 2026 mmkns
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+#pragma once
+
+#include "ProgramRunner.h"
+#include "Options.h"
+
+#include <string>
+#include <map>
+#include <set>
+#include <chrono>
+#include <filesystem>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ProgramWatcher - runs a program again whenever its files change (--watch)
+//
+//   - The files are the program and the modules that it imports (and that
+//     they import).  They are polled for their modification times, and a
+//     file whose contents haven't changed (e.g. saved again as it was) is
+//     ignored.  So is a file that has gone missing, since editors often
+//     replace a file by renaming another over it.
+//
+//   - The program is run by one ProgramRunner, which keeps the parsed
+//     modules.  Only the program itself, the modules that changed and the
+//     modules that import them are parsed again.
+//
+//   - The output file is only written after a run without errors, and only
+//     from the first byte that differs from what it already holds.  After
+//     an error, the output of the last good run stays in place.
+//
+//   It runs until it's killed.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class ProgramWatcher
+{
+    struct WatchedFile
+    {
+	bool exists = false;
+
+	std::filesystem::file_time_type mtime;
+
+	std::string content;
+    };
+
+    const Options &m_opt;
+
+    ProgramRunner m_runner;
+
+    std::map<std::string, WatchedFile> m_files;
+
+    // What the output file holds
+    std::string m_output;
+    bool m_have_output = false;
+
+    static constexpr std::chrono::milliseconds s_poll_interval{10};
+
+    // Returns false if it can't be read.
+    static bool read_file(const std::string &filename, WatchedFile &file);
+
+    // The files whose contents have changed since they were last read
+    std::set<std::string> find_changes();
+
+    // Adds the files that were read by the last build.
+    void watch_new_files();
+
+    // Both return false (after reporting it) if the output file can't be
+    // written.
+    bool build(const std::set<std::string> &changed);
+
+    bool write_output(const std::string &output, size_t &bytes_written);
+
+public:
+    ProgramWatcher(const ProgramWatcher &) = delete;
+    ProgramWatcher &operator=(const ProgramWatcher &) = delete;
+
+    explicit ProgramWatcher(const Options &opt);
+
+    // Only returns (with the exit code, 1) if the program can't be read, or
+    // the output can't be written.
+    int watch();
+};
@@ -34,10 +34,24 @@
 #include "BasicSVG.h"
 #include "FileUtil.h"
 #include "Options.h"
+#include "BinaryPath.h"
+#include "Messages.h"
+#include "Compositor.h"
+#include "Server.h"
+#include "Batch.h"
+#include "Watch.h"
+#include "RunMetrics.h"
+#include "Raster.h"
+#include "Polyline.h"
+#include "Png.h"
 
 #include <string>
+#include <chrono>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -99,6 +113,21 @@ public:
     }
 };
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Runs fn (which executes turtle code), reporting any errors
+//
+//////////////////////////////////////////////////////////////////////////////
+
+template<class FN>
+static void run_reporting_errors(EngineErrorReporter &reporter, FN fn)
+{
+    catch_execution_errors(fn, [&](const std::string &msg)
+    {
+	reporter.error_exit(msg);
+    });
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  Utility RAII class for outputting entire SVG file
@@ -111,22 +140,37 @@ class SvgOutRAII
 
     std::ostream &out;
 
+    SVGSymbols *symbols;
+
 public:
     SvgOutRAII(const SvgOutRAII &) = delete;
     SvgOutRAII &operator=(const SvgOutRAII &) = delete;
 
-    SvgOutRAII(const SVGConfig &svg_out, std::ostream &out)
+    // With flush_header, the header is sent before any path data is
+    // produced, so a streaming reader can get started.  With symbols, that
+    // writes the path elements (see SVGSymbols).
+    SvgOutRAII(const SVGConfig &svg_out, std::ostream &out,
+	       bool flush_header = false, SVGSymbols *symbols = nullptr)
 	: svg_out(svg_out)
 	, out(out)
+	, symbols(symbols)
     {
 	if(svg_out)
-	    svg_out.output_header(out);
+	{
+	    svg_out.output_header(out, !symbols);
+
+	    if(flush_header)
+		out.flush();
+	}
     }
 
     ~SvgOutRAII()
     {
+	if(symbols)
+	    symbols->finish();
+
 	if(svg_out)
-	    svg_out.output_footer(out);
+	    svg_out.output_footer(out, !symbols);
     }
 };
 
@@ -136,12 +180,250 @@ public:
 //
 //////////////////////////////////////////////////////////////////////////////
 
+static void setup_output(const Options &opt, Outfile &output_file)
+{
+    if(opt.stream)
+	output_file.get_buffer().set_streaming(
+		    opt.high_water_mark,
+		    std::chrono::milliseconds(opt.flush_interval_ms));
+}
+
+static void report_output_stats(Outfile &output_file,
+				std::uint64_t segment_count)
+{
+    // Flushing first, so that the byte count is what the reader has seen.
+    output_file.get_buffer().flush();
+
+    std::cerr << "Output: "
+	      << output_file.get_buffer().get_bytes_emitted() << " bytes, "
+	      << segment_count << " segments\n";
+}
+
+// With --png, the picture of the path data is written once it's all been
+// drawn.
+static void write_picture(PathRasterizer &raster, std::ostream &out)
+{
+    raster.finish();
+
+    write_png(out, raster.get_width(), raster.get_height(), raster.get_image());
+}
+
+// With --from-binary, the input is binary path IR (see BinaryPath.h) rather
+// than a program, and it is written out as SVG path data (or with --png,
+// drawn, or with --polylines, flattened).
+static int convert_from_binary(const Options &opt)
+{
+    Infile input_file(opt.input_filename, true);
+
+    Outfile output_file(opt.output_filename, opt.png || opt.polylines);
+
+    if(opt.polylines)
+    {
+	std::ostream &out = output_file;
+
+	PolylineWriter polylines(*out.rdbuf(), opt.polyline_tolerance);
+
+	try
+	{
+	    read_binary_path(input_file, polylines);
+	}
+	catch(const BinaryPathError &err)
+	{
+	    report_message(std::cerr, {}, "Error", err.what());
+	    exit(1);
+	}
+
+	polylines.finish();
+
+	return 0;
+    }
+
+    if(opt.png)
+    {
+	PathRasterizer raster(opt.svg_out);
+
+	try
+	{
+	    read_binary_path(input_file, raster);
+	}
+	catch(const BinaryPathError &err)
+	{
+	    report_message(std::cerr, {}, "Error", err.what());
+	    exit(1);
+	}
+
+	std::ostream &out = output_file;
+
+	write_picture(raster, out);
+
+	return 0;
+    }
+
+    setup_output(opt, output_file);
+
+    OstreamTurtle text(output_file);
+
+    text.set_decimal_places(opt.decimal_places);
+    text.set_output_format(opt.get_output_format());
+    text.set_simplify(opt.simplify);
+    text.set_integer_grid(opt.integer_grid);
+
+    {
+	SvgOutRAII write_svg(opt.svg_out, output_file, opt.stream);
+
+	try
+	{
+	    read_binary_path(input_file, text);
+	}
+	catch(const BinaryPathError &err)
+	{
+	    report_message(std::cerr, {}, "Error", err.what());
+	    exit(1);
+	}
+
+	text.finish();
+    }
+
+    if(opt.output_stats)
+	report_output_stats(output_file, text.get_segment_count());
+
+    return 0;
+}
+
+// With --composite, the input is an SVG template (see Compositor.h), and the
+// output is the SVG file made from it.
+static int composite(const Options &opt)
+{
+    std::string svg_template;
+
+    {
+	Infile input_file(opt.input_filename);
+
+	std::istream &in = input_file;
+
+	svg_template.assign(std::istreambuf_iterator<char>(in),
+			    std::istreambuf_iterator<char>());
+    }
+
+    Outfile output_file(opt.output_filename);
+
+    setup_output(opt, output_file);
+
+    Compositor compositor(opt, opt.get_output_format());
+
+    EngineErrorReporter reporter(compositor.get_engine(), nullptr);
+
+    run_reporting_errors(reporter, [&]
+    {
+	compositor.composite(svg_template, output_file);
+    });
+
+    if(opt.output_stats)
+	report_output_stats(output_file, compositor.get_segment_count());
+
+    return 0;
+}
+
+// With --server, the input is a series of requests (see Server.h), and the
+// output is a series of responses.
+static int serve(const Options &opt)
+{
+    Infile input_file(opt.input_filename, true);
+
+    Outfile output_file(opt.output_filename, true);
+
+    RenderServer server(opt);
+
+    return server.serve(input_file, output_file);
+}
+
+// With --batch, each program is run from its own file, into its own file.
+static int batch(const Options &opt)
+{
+    BatchRenderer batch(opt);
+
+    try
+    {
+	if(!opt.manifest_filename.empty())
+	    batch.add_manifest(opt.manifest_filename);
+
+	for(const auto &filename : opt.batch_filenames)
+	    batch.add_program(filename);
+    }
+    catch(const BatchRenderer::BatchError &err)
+    {
+	report_message(std::cerr, {}, "Error", err.what());
+	return 1;
+    }
+
+    return batch.run(static_cast<unsigned>(opt.jobs)) ? 1 : 0;
+}
+
+// With --watch, the program runs again whenever its files change, until it's
+// killed.
+static int watch(const Options &opt)
+{
+    ProgramWatcher watcher(opt);
+
+    return watcher.watch();
+}
+
+// With --metrics, the costs of the run are written to their own file, as
+// JSON.
+static void write_metrics(const Options &opt, const RunMetrics &metrics)
+{
+    std::ofstream out(opt.metrics_filename);
+
+    if(out)
+	metrics.write_json(out);
+
+    if(!out)
+	report_message(std::cerr, {}, "Error",
+		       "Can't write '" + opt.metrics_filename + "'");
+}
+
+// With --profile, the report goes to stderr, and the folded stacks (with
+// --profile-folded) to their own file.
+static void write_profile(const Options &opt, const EngineDebugger &debugger)
+{
+    std::cerr << "Profile:\n";
+
+    debugger.write_profile(std::cerr);
+
+    if(!opt.profile_folded_filename.empty())
+    {
+	std::ofstream out(opt.profile_folded_filename);
+
+	if(out)
+	    debugger.write_folded_stacks(out);
+
+	if(!out)
+	    report_message(std::cerr, {}, "Error",
+			   "Can't write '" + opt.profile_folded_filename + "'");
+    }
+}
+
 int main(int argc, char **argv)
 {
     Options opt;
 
     opt.parse_command_line(argc, argv);
 
+    if(opt.from_binary)
+	return convert_from_binary(opt);
+
+    if(opt.composite)
+	return composite(opt);
+
+    if(opt.server)
+	return serve(opt);
+
+    if(opt.batch)
+	return batch(opt);
+
+    if(opt.watch)
+	return watch(opt);
+
     // Prepare Debugger
 
     std::unique_ptr<EngineDebugger> debugger;
@@ -154,23 +436,123 @@ int main(int argc, char **argv)
 	debugger->set_parse_trace_level(opt.parse_trace_level);
 	debugger->set_report_breakpoints(opt.report_breakpoints);
 	debugger->set_show_stacks(true);
+	debugger->set_profile(opt.profile,
+			      static_cast<unsigned>(opt.sample_interval));
     }
 
     // Prepare Execution Engine
 
-    Outfile output_file(opt.output_filename);
+    Outfile output_file(opt.output_filename,
+			opt.binary || opt.binary64 || opt.png || opt.polylines);
 
-    ExecutionEngine engine(output_file, debugger.get());
+    setup_output(opt, output_file);
+
+    // With --fit, the path data is held here until the program has run, so
+    // that the SVG header can have its bounding box.
+    std::ostringstream fit_buffer;
+
+    std::ostream &out = output_file;
+    std::ostream &path_out = opt.fit ? fit_buffer : out;
+
+    auto backend = opt.bytecode ? ExecutionEngine::Backend::bytecode
+			        : ExecutionEngine::Backend::closures;
+
+    ExecutionEngine engine(path_out, debugger.get(), backend);
 
     engine.set_decimal_places(opt.decimal_places);
 
-    if(opt.optimize)
-	engine.set_output_format(OstreamTurtle::optimized_output);
-    else if(opt.prettyprint)
-	engine.set_output_format(OstreamTurtle::prettyprint_output);
+    engine.set_output_format(opt.get_output_format());
+
+    engine.set_simplify(opt.simplify);
+
+    engine.set_integer_grid(opt.integer_grid);
+
+    if(opt.clip)
+	engine.set_clip(opt.clip_rect);
+
+    engine.set_parallel_threads(static_cast<unsigned>(opt.threads));
+    engine.set_unique_range(static_cast<int>(opt.unique_range));
+    engine.set_memoize(opt.memoize);
+    engine.set_track_bounds(opt.fit);
+    engine.set_sample_interval(static_cast<unsigned>(opt.sample_interval));
+    engine.set_limits(opt.get_limits());
+
+    // With --symbols, what's drawn inside push_matrix ... pop_matrix goes
+    // in the SVG file as symbols, each copy of it placed with a <use>.
+    SVGSymbols symbols(opt.svg_out, path_out, opt.decimal_places);
+
+    if(opt.symbols)
+	engine.set_fragment_sink(&symbols);
+
+    // With --png, the path data is drawn, in place of being written.
+    std::unique_ptr<PathRasterizer> raster;
+
+    if(opt.png)
+    {
+	raster = std::make_unique<PathRasterizer>(opt.svg_out);
+
+	engine.set_segment_sink(*raster);
+    }
+
+    // With --polylines, it is flattened, and written as vertex arrays.
+    std::unique_ptr<PolylineWriter> polylines;
+
+    if(opt.polylines)
+    {
+	polylines = std::make_unique<PolylineWriter>(*path_out.rdbuf(),
+						     opt.polyline_tolerance);
+
+	engine.set_segment_sink(*polylines);
+    }
+
+    // new_path only separates the paths in an SVG file (or picture).
+    // Otherwise, each path's data just follows the previous.
+    if(raster)
+	engine.set_new_path_handler(
+	    [&raster](const std::string &, const std::string &attributes)
+	    {
+		raster->new_path(attributes);
+	    });
+    else if(polylines)
+	engine.set_new_path_handler(
+	    [&polylines](const std::string &, const std::string &)
+	    {
+		polylines->new_path();
+	    });
+    else if(opt.svg_out)
+	engine.set_new_path_handler(
+	    [&opt, &path_out, &symbols](const std::string &name,
+					const std::string &attributes)
+	    {
+		if(opt.symbols)
+		    symbols.new_path(name, attributes);
+		else
+		    opt.svg_out.output_new_path(path_out, name, attributes);
+	    });
 
     // Parse 
 
+    // --dump-ir needs the chunks' names, which the parser gives its sink.
+    // Without --debug, that's all the debugger is used for, so the engine
+    // compiles the program as it would otherwise.
+    EngineDebugger chunk_names;
+
+    ParserDebugSink *parser_sink = debugger ? debugger.get()
+			         : opt.dump_ir ? &chunk_names
+				 : nullptr;
+
+    using Clock = std::chrono::steady_clock;
+
+    RunMetrics metrics;
+
+    auto elapsed_ms = [](Clock::time_point start)
+    {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start)
+								    .count();
+    };
+
+    auto parse_start = Clock::now();
+
     size_t main_chunk_index = ExecutionEngine::no_chunk;
 
     {
@@ -178,25 +560,66 @@ int main(int argc, char **argv)
 
 	Lexer lex(input_file);
 
-	Parser p(lex, engine, debugger.get());
+	Parser p(lex, engine, parser_sink);
 
 	p.set_filename(opt.input_filename);
 
 	p.parse();
 
 	main_chunk_index = p.get_main();
+
+	metrics.imports = p.get_num_modules();
     }
 
+    metrics.parse_ms = elapsed_ms(parse_start);
+
+    for(const auto &[param, value] : opt.params)
+	if(!engine.set_param(main_chunk_index, param, value))
+	{
+	    report_message(std::cerr, {}, "Error",
+			   "The program has no param named '" + param + "'");
+	    return 1;
+	}
+
     if(debugger && opt.list_chunks)
 	debugger->list_chunks(std::cerr);
 
+    if(opt.dump_ir)
+    {
+	const EngineDebugger &names = debugger ? *debugger : chunk_names;
+
+	engine.dump_ir(std::cerr, main_chunk_index, [&names](size_t chunk_index)
+	{
+	    return names.get_chunk_name(chunk_index);
+	});
+    }
+
+    if(opt.arena_stats)
+    {
+	const auto &stats = engine.get_arena_stats();
+
+	std::cerr << "Program arena: "
+		  << stats.allocations << " allocations, "
+		  << stats.bytes << " bytes, "
+		  << stats.blocks << " blocks from the heap ("
+		  << stats.block_bytes << " bytes)\n";
+    }
+
     // Execute 
 
     EngineErrorReporter reporter(engine, debugger.get());
 
-    try
+    // With --fit, the SVG wrapper is written afterwards, around the held
+    // path data.
+    const SVGConfig no_svg_out;
+
+    auto execute_start = Clock::now();
+
+    run_reporting_errors(reporter, [&]
     {
-	SvgOutRAII write_svg(opt.svg_out, output_file);
+	SvgOutRAII write_svg(opt.fit || opt.png ? no_svg_out : opt.svg_out,
+			     output_file, opt.stream,
+			     opt.symbols ? &symbols : nullptr);
 
 	if(debugger && debugger->needs_trace_file())
 	    // Note: debugger trace output is interleaved with the SVG output on
@@ -205,37 +628,46 @@ int main(int argc, char **argv)
 	    debugger->set_trace_output(output_file.get_ptr());
 
 	engine.execute_main(main_chunk_index);
-    }
-    catch(const SvgPathTurtle::ParallelLinesException&)
-    {
-	reporter.error_exit("Parallel lines in q or Q command.");
-    }
-    catch(const SvgPathTurtle::InvalidReflectionException&)
-    {
-	reporter.error_exit("Invalid reflection arguments x==0 and y==0.");
-    }
-    catch(const SvgPathTurtle::EmptyTurtleStackException&)
-    {
-	reporter.error_exit("Empty stack in 'pop' command.");
-    }
-    catch(const SvgPathTurtle::EmptyMatrixStackException&)
-    {
-	reporter.error_exit("Empty stack in 'pop_matrix' command.");
-    }
-    catch(const ExecutionEngine::InfiniteRecursionException&)
-    {
-	reporter.error_exit("Stack overflow - probably due to infinitely "
-			    "recursive user-defined command function");
-    }
-    catch(const std::runtime_error &err)
-    {
-	reporter.error_exit(err.what());
-    }
-    catch(...)
+    });
+
+    metrics.execute_ms = elapsed_ms(execute_start);
+
+    if(raster)
+	write_picture(*raster, out);
+
+    if(polylines)
+	polylines->finish();
+
+    if(opt.fit)
     {
-	reporter.error_exit("Unknown error");
+	SVGConfig svg_out = opt.svg_out;
+
+	const auto &box = engine.get_bounds();
+
+	if(!box.empty)
+	    svg_out.fit_viewbox(box.min_x, box.min_y, box.max_x, box.max_y);
+
+	SvgOutRAII write_svg(svg_out, output_file);
+
+	out << fit_buffer.view();
     }
 
     if(!opt.disable_pen_warning)
 	reporter.report_pen_height_error();
+
+    if(opt.profile)
+	write_profile(opt, *debugger);
+
+    if(opt.output_stats)
+	report_output_stats(output_file, engine.get_segment_count());
+
+    if(!opt.metrics_filename.empty())
+    {
+	output_file.get_buffer().flush();
+
+	metrics.output_bytes = output_file.get_buffer().get_bytes_emitted();
+	metrics.read_engine(engine);
+
+	write_metrics(opt, metrics);
+    }
 }